@@ -0,0 +1,85 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__COMMANDS__PERF_H_
+#define _hCraft__COMMANDS__PERF_H_
+
+#include "command.hpp"
+
+
+namespace hCraft {
+	namespace commands {
+		
+		/* 
+		 * /perf -
+		 * 
+		 * Displays runtime performance metrics: world tick times and backlogs,
+		 * packet handler times, and per-player queues.
+		 * 
+		 * Permissions:
+		 *   - command.info.perf
+		 *       Needed to execute the command.
+		 */
+		class c_perf: public command
+		{
+		public:
+			const char* get_name () { return "perf"; }
+			
+			const char*
+			get_summary ()
+				{ return "Displays runtime performance metrics."; }
+			
+			const char*
+			get_help ()
+			{ return
+				".TH PERF 1 \"/perf\" \"Revision 1\" \"INFO COMMANDS\" "
+				".SH NAME "
+					"perf - Displays runtime performance metrics. "
+					".PP "
+				".SH SYNOPSIS "
+					"$g/perf .LN "
+					"$g/perf $ypackets .LN "
+					"$g/perf $yplayers .LN "
+					"$g/perf $yOPTION "
+					".PP "
+				".SH DESCRIPTION "
+					"Without arguments, displays the median, 95th and 99th percentile "
+					"times of the last few thousand ticks of every loaded world, how "
+					"many ticks the world is running behind (if any), and the amount of "
+					"block, lighting and physics updates waiting to be processed. "
+					"$ypackets $gshows the packet types that took the most time to "
+					"handle, and $yplayers $gshows the players with the most data "
+					"queued for them. The same metrics can be scraped in the Prometheus "
+					"text format if $Bmetrics.listen $gis set in the configuration file. "
+					"If OPTION is specified, then do as follows: "
+					".PP "
+					"$G\\\\help \\h $gDisplay help "
+					".PP "
+					"$G\\\\summary \\s $gDisplay a short description "
+				;}
+			
+			const char* get_exec_permission () { return "command.info.perf"; }
+			
+		//----
+			void execute (player *pl, command_reader& reader);
+		};
+	}
+}
+
+#endif
+
@@ -53,6 +53,8 @@ namespace hCraft {
 		 *       Required to regenerate the world.
 		 *   - commands.world.world.save
 		 *       Required to save the world.
+		 *   - command.world.world.view-distance
+		 *       Required to change the world's view distance.
 		 */
 		class c_world : public command
 		{
@@ -32,6 +32,11 @@ namespace hCraft {
 	/* 
 	 * A featureful class containing methods to draw both 2D and 3D primitives
 	 * onto an edit stage supplied by the user.
+	 * 
+	 * Lines, curves and solids are first rasterized into rows of blocks (see
+	 * drawing/raster.hpp), which are then filled in bulk.  @{max_blocks} is
+	 * checked while rasterizing, so nothing is drawn if a shape goes over it.
+	 * A negative limit means no limit.
 	 */
 	class draw_ops
 	{
@@ -120,6 +125,18 @@ namespace hCraft {
 		 * Returns the total number of blocks modified.
 		 */
 		int filled_ellipse (vector3 pt, double a, double b, blocki material, plane pn = XZ_PLANE, int max_blocks = -1);
+		
+		/* 
+		 * Fills the axis-aligned ellipsoid centered at @{pt} with the given radii.
+		 * Returns the total number of blocks modified.
+		 */
+		int filled_ellipsoid (vector3 pt, double rx, double ry, double rz, blocki material, int max_blocks = -1);
+		
+		/* 
+		 * Fills an upright cylinder whose bottom face is centered at @{pt}.
+		 * Returns the total number of blocks modified.
+		 */
+		int filled_cylinder (vector3 pt, double radius, int height, blocki material, int max_blocks = -1);
 	};
 }
 
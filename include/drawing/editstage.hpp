@@ -21,6 +21,7 @@
 
 #include "util/position.hpp"
 #include "slot/blocks.hpp"
+#include "util/spatial_map.hpp"
 #include <unordered_map>
 #include <unordered_set>
 #include <bitset>
@@ -32,6 +33,7 @@ namespace hCraft {
 	class world; // forward dec
 	class player;
 	class chunk;
+	class span_list;
 	
 	
 	#define ES_NONE	0xFFF
@@ -76,6 +78,15 @@ namespace hCraft {
 		
 		virtual int mod_count_at (int cx, int cz) { return 1; }
 		
+		/* 
+		 * Bulk modification:
+		 * Sets every block from (x0, y, z) to (x1, y, z), or every block covered
+		 * by the given span list.  By default, these just call set () for each
+		 * block.
+		 */
+		virtual void fill_span (int y, int z, int x0, int x1, unsigned short id, unsigned char meta = 0, unsigned char ex = 0);
+		virtual void fill_spans (const span_list& spans, unsigned short id, unsigned char meta = 0, unsigned char ex = 0);
+		
 		
 		/* 
 		 * Sends all modified blocks to the specified player(s).
@@ -150,6 +161,8 @@ namespace hCraft {
 	
 	//----
 		des_chunk ();
+		des_chunk (des_chunk&& other);
+		des_chunk (const des_chunk&) = delete;
 		~des_chunk ();
 	};
 	
@@ -162,7 +175,7 @@ namespace hCraft {
 	 */
 	class dense_edit_stage: public edit_stage
 	{
-		std::unordered_map<chunk_pos, des_chunk, chunk_pos_hash> chunks;
+		spatial_map<chunk_pos, des_chunk, chunk_pos_hash> chunks;
 		
 	private:
 		void send_to_players (std::vector<player *>& players,
@@ -179,8 +192,28 @@ namespace hCraft {
 		virtual blocki get (int x, int y, int z) override;
 		virtual void reset (int x, int y, int z) override;
 		
+		/* 
+		 * Like get (), but only succeeds if the block has been modified in this
+		 * edit stage (the underlying world is not looked at).
+		 */
+		bool get_staged (int x, int y, int z, blocki& out);
+		
+		/* 
+		 * Resets all blocks in the 8x8x8 microchunk that contains the specified
+		 * block.
+		 */
+		void reset_micro (int x, int y, int z);
+		
 		virtual int mod_count_at (int cx, int cz) override;
 		
+		/* 
+		 * Bulk modification:
+		 * fill_spans () splits the spans by chunk, and fills large span lists
+		 * using several threads (each chunk is filled by a single thread).
+		 */
+		virtual void fill_span (int y, int z, int x0, int x1, unsigned short id, unsigned char meta = 0, unsigned char ex = 0) override;
+		virtual void fill_spans (const span_list& spans, unsigned short id, unsigned char meta = 0, unsigned char ex = 0) override;
+		
 		
 		/* 
 		 * Sends all modified blocks to the specified player(s).
@@ -222,7 +255,7 @@ namespace hCraft {
 	
 	struct ses_chunk
 	{
-		std::unordered_map<block_pos, unsigned int, block_pos_hash> changes;
+		spatial_map<block_pos, unsigned int, block_pos_hash> changes;
 	};
 	
 	
@@ -233,7 +266,7 @@ namespace hCraft {
 	 */
 	class sparse_edit_stage: public edit_stage
 	{
-		std::unordered_map<chunk_pos, ses_chunk, chunk_pos_hash> chunks;
+		spatial_map<chunk_pos, ses_chunk, chunk_pos_hash> chunks;
 		
 	private:
 		void send_to_players (std::vector<player *>& players,
@@ -357,6 +390,12 @@ namespace hCraft {
 		
 		virtual int mod_count_at (int cx, int cz) override;
 		
+		/* 
+		 * Tests every block of every span, and passes on the blocks that pass
+		 * as a new span list.
+		 */
+		virtual void fill_spans (const span_list& spans, unsigned short id, unsigned char meta = 0, unsigned char ex = 0) override;
+		
 		
 		/* 
 		 * Sends all modified blocks to the specified player(s).
@@ -0,0 +1,141 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__RASTER_H_
+#define _hCraft__RASTER_H_
+
+#include "util/position.hpp"
+#include <vector>
+
+
+namespace hCraft {
+	
+	/* 
+	 * A run of blocks along the X axis: every block from (x0, y, z) up to and
+	 * including (x1, y, z).
+	 */
+	struct block_span
+	{
+		int y, z;
+		int x0, x1;
+		
+		inline int length () const { return this->x1 - this->x0 + 1; }
+	};
+	
+	
+	/* 
+	 * The output of a rasterizer: the list of spans that make up a shape.
+	 * 
+	 * Shapes are rasterized in full before any block is set, so that an edit
+	 * stage can fill whole rows at once (see edit_stage::fill_spans ()).  The
+	 * list may be given a budget, in which case adding a span that would take
+	 * the total past it fails, and the rasterizer stops early.
+	 */
+	class span_list
+	{
+		std::vector<block_span> spans;
+		long long total;
+		long long budget; // -1 for none
+		bool over;
+		
+	public:
+		typedef std::vector<block_span>::const_iterator const_iterator;
+		
+	public:
+		span_list (long long budget = -1);
+		
+		
+		inline long long volume () const { return this->total; }
+		inline bool over_budget () const { return this->over; }
+		inline bool empty () const { return this->spans.empty (); }
+		inline std::size_t size () const { return this->spans.size (); }
+		
+		inline const_iterator begin () const { return this->spans.begin (); }
+		inline const_iterator end () const { return this->spans.end (); }
+		
+		
+		/* 
+		 * Adds the span [x0, x1] at (y, z).  Returns false if that would go over
+		 * the budget, in which case nothing is added.
+		 */
+		bool add (int y, int z, int x0, int x1);
+		
+		/* 
+		 * Adds a single block, extending the last span if the block is right
+		 * next to it.
+		 */
+		bool add_point (int x, int y, int z);
+		
+		void clear ();
+	};
+	
+	
+	
+	/* 
+	 * Rasterizers for the shapes drawn by draw_ops.  Each produces exactly the
+	 * blocks (and block counts) that the corresponding draw_ops method used to
+	 * set one at a time, and returns false if the span list went over its
+	 * budget.
+	 */
+	namespace raster {
+		
+		/* 
+		 * A 3D Bresenham line from @{pt1} to @{pt2}.
+		 */
+		bool line (span_list& out, vector3 pt1, vector3 pt2);
+		
+		/* 
+		 * An N-th order bezier curve through N control points, as a series of
+		 * lines.
+		 */
+		bool bezier (span_list& out, const std::vector<vector3>& points);
+		
+		/* 
+		 * A Catmull-Rom curve through all but the first and last points.
+		 */
+		bool curve (span_list& out, const std::vector<vector3>& points);
+		
+		/* 
+		 * The box between two corners (inclusive).
+		 */
+		bool filled_cuboid (span_list& out, vector3 pt1, vector3 pt2);
+		
+		/* 
+		 * All blocks within round (radius) of the center.
+		 */
+		bool filled_sphere (span_list& out, vector3 pt, double radius);
+		
+		/* 
+		 * A one block thick sphere shell.
+		 */
+		bool hollow_sphere (span_list& out, vector3 pt, double radius);
+		
+		/* 
+		 * An axis-aligned ellipsoid with the given radii.
+		 */
+		bool filled_ellipsoid (span_list& out, vector3 pt, double rx, double ry, double rz);
+		
+		/* 
+		 * An upright cylinder whose bottom face is centered at @{pt}.
+		 */
+		bool filled_cylinder (span_list& out, vector3 pt, double radius, int height);
+	}
+}
+
+#endif
+
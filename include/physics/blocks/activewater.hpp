@@ -34,7 +34,7 @@ namespace hCraft {
 			virtual const char* name () { return "activewater"; }
 			virtual int  tick_rate () override { return 5; }
 		
-			virtual void tick (world &w, int x, int y, int z, int data,
+			virtual void tick (physics_context& ctx, int x, int y, int z, int data,
 				void *ptr, std::minstd_rand& rnd) override;
 		};
 	}
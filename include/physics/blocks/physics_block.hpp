@@ -27,6 +27,7 @@ namespace hCraft {
 	
 	class world;
 	class block_physics_worker;
+	class physics_context;
 	
 	
 	/* 
@@ -65,6 +66,15 @@ namespace hCraft {
 		virtual void tick (world &w, int x, int y, int z, int data,
 				void *ptr, std::minstd_rand& rnd) { }
 		
+		/* 
+		 * The version of tick () actually called by the physics loop.  Blocks
+		 * that override this one read and modify the world through the given
+		 * context, which batches everything up.  By default, the context's
+		 * queued updates are submitted and the world version is called.
+		 */
+		virtual void tick (physics_context& ctx, int x, int y, int z, int data,
+				void *ptr, std::minstd_rand& rnd);
+		
 		/* 
 		 * Called when a neighbouring block is destroyed\changed.
 		 */
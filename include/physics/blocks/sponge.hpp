@@ -34,7 +34,7 @@ namespace hCraft {
 			virtual int  tick_rate () override { return 3; }
 			virtual const char* name () { return "water-sponge"; }
 		
-			virtual void tick (world &w, int x, int y, int z, int data,
+			virtual void tick (physics_context& ctx, int x, int y, int z, int data,
 				void *ptr, std::minstd_rand& rnd) override;
 		};
 		
@@ -46,7 +46,7 @@ namespace hCraft {
 			virtual int  tick_rate () override { return 3; }
 			virtual const char* name () { return "water-sponge-agent"; }
 		
-			virtual void tick (world &w, int x, int y, int z, int data,
+			virtual void tick (physics_context& ctx, int x, int y, int z, int data,
 				void *ptr, std::minstd_rand& rnd) override;
 		};
 	}
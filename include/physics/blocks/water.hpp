@@ -35,7 +35,7 @@ namespace hCraft {
 			virtual int  tick_rate () override { return 5; }
 			virtual bool affected_by_neighbours () { return true; }
 		
-			virtual void tick (world &w, int x, int y, int z, int data,
+			virtual void tick (physics_context& ctx, int x, int y, int z, int data,
 				void *ptr, std::minstd_rand& rnd) override;
 			virtual void on_neighbour_modified (world &w, int x, int y, int z,
 				int nx, int ny, int nz) override;
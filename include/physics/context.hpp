@@ -0,0 +1,97 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__PHYSICS_CONTEXT_H_
+#define _hCraft__PHYSICS_CONTEXT_H_
+
+#include "world/world.hpp"
+#include "util/position.hpp"
+#include "util/spatial_map.hpp"
+#include <vector>
+
+
+namespace hCraft {
+	
+	/* 
+	 * Handed to physics blocks by the physics workers, so that they do not
+	 * have to go through the world (and its locks) for every single block they
+	 * look at or modify.
+	 * 
+	 * Reads see the world's edit stage (like world::get_final_block ()), and
+	 * the 3x3x3 neighbourhood of the block being ticked can be fetched in one
+	 * go with focus ().  Writes are collected locally and handed over to the
+	 * world all at once by submit (), until which they are only visible
+	 * through this context.
+	 * 
+	 * Chunks are looked up through the world (under its chunk lock) on every
+	 * read rather than cached, since an evicted chunk may be freed at any time;
+	 * the lookup also marks the chunk as recently used, so chunks that are
+	 * being simulated are not picked for eviction.
+	 */
+	class physics_context
+	{
+		world &w;
+		
+		// cached neighbourhood
+		bool focused;
+		int fx, fy, fz;
+		blocki nbh[27];
+		
+		std::vector<block_update> batch;
+		spatial_map<block_pos, blocki, block_pos_hash> written;
+		
+	private:
+		blocki fetch_nolock (int x, int y, int z);
+		
+	public:
+		inline world& get_world () { return this->w; }
+		inline size_t pending () const { return this->batch.size (); }
+		
+	public:
+		physics_context (world &w);
+		~physics_context ();
+		
+		
+		/* 
+		 * Caches the 3x3x3 cube of blocks centered at the given coordinates.
+		 */
+		void focus (int x, int y, int z);
+		
+		/* 
+		 * Returns the block at the given coordinates, taking queued updates
+		 * into account.
+		 */
+		blocki get (int x, int y, int z);
+		inline unsigned short get_id (int x, int y, int z)
+			{ return this->get (x, y, z).id; }
+		
+		/* 
+		 * Queues an update to the block at the given coordinates.
+		 */
+		void set (int x, int y, int z, unsigned short id, unsigned char meta = 0,
+			int extra = 0);
+		
+		/* 
+		 * Hands all queued updates over to the world.
+		 */
+		void submit ();
+	};
+}
+
+#endif
+
@@ -29,6 +29,7 @@
 #include <unordered_map>
 #include <random>
 #include "util/position.hpp"
+#include "util/spatial_map.hpp"
 #include "tbb/concurrent_queue.h"
 
 
@@ -133,6 +134,17 @@ namespace hCraft {
 				subs[i] = nullptr;
 		}
 		
+		// move constructor
+		ph_mem_chunk (ph_mem_chunk&& other) {
+			for (int i = 0; i < 16; ++i)
+				{
+					subs[i] = other.subs[i];
+					other.subs[i] = nullptr;
+				}
+		}
+		
+		ph_mem_chunk (const ph_mem_chunk&) = delete;
+		
 		// destructor
 		~ph_mem_chunk () {
 			for (int i = 0; i < 16; ++i)
@@ -191,9 +203,8 @@ namespace hCraft {
 		std::vector<std::shared_ptr<physics_worker>> workers;
 		std::mutex lock;
 		
-		std::unordered_map<world *,
-			std::unordered_map<chunk_pos, ph_mem_chunk, chunk_pos_hash>>
-				block_mem;
+		typedef spatial_map<chunk_pos, ph_mem_chunk, chunk_pos_hash> ph_mem_map;
+		std::unordered_map<world *, ph_mem_map> block_mem;
 				
 	public:
 		tbb::concurrent_queue<physics_update> updates;
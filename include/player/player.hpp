@@ -39,6 +39,7 @@
 #include <queue>
 #include <deque>
 #include <unordered_set>
+#include <unordered_map>
 #include <mutex>
 #include <chrono>
 #include <event2/event.h>
@@ -84,14 +85,10 @@ namespace hCraft {
 	
 	class selection_block_hash
 	{
-		std::hash<int> int_hash;
-		
 	public:
 		std::size_t
 		operator() (const selection_block& sb) const
-		{
-			return int_hash (sb.x) ^ (int_hash (sb.y) << 11) ^ (int_hash (sb.z) << 5);
-		}
+			{ return hash_xyz (sb.x, sb.y, sb.z); }
 	};
 	
 	
@@ -109,7 +106,16 @@ namespace hCraft {
 		{
 			return ((this->w == other.w) && (this->cx == other.cx) && (this->cz == other.cz));
 		}
+		
+		static inline unsigned long long
+		key (int cx, int cz)
+		{
+			return ((unsigned long long)((unsigned int)cz) << 32)
+				| (unsigned long long)((unsigned int)cx);
+		}
 	};
+	
+	typedef std::unordered_map<unsigned long long, known_chunk> known_chunk_map;
 
 //------------
 	
@@ -119,6 +125,7 @@ namespace hCraft {
 	class player: public living_entity
 	{
 		friend class authenticator;
+		friend class sql_store;
 		
 		logger& log;
 		
@@ -176,17 +183,19 @@ namespace hCraft {
 		unsigned char vtoken[4];
 		unsigned char ssec[16]; // shared secret
 		
-		// Using a thread pool to execute packet handling methods gives rise to a
-		// problem: Packets that must be executed in a certain order (such as, for
-		// example - 0x66 [window click] packets) are NOT guaranteed to be handled
-		// in the same order they were received. To solve this, received packets
-		// are first put into this queue, and only after a conclusion is made that
-		// it is indeed safe to call the packet callbacks, the packets in the queue
-		// are executed one after the other all at once in a pooled thread.
-		std::deque<unsigned char *> exec_queue;
+		// Received packets are handled on the server's thread pool, but through
+		// a strand: packets are appended to this queue, and a single pooled task
+		// at a time drains it (see run_strand ()).  So a player's packets are
+		// always handled one after the other, in the order they were received,
+		// and never by two threads at once.
+		std::vector<unsigned char *> strand_queue;
+		std::vector<std::function<void ()>> strand_tasks; // see post ()
+		std::mutex strand_lock;
+		bool strand_running;
 		
 		bool writing;
 		std::queue<packet *> out_queue;
+		std::atomic<long long> out_bytes; // total size of out_queue
 		std::mutex out_lock;
 		CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption *encryptor;
 		
@@ -200,7 +209,7 @@ namespace hCraft {
 		chunk_pos chcurr;
 		std::mutex world_lock;
 		bool joining_world;
-		bool streaming_chunks;
+		std::atomic_bool streaming_chunks;
 		std::set<zone *> curr_zones;
 		entity_pos old_pos;
 		entity_pos last_good_pos;
@@ -208,10 +217,22 @@ namespace hCraft {
 		std::unordered_set<player *> visible_players;
 		std::mutex visible_player_lock;
 		
-		std::vector<known_chunk> pending_chunks;
+		known_chunk_map pending_chunks; // requested, but not sent yet
 		std::queue<gen_response> response_chunks;
 		std::mutex response_chunks_lock;
+		std::vector<gen_response> ready_chunks; // generated, waiting to be sent
+		std::atomic<bool> chunks_in_flight;
 		bool need_new_chunks;
+		
+		// view distance (see update_view_distance ())
+		std::atomic<int> view_dist;
+		std::atomic<int> client_view_dist; // as sent in the client settings packet (0 = unknown)
+		int send_cap;         // lowered while too much outbound data is queued
+		int send_calm_checks;
+		
+		// chunk send rate limiting
+		double chunk_tokens;
+		std::chrono::steady_clock::time_point chunk_tokens_time;
 				
 		std::chrono::steady_clock::time_point last_tick;
 		std::chrono::steady_clock::time_point last_heart_regen;
@@ -240,7 +261,7 @@ namespace hCraft {
 		blocki sb_block;
 		std::mutex sb_lock;
 		
-		std::vector<known_chunk> known_chunks;
+		known_chunk_map known_chunks;
 		
 		inventory inv;
 		block_undo *bundo;
@@ -298,26 +319,21 @@ namespace hCraft {
 		static int handle_pl_packet_0e (player *pl, packet_reader reader);
 		static int handle_pl_packet_10 (player *pl, packet_reader reader);
 		static int handle_pl_packet_12 (player *pl, packet_reader reader);
+		static int handle_pl_packet_15 (player *pl, packet_reader reader);
 		static int handle_pl_packet_16 (player *pl, packet_reader reader);
 		
 		
 		/* 
-		 * Examines the queue that holds packets pending to be handled by
-		 * appropriate callback methods in-order to conclude whether it is safe
-		 * to handle the packets. 
+		 * Handles the packets in the player's strand queue until it is empty.
+		 * Ran as a thread pool task, with at most one instance per player.
 		 */
-		bool test_packet_chain ();
+		static void run_strand (void *ptr);
 		
 		/* 
 		 * Executes the appropriate packet handler for the given byte array.
 		 */
 		int handle (const unsigned char *data);
 		
-		/* 
-		 * Executed in a thread pool task, spawned by handle ().
-		 */
-		friend void handle_func (void *ctx);
-		
 		
 	//----
 		
@@ -341,6 +357,12 @@ namespace hCraft {
 		
 		void update_home_chunk ();
 		
+		/* 
+		 * Recomputes the player's view distance from the world's current cap,
+		 * the client's own setting and how much outbound data is queued up.
+		 */
+		void update_view_distance ();
+		
 	//----
 		
 		/* 
@@ -381,13 +403,14 @@ namespace hCraft {
 		inline bool is_reading () { return this->reading; }
 		inline bool is_writing () { return this->writing; }
 		inline bool is_handling_packets () { return (this->handlers_scheduled.load () > 0); }
+		inline bool is_streaming_chunks () { return this->streaming_chunks.load (); }
 		inline bool is_disconnecting () { return this->disconnecting; }
 		inline std::chrono::time_point<std::chrono::system_clock> disconnection_time ()
 			{ return this->fail_time; }
 		
 		inline world* get_world () { return this->curr_world; }
 		inline std::mutex& get_world_lock () { return this->world_lock; }
-		static constexpr int chunk_radius () { return 5; }
+		inline int chunk_radius () const { return this->view_dist.load (); }
 		
 		inline window* get_open_window () { return this->open_win; }
 		inline slot_item& held_item () { return this->inv.get (this->held_slot); }
@@ -395,6 +418,7 @@ namespace hCraft {
 		inline gamemode_type gamemode () { return this->curr_gamemode; }
 		
 		inline int get_ping () { return this->ping_time_ms; }
+		inline long long get_outbound_bytes () const { return this->out_bytes; }
 		
 		// whether the player isn't valid anymore, and should be destroyed.
 		inline bool bad () { return this->fail || this->disconnecting; }
@@ -463,7 +487,7 @@ namespace hCraft {
 		 * Loads new close chunks to the player and unloads those that are too
 		 * far away.
 		 */
-		void stream_chunks (int radius = player::chunk_radius ());
+		void stream_chunks ();
 		
 		/* 
 		 * Checks whether the specified chunk is within the visible chunk range
@@ -558,6 +582,14 @@ namespace hCraft {
 		 */
 		bool perm (const char *perm);
 		
+		/* 
+		 * Queues @{fn} to be run on the player's strand, so that it never runs
+		 * concurrently with the player's packet handlers (and commands).  Used to
+		 * resume work once an asynchronous query completes.  Tasks still queued
+		 * when the player disconnects are dropped.
+		 */
+		void post (std::function<void ()>&& fn);
+		
 		
 		
 	//----
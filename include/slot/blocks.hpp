@@ -20,6 +20,7 @@
 #define _hCraft__BLOCKS_H_
 
 #include <functional>
+#include <bitset>
 #include <cstddef>
 
 
@@ -348,6 +349,68 @@ namespace hCraft {
 	};
 	
 	
+	
+	/* 
+	 * Flat copies of the block properties that are read on hot paths
+	 * (lighting, heightmaps, block updates), indexed by block ID and covering
+	 * both vanilla and physics blocks.
+	 * 
+	 * The tables are built once at startup and only read afterwards, so they
+	 * can be accessed from any thread without locking.  IDs that are not
+	 * associated with any block behave like air.
+	 */
+	struct block_props
+	{
+		static const int id_count = 0x1000;
+		
+		static unsigned char opacity_table[id_count];
+		static unsigned char luminance_table[id_count];
+		static unsigned char height_table[id_count];      // solid and opaque
+		
+		// what the client is sent in place of each ID: the ID itself and 0xFF
+		// (keep the metadata value) for vanilla IDs, the vanilla block a physics
+		// block is displayed as, or air for unknown IDs.
+		static unsigned char client_id_table[id_count];
+		static unsigned char client_meta_table[id_count];
+		
+		static std::bitset<id_count> known_set;
+		static std::bitset<id_count> solid_set;       // state == BS_SOLID
+		static std::bitset<id_count> opaque_set;
+		static std::bitset<id_count> transparent_set; // opacity == 0
+		static std::bitset<id_count> physics_set;     // has a physics_block
+		static std::bitset<id_count> neighbour_set;   // physics_block::affected_by_neighbours ()
+		
+	//----
+		
+		/* 
+		 * (Re)builds the tables from the block list and from the registered
+		 * physics blocks.  Vanilla blocks are filled in during static
+		 * initialization; this must be called again once physics blocks have
+		 * been registered, before any world starts ticking.
+		 */
+		static void init ();
+		
+		
+		static inline int opacity (unsigned short id)
+			{ return opacity_table[id & 0xFFF]; }
+		static inline int luminance (unsigned short id)
+			{ return luminance_table[id & 0xFFF]; }
+		
+		static inline bool is_known (unsigned short id)
+			{ return known_set[id & 0xFFF]; }
+		static inline bool is_solid (unsigned short id)
+			{ return solid_set[id & 0xFFF]; }
+		static inline bool is_opaque (unsigned short id)
+			{ return opaque_set[id & 0xFFF]; }
+		static inline bool is_transparent (unsigned short id)
+			{ return transparent_set[id & 0xFFF]; }
+		static inline bool has_physics (unsigned short id)
+			{ return physics_set[id & 0xFFF]; }
+		static inline bool affected_by_neighbours (unsigned short id)
+			{ return neighbour_set[id & 0xFFF]; }
+	};
+	
+	
 
 //----
 	/* 
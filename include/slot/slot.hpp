@@ -23,6 +23,7 @@
 #include "items.hpp"
 #include <vector>
 #include <string>
+#include <memory>
 
 
 namespace hCraft {
@@ -43,11 +44,13 @@ namespace hCraft {
 				item_info  *iinf;
 				void       *ptr;
 			} s_info;
-			
-	public:
-		enchantment_list enchants;
-		std::string display_name;
-		std::vector<std::string> lore;
+		
+		enchantment_list s_enchants;
+		std::string s_display_name;
+		std::vector<std::string> s_lore;
+		
+		// encoded metadata, built on demand and shared between copies.
+		mutable std::shared_ptr<const std::vector<unsigned char>> s_meta;
 		
 	public:
 		inline bool is_valid () const { return s_id != BT_UNKNOWN && s_id != IT_UNKNOWN && s_id != BT_AIR; }
@@ -58,6 +61,13 @@ namespace hCraft {
 		inline unsigned short damage () const { return s_damage; }
 		inline unsigned short amount () const { return s_amount; }
 		
+		inline const enchantment_list& enchants () const { return s_enchants; }
+		inline const std::string& display_name () const { return s_display_name; }
+		inline const std::vector<std::string>& lore () const { return s_lore; }
+		
+		inline bool has_metadata () const
+			{ return !s_enchants.empty () || !s_display_name.empty () || !s_lore.empty (); }
+		
 		inline bool empty () const { return (s_amount == 0) || (s_id == 0); }
 		inline bool full () const
 		{
@@ -91,6 +101,16 @@ namespace hCraft {
 		
 		void set_enchants (const enchantment_list& enc);
 		void copy_enchants_from (const slot_item& other);
+		void set_display_name (const std::string& name);
+		void set_lore (const std::vector<std::string>& lore);
+		
+		/* 
+		 * Returns the item's metadata (name, lore and enchantments) as a gzipped
+		 * NBT compound, the way it is sent in slot data.  The blob is encoded
+		 * once and then reused (and shared with copies of the item) until the
+		 * metadata is changed.  Returns null if the item has no metadata.
+		 */
+		std::shared_ptr<const std::vector<unsigned char>> encoded_metadata () const;
 		
 		const char* name () const;
 		int max_stack () const;
@@ -0,0 +1,249 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__METRICS_H_
+#define _hCraft__METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <sstream>
+#include <functional>
+#include <thread>
+
+
+namespace hCraft {
+	
+	/* 
+	 * A monotonically increasing counter.
+	 */
+	class metric_counter
+	{
+		std::atomic<unsigned long long> val;
+		
+	public:
+		metric_counter () : val (0) { }
+		
+		inline void inc (unsigned long long n = 1)
+			{ this->val.fetch_add (n, std::memory_order_relaxed); }
+		inline unsigned long long get () const
+			{ return this->val.load (std::memory_order_relaxed); }
+	};
+	
+	/* 
+	 * A value that can go both up and down.
+	 */
+	class metric_gauge
+	{
+		std::atomic<long long> val;
+		
+	public:
+		metric_gauge () : val (0) { }
+		
+		inline void set (long long v)
+			{ this->val.store (v, std::memory_order_relaxed); }
+		inline void add (long long n)
+			{ this->val.fetch_add (n, std::memory_order_relaxed); }
+		inline long long get () const
+			{ return this->val.load (std::memory_order_relaxed); }
+	};
+	
+	/* 
+	 * Latency histogram with fixed power-of-two buckets, from 1us up to ~16s.
+	 * Recording a sample costs a couple of relaxed atomic additions, so it is
+	 * cheap enough for hot paths.
+	 */
+	class metric_histogram
+	{
+	public:
+		static const int bucket_count = 25; // plus one for everything above
+		
+	private:
+		std::atomic<unsigned long long> buckets[bucket_count + 1];
+		std::atomic<unsigned long long> count;
+		std::atomic<unsigned long long> sum; // in microseconds
+		
+	public:
+		metric_histogram ();
+		
+		/* 
+		 * Records a sample, in microseconds.
+		 */
+		inline void
+		observe (unsigned long long us)
+			{
+				int b = (us == 0) ? 0 : (64 - __builtin_clzll (us));
+				if (b > bucket_count)
+					b = bucket_count;
+				this->buckets[b].fetch_add (1, std::memory_order_relaxed);
+				this->count.fetch_add (1, std::memory_order_relaxed);
+				this->sum.fetch_add (us, std::memory_order_relaxed);
+			}
+		
+		inline void
+		observe (std::chrono::steady_clock::time_point start)
+			{
+				this->observe ((unsigned long long)std::chrono::duration_cast<
+					std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ());
+			}
+		
+		inline unsigned long long get_count () const
+			{ return this->count.load (std::memory_order_relaxed); }
+		inline unsigned long long get_sum () const
+			{ return this->sum.load (std::memory_order_relaxed); }
+		inline unsigned long long get_bucket (int b) const
+			{ return this->buckets[b].load (std::memory_order_relaxed); }
+		
+		/* 
+		 * Returns the upper bound of bucket @{b}, in microseconds.
+		 */
+		static inline unsigned long long bucket_bound (int b)
+			{ return 1ULL << b; }
+		
+		/* 
+		 * Estimates the given percentile (0-100) of all recorded samples, in
+		 * microseconds.
+		 */
+		double percentile (double p) const;
+	};
+	
+	/* 
+	 * Remembers the last few thousand samples (in microseconds), so that exact
+	 * percentiles can be computed over recent activity rather than over the
+	 * whole lifetime of the server like metric_histogram does.
+	 * Samples must be recorded from one thread at a time.
+	 */
+	class metric_window
+	{
+	public:
+		static const int size = 2048;
+		
+	private:
+		std::atomic<unsigned int> samples[size];
+		std::atomic<unsigned int> pos; // total samples recorded
+		
+	public:
+		metric_window ();
+		
+		inline void
+		observe (unsigned long long us)
+			{
+				unsigned int p = this->pos.load (std::memory_order_relaxed);
+				this->samples[p % size].store ((us > 0xFFFFFFFFULL) ? 0xFFFFFFFFU : (unsigned int)us,
+					std::memory_order_relaxed);
+				this->pos.store (p + 1, std::memory_order_release);
+			}
+		
+		inline void
+		observe (std::chrono::steady_clock::time_point start)
+			{
+				this->observe ((unsigned long long)std::chrono::duration_cast<
+					std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ());
+			}
+		
+		/* 
+		 * Returns the given percentiles (0-100) of the samples currently in the
+		 * window, in microseconds.  All zeroes if nothing has been recorded.
+		 */
+		void percentiles (const double *ps, double *out, int count) const;
+		
+		inline double
+		percentile (double p) const
+			{ double v; this->percentiles (&p, &v, 1); return v; }
+	};
+	
+	
+	
+	/* 
+	 * Builds up a scrape in the Prometheus text exposition format.
+	 * Samples may be added in any order; they are grouped by metric when the
+	 * output is generated.
+	 */
+	class metrics_writer
+	{
+		struct family
+		{
+			std::string name;
+			std::string type;
+			std::string help;
+			std::ostringstream samples;
+		};
+		
+		std::vector<family *> families;
+		std::unordered_map<std::string, family *> index;
+		
+	private:
+		family& get_family (const char *name, const char *type, const char *help);
+		
+	public:
+		~metrics_writer ();
+		
+		/* 
+		 * Formats a single label pair, escaping the value as needed.
+		 */
+		static std::string label (const char *key, const std::string& val);
+		
+		void counter (const char *name, const char *help,
+			const std::string& labels, unsigned long long val);
+		void gauge (const char *name, const char *help,
+			const std::string& labels, double val);
+		void histogram (const char *name, const char *help,
+			const std::string& labels, const metric_histogram& h);
+		
+		std::string str () const;
+	};
+	
+	
+	
+	/* 
+	 * Serves metrics over a local TCP or UNIX socket.  The collect function is
+	 * only called when a scrape comes in, so the exporter costs nothing while
+	 * nobody is looking.  HTTP GET requests get an HTTP response; clients that
+	 * do not send anything (e.g. `socat - UNIX:path') get the bare text.
+	 */
+	class metrics_exporter
+	{
+		int fd;
+		std::string unix_path;
+		std::thread th;
+		std::atomic<bool> running;
+		std::function<std::string ()> collect;
+		
+	private:
+		void main_loop ();
+		void serve (int cfd);
+		
+	public:
+		metrics_exporter ();
+		~metrics_exporter ();
+		
+		/* 
+		 * Starts listening on @{addr}, which is either "host:port" or
+		 * "unix:/path/to/socket".  Returns false and fills @{err} on failure.
+		 */
+		bool start (const std::string& addr, std::function<std::string ()> collect,
+			std::string& err);
+		
+		void stop ();
+	};
+}
+
+#endif
+
@@ -42,6 +42,14 @@ namespace hCraft {
 	};
 	
 	
+	// a column sent as part of a Map Chunk Bulk packet.
+	struct chunk_column
+	{
+		int x, z;
+		chunk *ch;
+	};
+	
+	
 	struct entity_property
 	{
 		const char *key;
@@ -176,6 +184,14 @@ namespace hCraft {
 	
 	
 	namespace packets {
+		
+		/* 
+		 * Gets\sets the zlib level (0-9) used to compress chunk data sent to
+		 * clients. Lower levels trade bandwidth for CPU time.
+		 */
+		int get_chunk_compression_level ();
+		void set_chunk_compression_level (int level);
+		
 		/* 
 		 * Packet creation.
 		 */
@@ -217,6 +233,10 @@ namespace hCraft {
 				const std::vector<entity_property>& props);
 			packet* make_chunk (int x, int z, chunk *ch, const std::vector<edit_stage *> es_vec);
 			packet* make_chunk (int x, int z, chunk *ch);
+			packet* make_chunk_sections (int x, int z, chunk *ch,
+				unsigned short sections, const std::vector<edit_stage *>& es_vec);
+			packet* make_chunk_bulk (const std::vector<chunk_column>& cols,
+				const std::vector<edit_stage *>& es_vec);
 			packet* make_empty_chunk (int x, int z);
 			packet* make_multi_block_change (int cx, int cz,
 				const std::vector<block_change_record>& records, player *sb = nullptr);
@@ -26,6 +26,9 @@
 #include "system/scheduler.hpp"
 #include "world/world.hpp"
 #include "system/threadpool.hpp"
+#include "system/metrics.hpp"
+#include "system/sqlstore.hpp"
+#include "world/tick_executor.hpp"
 #include "commands/command.hpp"
 #include "player/permissions.hpp"
 #include "player/rank.hpp"
@@ -35,6 +38,8 @@
 #include "system/messages.hpp"
 #include "irc/irc.hpp"
 #include "slot/crafting.hpp"
+#include "util/slot_map.hpp"
+#include "util/epoch.hpp"
 
 #include <soci/soci.h>
 #include <unordered_map>
@@ -86,6 +91,9 @@ namespace hCraft {
 		char name_highlight_color;
 		
 		// sql:
+		std::string db_backend; // "mysql" or "sqlite"
+		std::string db_file;    // database file used by the sqlite backend
+		int db_flush_interval;  // seconds between writes of player records
 		std::string db_name;
 		std::string db_user;
 		std::string db_pass;
@@ -99,6 +107,27 @@ namespace hCraft {
 		std::string irc_chan;
 		std::string irc_nick;
 		
+		// compression:
+		int chunk_codec;      // CODEC_* used to store chunks on disk
+		int chunk_level;
+		int chunk_bg_codec;   // chunks stored raw get recompressed with this
+		int packet_level;     // zlib level for chunk packets
+		
+		// memory:
+		int world_chunk_budget; // MB of chunk data kept per world (0 = unlimited)
+		int total_chunk_budget; // MB of chunk data kept by all worlds (0 = unlimited)
+		
+		// streaming:
+		int view_distance;      // default view distance, in chunks
+		int min_view_distance;  // view distances are never reduced below this
+		int tick_budget;        // % of the tick period; worlds that tick slower shrink their view distance
+		int player_send_budget; // KB of unsent data a player may have queued
+		int chunk_rate;         // chunks sent to a single player per second
+		int chunk_bulk_size;    // KB of uncompressed column data per bulk packet (0 = no bulk packets)
+		
+		// metrics:
+		std::string metrics_listen; // "host:port" or "unix:path" (empty = disabled)
+		
 		std::set<std::string> dcmds; // disabled commands
 	};
 	
@@ -167,6 +196,7 @@ namespace hCraft {
 		
 		//sql::connection_pool spool;
 		soci::connection_pool spool;
+		sql_store sstore;
 		
 		permission_manager perms;
 		group_manager groups;
@@ -174,6 +204,7 @@ namespace hCraft {
 		std::vector<initializer> inits; // <init, destroy> pairs
 		bool running;
 		bool shutting_down;
+		bool sql_open;
 		
 		std::vector<worker> workers;
 		int worker_count;
@@ -188,14 +219,13 @@ namespace hCraft {
 		std::mutex player_lock;
 		crafting_manager craftman;
 		
-		std::mutex id_lock;
-		int entity_id_counter;
-		std::unordered_map<int, entity *> entity_map;
-		int world_id_counter;
-		std::map<int, world *> world_map;
+		slot_map<entity> entity_map;
+		slot_map<world> world_map;
+		epoch_manager epochs;
 		
 		scheduler sched;
 		thread_pool tpool;
+		tick_executor wtick;
 		
 		world_list worlds;
 		world *main_world;
@@ -213,6 +243,8 @@ namespace hCraft {
 		// IRC client
 		irc_client *ircc;
 		
+		metrics_exporter mexp;
+		
 	public:
 		physics_manager global_physics; // initially shared between all worlds
 		authenticator auth;
@@ -220,6 +252,12 @@ namespace hCraft {
 		
 		server_messages msgs;
 		
+		// time spent in the handlers of play-state packets, by opcode.
+		metric_histogram packet_times[0x100];
+		
+		// movement packets dropped because newer ones made them redundant.
+		metric_counter moves_coalesced;
+		
 	private:
 		// <init, destroy> functions:
 		
@@ -298,6 +336,13 @@ namespace hCraft {
 		void init_irc ();
 		void destroy_irc ();
 		
+		/* 
+		 * Starts serving metrics on the address specified in the configuration
+		 * file, if any.
+		 */
+		void init_metrics ();
+		void destroy_metrics ();
+		
 	private:
 		/* 
 		 * The function executed by worker threads.
@@ -351,6 +396,7 @@ namespace hCraft {
 		inline irc_client* get_irc () { return this->ircc; }
 		inline scheduler& get_scheduler () { return this->sched; }
 		inline thread_pool& get_thread_pool () { return this->tpool; }
+		inline tick_executor& get_tick_executor () { return this->wtick; }
 		inline world* get_main_world () { return this->main_world; }
 		inline command_list& get_commands () { return *this->commands; }
 		inline permission_manager& get_perms () { return this->perms; }
@@ -361,6 +407,9 @@ namespace hCraft {
 		inline std::mutex& get_player_lock () { return this->player_lock; }
 		
 		inline soci::connection_pool& sql_pool () { return this->spool; }
+		inline sql_store& get_sql_store () { return this->sstore; }
+		inline epoch_manager& get_epochs () { return this->epochs; }
+		inline bool has_sql () const { return this->sql_open; }
 		
 		inline const std::string& auth_id () { return this->server_id; }
 		inline CryptoPP::RSA::PublicKey public_key ()
@@ -400,6 +449,13 @@ namespace hCraft {
 		
 		
 		
+		/* 
+		 * Gathers the server's metrics in the Prometheus text format.
+		 */
+		std::string collect_metrics ();
+		
+		
+		
 //-----
 		/* 
 		 * Returns a unique number that can be used for entity identification.
@@ -413,7 +469,10 @@ namespace hCraft {
 		void deregister_entity (int eid);
 		
 		/* 
-		 * Returns the player\entity associated with the given ID.
+		 * Returns the player\entity associated with the given ID, or null if the
+		 * ID is stale.  Does not block.  Unless called from the entity's own
+		 * strand, the caller should hold an epoch_guard (see get_epochs ()) for
+		 * as long as it uses the returned entity.
 		 */
 		entity* entity_by_id (int id);
 		player* player_by_id (int id);
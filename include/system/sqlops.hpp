@@ -61,6 +61,16 @@ namespace hCraft {
 			bool banned;
 	 	};
 	 	
+	 	/* 
+	 	 * Where a player was when they logged out.
+	 	 */
+	 	struct logout_info
+	 	{
+	 		std::string world;
+	 		entity_pos pos;
+	 		int gm;
+	 	};
+	 	
 	 	
 	 //----
 	 	
@@ -104,6 +114,24 @@ namespace hCraft {
 		static void default_player_data (const char *name, server &srv, player_info& pd);
 		
 		
+		/* 
+		 * Loads\saves the position the given player logged out at.
+		 * logout_data () returns false if none was recorded.
+		 */
+		static bool logout_data (soci::session& sql, const char *name, logout_info& out);
+		static void save_logout_data (soci::session& sql, const char *name,
+			const logout_info& in);
+		
+		
+		/* 
+		 * Returns the integer stored in column @{col} of the given row.
+		 * Backends report integer columns with different types (INT UNSIGNED
+		 * comes back as a long long from MySQL, INTEGER as an int from SQLite),
+		 * so this accepts any of them.
+		 */
+		static long long column_int (const soci::row& r, std::size_t col);
+		
+		
 		
 		/* 
 		 * Recording bans\kicks:
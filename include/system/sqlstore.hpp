@@ -0,0 +1,230 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__SQLSTORE_H_
+#define _hCraft__SQLSTORE_H_
+
+#include "system/sqlops.hpp"
+#include "system/metrics.hpp"
+#include <soci/soci.h>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <string>
+#include <chrono>
+
+
+namespace hCraft {
+	
+	// forward decs
+	class server;
+	class player;
+	
+	
+	/* 
+	 * The outcome of an asynchronous query.
+	 */
+	template<typename T>
+	struct sql_result
+	{
+		bool ok;
+		T value;
+		std::string error; // set if the query threw
+		
+		sql_result ()
+			: ok (false), value ()
+			{ }
+	};
+	
+	
+	/* 
+	 * Asynchronous access to the server's database.
+	 * 
+	 * Queries are run by a dedicated thread, one after the other, in the order
+	 * they were submitted.  A slow query therefore only holds up other
+	 * queries, and not the thread pool that handles gameplay packets.  query ()
+	 * hands its result back on the requesting player's strand, and call ()
+	 * returns a future.
+	 * 
+	 * Player records are written behind: save_player () only stores a snapshot
+	 * of the record, and dirty records are written out together, in a single
+	 * transaction, every few seconds.  They are also always written before the
+	 * next queued query runs, so queries never see stale player data.
+	 * 
+	 * Before start () and after stop (), jobs are run on the calling thread.
+	 */
+	class sql_store
+	{
+		typedef std::function<void (soci::session&)> job_fn;
+		
+		struct player_record
+		{
+			sqlops::player_info info;
+			bool has_logout;
+			sqlops::logout_info logout;
+			
+			player_record ()
+				: has_logout (false)
+				{ }
+		};
+		
+	private:
+		server &srv;
+		soci::connection_pool &pool;
+		
+		std::thread th;
+		std::mutex lock;
+		std::condition_variable cv;
+		std::deque<job_fn> jobs;
+		std::unordered_map<std::string, player_record> dirty; // by name
+		bool running;
+		bool flush_requested;
+		std::chrono::seconds flush_interval;
+		
+	public:
+		metric_histogram query_times;
+		metric_histogram flush_times;
+		metric_counter records_flushed;
+		metric_counter flush_failures;
+		metric_gauge backlog; // queued jobs
+		
+	private:
+		/* 
+		 * The function ran by the database thread.
+		 */
+		void main_loop ();
+		
+		/* 
+		 * Writes all dirty player records to the database.
+		 */
+		void flush (soci::session& sql);
+		
+		/* 
+		 * Runs @{job} on the database thread, then @{resume} on @{pl}'s strand.
+		 */
+		void submit_for (player *pl, job_fn&& job, std::function<void ()>&& resume);
+		
+	public:
+		sql_store (server& srv, soci::connection_pool& pool);
+		~sql_store ();
+		
+		sql_store (const sql_store&) = delete;
+		sql_store& operator= (const sql_store&) = delete;
+		
+		
+		/* 
+		 * Starts the database thread.  Dirty records are written at least every
+		 * @{flush_interval} seconds.
+		 */
+		void start (int flush_interval);
+		
+		/* 
+		 * Runs all queued jobs, writes all dirty records and stops the thread.
+		 */
+		void stop ();
+		
+		
+		/* 
+		 * Queues @{job} for the database thread.  Exceptions thrown by it are
+		 * logged and otherwise ignored.
+		 */
+		void post (job_fn&& job);
+		
+		/* 
+		 * Runs @{fn} on the database thread, and passes its result to @{done},
+		 * which is then run on @{pl}'s strand.  Nothing is run if the player
+		 * disconnects in the meantime.
+		 */
+		template<typename T>
+		void
+		query (player *pl, std::function<T (soci::session&)>&& fn,
+			std::function<void (sql_result<T>&)>&& done)
+		{
+			auto res = std::make_shared<sql_result<T>> ();
+			std::function<T (soci::session&)> f = std::move (fn);
+			std::function<void (sql_result<T>&)> d = std::move (done);
+			this->submit_for (pl,
+				[res, f] (soci::session& sql)
+					{
+						try
+							{
+								res->value = f (sql);
+								res->ok = true;
+							}
+						catch (const std::exception& ex)
+							{
+								res->error = ex.what ();
+							}
+					},
+				[res, d] () { d (*res); });
+		}
+		
+		/* 
+		 * Runs @{fn} on the database thread and returns a future for its
+		 * result.  Must not be waited on from within a job.
+		 */
+		template<typename T>
+		std::future<T>
+		call (std::function<T (soci::session&)>&& fn)
+		{
+			auto prom = std::make_shared<std::promise<T>> ();
+			std::future<T> fut = prom->get_future ();
+			std::function<T (soci::session&)> f = std::move (fn);
+			this->post (
+				[prom, f] (soci::session& sql)
+					{
+						try
+							{
+								prom->set_value (f (sql));
+							}
+						catch (...)
+							{
+								prom->set_exception (std::current_exception ());
+							}
+					});
+			return fut;
+		}
+		
+		
+		/* 
+		 * Stores a snapshot of a player's record (and optionally of where they
+		 * are), to be written to the database by the next flush.  Replaces any
+		 * snapshot of the same player that has not been written yet.
+		 */
+		void save_player (const sqlops::player_info& pd,
+			const sqlops::logout_info *logout = nullptr);
+		
+		/* 
+		 * Makes the database thread write all dirty records as soon as possible.
+		 */
+		void flush_soon ();
+		
+		/* 
+		 * Number of jobs waiting to be run.
+		 */
+		size_t pending ();
+	};
+}
+
+#endif
+
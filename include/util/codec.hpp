@@ -0,0 +1,81 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__CODEC_H_
+#define _hCraft__CODEC_H_
+
+
+namespace hCraft {
+	
+	/* 
+	 * Block compression codecs used to store chunk data.
+	 * The numeric IDs are written to disk, so they must never change.
+	 */
+	enum codec_id
+	{
+		CODEC_ZLIB = 0,
+		CODEC_RAW  = 1, // stored uncompressed
+		CODEC_LZ4  = 2, // only available if built with HCRAFT_USE_LZ4
+	};
+	
+	
+	namespace codec {
+		
+		/* 
+		 * Returns true if the specified codec was compiled in.
+		 */
+		bool available (int id);
+		
+		/* 
+		 * Returns the name of the given codec (e.g. "zlib"), or "unknown".
+		 */
+		const char* name (int id);
+		
+		/* 
+		 * Returns the ID of the codec that has the specified name, or -1 if
+		 * there is no such codec.
+		 */
+		int from_name (const char *name);
+		
+		/* 
+		 * Returns the maximum number of bytes compress () may produce for an
+		 * input of @{len} bytes.
+		 */
+		unsigned long bound (int id, unsigned long len);
+		
+		/* 
+		 * Compresses @{slen} bytes from @{src} into @{dest}, which must be at least
+		 * bound (id, slen) bytes long. @{dlen} receives the compressed size.
+		 * The meaning of @{level} depends on the codec (0-9 for zlib, where -1
+		 * selects the library default; ignored by the others).
+		 */
+		bool compress (int id, int level, const unsigned char *src,
+			unsigned long slen, unsigned char *dest, unsigned long& dlen);
+		
+		/* 
+		 * Decompresses @{slen} bytes from @{src} into @{dest}. On input, @{dlen}
+		 * should hold the capacity of @{dest}; on output, the number of bytes
+		 * actually written.
+		 */
+		bool decompress (int id, const unsigned char *src, unsigned long slen,
+			unsigned char *dest, unsigned long& dlen);
+	}
+}
+
+#endif
+
@@ -0,0 +1,126 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__EPOCH_H_
+#define _hCraft__EPOCH_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+
+namespace hCraft {
+	
+	/* 
+	 * Epoch-based reclamation.
+	 * 
+	 * Threads that look up shared objects without holding a lock (e.g. through
+	 * a slot_map) do so from within an epoch_guard.  Objects are destroyed by
+	 * unlinking them first (so no new lookup can find them), and then passing
+	 * the destruction to retire ().  collect () runs the destruction only once
+	 * every thread that was inside a guard when the object was retired has
+	 * left it.
+	 */
+	class epoch_manager
+	{
+		friend class epoch_guard;
+		
+	public:
+		static const int max_threads = 256;
+		
+	private:
+		struct alignas (64) thread_record
+		{
+			std::atomic<std::uint64_t> epoch; // 0 if not inside a guard
+			int depth;                        // only touched by the owner
+		};
+		
+		struct retired
+		{
+			std::uint64_t epoch;
+			std::function<void ()> fn;
+		};
+		
+		std::atomic<std::uint64_t> global_epoch;
+		thread_record records[max_threads];
+		
+		std::mutex lock;
+		std::vector<retired> pending;
+		
+	private:
+		void enter ();
+		void leave ();
+		
+	public:
+		epoch_manager ();
+		~epoch_manager ();
+		
+		epoch_manager (const epoch_manager&) = delete;
+		epoch_manager& operator= (const epoch_manager&) = delete;
+		
+		
+		/* 
+		 * Queues @{fn} to be run once no thread can still be using the object it
+		 * destroys.  The object must already be unreachable to new lookups.
+		 */
+		void retire (std::function<void ()>&& fn);
+		
+		/* 
+		 * Runs all retired functions that are safe to run, and returns how many
+		 * were run.  Must not be called from within an epoch_guard.
+		 */
+		int collect ();
+		
+		/* 
+		 * Runs all retired functions, regardless of guards.  Only to be used once
+		 * no other thread can enter a guard anymore (e.g. at shutdown).
+		 */
+		void drain ();
+		
+		/* 
+		 * Returns the number of retired functions that have not been run yet.
+		 */
+		int backlog ();
+	};
+	
+	
+	/* 
+	 * Marks the calling thread as possibly using objects protected by an
+	 * epoch_manager for as long as the guard lives.  Guards may be nested.
+	 */
+	class epoch_guard
+	{
+		epoch_manager& man;
+		
+	public:
+		epoch_guard (epoch_manager& man)
+			: man (man)
+			{ this->man.enter (); }
+		
+		~epoch_guard ()
+			{ this->man.leave (); }
+		
+		epoch_guard (const epoch_guard&) = delete;
+		epoch_guard& operator= (const epoch_guard&) = delete;
+	};
+}
+
+#endif
+
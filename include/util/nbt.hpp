@@ -22,6 +22,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <cstddef>
 
 
 namespace hCraft {
@@ -46,6 +47,65 @@ namespace hCraft {
 	};
 	
 	
+	/* 
+	 * A bump allocator for NBT trees.
+	 * 
+	 * While an nbt_arena_scope is alive, tags created with new on the same
+	 * thread (including the ones created by nbt_tag::decode ()) are carved out
+	 * of its arena instead of being allocated one by one.  Deleting such a tag
+	 * still runs its destructor, but the memory itself is only given back when
+	 * the arena is reset or destroyed, so trees built in an arena must be
+	 * deleted before it is.
+	 */
+	class nbt_arena
+	{
+		struct block
+		{
+			block *next;
+			std::size_t size;
+			std::size_t used;
+		};
+		
+		block *head;
+		std::size_t block_size;
+		
+	public:
+		nbt_arena (std::size_t block_size = 4096);
+		~nbt_arena ();
+		
+		nbt_arena (const nbt_arena&) = delete;
+		nbt_arena& operator= (const nbt_arena&) = delete;
+		
+		/* 
+		 * Returns @{n} bytes of suitably aligned memory.
+		 */
+		void* alloc (std::size_t n);
+		
+		/* 
+		 * Releases everything allocated so far.  The first block is kept around
+		 * for reuse.
+		 */
+		void reset ();
+	};
+	
+	/* 
+	 * Makes @{arena} the current NBT arena of the calling thread for as long
+	 * as the scope object lives.  Scopes can be nested.
+	 */
+	class nbt_arena_scope
+	{
+		nbt_arena *prev;
+		
+	public:
+		explicit nbt_arena_scope (nbt_arena& arena);
+		~nbt_arena_scope ();
+		
+		nbt_arena_scope (const nbt_arena_scope&) = delete;
+		nbt_arena_scope& operator= (const nbt_arena_scope&) = delete;
+	};
+	
+	
+	
 	/* 
 	 * Base class for all tag types.
 	 */
@@ -58,6 +118,11 @@ namespace hCraft {
 		
 		virtual ~nbt_tag () {};
 		virtual nbt_tag_type type () = 0;
+		
+		// allocate from the current nbt_arena, if there is one.
+		static void* operator new (std::size_t size);
+		static void operator delete (void *ptr);
+		
 		virtual int size (bool with_id_and_tag = true)
 			{ return with_id_and_tag ? (3 + tag_name.size ()) : 0; }
 		virtual const std::string& name () { return this->tag_name; }
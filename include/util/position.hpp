@@ -199,28 +199,59 @@ namespace hCraft {
 	
 //----
 	
+	/* 
+	 * Position hashes.
+	 * 
+	 * std::hash<int> is the identity function on most implementations, so
+	 * simply xor-ing shifted coordinates together makes neighbouring positions
+	 * collide all the time.  The coordinates are instead packed into a single
+	 * 64-bit integer which is then run through the SplitMix64 finalizer, so
+	 * that every input bit affects every output bit.
+	 */
+	
+	inline unsigned long long
+	mix_hash64 (unsigned long long v)
+	{
+		v ^= v >> 30;
+		v *= 0xbf58476d1ce4e5b9ULL;
+		v ^= v >> 27;
+		v *= 0x94d049bb133111ebULL;
+		v ^= v >> 31;
+		return v;
+	}
+	
+	inline std::size_t
+	hash_xz (int x, int z)
+	{
+		return (std::size_t)mix_hash64 (((unsigned long long)(unsigned int)x << 32)
+			| (unsigned int)z);
+	}
+	
+	inline std::size_t
+	hash_xyz (int x, int y, int z)
+	{
+		// 26 bits for x and z (+-33 million blocks) and 12 bits for y.
+		return (std::size_t)mix_hash64 (
+			  ((unsigned long long)((unsigned int)x & 0x3FFFFFF) << 38)
+			| ((unsigned long long)((unsigned int)z & 0x3FFFFFF) << 12)
+			| ((unsigned int)y & 0xFFF));
+	}
+	
+	
 	class chunk_pos_hash
 	{
-		std::hash<int> int_hash;
-		
 	public:
 		std::size_t
 		operator() (const chunk_pos& cpos) const
-		{
-			return int_hash (cpos.x) ^ (int_hash (cpos.z) << 5);
-		}
+			{ return hash_xz (cpos.x, cpos.z); }
 	};
 	
 	class block_pos_hash
 	{
-		std::hash<int> int_hash;
-		
 	public:
 		std::size_t
 		operator() (const block_pos& bpos) const
-		{
-			return int_hash (bpos.x) ^ (int_hash (bpos.y) << 11) ^ (int_hash (bpos.z) << 5);
-		}
+			{ return hash_xyz (bpos.x, bpos.y, bpos.z); }
 	};
 	
 	
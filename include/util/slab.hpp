@@ -0,0 +1,126 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__SLAB_H_
+#define _hCraft__SLAB_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+
+namespace hCraft {
+	
+	/* 
+	 * Statistics of a single slab pool, in objects.
+	 */
+	struct slab_stats
+	{
+		const char *name;
+		std::size_t obj_size;
+		long long live;  // allocated and not yet freed
+		long long free;  // carved out of a slab, but not in use
+		long long peak;  // highest live count seen
+		long long slabs;
+	};
+	
+	
+	/* 
+	 * A pool of fixed-size objects, carved out of large slabs.
+	 * 
+	 * Freed objects are kept for reuse rather than given back to the system,
+	 * first in a small per-thread cache (no locking), and then in the pool's
+	 * global free list.  Slabs are never released, so a long-running server
+	 * settles at its peak working set instead of fragmenting the heap.
+	 * 
+	 * Zeroing is lazy: slabs come straight from the system (zeroed by the
+	 * kernel on first touch), and the pool remembers which objects have never
+	 * been handed out.  alloc () reports whether the object it returns is
+	 * still all zero, so constructors only have to clear recycled objects and
+	 * the pages of fresh ones are not touched until they are used.
+	 * 
+	 * Pools are meant to live for the whole process (see chunk.cpp).
+	 */
+	class slab_pool
+	{
+		friend struct slab_thread_cache;
+		
+	public:
+		static const int max_pools = 8;
+		
+	private:
+		const char *name;
+		std::size_t obj_size;
+		std::size_t slab_size;
+		int index;
+		int cache_cap; // objects kept per thread
+		
+		std::mutex lock;
+		std::vector<void *> free_list;
+		std::vector<unsigned char *> slabs;
+		unsigned char *bump;      // uncarved part of the last slab
+		std::size_t bump_left;    // in objects
+		
+		std::atomic<long long> live;
+		std::atomic<long long> peak;
+		std::atomic<long long> carved;
+		
+	private:
+		// moves up to @{n} objects from the pool into @{out}, and returns how many.
+		int refill (void **out, int n);
+		
+		// gives @{n} objects back to the pool.
+		void release (void **objs, int n);
+		
+	public:
+		/* 
+		 * Creates a pool for objects of @{obj_size} bytes, allocating memory
+		 * @{slab_size} bytes at a time.
+		 */
+		slab_pool (const char *name, std::size_t obj_size,
+			std::size_t slab_size = 1 << 20);
+		
+		slab_pool (const slab_pool&) = delete;
+		slab_pool& operator= (const slab_pool&) = delete;
+		
+		
+		/* 
+		 * Returns uninitialized memory for a single object.  If @{zeroed} is
+		 * not null, it is set to true if the memory is known to be all zero.
+		 * Throws std::bad_alloc if out of memory.
+		 */
+		void* alloc (bool *zeroed = nullptr);
+		
+		/* 
+		 * Returns an object allocated with alloc () to the pool.
+		 */
+		void free (void *ptr);
+		
+		
+		slab_stats stats ();
+		
+		/* 
+		 * Fills @{out} with the statistics of every pool created so far.
+		 */
+		static void all_stats (std::vector<slab_stats>& out);
+	};
+}
+
+#endif
+
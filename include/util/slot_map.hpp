@@ -0,0 +1,216 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__SLOT_MAP_H_
+#define _hCraft__SLOT_MAP_H_
+
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <stdexcept>
+
+
+namespace hCraft {
+	
+	/* 
+	 * Maps small integer IDs to objects.
+	 * 
+	 * An ID is made of a slot index (the low 20 bits) and the generation of
+	 * that slot (the next 11 bits).  Every time a slot is reused its
+	 * generation is bumped, and freed slots are reused in FIFO order, so an ID
+	 * that outlived its object resolves to null rather than to whatever took
+	 * its place.  IDs are always positive.
+	 * 
+	 * find () takes no locks and may run concurrently with insert () and
+	 * erase ().  Slots are allocated in pages that are never moved or freed
+	 * while the map lives.  Note that the map does not keep the objects alive:
+	 * callers that may race with the destruction of an object should look it
+	 * up from within an epoch_guard, and have it destroyed through
+	 * epoch_manager::retire ().
+	 */
+	template<typename T>
+	class slot_map
+	{
+	public:
+		static const int index_bits = 20;
+		static const int gen_bits = 11;
+		static const int max_slots = 1 << index_bits;
+		
+	private:
+		static const int page_bits = 10;
+		static const int page_size = 1 << page_bits;
+		static const int page_count = max_slots / page_size;
+		
+		struct slot
+		{
+			std::atomic<int> id;    // -1 if free
+			std::atomic<T *> ptr;
+		};
+		
+		struct page
+		{
+			slot slots[page_size];
+			
+			page ()
+			{
+				for (int i = 0; i < page_size; ++i)
+					{
+						this->slots[i].id.store (-1, std::memory_order_relaxed);
+						this->slots[i].ptr.store (nullptr, std::memory_order_relaxed);
+					}
+			}
+		};
+		
+		std::atomic<page *> pages[page_count];
+		
+		// writer-side state
+		std::mutex lock;
+		int next_index;          // first never-used slot
+		std::deque<int> free_ids; // IDs of freed slots, with their old generation
+		std::atomic<int> count;
+		
+	private:
+		static inline int index_of (int id) { return id & (max_slots - 1); }
+		static inline int gen_of (int id) { return (id >> index_bits) & ((1 << gen_bits) - 1); }
+		static inline int make_id (int index, int gen) { return (gen << index_bits) | index; }
+		
+		slot&
+		slot_at (int index)
+		{
+			return this->pages[index >> page_bits].load (std::memory_order_relaxed)
+				->slots[index & (page_size - 1)];
+		}
+		
+	public:
+		slot_map ()
+			: next_index (0), count (0)
+		{
+			for (int i = 0; i < page_count; ++i)
+				this->pages[i].store (nullptr, std::memory_order_relaxed);
+		}
+		
+		~slot_map ()
+		{
+			for (int i = 0; i < page_count; ++i)
+				delete this->pages[i].load (std::memory_order_relaxed);
+		}
+		
+		slot_map (const slot_map&) = delete;
+		slot_map& operator= (const slot_map&) = delete;
+		
+		
+		/* 
+		 * Returns the number of objects in the map.
+		 */
+		inline int size () const { return this->count.load (std::memory_order_relaxed); }
+		
+		
+		/* 
+		 * Inserts @{obj} into the map and returns its ID.
+		 * Throws std::length_error if all slots are in use.
+		 */
+		int
+		insert (T *obj)
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			
+			int index, gen;
+			if (!this->free_ids.empty ())
+				{
+					int old_id = this->free_ids.front ();
+					this->free_ids.pop_front ();
+					index = index_of (old_id);
+					gen = (gen_of (old_id) + 1) & ((1 << gen_bits) - 1);
+				}
+			else
+				{
+					if (this->next_index == max_slots)
+						throw std::length_error ("slot_map: out of slots");
+					
+					index = this->next_index ++;
+					if (!this->pages[index >> page_bits].load (std::memory_order_relaxed))
+						this->pages[index >> page_bits].store (new page (), std::memory_order_release);
+					gen = 0;
+				}
+			
+			// publish the object before the ID, so that a reader that sees the new
+			// ID also sees the new object (see find ()).
+			int id = make_id (index, gen);
+			slot& s = this->slot_at (index);
+			s.ptr.store (obj);
+			s.id.store (id);
+			this->count.fetch_add (1, std::memory_order_relaxed);
+			return id;
+		}
+		
+		/* 
+		 * Removes the object with the specified ID from the map, and returns it
+		 * (or null if the ID is stale).
+		 */
+		T*
+		erase (int id)
+		{
+			if (id < 0)
+				return nullptr;
+			std::lock_guard<std::mutex> guard {this->lock};
+			
+			int index = index_of (id);
+			if (index >= this->next_index)
+				return nullptr;
+			slot& s = this->slot_at (index);
+			if (s.id.load (std::memory_order_relaxed) != id)
+				return nullptr;
+			
+			T *obj = s.ptr.load (std::memory_order_relaxed);
+			s.ptr.store (nullptr);
+			s.id.store (-1);
+			this->free_ids.push_back (id);
+			this->count.fetch_sub (1, std::memory_order_relaxed);
+			return obj;
+		}
+		
+		/* 
+		 * Returns the object associated with the specified ID, or null if there
+		 * is none.  Does not block.
+		 */
+		T*
+		find (int id)
+		{
+			if (id < 0)
+				return nullptr;
+			page *p = this->pages[index_of (id) >> page_bits].load (std::memory_order_acquire);
+			if (!p)
+				return nullptr;
+			
+			// insert () sets the pointer before the ID, and erase () clears the
+			// pointer before the ID.  So if the ID matches both before and after
+			// the pointer is read, the pointer is either null or the one that was
+			// stored along with the ID.
+			slot& s = p->slots[index_of (id) & (page_size - 1)];
+			if (s.id.load () != id)
+				return nullptr;
+			T *obj = s.ptr.load ();
+			if (s.id.load () != id)
+				return nullptr;
+			return obj;
+		}
+	};
+}
+
+#endif
+
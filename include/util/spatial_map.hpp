@@ -0,0 +1,361 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__SPATIAL_MAP_H_
+#define _hCraft__SPATIAL_MAP_H_
+
+#include <utility>
+#include <new>
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+
+
+namespace hCraft {
+	
+	/* 
+	 * A flat hash map with open addressing and linear probing, meant to be
+	 * keyed by chunk_pos or block_pos (with chunk_pos_hash/block_pos_hash).
+	 * 
+	 * Entries live in a single array, so that lookups of positions that hash
+	 * close together stay within a few cache lines, unlike std::unordered_map
+	 * which allocates a node per entry.  The interface is a subset of
+	 * std::unordered_map's.
+	 * 
+	 * Erased entries leave a tombstone behind, so erasing does not move any
+	 * other entry: erasing while iterating is fine.  Inserting may rehash the
+	 * table though, which invalidates all iterators and references.
+	 */
+	template<typename K, typename V, typename Hash>
+	class spatial_map
+	{
+	public:
+		typedef K key_type;
+		typedef V mapped_type;
+		typedef std::pair<const K, V> value_type;
+		
+	private:
+		enum : unsigned char { SLOT_EMPTY = 0, SLOT_FULL, SLOT_DELETED };
+		
+		struct slot
+		{
+			alignas (value_type) unsigned char data[sizeof (value_type)];
+			
+			value_type* get () { return reinterpret_cast<value_type *> (this->data); }
+			const value_type* get () const { return reinterpret_cast<const value_type *> (this->data); }
+		};
+		
+		slot *slots;
+		unsigned char *states;
+		std::size_t cap;     // always a power of two, or zero.
+		std::size_t used;    // full slots
+		std::size_t deleted; // tombstones
+		Hash hasher;
+		
+		static const std::size_t min_capacity = 16;
+		
+	public:
+		template<typename MapT, typename ValT>
+		class basic_iterator
+		{
+			friend class spatial_map;
+			
+			MapT *m;
+			std::size_t i;
+			
+			void
+			skip ()
+			{
+				while (this->i < this->m->cap && this->m->states[this->i] != SLOT_FULL)
+					++ this->i;
+			}
+			
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef ValT value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef ValT* pointer;
+			typedef ValT& reference;
+			
+			basic_iterator (MapT *m = nullptr, std::size_t i = 0)
+				: m (m), i (i)
+				{ }
+			
+			// iterator -> const_iterator
+			template<typename M2, typename V2>
+			basic_iterator (const basic_iterator<M2, V2>& other)
+				: m (other.m), i (other.i)
+				{ }
+			
+			ValT& operator* () const { return *this->m->slots[this->i].get (); }
+			ValT* operator-> () const { return this->m->slots[this->i].get (); }
+			
+			basic_iterator&
+			operator++ ()
+			{
+				++ this->i;
+				this->skip ();
+				return *this;
+			}
+			
+			basic_iterator
+			operator++ (int)
+			{
+				basic_iterator prev = *this;
+				++ *this;
+				return prev;
+			}
+			
+			bool operator== (const basic_iterator& other) const { return this->i == other.i; }
+			bool operator!= (const basic_iterator& other) const { return this->i != other.i; }
+			
+			template<typename M2, typename V2> friend class basic_iterator;
+		};
+		
+		typedef basic_iterator<spatial_map, value_type> iterator;
+		typedef basic_iterator<const spatial_map, const value_type> const_iterator;
+		
+	private:
+		/* 
+		 * Returns the index of the slot that holds @{key}, or cap if the key
+		 * is not in the map.
+		 */
+		std::size_t
+		find_index (const K& key) const
+		{
+			if (this->used == 0)
+				return this->cap;
+			
+			std::size_t mask = this->cap - 1;
+			std::size_t i = this->hasher (key) & mask;
+			for (;;)
+				{
+					unsigned char st = this->states[i];
+					if (st == SLOT_EMPTY)
+						return this->cap;
+					if (st == SLOT_FULL && this->slots[i].get ()->first == key)
+						return i;
+					i = (i + 1) & mask;
+				}
+		}
+		
+		/* 
+		 * Reallocates the table with @{ncap} slots (a power of two), moving
+		 * all entries over and dropping tombstones.
+		 */
+		void
+		rehash (std::size_t ncap)
+		{
+			slot *oslots = this->slots;
+			unsigned char *ostates = this->states;
+			std::size_t ocap = this->cap;
+			
+			this->slots = static_cast<slot *> (::operator new (ncap * sizeof (slot)));
+			this->states = new unsigned char[ncap] ();
+			this->cap = ncap;
+			this->deleted = 0;
+			
+			std::size_t mask = ncap - 1;
+			for (std::size_t j = 0; j < ocap; ++j)
+				if (ostates[j] == SLOT_FULL)
+					{
+						value_type *v = oslots[j].get ();
+						std::size_t i = this->hasher (v->first) & mask;
+						while (this->states[i] != SLOT_EMPTY)
+							i = (i + 1) & mask;
+						new (this->slots[i].data) value_type (std::move (*v));
+						this->states[i] = SLOT_FULL;
+						v->~value_type ();
+					}
+			
+			::operator delete (oslots);
+			delete[] ostates;
+		}
+		
+		// keeps the load factor (tombstones included) under 0.7.
+		void
+		grow_for (std::size_t n)
+		{
+			if ((n + this->deleted) * 10 < this->cap * 7)
+				return;
+			
+			std::size_t ncap = this->cap ? this->cap : min_capacity;
+			while (n * 10 >= ncap * 7)
+				ncap <<= 1;
+			this->rehash (ncap);
+		}
+		
+		void
+		destroy_all ()
+		{
+			for (std::size_t i = 0; i < this->cap; ++i)
+				if (this->states[i] == SLOT_FULL)
+					this->slots[i].get ()->~value_type ();
+		}
+		
+	public:
+		spatial_map ()
+			: slots (nullptr), states (nullptr), cap (0), used (0), deleted (0)
+			{ }
+		
+		spatial_map (spatial_map&& other)
+			: slots (other.slots), states (other.states), cap (other.cap),
+				used (other.used), deleted (other.deleted)
+		{
+			other.slots = nullptr;
+			other.states = nullptr;
+			other.cap = other.used = other.deleted = 0;
+		}
+		
+		spatial_map (const spatial_map&) = delete;
+		spatial_map& operator= (const spatial_map&) = delete;
+		
+		~spatial_map ()
+		{
+			this->destroy_all ();
+			::operator delete (this->slots);
+			delete[] this->states;
+		}
+		
+	//----
+		
+		iterator
+		begin ()
+		{
+			iterator itr (this, 0);
+			itr.skip ();
+			return itr;
+		}
+		
+		const_iterator
+		begin () const
+		{
+			const_iterator itr (this, 0);
+			itr.skip ();
+			return itr;
+		}
+		
+		iterator end () { return iterator (this, this->cap); }
+		const_iterator end () const { return const_iterator (this, this->cap); }
+		
+		std::size_t size () const { return this->used; }
+		bool empty () const { return this->used == 0; }
+		
+	//----
+		
+		iterator
+		find (const K& key)
+			{ return iterator (this, this->find_index (key)); }
+		
+		const_iterator
+		find (const K& key) const
+			{ return const_iterator (this, this->find_index (key)); }
+		
+		std::size_t
+		count (const K& key) const
+			{ return (this->find_index (key) != this->cap) ? 1 : 0; }
+		
+		
+		/* 
+		 * Inserts a value-initialized entry for @{key} if there is none, and
+		 * returns an iterator to it along with whether it was inserted.
+		 */
+		std::pair<iterator, bool>
+		try_emplace (const K& key)
+		{
+			std::size_t idx = this->find_index (key);
+			if (idx != this->cap)
+				return std::make_pair (iterator (this, idx), false);
+			
+			this->grow_for (this->used + 1);
+			
+			// reuse the first tombstone on the probe sequence, if any.
+			std::size_t mask = this->cap - 1;
+			std::size_t i = this->hasher (key) & mask;
+			while (this->states[i] == SLOT_FULL)
+				i = (i + 1) & mask;
+			if (this->states[i] == SLOT_DELETED)
+				-- this->deleted;
+			
+			new (this->slots[i].data) value_type (std::piecewise_construct,
+				std::forward_as_tuple (key), std::forward_as_tuple ());
+			this->states[i] = SLOT_FULL;
+			++ this->used;
+			return std::make_pair (iterator (this, i), true);
+		}
+		
+		V&
+		operator[] (const K& key)
+			{ return this->try_emplace (key).first->second; }
+		
+		
+		/* 
+		 * Removes the entry pointed to by @{itr}, and returns an iterator to
+		 * the entry that follows it.
+		 */
+		iterator
+		erase (iterator itr)
+		{
+			std::size_t i = itr.i;
+			this->slots[i].get ()->~value_type ();
+			-- this->used;
+			
+			// a tombstone is only needed if some probe sequence may pass
+			// through this slot.
+			if (this->states[(i + 1) & (this->cap - 1)] == SLOT_EMPTY)
+				this->states[i] = SLOT_EMPTY;
+			else
+				{
+					this->states[i] = SLOT_DELETED;
+					++ this->deleted;
+				}
+			
+			++ itr;
+			return itr;
+		}
+		
+		std::size_t
+		erase (const K& key)
+		{
+			std::size_t idx = this->find_index (key);
+			if (idx == this->cap)
+				return 0;
+			this->erase (iterator (this, idx));
+			return 1;
+		}
+		
+		void
+		clear ()
+		{
+			this->destroy_all ();
+			for (std::size_t i = 0; i < this->cap; ++i)
+				this->states[i] = SLOT_EMPTY;
+			this->used = this->deleted = 0;
+		}
+		
+		/* 
+		 * Makes room for @{n} entries without rehashing.
+		 */
+		void
+		reserve (std::size_t n)
+			{ this->grow_for (n); }
+	};
+}
+
+#endif
+
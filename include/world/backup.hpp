@@ -0,0 +1,124 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__BACKUP_H_
+#define _hCraft__BACKUP_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+
+namespace hCraft {
+	
+	class world;
+	
+	
+	/* 
+	 * Describes a single backup in a world's backup chain.
+	 */
+	struct backup_info
+	{
+		int num;
+		bool base;         // a full copy of the world file, rather than a delta
+		int parent;        // the backup this one is a delta of (0 for bases)
+		unsigned long long file_size;
+		long long time;    // UNIX timestamp
+		unsigned int block_count; // number of 4KB blocks stored
+	};
+	
+	
+	/* 
+	 * Incremental world backups.
+	 * 
+	 * Each backup is either a base (a full copy of the world file), or a delta
+	 * that only holds the 4KB blocks of the file that were written to since
+	 * the backup before it.  A world's backups are stored under
+	 * data/backups/<world>/ (the world's name in lowercase) as pairs of files:
+	 * <num>.blk holds the block data, and <num>.idx describes the backup (and
+	 * lists the blocks of deltas).
+	 * 
+	 * Copies are done with copy_file_range () (and reflinks, for bases) where
+	 * the filesystem supports them.
+	 */
+	class backup_chain
+	{
+		std::string world_name;
+		std::string dir;
+		
+	public:
+		/* 
+		 * A new base is taken after this many deltas, so that restores never
+		 * have to walk a long chain.
+		 */
+		static const int base_interval = 8;
+		
+	public:
+		backup_chain (const char *world_name);
+		
+		/* 
+		 * The directory the world's backups are kept in.  Old full-copy backups
+		 * (<world file>.<num>) live here too.
+		 */
+		inline const std::string& get_dir () const { return this->dir; }
+		
+		/* 
+		 * Returns the path of the old full-copy backup @{num} of the world file
+		 * named @{file_name} (e.g. "world.hw").
+		 */
+		std::string legacy_path (const char *file_name, int num) const;
+		
+		
+		
+		/* 
+		 * Fills @{out} with all backups in the chain, ordered by number.
+		 */
+		void list (std::vector<backup_info>& out);
+		
+		/* 
+		 * Reads the description of backup @{num} into @{out}.
+		 */
+		bool find (int num, backup_info& out);
+		
+		/* 
+		 * Returns true if a backup or restore of the world is in progress.
+		 */
+		bool busy ();
+		
+		
+		
+		/* 
+		 * Backs up world @{w} in the background.  Modified chunks are saved
+		 * first, and the world file is then copied without holding off
+		 * writes to it for longer than it takes to copy the blocks that change
+		 * during the backup.  @{done} is called from a pool thread with the
+		 * number of the new backup, or with -1 and an error message.
+		 * Returns false if another backup of the world is already running.
+		 */
+		bool start (world &w, std::function<void (int, const std::string&)> done);
+		
+		/* 
+		 * Rebuilds the world file as it was at backup @{num} from the chain, and
+		 * writes it out to @{dest_path} (replacing it atomically).
+		 */
+		bool restore (int num, const char *dest_path, std::string& err);
+	};
+}
+
+#endif
+
@@ -0,0 +1,102 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__CHANGE_TRACKER_H_
+#define _hCraft__CHANGE_TRACKER_H_
+
+#include "util/position.hpp"
+#include "slot/blocks.hpp"
+#include <unordered_map>
+#include <vector>
+
+
+namespace hCraft {
+	
+	class world;
+	class player;
+	
+	
+	/* 
+	 * Collects the block changes made to a world during a single tick, and
+	 * sends them to nearby players once the tick is over.
+	 * 
+	 * Changes are kept per chunk, and a block that is modified several times
+	 * during the same tick is only sent once (or not at all, if it ends up
+	 * being reverted to its original state). For every chunk, the tracker then
+	 * picks the cheapest way to get the changes across: a single block change,
+	 * a multi block change, or a resend of the modified sections only.
+	 * 
+	 * Edit stage commits go through the tracker as well, which is why it is
+	 * only to be used with the world's update lock held.
+	 */
+	class chunk_change_tracker
+	{
+		struct tracked_block
+		{
+			blocki old_bl;
+			blocki new_bl;
+			
+			// set if a player initiated any of the changes. Since the player's
+			// client might have already modified the block locally, changes like
+			// these are sent even if they end up reverting the block.
+			bool forced;
+		};
+		
+		struct tracked_chunk
+		{
+			// (y << 8) | (z << 4) | x
+			std::unordered_map<unsigned short, tracked_block> blocks;
+		};
+		
+		world *w;
+		std::unordered_map<chunk_pos, tracked_chunk, chunk_pos_hash> chunks;
+		
+	private:
+		void send_chunk (std::vector<player *>& players, int cx, int cz,
+			tracked_chunk& tch);
+		
+	public:
+		inline bool empty () const { return this->chunks.empty (); }
+		
+	public:
+		chunk_change_tracker (world *w);
+		
+		
+		/* 
+		 * Records a change made to the block at the specified coordinates.
+		 * The given block types should be the ones that players see (i.e.
+		 * vanilla equivalents of physics blocks).
+		 */
+		void mark (int x, int y, int z, blocki old_bl, blocki new_bl,
+			bool forced = false);
+		
+		/* 
+		 * Sends all recorded changes to the specified players, and clears the
+		 * tracker.
+		 */
+		void flush (std::vector<player *>& players);
+		
+		/* 
+		 * Discards all recorded changes.
+		 */
+		void clear ();
+	};
+}
+
+#endif
+
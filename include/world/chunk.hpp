@@ -21,6 +21,8 @@
 
 #include "slot/blocks.hpp"
 #include "util/position.hpp"
+#include "util/spatial_map.hpp"
+#include "util/slab.hpp"
 #include <unordered_set>
 #include <mutex>
 #include <functional>
@@ -105,6 +107,12 @@ namespace hCraft {
 		 */
 		~subchunk ();
 		
+		/* 
+		 * Subchunks are allocated from a slab pool (see util/slab.hpp).
+		 */
+		static void* operator new (std::size_t size);
+		static void operator delete (void *ptr, std::size_t size);
+		
 		
 		/* 
 		 * Block interaction:
@@ -128,6 +136,35 @@ namespace hCraft {
 		unsigned char get_extra (int x, int y, int z);
 		
 		block_data get_block (int x, int y, int z);
+		
+		
+		/* 
+		 * Bulk block interaction:
+		 * 
+		 * These operate on whole rows of blocks at a time, and update the
+		 * subchunk's air\add counts and custom block bitmap once, instead of for
+		 * every block.
+		 */
+		
+		// fills the entire subchunk with the specified block.
+		void fill (unsigned short id, unsigned char meta, unsigned char ex = 0);
+		
+		// fills the given box (both corners inclusive). if @{recount} is false,
+		// recalc_counts () must be called before the subchunk is used again.
+		void fill_box (int x1, int y1, int z1, int x2, int y2, int z2,
+			unsigned short id, unsigned char meta, unsigned char ex = 0,
+			bool recount = true);
+		
+		// sets a single block without updating any counts or bitmaps.
+		// recalc_counts () must be called once all blocks have been set.
+		void set_block_raw (int x, int y, int z, unsigned short id,
+			unsigned char meta, unsigned char ex = 0);
+		
+		/* 
+		 * Rebuilds the air\add counts and the custom block bitmap from the
+		 * subchunk's ID arrays.
+		 */
+		void recalc_counts ();
 	};
 	
 	
@@ -145,7 +182,7 @@ namespace hCraft {
 		};
 		
 	public:
-		std::unordered_map<block_pos, sign, block_pos_hash> signs;
+		spatial_map<block_pos, sign, block_pos_hash> signs;
 		std::mutex lock;
 		
 	public:
@@ -185,6 +222,10 @@ namespace hCraft {
 		bool modified;
 		bool generated;
 		
+		// low 32 bits of the owning world's tick counter at the time the chunk
+		// was last looked up (used to pick chunks to evict).
+		unsigned int last_access;
+		
 		chunk *north; // -z
 		chunk *south; // +z
 		chunk *west;  // -x
@@ -215,6 +256,18 @@ namespace hCraft {
 		 */
 		~chunk ();
 		
+		/* 
+		 * Chunks are allocated from a slab pool as well.
+		 */
+		static void* operator new (std::size_t size);
+		static void operator delete (void *ptr, std::size_t size);
+		
+		/* 
+		 * Returns the pools used to allocate chunks and subchunks.
+		 */
+		static slab_pool& chunk_pool ();
+		static slab_pool& subchunk_pool ();
+		
 		
 		/* 
 		 * Creates (if does not already exist) and returns the sub-chunk located at
@@ -246,6 +299,22 @@ namespace hCraft {
 		
 		block_data get_block (int x, int y, int z);
 		
+		
+		/* 
+		 * Bulk block interaction:
+		 */
+		
+		// fills the subchunk at vertical position @{sy} (creating it if needed).
+		void fill_sub (int sy, unsigned short id, unsigned char meta, unsigned char ex = 0);
+		
+		// replaces the subchunk at vertical position @{sy} with a copy of @{sub}.
+		void copy_sub (int sy, const subchunk& sub);
+		
+		// fills the given box (both corners inclusive, in chunk coordinates).
+		// a box one block wide and long fills a column.
+		void fill_box (int x1, int y1, int z1, int x2, int y2, int z2,
+			unsigned short id, unsigned char meta, unsigned char ex = 0);
+		
 	//----
 		
 		/* 
@@ -276,6 +345,20 @@ namespace hCraft {
 		 */
 		void all_entities (std::function<void (entity *)> f);
 		
+		/* 
+		 * Checks whether the chunk's entity list is non-empty.
+		 */
+		bool has_entities ();
+		
+		
+	//----
+		
+		/* 
+		 * Returns the approximate amount of heap memory (in bytes) used by this
+		 * chunk and its sub-chunks.
+		 */
+		size_t memory_usage ();
+		
 		
 	//----
 		
@@ -0,0 +1,158 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__CHUNK_KERNELS_H_
+#define _hCraft__CHUNK_KERNELS_H_
+
+
+namespace hCraft {
+	
+	/* 
+	 * Instruction sets the chunk kernels have been written for, from slowest
+	 * to fastest.
+	 */
+	enum simd_level
+	{
+		SIMD_SCALAR = 0,
+		SIMD_SSE2,
+		SIMD_AVX2,
+	};
+	
+	
+	/* 
+	 * Loops over whole subchunks and chunks that are hot enough to be worth
+	 * vectorizing.  Every kernel has a scalar version, and SSE2/AVX2 versions
+	 * on x86 builds; the fastest one the CPU supports (as reported by CPUID) is
+	 * picked the first time a kernel is called.  All versions produce exactly
+	 * the same output.
+	 * 
+	 * Unless stated otherwise, arrays are laid out like subchunk arrays: 4096
+	 * bytes for IDs, 2048 for nibble arrays, and indexed with (y << 8) |
+	 * (z << 4) | x.
+	 */
+	namespace chunk_kernels {
+		
+		/* 
+		 * Scans the 4096 IDs in @{ids} (lower 8 bits only), sets the bits of
+		 * @{custom} (128 words) that correspond to IDs the vanilla client does
+		 * not know about, and returns the number of non-air IDs.
+		 */
+		typedef int (*classify_ids_fn) (const unsigned char *ids,
+			unsigned int *custom);
+		
+		/* 
+		 * Computes the heightmap of a chunk: for every column, one plus the Y
+		 * coordinate of the highest block whose entry in @{table} (256 bytes,
+		 * indexed by ID) is non-zero, or 0 if there is none.  @{subs} holds the
+		 * ID arrays of the chunk's 16 subchunks, where null stands for a
+		 * subchunk that is all air.  @{table} [0] must be zero.
+		 */
+		typedef void (*heightmap_fn) (const unsigned char *const *subs,
+			const unsigned char *table, int *heights);
+		
+		/* 
+		 * Translates the IDs and metadata values of a subchunk into the ones that
+		 * are sent to the client.  Only groups of 32 blocks whose bit is set in
+		 * @{custom} are translated, the rest are copied as is.  Each ID is
+		 * replaced with @{id_table} [id] and its metadata with @{meta_table} [id],
+		 * unless the latter is 0xFF, in which case the metadata is kept.
+		 */
+		typedef void (*translate_ids_fn) (const unsigned char *ids,
+			const unsigned char *meta, const unsigned int *custom,
+			const unsigned char *id_table, const unsigned char *meta_table,
+			unsigned char *out_ids, unsigned char *out_meta);
+		
+		/* 
+		 * Packs @{count} bytes (each holding a value between 0-15) from @{in}
+		 * into @{count} / 2 nibbles, low nibble first.  @{count} must be even.
+		 */
+		typedef void (*pack_nibbles_fn) (const unsigned char *in,
+			unsigned char *out, int count);
+		
+		/* 
+		 * The inverse of pack_nibbles: expands @{count} nibbles from @{in} into
+		 * @{count} bytes.  @{count} must be even.
+		 */
+		typedef void (*unpack_nibbles_fn) (const unsigned char *in,
+			unsigned char *out, int count);
+		
+		
+		struct kernel_set
+		{
+			simd_level level;
+			
+			classify_ids_fn classify_ids;
+			heightmap_fn heightmap;
+			translate_ids_fn translate_ids;
+			pack_nibbles_fn pack_nibbles;
+			unpack_nibbles_fn unpack_nibbles;
+		};
+		
+		
+		/* 
+		 * Returns the best instruction set supported by the CPU.
+		 */
+		simd_level detect ();
+		
+		/* 
+		 * Returns the name of the given level ("scalar", "sse2" or "avx2").
+		 */
+		const char* level_name (simd_level level);
+		
+		/* 
+		 * Returns the kernels written for the specified instruction set, or null
+		 * if they were not compiled in or the CPU cannot run them.
+		 */
+		const kernel_set* get (simd_level level);
+		
+		/* 
+		 * Returns the fastest set of kernels the CPU can run.
+		 */
+		const kernel_set& best ();
+		
+		
+		
+		inline int
+		classify_ids (const unsigned char *ids, unsigned int *custom)
+			{ return best ().classify_ids (ids, custom); }
+		
+		inline void
+		heightmap (const unsigned char *const *subs, const unsigned char *table,
+			int *heights)
+			{ best ().heightmap (subs, table, heights); }
+		
+		inline void
+		translate_ids (const unsigned char *ids, const unsigned char *meta,
+			const unsigned int *custom, const unsigned char *id_table,
+			const unsigned char *meta_table, unsigned char *out_ids,
+			unsigned char *out_meta)
+			{ best ().translate_ids (ids, meta, custom, id_table, meta_table,
+				out_ids, out_meta); }
+		
+		inline void
+		pack_nibbles (const unsigned char *in, unsigned char *out, int count)
+			{ best ().pack_nibbles (in, out, count); }
+		
+		inline void
+		unpack_nibbles (const unsigned char *in, unsigned char *out, int count)
+			{ best ().unpack_nibbles (in, out, count); }
+	}
+}
+
+#endif
+
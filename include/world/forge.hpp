@@ -0,0 +1,102 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__FORGE_H_
+#define _hCraft__FORGE_H_
+
+#include <functional>
+#include <vector>
+
+
+namespace hCraft {
+	
+	class world;
+	class world_generator;
+	
+	
+	/* 
+	 * Options for the world forge.
+	 */
+	struct forge_options
+	{
+		int threads;    // 0 = one per core
+		int codec;      // CODEC_* to save chunks with (-1 = provider default)
+		int level;
+		bool relight;   // relight converted chunks
+		
+		// called with the number of chunks done so far, and the total.
+		std::function<void (int, int)> progress;
+		
+		forge_options ()
+			: threads (0), codec (-1), level (6), relight (false)
+			{ }
+	};
+	
+	
+	/* 
+	 * Pre-generates and converts whole worlds using all available cores.
+	 * 
+	 * The world passed to the forge must not be ticked or used by players
+	 * while the forge works on it (it is either a world that has not been
+	 * registered yet, or one owned by an offline tool).
+	 */
+	class world_forge
+	{
+		world &w;
+		forge_options opts;
+		std::vector<world_generator *> gens; // one per thread
+		
+	private:
+		int thread_count () const;
+		void apply_codec ();
+		
+		void generate_row (int row, int x_chunks, int z_chunks);
+		void finish_row (int row, int x_chunks, int z_chunks);
+		
+	public:
+		world_forge (world &w, const forge_options& opts);
+		
+		
+		
+		/* 
+		 * Generates, lights and saves every chunk of the (bounded) world.
+		 * 
+		 * Chunks are generated in rows of 8x4-chunk tiles, two tile rows at a
+		 * time, and written out tile by tile so that neighbouring chunks end up
+		 * next to each other in the world file.  If the world file already
+		 * contains some of the rows (from an interrupted run), generation
+		 * resumes from the first incomplete one.
+		 * 
+		 * Returns the number of chunks generated.
+		 */
+		int pregenerate ();
+		
+		/* 
+		 * Copies every chunk stored by world @{srcw} into the forge's world, along with its portals, zones and security
+		 * settings.  Chunks the destination already has are skipped, so an
+		 * interrupted conversion can be resumed.
+		 * 
+		 * Returns the number of chunks copied (nothing is copied if the source
+		 * provider cannot enumerate its chunks).
+		 */
+		int convert (world &srcw);
+	};
+}
+
+#endif
+
@@ -124,6 +124,12 @@ namespace hCraft {
 		 * Cancels all chunk requests for the given world.
 		 */
 		void cancel_requests (world *w);
+		
+		/* 
+		 * Fills @{out} with the number of pending requests of every player that
+		 * has any (as <player id, count> pairs).
+		 */
+		void queue_depths (std::vector<std::pair<int, size_t>>& out);
 	};
 }
 
@@ -22,6 +22,7 @@
 #include <queue>
 #include <mutex>
 #include <bitset>
+#include <chrono>
 
 
 namespace hCraft {
@@ -79,11 +80,23 @@ namespace hCraft {
 		
 		/* 
 		 * Goes through all queued updates and handles them (No more than
-		 * @{max_updates} updates are handled).
+		 * @{max_updates} updates are handled, and handling stops once
+		 * @{deadline} has passed).
 		 * 
 		 * Returns the total amount of updates handled.
 		 */
-		int update (int max_updates = 384);
+		int update (int max_updates = 384,
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max ());
+		
+		/* 
+		 * Checks whether there are no queued updates.
+		 */
+		bool idle ();
+		
+		/* 
+		 * Returns the number of queued updates.
+		 */
+		size_t backlog ();
 		
 		/* 
 		 * Relights a whole chunk (as much as possible).
@@ -22,6 +22,9 @@
 #include "worldprovider.hpp"
 #include <fstream>
 #include <vector>
+#include <unordered_map>
+#include <map>
+#include <mutex>
 
 
 namespace hCraft {
@@ -34,12 +37,14 @@ namespace hCraft {
 		int z;
 		unsigned int sector_table[256];
 		int size;
+		unsigned char codec; // one of CODEC_*, stored right after the sector table
 		
 		hw_chunk (int x, int z)
 		{
 			this->x = x;
 			this->z = z;
 			this->size = 0;
+			this->codec = 0;
 			for (int i = 0; i < 256; ++i)
 				sector_table[i] = 0;
 		}
@@ -138,6 +143,126 @@ namespace hCraft {
 	};
 	
 	
+	class hw_sector_cache;
+	
+	/* 
+	 * Keeps track of unused space within a .hw file, in 512-byte units.
+	 * Space released while chunk reads are in flight is held back until all
+	 * of them complete, so a concurrent load never sees its sectors reused.
+	 * Not thread-safe by itself; the provider serializes access to it.
+	 */
+	class hw_free_map
+	{
+		std::map<unsigned int, unsigned int> extents; // offset -> length
+		std::vector<std::pair<unsigned int, unsigned int>> limbo;
+		int readers;
+		unsigned long long total;
+		
+	public:
+		bool dirty;
+		
+	private:
+		void insert (unsigned int off, unsigned int len);
+		void release_limbo ();
+		
+	public:
+		hw_free_map ();
+		
+		inline unsigned long long free_units () const { return this->total; }
+		
+		/* 
+		 * Finds the smallest free extent that can hold @{len} units and carves
+		 * the requested space out of it. Returns 0 if there is no such extent.
+		 */
+		unsigned int alloc (unsigned int len);
+		
+		/* 
+		 * Like alloc (), but picks the lowest-addressed extent that fits, and
+		 * only if it begins before @{below}.
+		 */
+		unsigned int alloc_below (unsigned int len, unsigned int below);
+		
+		/* 
+		 * Marks the given range as unused.
+		 */
+		void free (unsigned int off, unsigned int len);
+		
+		/* 
+		 * Removes the given range from the map, if any of it is marked free.
+		 */
+		void reserve (unsigned int off, unsigned int len);
+		
+		/* 
+		 * If the last extent ends exactly at @{end}, it is removed and its
+		 * offset returned (so that the file can be truncated). Otherwise,
+		 * returns @{end}.
+		 */
+		unsigned int trim_tail (unsigned int end);
+		
+		void begin_read ();
+		void end_read ();
+		
+		void clear ();
+		
+		unsigned int serialized_size () const;
+		unsigned int serialize (unsigned char *out) const;
+		void deserialize (const unsigned char *data, unsigned int len);
+	};
+	
+	/* 
+	 * Keeps track of which 4KB blocks of a .hw file were written to since the
+	 * last backup. Not thread-safe by itself; the provider only touches it
+	 * while holding its write lock.
+	 */
+	class hw_dirty_map
+	{
+		std::vector<unsigned long long> bits;
+		bool all;
+		unsigned long long last_block;
+		
+	public:
+		// position of the stream writer within the file, or -1 if unknown.
+		long long cursor;
+		
+	private:
+		void mark_blocks (unsigned long long first, unsigned long long last);
+		
+	public:
+		hw_dirty_map ();
+		
+		/* 
+		 * Marks the given byte range as modified.
+		 */
+		inline void
+		mark (unsigned long long off, unsigned long long len)
+			{ if (len > 0) this->mark_blocks (off >> 12, (off + len - 1) >> 12); }
+		
+		/* 
+		 * Marks @{len} bytes at the writer's cursor as modified, and moves the
+		 * cursor past them.
+		 */
+		inline void
+		advance (unsigned int len)
+			{
+				unsigned long long first = this->cursor >> 12;
+				unsigned long long last = (this->cursor + len - 1) >> 12;
+				this->cursor += len;
+				if (first != last || first != this->last_block)
+					this->mark_blocks (first, last);
+			}
+		
+		/* 
+		 * Forgets everything and treats the whole file as modified.
+		 */
+		void mark_all ();
+		
+		/* 
+		 * Moves the set of modified blocks into @{out}. Returns false if the
+		 * whole file should be considered modified.
+		 */
+		bool take (std::vector<unsigned int>& out);
+	};
+	
 	struct hw_layer
 	{
 		std::string name;
@@ -154,12 +279,45 @@ namespace hCraft {
 		hw_superblock *sblocks[4096];
 		std::fstream strm;
 		
+		// held by everything that writes to the world file, so that backups
+		// can take a consistent copy of it.
+		std::recursive_mutex write_lock;
+		hw_dirty_map dmap;
+		
+		// flat chunk index (keyed by chunk coordinates) into the table tree
+		// above, so that lookups on the load path do not have to walk it.
+		std::unordered_map<unsigned long long, hw_chunk *> cindex;
+		std::mutex idx_lock;
+		
+		// read-only descriptor used by load (), independent of @{strm}.
+		int rfd;
+		hw_sector_cache *scache;
+		
+		// chunks stored with CODEC_RAW that idle () should recompress.
+		std::vector<unsigned long long> raw_pending;
+		unsigned int save_counter;
+		
+		hw_free_map fmap;
+		
+		// chunks left to visit in the current compaction pass, in Z-order.
+		std::vector<unsigned long long> compact_queue;
+		size_t compact_pos;
+		
+		int codec;
+		int codec_level;
+		int bg_codec;
+		
 		world_information inf;
 		
 		std::vector<hw_layer> layers;
 		
 	private:
 		void read_layer_table (std::fstream& strm);
+		unsigned char* read_layer (std::fstream& strm, const char *layer_name,
+			unsigned int& data_size);
+		
+		void validate_free_map (std::fstream& strm);
+		bool compact_some (int fd, int max_moves);
 		
 	protected:
 		void write_layer (const char *layer_name, const unsigned char *data,
@@ -200,6 +358,36 @@ namespace hCraft {
 		 */
 		virtual void close () override;
 		
+		/* 
+		 * Chunks are read through a separate read-only descriptor with pread (),
+		 * so load () can be called from several threads at once, and without
+		 * a prior call to open ().
+		 */
+		virtual bool concurrent_loads () override
+			{ return true; }
+		
+		/* 
+		 * Recompresses a few chunks that were stored raw (if the world was
+		 * configured to do so) with the background codec, and moves a few chunks
+		 * towards the front of the file if enough space has been freed.
+		 */
+		virtual void idle (world &wr) override;
+		
+		
+		
+		/* 
+		 * Sets the codec (CODEC_*) and level used by providers constructed from
+		 * this point on when saving chunks. If @{codec} is CODEC_RAW and
+		 * @{bg_codec} is not, chunks are written uncompressed on the save path
+		 * and recompressed later from idle ().
+		 */
+		static void set_default_codec (int codec, int level, int bg_codec);
+		
+		/* 
+		 * Changes the codec used by this provider for subsequent saves.
+		 */
+		void set_codec (int codec, int level, int bg_codec);
+		
 		
 		
 		/* 
@@ -270,6 +458,11 @@ namespace hCraft {
 		 */
 		virtual bool load (world &wr, chunk *ch, int x, int z) override;
 		
+		/* 
+		 * Fills @{out} with the coordinates of every chunk stored in the world.
+		 */
+		virtual void list_chunks (std::vector<std::pair<int, int>>& out) override;
+		
 		/* 
 		 * Loads world information into the specified structure.
 		 */
@@ -282,6 +475,16 @@ namespace hCraft {
 		 * Returns the filesystem path to the world file.
 		 */
 		virtual const char* get_path () override;
+		
+		
+		
+		/* 
+		 * Incremental backup support.
+		 */
+		virtual bool take_dirty_blocks (std::vector<unsigned int>& out,
+			unsigned long long& file_size) override;
+		virtual void mark_dirty_blocks (const std::vector<unsigned int>& blocks) override;
+		virtual void freeze (const std::function<void ()>& fn) override;
 	};
 }
 
@@ -25,6 +25,7 @@
 #include <utility>
 #include <string>
 #include <stdexcept>
+#include <functional>
 
 
 namespace hCraft {
@@ -56,6 +57,8 @@ namespace hCraft {
 		
 		std::string generator;
 		int seed;
+		
+		int view_dist; // 0 = the server's default
 	};
 	
 	
@@ -132,6 +135,20 @@ namespace hCraft {
 		 */
 		virtual void close () = 0;
 		
+		/* 
+		 * Returns true if load () is safe to call from multiple threads at
+		 * once, without surrounding it with open () and close ().
+		 */
+		virtual bool concurrent_loads ()
+			{ return false; }
+		
+		/* 
+		 * Called periodically from the world's thread, to let the provider
+		 * perform incremental background maintenance.
+		 */
+		virtual void idle (world &wr)
+			{ }
+		
 		
 		
 		/* 
@@ -203,6 +220,13 @@ namespace hCraft {
 		 */
 		virtual bool load (world &wr, chunk *ch, int x, int z) = 0;
 		
+		/* 
+		 * Fills @{out} with the coordinates of every chunk stored in the world.
+		 * Providers that cannot enumerate their chunks leave it empty.
+		 */
+		virtual void list_chunks (std::vector<std::pair<int, int>>& out)
+			{ }
+		
 		/* 
 		 * Returns a structure that contains essential information about the
 		 * underlying world.
@@ -218,6 +242,40 @@ namespace hCraft {
 		
 		
 		
+		/* 
+		 * Incremental backups:
+		 * Providers that store the world in a single file can keep track of which
+		 * 4KB blocks of it were written to, so that backups only have to copy
+		 * those.
+		 */
+		
+		/* 
+		 * Moves the indices of all blocks modified since the last call into
+		 * @{out} and stores the current size of the world file in @{file_size}.
+		 * Returns false if the provider does not track modifications, or if it
+		 * lost track of them (in which case the whole file should be copied).
+		 * Must be called from within freeze ().
+		 */
+		virtual bool take_dirty_blocks (std::vector<unsigned int>& out,
+			unsigned long long& file_size)
+			{ return false; }
+		
+		/* 
+		 * Marks the specified blocks as modified again (e.g. after a failed
+		 * backup).
+		 */
+		virtual void mark_dirty_blocks (const std::vector<unsigned int>& blocks)
+			{ }
+		
+		/* 
+		 * Calls @{fn} with all writes to the world file held off, and with
+		 * everything written so far flushed out to it.
+		 */
+		virtual void freeze (const std::function<void ()>& fn)
+			{ fn (); }
+		
+		
+		
 		/* 
 		 * Returns a new instance of the world provider named @{name}.
 		 * @{path} specifies the directory to which the world should be exported to/
@@ -0,0 +1,132 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__TICK_EXECUTOR_H_
+#define _hCraft__TICK_EXECUTOR_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+
+
+namespace hCraft {
+	
+	class world;
+	
+	// time between two consecutive ticks of a world.
+	static const std::chrono::milliseconds tick_period {5};
+	
+	
+	/* 
+	 * Runs the ticks of all loaded worlds on a fixed number of threads.
+	 * 
+	 * Every world is ticked at a fixed rate (once every 5ms).  Worlds that fall
+	 * behind are allowed to catch up on a limited number of missed ticks, after
+	 * which the backlog is dropped.  Each tick is told how far behind the world
+	 * is, so that it can shed low-priority work while catching up.  Worlds are
+	 * picked earliest-deadline first, so a single slow world cannot starve the
+	 * others.
+	 * 
+	 * Worlds that stay idle for long enough (see world::tick ()) are asked to
+	 * hibernate, and are not ticked again until they are woken up.
+	 */
+	class tick_executor
+	{
+		typedef std::chrono::steady_clock clock;
+		
+		struct entry
+		{
+			world *w;
+			clock::time_point next; // when the next tick is due
+			int idle_ticks;
+			
+			bool busy;     // being ticked right now
+			bool queued;   // in the run queue
+			bool sleeping; // hibernating
+			bool removed;
+		};
+		
+		typedef std::pair<clock::time_point, entry *> queued_entry;
+		struct queued_entry_cmp
+		{
+			bool operator() (const queued_entry& a, const queued_entry& b) const
+				{ return a.first > b.first; }
+		};
+		
+	private:
+		std::vector<std::thread> threads;
+		bool running;
+		
+		std::unordered_map<world *, entry *> entries;
+		std::priority_queue<queued_entry, std::vector<queued_entry>, queued_entry_cmp> runq;
+		std::mutex lock;
+		std::condition_variable cv;      // run queue changes
+		std::condition_variable done_cv; // a tick has finished
+		
+	private:
+		/* 
+		 * The function ran by each of the executor's threads.
+		 */
+		void main_loop ();
+		
+		void push_nolock (entry *e);
+		
+	public:
+		tick_executor ();
+		~tick_executor ();
+		
+		
+		
+		/* 
+		 * Starts the specified amount of threads.
+		 */
+		void start (int thread_count);
+		
+		/* 
+		 * Waits for ticks in progress to finish, and stops all threads.
+		 */
+		void stop ();
+		
+		
+		
+		/* 
+		 * Starts ticking the specified world.
+		 */
+		void add (world *w);
+		
+		/* 
+		 * Stops ticking the given world.  If the world is being ticked, the
+		 * function blocks until the tick completes (and so must not be called
+		 * from within the world's tick).
+		 */
+		void remove (world *w);
+		
+		/* 
+		 * Resumes ticking a hibernating world.
+		 */
+		void wake (world *w);
+	};
+}
+
+#endif
+
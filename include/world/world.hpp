@@ -31,10 +31,12 @@
 #include "block_history.hpp"
 #include "world_security.hpp"
 #include "zone.hpp"
+#include "system/metrics.hpp"
 
 #include <unordered_set>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <thread>
@@ -51,6 +53,7 @@ namespace hCraft {
 	class player;
 	class player_list;
 	class world_transaction;
+	class chunk_change_tracker;
 	
 	
 	/* 
@@ -129,20 +132,35 @@ namespace hCraft {
 		char name[33]; // 32 chars max
 		player_list *players;
 		
-		std::unique_ptr<std::thread> th;
-		bool th_running;
+		bool ticking; // registered with the server's tick executor
+		std::atomic<bool> hibernating;
+		chunk_change_tracker *chtr;
 		
 		std::deque<block_update> updates;
 		world_physics_state ph_state;
 		unsigned long long ticks;
 		unsigned long long wtime;
 		bool wtime_frozen;
+		std::chrono::steady_clock::time_point wtime_clock; // wall time wtime is synced to
+		std::atomic<int> tick_lag; // ticks behind schedule at the start of the last tick
 		
 		std::unordered_map<unsigned long long, chunk *> chunks;
 		std::vector<tagged_chunk> bad_chunks;
 		std::mutex chunk_lock;
 		std::mutex bad_chunk_lock;
 		
+		// chunks picked for eviction that are still being saved.  a lookup that
+		// finds its chunk in here puts it back into the world.
+		std::unordered_map<unsigned long long, chunk *> evicting;
+		std::atomic<int> pending_tasks; // see run_async ()
+		long long chunk_mem; // as of the last eviction pass
+		
+		// adaptive view distance (see adjust_view_distance ())
+		std::atomic<int> view_cap;
+		std::chrono::steady_clock::time_point vd_clock; // time of the last check
+		unsigned long long vd_tick_count, vd_tick_sum; // tick_times at the last check
+		int vd_calm_checks;
+		
 		struct { int x, z; chunk *ch; } last_chunk;
 		
 		std::unordered_set<entity *> entities;
@@ -176,9 +194,20 @@ namespace hCraft {
 		int def_gm;
 		std::string def_inv;
 		int use_def_inv;
+		int view_dist; // 0 = the server's default
 		
 		int id;
 		
+		metric_histogram tick_times;
+		metric_window recent_tick_times;
+		metric_histogram save_times;
+		
+		// time spent in each phase of a tick
+		metric_histogram update_times;
+		metric_histogram light_times;
+		metric_histogram maint_times;
+		metric_counter shed_ticks; // ticks that skipped low-priority work
+		
 	public:
 		inline server& get_server () const { return this->srv; }
 		inline world_type get_type () const { return this->typ; }
@@ -210,9 +239,31 @@ namespace hCraft {
 		inline std::mutex& get_update_lock () { return this->update_lock; }
 		inline std::mutex& get_chunk_lock () { return this->chunk_lock; }
 		
+		// only to be used with the update lock held.
+		inline chunk_change_tracker& get_change_tracker () { return *this->chtr; }
+		
 		inline world_security& security () { return this->wsec; }
 		inline zone_manager& get_zones () { return this->zman; }
 		
+		/* 
+		 * Returns the number of block updates waiting to be processed.
+		 */
+		size_t update_backlog ();
+		
+		/* 
+		 * The view distance configured for this world, and the one currently
+		 * in effect, which is lowered while the world takes longer to tick than
+		 * the server's tick budget allows.
+		 */
+		int max_view_distance () const;
+		inline int get_view_distance () const { return this->view_cap.load (); }
+		
+		/* 
+		 * How many ticks the world was running behind schedule as of its last
+		 * tick.
+		 */
+		inline int get_tick_lag () const { return this->tick_lag.load (); }
+		
 	public:
 		std::string get_colored_name ();
 		
@@ -220,16 +271,31 @@ namespace hCraft {
 		void set_generator (world_generator *gen);
 		
 	private:
-		/* 
-		 * The function ran by the world's thread.
-		 */
-		void worker ();
-		
 		std::unordered_set<entity *>::iterator
 		despawn_entity_nolock (std::unordered_set<entity *>::iterator itr);
 		
 		void get_information (world_information& inf);
 		
+		/* 
+		 * Unloads chunks that have not been used in a while and that no player
+		 * can see, if the world's chunks take up more memory than allowed by the
+		 * server's configuration.  Modified chunks are saved asynchronously.
+		 */
+		void evict_cold_chunks ();
+		void finish_eviction (const std::vector<tagged_chunk>& evicted);
+		
+		/* 
+		 * Shrinks the world's view distance by one chunk if recent ticks went
+		 * over budget, or grows it back once there has been headroom for a
+		 * while.
+		 */
+		void adjust_view_distance ();
+		
+		/* 
+		 * Blocks until all tasks started with run_async () have completed.
+		 */
+		void wait_for_tasks ();
+		
 	public:
 		/* 
 		 * Constructs a new empty world.
@@ -252,6 +318,13 @@ namespace hCraft {
 		 */
 		void reload_world (const char *name);
 		
+		/* 
+		 * Forgets about chunks that were evicted but not saved yet, so that they
+		 * are never written out, and waits for saves that already started.
+		 * Must be called before the world file is replaced on disk.
+		 */
+		void discard_pending_saves ();
+		
 	//----
 		
 		/* 
@@ -262,15 +335,39 @@ namespace hCraft {
 	//----
 		
 		/* 
-		 * Starts the world's "physics"-handling thread.
+		 * Starts ticking the world on the server's tick executor.
 		 */
 		void start ();
 		
 		/* 
-		 * Stops the world's thread.
+		 * Stops ticking the world.
 		 */
 		void stop ();
 		
+		/* 
+		 * Performs a single world tick (block and lighting updates, chunk
+		 * disposal, etc...).  Called by the server's tick executor, with @{lag}
+		 * being the number of ticks the world is running behind; lighting and
+		 * maintenance work is cut back while the world is trying to catch up.
+		 * Returns true if the world had nothing to do (no players, no queued
+		 * updates), in which case it may be put to sleep.
+		 */
+		bool tick (int lag = 0);
+		
+		/* 
+		 * Saves and frees all chunks so that the world can stop being ticked
+		 * until a player joins it again.  Returns false if the world turned out
+		 * to still be in use.
+		 */
+		bool hibernate ();
+		
+		/* 
+		 * Brings the world out of hibernation.
+		 */
+		void wake ();
+		
+		inline bool is_hibernating () const { return this->hibernating; }
+		
 		
 		
 		/* 
@@ -283,6 +380,18 @@ namespace hCraft {
 		 */
 		void save_meta ();
 		
+		/* 
+		 * Calls @{fn} with the world's provider while nothing can be written to
+		 * the world file (used to take consistent backups).
+		 */
+		void freeze_provider (const std::function<void (world_provider *)>& fn);
+		
+		/* 
+		 * Runs @{fn} on the server's thread pool.  The world is not destroyed,
+		 * and its chunks are not cleared, until the task completes.
+		 */
+		void run_async (std::function<void ()> fn);
+		
 		
 		
 		/* 
@@ -336,6 +445,11 @@ namespace hCraft {
 		 */
 		void clear_chunks (bool save, bool del = false);
 		
+		/* 
+		 * Frees chunks removed from the world that no player can see anymore.
+		 */
+		void dispose_bad_chunks ();
+		
 		/* 
 		 * Checks whether a block exists at the given coordinates.
 		 */
@@ -410,6 +524,11 @@ namespace hCraft {
 		
 		void queue_update (world_transaction *tr);
 		
+		/* 
+		 * Enqueues a batch of updates, taking the world's locks only once.
+		 */
+		void queue_updates (const std::vector<block_update>& batch);
+		
 		void queue_lighting (int x, int y, int z)
 			{ this->lm.enqueue (x, y, z); }
 		void queue_lighting_nolock (int x, int y, int z)
@@ -22,6 +22,7 @@
 #include "drawing/selection/world_selection.hpp"
 #include "system/security.hpp"
 #include "util/position.hpp"
+#include "util/spatial_map.hpp"
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -129,7 +130,7 @@ namespace hCraft {
 	class zone_manager
 	{
 		std::vector<zone *> zones;
-		std::unordered_map<chunk_pos, internal::zone_block *, chunk_pos_hash> blocks[4]; // 4x64 = 256
+		spatial_map<chunk_pos, internal::zone_block *, chunk_pos_hash> blocks[4]; // 4x64 = 256
 		std::mutex zone_lock;
 		
 	public:
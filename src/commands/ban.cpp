@@ -27,6 +27,20 @@ namespace hCraft {
 	namespace commands {
 	
 		
+		enum _ban_status
+		{
+			BAN_OK,
+			BAN_NEW_PLAYER,      // the player has never logged in
+			BAN_ALREADY_BANNED,
+		};
+		
+		struct _ban_outcome
+		{
+			_ban_status status;
+			std::string name;
+			std::string colored_nick;
+		};
+		
 		static void
 		_ban_player (player *pl, std::string target_name,
 			const std::string& reason, const std::string& ban_msg, bool silent = false)
@@ -40,29 +54,34 @@ namespace hCraft {
 					return;
 				}
 			
+			std::string target_colored_nick;
+			int target_pid = 0;
+			int banner_pid = pl->pid ();
+			
 			player *target = srv.get_players ().find (target_name.c_str ());
 			if (target)
 				{
 					target->banned = true;
+					target_colored_nick = target->get_colored_nickname ();
+					target_name = target->get_username ();
+					target_pid = target->pid ();
 				}
-			std::string target_colored_nick;
 			
-			int target_pid = 0;
-			int banner_pid = pl->pid ();
-
-			// record ban
-			{
-				soci::session sql (srv.sql_pool ());
-				
-				try
+			// record ban.
+			// offline players have to be looked up first, and all of it is done on
+			// the database thread.
+			bool online = (target != nullptr);
+			srv.get_sql_store ().query<_ban_outcome> (pl,
+				[&srv, online, target_name, target_colored_nick, target_pid, banner_pid, reason]
+				(soci::session& sql)
 					{
-						if (target)
-							{
-								target_colored_nick = target->get_colored_nickname ();
-								target_name = target->get_username ();
-								target_pid = target->pid ();
-							}
-						else
+						_ban_outcome out;
+						out.status = BAN_OK;
+						out.name = target_name;
+						out.colored_nick = target_colored_nick;
+						
+						int pid = target_pid;
+						if (!online)
 							{
 								if (!sqlops::player_exists (sql, target_name.c_str ()))
 									{
@@ -71,51 +90,61 @@ namespace hCraft {
 										pd.banned = true;
 										sqlops::save_player_data (sql, target_name.c_str (), srv, pd);
 										
-										target_colored_nick.assign ("§");
-										target_colored_nick.push_back (srv.get_groups ().default_rank.main ()->color);
-										target_colored_nick.append (target_name);
-										
-										if (!silent)
-											pl->message ("§7 | §cNOTE§7: §ePlayer " + target_colored_nick + " §ehas not logged in even once§7.");
+										out.colored_nick.assign ("§");
+										out.colored_nick.push_back (srv.get_groups ().default_rank.main ()->color);
+										out.colored_nick.append (target_name);
+										out.status = BAN_NEW_PLAYER;
 									}
 								else
 									{
 										if (sqlops::is_banned (sql, target_name.c_str ()))
 											{
-												if (!silent)
-													pl->message ("§c * §7Player is already banned§c.");
-												return;
+												out.status = BAN_ALREADY_BANNED;
+												return out;
 											}
 										
-										target_name = sqlops::player_name (sql, target_name.c_str ());
-										target_colored_nick = sqlops::player_colored_nick (sql, target_name.c_str (), srv);
+										out.name = sqlops::player_name (sql, target_name.c_str ());
+										out.colored_nick = sqlops::player_colored_nick (sql, out.name.c_str (), srv);
 									}
-								target_pid = sqlops::player_id (sql, target_name.c_str ());
+								pid = sqlops::player_id (sql, out.name.c_str ());
 							}
 						
-						sqlops::modify_ban_status (sql, target_name.c_str (), true);
-						sqlops::record_ban (sql, target_pid, banner_pid, reason.c_str ());
+						sqlops::modify_ban_status (sql, out.name.c_str (), true);
+						sqlops::record_ban (sql, pid, banner_pid, reason.c_str ());
+						return out;
+					},
+				[pl, reason, silent] (sql_result<_ban_outcome>& res)
+					{
+						if (!res.ok)
+							{
+								pl->message ("§4 * §cAn error has occurred while recording ban");
+								return;
+							}
+						else if (silent)
+							return;
 						
-						if (!silent)
+						_ban_outcome& out = res.value;
+						if (out.status == BAN_ALREADY_BANNED)
 							{
-								pl->message ("§7 | §eRecorded ban message§7: §c\"" + reason + "§c\"");
-								
-								std::ostringstream ss;
-								ss << "§4 > " << target_colored_nick << " §4has been banned by "
-									 << pl->get_colored_nickname () << "§4!";
-								srv.get_players ().message (ss.str ());
-								
-								srv.get_logger () (LT_SYSTEM) << "Player " << target_name << " has been banned by "
-									<< pl->get_username () << "! (reason: " << reason << ")" << std::endl;
-								if (srv.get_irc ())
-									srv.get_irc ()->chan_msg ("§c! " + target_name + " has been banned by " + pl->get_username () + "! §7(reason: §8" + reason + "§7)");
+								pl->message ("§c * §7Player is already banned§c.");
+								return;
 							}
-					}
-				catch (const std::exception& ex)
-					{
-						pl->message ("§4 * §cAn error has occurred while recording ban");
-					}
-			}
+						else if (out.status == BAN_NEW_PLAYER)
+							pl->message ("§7 | §cNOTE§7: §ePlayer " + out.colored_nick + " §ehas not logged in even once§7.");
+						
+						pl->message ("§7 | §eRecorded ban message§7: §c\"" + reason + "§c\"");
+						
+						server& srv = pl->get_server ();
+						std::ostringstream ss;
+						ss << "§4 > " << out.colored_nick << " §4has been banned by "
+							 << pl->get_colored_nickname () << "§4!";
+						srv.get_players ().message (ss.str ());
+						
+						srv.get_logger () (LT_SYSTEM) << "Player " << out.name << " has been banned by "
+							<< pl->get_username () << "! (reason: " << reason << ")" << std::endl;
+						if (srv.get_irc ())
+							srv.get_irc ()->chan_msg ("§c! " + out.name + " has been banned by " + pl->get_username () + "! §7(reason: §8" + reason + "§7)");
+					});
 			
 			if (target)
 				target->kick (ban_msg.c_str (), ("Banned by " + std::string (pl->get_username ())).c_str ());
@@ -43,6 +43,7 @@
 #include "commands/money.hpp"
 #include "commands/mute.hpp"
 #include "commands/nick.hpp"
+#include "commands/perf.hpp"
 #include "commands/physics.hpp"
 #include "commands/ping.hpp"
 #include "commands/players.hpp"
@@ -90,6 +91,7 @@ namespace hCraft {
 	static command* create_c_whodid () { return new commands::c_whodid (); }
 	static command* create_c_rules () { return new commands::c_rules (); }
 	static command* create_c_players () { return new commands::c_players (); }
+	static command* create_c_perf () { return new commands::c_perf (); }
 	
 	// chat commands:
 	static command* create_c_me () { return new commands::c_me (); }
@@ -196,6 +198,7 @@ namespace hCraft {
 			{ "warnlog", create_c_warnlog },
 			{ "worlds", create_c_worlds },
 			{ "zone", create_c_zone },
+			{ "perf", create_c_perf },
 			};
 		
 		auto itr = creators.find (name);
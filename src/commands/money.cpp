@@ -35,6 +35,51 @@ namespace hCraft {
 			M_PAY,
 		};
 		
+		/* 
+		 * What an offline lookup of a player found.
+		 */
+		struct _m_target
+		{
+			bool found;
+			std::string name;
+			std::string colored_name;
+			
+			_m_target ()
+				: found (false)
+				{ }
+		};
+		
+		static void
+		_report_transfer (player *pl, player *target, _m_action act, double amount,
+			const std::string& target_name, const std::string& colored_target_name)
+		{
+			std::ostringstream ss;
+			if (act == M_PAY)
+				ss << "§7$" << utils::format_number (amount, 2)
+					 << " §ehas been sent to " << colored_target_name;
+			else if (act == M_GIVE)
+				ss << "§7$" << utils::format_number (amount, 2)
+					 << " §ehas been added to " << colored_target_name << "§e's account";
+			else
+				ss << "§7$" << utils::format_number (-amount, 2)
+					 << " §ehas been taken from " << colored_target_name << "§e's account";
+			pl->message (ss.str ());
+			if ((act != M_TAKE) && (target && target != pl))
+				{
+					ss.clear (); ss.str (std::string ());
+					ss << pl->get_colored_username () << " §ehas sent you §7$"
+						 << utils::format_number (amount, 2);
+				 	target->message (ss.str ());
+				}
+			
+			if (act == M_TAKE)
+				amount = -amount;
+			pl->get_logger () (LT_SYSTEM) << pl->get_username () << " has " <<
+				((act == M_PAY) ? "sent" : ((act == M_GIVE) ? "given" : "taken"))
+				<< " $" << utils::format_number (amount, 2) <<
+					((act == M_TAKE) ? " from " : " to ") << target_name << std::endl;
+		}
+		
 		static void
 		_pay_give_take (player *pl, command_reader& reader, _m_action act)
 		{
@@ -96,8 +141,6 @@ namespace hCraft {
 					return;
 				}
 		
-			std::string colored_target_name;
-			
 			// the easy way
 			player *target = pl->get_server ().get_players ().find (target_name.c_str ());
 			if (target)
@@ -105,60 +148,47 @@ namespace hCraft {
 					if (act == M_PAY)
 						pl->bal -= amount;
 					target->bal += amount;
-					target_name.assign (target->get_username ());
-					colored_target_name.assign (target->get_colored_username ());
-				}
-			else
-				{
-					// the hard way
-					soci::session sql (pl->get_server ().sql_pool ());
-					try
-						{
-							if (!sqlops::player_exists (sql, target_name.c_str ()))
-								{
-									pl->message ("§c * §7No such player§f: §c" + target_name);
-									return;
-								}
-							if (act == M_PAY)
-								pl->bal -= amount;
-							sqlops::add_money (sql, target_name.c_str (), amount);
-							colored_target_name.assign (sqlops::player_colored_name (sql,
-								target_name.c_str (), pl->get_server ()));
-							target_name.assign (sqlops::player_name (sql, target_name.c_str ()));
-						}
-					catch (const std::exception& ex)
-						{
-							pl->message ("§4 * §cAn error has occurred§4.");
-							return;
-						}
+					_report_transfer (pl, target, act, amount, target->get_username (),
+						target->get_colored_username ());
+					return;
 				}
 			
-			std::ostringstream ss;
+			// the hard way.
+			// the money is taken out of the sender's account before the query is
+			// queued, so that it cannot be spent twice while it runs.
 			if (act == M_PAY)
-				ss << "§7$" << utils::format_number (amount, 2)
-					 << " §ehas been sent to " << colored_target_name;
-			else if (act == M_GIVE)
-				ss << "§7$" << utils::format_number (amount, 2)
-					 << " §ehas been added to " << colored_target_name << "§e's account";
-			else
-				ss << "§7$" << utils::format_number (-amount, 2)
-					 << " §ehas been taken from " << colored_target_name << "§e's account";
-			pl->message (ss.str ());
-			if ((act != M_TAKE) && (target && target != pl))
-				{
-					ss.clear (); ss.str (std::string ());
-					ss << pl->get_colored_username () << " §ehas sent you §7$"
-						 << utils::format_number (amount, 2);
-				 	target->message (ss.str ());
-				}
-			
-			if (act == M_TAKE)
-				amount = -amount;
-			pl->get_logger () (LT_SYSTEM) << pl->get_username () << " has " <<
-				((act == M_PAY) ? "sent" : ((act == M_GIVE) ? "given" : "taken"))
-				<< " $" << utils::format_number (amount, 2) <<
-					((act == M_TAKE) ? " from " : " to ") << target_name << std::endl;
-			return;
+				pl->bal -= amount;
+			server &srv = pl->get_server ();
+			srv.get_sql_store ().query<_m_target> (pl,
+				[&srv, target_name, amount] (soci::session& sql)
+					{
+						_m_target t;
+						t.found = sqlops::player_exists (sql, target_name.c_str ());
+						if (t.found)
+							{
+								sqlops::add_money (sql, target_name.c_str (), amount);
+								t.colored_name = sqlops::player_colored_name (sql,
+									target_name.c_str (), srv);
+								t.name = sqlops::player_name (sql, target_name.c_str ());
+							}
+						return t;
+					},
+				[pl, act, amount, target_name] (sql_result<_m_target>& res)
+					{
+						if (!res.ok || !res.value.found)
+							{
+								if (act == M_PAY)
+									pl->bal += amount;
+								if (!res.ok)
+									pl->message ("§4 * §cAn error has occurred§4.");
+								else
+									pl->message ("§c * §7No such player§f: §c" + target_name);
+								return;
+							}
+						
+						_report_transfer (pl, nullptr, act, amount, res.value.name,
+							res.value.colored_name);
+					});
 		}
 		
 		static void
@@ -192,41 +222,45 @@ namespace hCraft {
 			std::string target_name = reader.next ();
 			double amount = reader.next ().as_float ();
 			
-			std::string colored_target_name;
-			
 			// the easy way
 			player *target = pl->get_server ().get_players ().find (target_name.c_str ());
 			if (target)
 				{
 					target->bal = amount;
-					colored_target_name.assign (target->get_colored_username ());
-				}
-			else
-				{
-					// the hard way
-					soci::session sql (pl->get_server ().sql_pool ());
-					try
-						{
-							if (!sqlops::player_exists (sql, target_name.c_str ()))
-								{
-									pl->message ("§c * §7No such player§f: §c" + target_name);
-									return;
-								}
-							sqlops::set_money (sql, target_name.c_str (), amount);
-							colored_target_name.assign (sqlops::player_colored_name (sql,
-								target_name.c_str (), pl->get_server ()));
-						}
-					catch (const std::exception& ex)
-						{
-							pl->message ("§4 * §cAn error has occurred§4.");
-							return;
-						}
+					std::ostringstream ss;
+					ss << target->get_colored_username () << "§e's balance has been set to §7$"
+						 << utils::format_number (amount, 2);
+					pl->message (ss.str ());
+					return;
 				}
 			
-			std::ostringstream ss;
-			ss << colored_target_name << "§e's balance has been set to §7$"
-				 << utils::format_number (amount, 2);
-			pl->message (ss.str ());
+			// the hard way
+			server &srv = pl->get_server ();
+			srv.get_sql_store ().query<_m_target> (pl,
+				[&srv, target_name, amount] (soci::session& sql)
+					{
+						_m_target t;
+						t.found = sqlops::player_exists (sql, target_name.c_str ());
+						if (t.found)
+							{
+								sqlops::set_money (sql, target_name.c_str (), amount);
+								t.colored_name = sqlops::player_colored_name (sql,
+									target_name.c_str (), srv);
+							}
+						return t;
+					},
+				[pl, amount, target_name] (sql_result<_m_target>& res)
+					{
+						if (!res.ok)
+							{ pl->message ("§4 * §cAn error has occurred§4."); return; }
+						else if (!res.value.found)
+							{ pl->message ("§c * §7No such player§f: §c" + target_name); return; }
+						
+						std::ostringstream ss;
+						ss << res.value.colored_name << "§e's balance has been set to §7$"
+							 << utils::format_number (amount, 2);
+						pl->message (ss.str ());
+					});
 		}
 		
 		
@@ -314,24 +348,28 @@ namespace hCraft {
 								ss << target->get_colored_username () << "§e's balance§f: §a$§f" << utils::format_number (target->bal, 2);
 							else
 								{
-									soci::session sql (pl->get_server ().sql_pool ());
-									
-									try
-										{
-											if (!sqlops::player_exists (sql, target_name.c_str ()))
-												{
+									server &srv = pl->get_server ();
+									srv.get_sql_store ().query<std::string> (pl,
+										[&srv, target_name] (soci::session& sql)
+											{
+												if (!sqlops::player_exists (sql, target_name.c_str ()))
+													return std::string ();
+												
+												std::ostringstream ss;
+												ss << sqlops::player_colored_name (sql, target_name.c_str (), srv)
+													 << "§2's balance§f: §a$§f" << utils::format_number (sqlops::get_money (sql, target_name.c_str ()), 2);
+												return ss.str ();
+											},
+										[pl, target_name] (sql_result<std::string>& res)
+											{
+												if (!res.ok)
+													pl->message ("§4 * §cAn error has occurred§4.");
+												else if (res.value.empty ())
 													pl->message ("§c * §7No such player§f: §c" + target_name);
-													return;
-												}
-											
-											ss << sqlops::player_colored_name (sql, target_name.c_str (), pl->get_server ())
-												 << "§2's balance§f: §a$§f" << utils::format_number (sqlops::get_money (sql, target_name.c_str ()), 2);
-										}
-									catch (const std::exception& ex)
-										{
-											pl->message ("§4 * §cAn error has occurred§4.");
-											return;
-										}
+												else
+													pl->message (res.value);
+											});
+									return;
 								}
 						}
 				}
@@ -0,0 +1,174 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "commands/perf.hpp"
+#include "system/server.hpp"
+#include "player/player.hpp"
+#include "world/world.hpp"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+
+
+namespace hCraft {
+	namespace commands {
+		
+		static void
+		_show_worlds (player *pl)
+		{
+			std::vector<std::string> lines;
+			pl->get_server ().get_worlds ().all (
+				[&lines] (world *w)
+					{
+						std::ostringstream ss;
+						ss << std::fixed << std::setprecision (2);
+						ss << "§7 | " << w->get_colored_name () << "§f: ";
+						if (w->is_hibernating ())
+							ss << "§8hibernating";
+						else
+							{
+								static const double qs[] = { 50.0, 95.0, 99.0 };
+								double qv[3];
+								w->recent_tick_times.percentiles (qs, qv, 3);
+								ss << "§etick §a" << (qv[0] / 1000.0) << "§7/§e" << (qv[1] / 1000.0)
+									<< "§7/§c" << (qv[2] / 1000.0) << "§7ms";
+								if (w->get_tick_lag () > 0)
+									ss << " §c(" << w->get_tick_lag () << " behind)";
+							}
+						ss << " §eupdates §b" << w->update_backlog ()
+							<< " §elight §b" << w->lm.backlog ()
+							<< " §ephysics §b" << w->physics.updates.unsafe_size ();
+						lines.push_back (ss.str ());
+					});
+			
+			pl->message ("§3Worlds §7(median§f/§795th§f/§799th percentile of recent ticks)§f:");
+			for (const std::string& line : lines)
+				pl->message (line);
+			
+			std::ostringstream ss;
+			ss << "§7 | §eGlobal physics queue§f: §b"
+				<< pl->get_server ().global_physics.updates.unsafe_size ();
+			pl->message (ss.str ());
+		}
+		
+		static void
+		_show_packets (player *pl)
+		{
+			server& srv = pl->get_server ();
+			
+			std::vector<int> ops;
+			for (int op = 0; op < 0x100; ++op)
+				if (srv.packet_times[op].get_count () > 0)
+					ops.push_back (op);
+			std::sort (ops.begin (), ops.end (),
+				[&srv] (int a, int b)
+					{ return srv.packet_times[a].get_sum () > srv.packet_times[b].get_sum (); });
+			if (ops.size () > 8)
+				ops.resize (8);
+			
+			if (ops.empty ())
+				{
+					pl->message ("§c * §7No packets handled yet§c.");
+					return;
+				}
+			
+			pl->message ("§3Packet handlers §7(by total time)§f:");
+			for (int op : ops)
+				{
+					const metric_histogram& h = srv.packet_times[op];
+					std::ostringstream ss;
+					ss << std::fixed << std::setprecision (1);
+					ss << "§7 | §b0x" << std::hex << std::setw (2) << std::setfill ('0') << op
+						<< std::dec << std::setfill (' ') << "§f: §a" << h.get_count ()
+						<< " §7handled, mean §a" << ((double)h.get_sum () / h.get_count ())
+						<< "§7us, p99 §c" << h.percentile (99) << "§7us";
+					pl->message (ss.str ());
+				}
+		}
+		
+		static void
+		_show_players (player *pl)
+		{
+			server& srv = pl->get_server ();
+			
+			std::vector<std::pair<int, size_t>> depths;
+			srv.cgen.queue_depths (depths);
+			std::unordered_map<int, size_t> depth_map (depths.begin (), depths.end ());
+			
+			struct entry { std::string name; long long out; size_t gen; };
+			std::vector<entry> entries;
+			srv.get_players ().all (
+				[&entries, &depth_map] (player *p)
+					{
+						auto itr = depth_map.find (p->get_eid ());
+						entries.push_back ({ p->get_colored_username (), p->get_outbound_bytes (),
+							(itr == depth_map.end ()) ? 0 : itr->second });
+					});
+			std::sort (entries.begin (), entries.end (),
+				[] (const entry& a, const entry& b)
+					{ return (a.out + a.gen * 4096) > (b.out + b.gen * 4096); });
+			if (entries.size () > 8)
+				entries.resize (8);
+			
+			pl->message ("§3Players §7(outbound queue, pending chunk requests)§f:");
+			for (const entry& e : entries)
+				{
+					std::ostringstream ss;
+					ss << "§7 | " << e.name << "§f: §a" << (e.out / 1024) << "§7KB, §a"
+						<< e.gen << " §7chunks";
+					pl->message (ss.str ());
+				}
+		}
+		
+		
+		
+		/* 
+		 * /perf -
+		 * 
+		 * Displays runtime performance metrics: world tick times and backlogs,
+		 * packet handler times, and per-player queues.
+		 * 
+		 * Permissions:
+		 *   - command.info.perf
+		 *       Needed to execute the command.
+		 */
+		void
+		c_perf::execute (player *pl, command_reader& reader)
+		{
+			if (!pl->perm (this->get_exec_permission ()))
+				return;
+			
+			if (!reader.parse (this, pl))
+				return;
+			if (reader.arg_count () > 1)
+				{ this->show_summary (pl); return; }
+			
+			std::string what = reader.has_next () ? reader.next ().as_str () : "";
+			if (what.empty () || what == "worlds")
+				_show_worlds (pl);
+			else if (what == "packets")
+				_show_packets (pl);
+			else if (what == "players")
+				_show_players (pl);
+			else
+				this->show_summary (pl);
+		}
+	}
+}
+
@@ -78,6 +78,8 @@ namespace hCraft {
 						return (*a) > (*b);
 					});
 			
+			// keeps the players collected below from being destroyed under us.
+			epoch_guard eg {pl->get_server ().get_epochs ()};
 			for (group *grp : group_list)
 				{
 					std::vector<player *> vec;
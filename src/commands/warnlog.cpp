@@ -31,11 +31,99 @@ namespace hCraft {
 		
 		struct warn_entry {
 			unsigned int num;
-			unsigned int warner;
+			std::string warner; // colored name
 			std::string reason;
 			std::time_t when;
 		};
 		
+		struct warn_log {
+			bool found;
+			std::string col_nick;
+			std::vector<warn_entry> warns;
+		};
+		
+		
+		
+		static warn_log
+		_fetch_warn_log (soci::session& sql, const std::string& target_name,
+			server& srv)
+		{
+			warn_log log;
+			
+			sqlops::player_info pinf;
+			log.found = sqlops::player_data (sql, target_name.c_str (), srv, pinf);
+			if (!log.found)
+				return log;
+			
+			int target_pid = pinf.id;
+			log.col_nick = "§" + std::string (1, pinf.rnk.main ()->color) + pinf.nick;
+			
+			std::vector<unsigned int> warners;
+			soci::rowset<soci::row> rs = (sql.prepare << "SELECT `num`, `warner`, `reason`, `warn_time` FROM `warns` WHERE `target`=:tar",
+				soci::use (target_pid));
+			for (auto itr = rs.begin (); itr != rs.end (); ++itr)
+				{
+					const soci::row& r = *itr;
+					log.warns.push_back ({
+						.num = (unsigned int)sqlops::column_int (r, 0),
+						.warner = std::string (),
+						.reason = r.get<std::string> (2),
+						.when = (std::time_t)sqlops::column_int (r, 3)
+					});
+					warners.push_back ((unsigned int)sqlops::column_int (r, 1));
+				}
+			
+			// resolve the names of the warners while still on the database thread.
+			for (std::size_t i = 0; i < log.warns.size (); ++i)
+				log.warns[i].warner = sqlops::player_colored_name (sql, warners[i], srv);
+			
+			std::sort (log.warns.begin (), log.warns.end (),
+				[] (const warn_entry& a, const warn_entry& b)
+					{
+						return a.num < b.num;
+					});
+			return log;
+		}
+		
+		static void
+		_show_warn_log (player *pl, bool self, const warn_log& log)
+		{
+			const std::vector<warn_entry>& warns = log.warns;
+			if (warns.empty ())
+				{
+					if (self)
+						pl->message ("§3You have no warnings§e.");
+					else
+						pl->message (log.col_nick + " §3has no warnings§e.");
+					return;
+				}
+			
+			std::ostringstream ss;
+			if (self)
+				{
+					ss << "§cDisplaying your warnings §4[§7" << warns.size () << " §cwarning" << ((warns.size () == 1) ? "" : "s") << "§4]§f:";
+					pl->message (ss.str ());
+				}
+			else
+				{
+					ss << "§cDisplaying " << log.col_nick << "§c's warnings §4[§7" << warns.size () << " §cwarning" << ((warns.size () == 1) ? "" : "s") << "§4]§f:";
+					pl->message (ss.str ());
+				}
+			
+			std::time_t now = std::time (nullptr);
+			for (const warn_entry& warn : warns)
+				{
+					std::string rel;
+					utils::relative_time_short (now, warn.when, rel);
+					
+					ss.str (std::string ());
+					ss << "§8    #" << warn.num << ") §7by " << warn.warner << "§7, " << rel << " ago §7- §c" << warn.reason;
+					pl->message (ss.str ());
+				}
+		}
+		
+		
+		
 		/*
 		 * /warnlog
 		 * 
@@ -71,85 +159,21 @@ namespace hCraft {
 						}
 				}
 			
-			std::string target_col_nick = target_name;
-			int target_pid;
-			
-			try
-				{
-					soci::session sql {srv.sql_pool ()};
-					
-					sqlops::player_info pinf;
-					if (!sqlops::player_data (sql, target_name.c_str (), srv, pinf))
-						{
+			bool self = (target == pl);
+			srv.get_sql_store ().query<warn_log> (pl,
+				[&srv, target_name] (soci::session& sql)
+					{
+						return _fetch_warn_log (sql, target_name, srv);
+					},
+				[pl, self, target_name] (sql_result<warn_log>& res)
+					{
+						if (!res.ok)
+							pl->message ("§4 * §cFailed to fetch warn log§4.");
+						else if (!res.value.found)
 							pl->message ("§c * §7Unknown player§f: §c" + target_name);
-							return;
-						}
-					
-					target_pid = pinf.id;
-					target_name = pinf.name;
-					target_col_nick = "§" + std::string (1, pinf.rnk.main ()->color) + pinf.nick;
-					
-					soci::rowset<soci::row> rs = (sql.prepare << "SELECT `num`, `warner`, `reason`, `warn_time` FROM `warns` WHERE `target`=:tar",
-						soci::use (target_pid));
-					std::vector<warn_entry> warns;
-					for (auto itr = rs.begin (); itr != rs.end (); ++itr)
-						{
-							const soci::row& r = *itr;
-							warns.push_back ({
-								.num = r.get<unsigned int> (0),
-								.warner = r.get<unsigned int> (1),
-								.reason = r.get<std::string> (2),
-								.when = (std::time_t)r.get<unsigned long long> (3)
-							});
-						}
-					
-					std::sort (warns.begin (), warns.end (),
-						[] (const warn_entry& a, const warn_entry& b)
-							{
-								return a.num < b.num;
-							});
-					
-					if (warns.empty ())
-						{
-							if (target == pl)
-								pl->message ("§3You have no warnings§e.");
-							else
-								pl->message (target_col_nick + " §3has no warnings§e.");
-						}
-					else
-						{
-							std::ostringstream ss;
-							if (target == pl)
-								{
-									ss << "§cDisplaying your warnings §4[§7" << warns.size () << " §cwarning" << ((warns.size () == 1) ? "" : "s") << "§4]§f:";
-									pl->message (ss.str ());
-								}
-							else
-								{
-									ss << "§cDisplaying " << target_col_nick << "§c's warnings §4[§7" << warns.size () << " §cwarning" << ((warns.size () == 1) ? "" : "s") << "§4]§f:";
-									pl->message (ss.str ());
-								}
-							
-							for (warn_entry& warn : warns)
-								{
-									std::time_t now = std::time (nullptr);
-									std::time_t then = warn.when;
-									std::string rel;
-									utils::relative_time_short (now, then, rel);
-									
-									ss.str (std::string ());
-									ss << "§8    #" << warn.num << ") §7by " << sqlops::player_colored_name (sql, warn.warner, srv) << "§7, " << rel << " ago §7- §c" << warn.reason;
-									pl->message (ss.str ());
-								}
-						}
-				}
-			catch (const std::exception& ex)
-				{
-					pl->message ("§4 * §cFailed to fetch warn log§4.");
-					return;
-				}
-			
-			
+						else
+							_show_warn_log (pl, self, res.value);
+					});
 		}
 	}
 }
@@ -20,67 +20,72 @@
 #include "system/server.hpp"
 #include "player/player.hpp"
 #include "world/world.hpp"
+#include "world/forge.hpp"
 #include "util/stringutils.hpp"
 #include "world/providers/worldprovider.hpp"
 #include "world/generation/worldgenerator.hpp"
 #include <chrono>
 #include <functional>
 #include <thread>
+#include <sstream>
+#include <algorithm>
 
 
 namespace hCraft {
 	namespace commands {
 		
 		
+		/* 
+		 * The pre-generation thread may outlive the player that started it, so it
+		 * only keeps the player's entity ID, and looks the player up again (under
+		 * an epoch guard) whenever there is something to tell them.
+		 */
 		static void
-		_pregen_worker (player *pl, world *w, bool load)
+		_pregen_message (server& srv, int eid, const std::string& msg)
 		{
-			pl->message ("§d | §5World generation started");
-			
-			int x_chunks = w->get_width () / 16;
-			int z_chunks = w->get_depth () / 16;
-			int done = 0;
-			int left = x_chunks * z_chunks;
-			
-			int upmod = x_chunks * z_chunks / 64 / 10;
-			if (upmod == 0) upmod = 1;
-			int batches_done = 0;
+			epoch_guard eg {srv.get_epochs ()};
+			player *pl = srv.player_by_id (eid);
+			if (pl && !pl->is_disconnecting ())
+				pl->message (msg);
+		}
+		
+		static void
+		_pregen_worker (server& srv, int eid, world *w, bool load)
+		{
+			_pregen_message (srv, eid, "§d | §5World generation started");
 			
-			// populate the world in batches of 8x8 (64) chunks
-			for (int xb = 0; xb < x_chunks; xb += 8)
-				for (int zb = 0; zb < z_chunks; zb += 8)
-					{
-						for (int cx = xb; cx < (xb + 8) && cx < x_chunks; ++cx)
-							for (int cz = zb; cz < (zb + 8) && cz < z_chunks; ++cz)
-								{
-									w->load_chunk (cx, cz);
-									++ done;
-									-- left;
-								}
-						
-						w->clear_chunks (true);
-						if (batches_done++ % upmod == 0)
-							{
-								std::ostringstream ss;
-								ss << "§d |   §a%" << (batches_done / (x_chunks * z_chunks / 64.0) * 100.0) << " §5- §a" << done << "§5/§a" << (x_chunks * z_chunks) << " §5chunks done";
-								pl->message (ss.str ());
-							}
-					}
+			// report progress roughly every 10%
+			int next_report = 0;
+			// leave half the cores to the running server.
+			forge_options opts;
+			opts.threads = std::max (1, (int)std::thread::hardware_concurrency () / 2);
+			opts.progress = [&srv, eid, &next_report] (int done, int total)
+				{
+					int percent = (total > 0) ? (done * 100 / total) : 100;
+					if (percent < next_report)
+						return;
+					next_report = percent + 10;
+					
+					std::ostringstream ss;
+					ss << "§d |   §a%" << percent << " §5- §a" << done << "§5/§a" << total << " §5chunks done";
+					_pregen_message (srv, eid, ss.str ());
+				};
 			
-			w->prepare_spawn (0, true);
-			w->save_all ();
-			pl->message ("§d | §5Done");
+			world_forge forge {*w, opts};
+			forge.pregenerate ();
+			_pregen_message (srv, eid, "§d | §5Done");
 			
 			if (load)
 				{
-					if (!pl->get_server ().get_worlds ().add (w))
+					if (!srv.get_worlds ().add (w))
 						{
 							delete w;
-							pl->message ("§cFailed to load world§7.");
+							_pregen_message (srv, eid, "§cFailed to load world§7.");
+							return;
 						}
 					
 					w->start ();
-					pl->get_server ().get_players ().message (
+					srv.get_players ().message (
 						std::string ("§3World §b") + w->get_colored_name () + " §3has been loaded§b!");
 				}
 			else
@@ -93,7 +98,8 @@ namespace hCraft {
 		_pregen_world (player *pl, world *w, bool load)
 		{
 			// do this in a separate thread
-			std::thread (_pregen_worker, pl, w, load).detach ();
+			std::thread (_pregen_worker, std::ref (pl->get_server ()), pl->get_eid (),
+				w, load).detach ();
 		}
 		
 		/* 
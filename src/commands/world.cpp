@@ -23,12 +23,14 @@
 #include "system/sqlops.hpp"
 #include "util/cistring.hpp"
 #include "system/messages.hpp"
+#include "world/backup.hpp"
 #include <cstdio>
 #include <sys/stat.h>
 #include <unordered_map>
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <ctime>
 
 #include <iostream> // DEBUG
 
@@ -111,6 +113,13 @@ namespace hCraft {
 			// time
 			pl->message ("§e  Time§f: §9" + _get_time_str (w->get_time ()) + (w->is_time_frozen () ? " [Frozen]" : ""));
 			
+			// view distance
+			ss << "§e  View distance§f: §a" << w->get_view_distance () << " §7/ §a" << w->max_view_distance ();
+			if (w->view_dist <= 0)
+				ss << " §7(server default)";
+			pl->message (ss.str ());
+			ss.str (std::string ());
+			
 			// owners
 			const auto& owner_pids = sec.get_owners ();
 			if (owner_pids.empty ())
@@ -809,25 +818,6 @@ namespace hCraft {
 			return true;
 		}
 		
-		static int
-		_determine_backup_number (const std::string& path)
-		{
-			int num = 1;
-			std::ostringstream ss;
-			for (;;)
-				{
-					ss << path << "." << num;
-					
-					FILE *f = std::fopen (ss.str ().c_str (), "rb");
-					if (!f)
-						return num;
-					
-					std::fclose (f);
-					ss.str (std::string ());
-					++ num;
-				}
-		}
-		
 		static void
 		_handle_backup (player *pl, world *w, command_reader& reader)
 		{
@@ -837,32 +827,78 @@ namespace hCraft {
     			return;
     		}
     	
-    	mkdir ("data/backups", 0744);
-    	mkdir (("data/backups/" + std::string (w->get_name ())).c_str (), 0744);
+    	// the backup runs in the background, and the player might be gone by
+    	// the time it is done.
+    	server& srv = pl->get_server ();
+    	std::string pl_name = pl->get_username ();
+    	std::string w_name = w->get_colored_name ();
     	
-    	std::string dest = w->get_path ();
-    	dest.erase (0, 12); // remove "data/worlds/" part
-    	dest.insert (0, "data/backups/" + std::string (w->get_name ()) + "/");
-    	
-    	int backup_num = _determine_backup_number (dest.c_str ());
-    	std::ostringstream ss;
-    	ss << dest << "." << backup_num;
+    	backup_chain chain {w->get_name ()};
+    	bool started = chain.start (*w,
+    		[&srv, pl_name, w_name] (int num, const std::string& err)
+    			{
+    				srv.get_players ().all (
+    					[&] (player *pl)
+    						{
+    							if (pl_name.compare (pl->get_username ()) != 0)
+    								return;
+    							
+    							if (num == -1)
+    								{
+    									pl->message ("§4 * §cFailed to save backup of " + w_name + "§f: §c" + err);
+    									return;
+    								}
+    							
+    							std::ostringstream ss;
+    							ss << "§eBackup of " << w_name << " §esaved §f[§e#§b" << num << "§f]";
+    							pl->message (ss.str ());
+    							
+    							ss.str (std::string ());
+    							ss << "§7 | Use §e/world restore §b" << num << " §7to restore this backup.";
+    							pl->message (ss.str ());
+    						});
+    			});
     	
-    	w->save_all ();
-    	if (!_copy_file (ss.str ().c_str (), w->get_path ()))
-    		pl->message ("§4 * §cFailed to save backup§4.");
+    	if (!started)
+    		pl->message ("§c * §7A backup of this world is already in progress§c.");
     	else
-    		{
-    			pl->message ("§eBackup saved");
-    			
-    			ss.str (std::string ());
-    			ss << "§7 | Use §e/world restore §b" << backup_num << " §7to restore this backup.";
-    			pl->message (ss.str ());
-    		}
+    		pl->message ("§eBacking up world§f...");
 		}
 		
 		
 		
+		static void
+		_list_backups (player *pl, backup_chain& chain)
+		{
+			std::vector<backup_info> backups;
+			chain.list (backups);
+			if (backups.empty ())
+				{
+					pl->message ("§c * §7This world has no backups§c.");
+					return;
+				}
+			
+			pl->message ("§eBackups§f:");
+			size_t first = (backups.size () > 10) ? (backups.size () - 10) : 0;
+			for (size_t i = first; i < backups.size (); ++i)
+				{
+					const backup_info& inf = backups[i];
+					
+					char tstr[64];
+					std::time_t t = (std::time_t)inf.time;
+					std::strftime (tstr, sizeof tstr, "%Y-%m-%d %H:%M:%S", std::localtime (&t));
+					
+					std::ostringstream ss;
+					ss << "§7 | §b#" << inf.num << " §7" << tstr << " §f- ";
+					if (inf.base)
+						ss << "§efull";
+					else
+						ss << "§a" << inf.block_count << " §7changed blocks";
+					pl->message (ss.str ());
+				}
+			pl->message ("§7 | Use §e/world restore §bbackup-number §7to restore one.");
+		}
+		
 		static void
 		_handle_restore (player *pl, world *w, command_reader& reader)
 		{
@@ -872,9 +908,10 @@ namespace hCraft {
     			return;
     		}
     	
+    	backup_chain chain {w->get_name ()};
     	if (!reader.has_next ())
     		{
-    			pl->message ("§c * §7Usage§f: §e/world restore §cbackup-number");
+    			_list_backups (pl, chain);
     			return;
     		}
     	
@@ -886,32 +923,47 @@ namespace hCraft {
     			return;
     		}
     	
-    	std::string src = w->get_path ();
-    	src.erase (0, 12); // remove "data/worlds/" part
-    	src.insert (0, "data/backups/" + std::string (w->get_name ()) + "/");
-    	std::ostringstream ss;
-    	ss << src << "." << backup_num;
+    	// chunks evicted before the restore must not be saved over it.
+    	w->discard_pending_saves ();
     	
-    	FILE *f = std::fopen (ss.str ().c_str (), "rb");
-    	if (!f)
+    	backup_info inf;
+    	if (chain.find (backup_num, inf))
     		{
-    			pl->message ("§c * §7Backup does not exist§c.");
-    			return;
+    			// rebuild the file from the backup chain.
+    			std::string err;
+    			if (!chain.restore (backup_num, w->get_path (), err))
+    				{
+    					pl->message ("§4 * §cFailed to restore backup§f: §c" + err);
+    					return;
+    				}
+    		}
+    	else
+    		{
+    			// old full-copy backup
+    			std::string file_name = w->get_path ();
+    			file_name.erase (0, 12); // remove "data/worlds/" part
+    			std::string src = chain.legacy_path (file_name.c_str (), backup_num);
+    			
+    			FILE *f = std::fopen (src.c_str (), "rb");
+    			if (!f)
+    				{
+    					pl->message ("§c * §7Backup does not exist§c.");
+    					return;
+    				}
+    			std::fclose (f);
+    			
+    			_copy_file (w->get_path (), src.c_str ());
     		}
-    	std::fclose (f);
     	
-    	_copy_file (w->get_path (), ss.str ().c_str ());
     	w->reload_world (w->get_name ());
     	w->get_players ().all (
 				[] (player *pl)
 					{
-						std::cout << "W a" << std::endl;
 						pl->rejoin_world ();
-						std::cout << "W b" << std::endl;
 						pl->message ("§bWorld reloaded");
 					});
 			
-			ss.str (std::string ());
+			std::ostringstream ss;
 			ss << "§eRestored backup #§b" << backup_num;
 			pl->message (ss.str ());
 		}
@@ -1075,6 +1127,73 @@ namespace hCraft {
 		
 		
 		
+		static void
+		_handle_view_distance (player *pl, world *w, command_reader& reader)
+		{
+			std::ostringstream ss;
+			
+			if (!reader.has_next ())
+				{
+					pl->message ("§6Displaying view distance for " + w->get_colored_name () + "§e:");
+					ss << "§7    Current§f: §a" << w->get_view_distance () << " §7chunks";
+					pl->message (ss.str ());
+					ss.str (std::string ());
+					ss << "§7    Configured§f: §a" << w->max_view_distance () << " §7chunks";
+					if (w->view_dist <= 0)
+						ss << " (server default)";
+					pl->message (ss.str ());
+					return;
+				}
+			
+			if (!pl->has ("command.world.world.view-distance"))
+				{
+					pl->message (messages::not_allowed ());
+					return;
+				}
+			
+			std::string arg = reader.next ();
+			if (sutils::iequals (arg, "set"))
+				{
+					if (!reader.has_next ())
+						{
+							pl->message ("§c * §7Usage§f: §e/world view-distance set §cchunks");
+							return;
+						}
+					
+					auto a = reader.next ();
+					if (!a.is_int ())
+						{
+							pl->message ("§c * §7The view distance must be a number§c.");
+							return;
+						}
+					
+					int vd = a.as_int ();
+					if (vd < 2 || vd > 15)
+						{
+							pl->message ("§c * §7The view distance must be between §a2 §7and §a15§c.");
+							return;
+						}
+					
+					w->view_dist = vd;
+					ss << "§eView distance for " << w->get_colored_name () << " §ehas been set to§f: §a"
+						<< vd << " §7chunks";
+					pl->message (ss.str ());
+				}
+			else if (sutils::iequals (arg, "reset"))
+				{
+					w->view_dist = 0;
+					ss << "§eView distance for " << w->get_colored_name () << " §ehas been reset to the server default§f: §a"
+						<< w->max_view_distance () << " §7chunks";
+					pl->message (ss.str ());
+				}
+			else
+				{
+					pl->message ("§c * §7Unknown sub-command§f: §cview-distance." + arg);
+				}
+		}
+		
+		
+		
 		/* 
 		 * /world - 
 		 * 
@@ -1105,6 +1224,8 @@ namespace hCraft {
 		 *       Required to save the world.
 		 *   - commands.world.world.time
 		 *       Required to change the time of the world.
+		 *   - command.world.world.view-distance
+		 *       Required to change the world's view distance.
 		 */
 		void
 		c_world::execute (player *pl, command_reader& reader)
@@ -1149,6 +1270,7 @@ namespace hCraft {
 						{ "restore", _handle_restore },
 						{ "save", _handle_save },
 						{ "time", _handle_time },
+						{ "view-distance", _handle_view_distance },
 					};
 					
 					auto itr = _map.find (arg1.c_str ());
@@ -46,7 +46,7 @@ namespace hCraft {
 			struct callback_data {
 				server *srv;
 				world *w;
-				std::vector<player *> pls;
+				std::vector<int> pls; // entity IDs of the transferred players
 			};
 		}
 		
@@ -62,16 +62,24 @@ namespace hCraft {
 			wr->save_all ();
 			srv.get_worlds ().remove (wr);
 			
-			std::vector<player *>& pls = data->pls;
-			for (player *pl : pls)
-				{
-					if (pl->got_known_chunks_for (wr))
-						pl->disconnect ();
-				}
+			{
+				// the players might have left during the delay.
+				epoch_guard eg {srv.get_epochs ()};
+				for (int eid : data->pls)
+					{
+						player *pl = srv.player_by_id (eid);
+						if (pl && pl->got_known_chunks_for (wr))
+							pl->disconnect ();
+					}
+			}
 			
 			srv.get_players ().message (
 				"§4> §cWorld " + colname + " §chas been unloaded§c!");
-			delete wr;
+			
+			// physics and generator threads may still hold a pointer they looked up
+			// by the world's ID.
+			srv.deregister_world (wr);
+			srv.get_epochs ().retire ([wr] () { delete wr; });
 			delete data;
 		}
 		
@@ -123,10 +131,17 @@ namespace hCraft {
 			world_name.assign (wr->get_name ());
 			
 			// transfer all players to the server's main world.
-			std::vector<player *> to_transfer;
-			wr->get_players ().populate (to_transfer);
-			for (player *pl : to_transfer)
-				pl->join_world (pl->get_server ().get_main_world ());
+			std::vector<int> transferred;
+			{
+				epoch_guard eg {pl->get_server ().get_epochs ()};
+				std::vector<player *> to_transfer;
+				wr->get_players ().populate (to_transfer);
+				for (player *tpl : to_transfer)
+					{
+						transferred.push_back (tpl->get_eid ());
+						tpl->join_world (tpl->get_server ().get_main_world ());
+					}
+			}
 			
 			// autoload
 			if (reader.opt ("autoload")->found ())
@@ -141,7 +156,7 @@ namespace hCraft {
 			callback_data *data = new callback_data ();
 			data->srv = &pl->get_server ();
 			data->w = wr;
-			data->pls = to_transfer;
+			data->pls = transferred;
 			pl->get_server ().get_scheduler ().new_task (_callback_func, data)
 				.run_once (5000);
 		}
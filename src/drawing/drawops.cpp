@@ -18,8 +18,8 @@
 
 #include "drawing/drawops.hpp"
 #include "drawing/editstage.hpp"
+#include "drawing/raster.hpp"
 #include "util/utils.hpp"
-#include <alloca.h>
 #include <cmath>
 #include <algorithm>
 
@@ -36,162 +36,34 @@ namespace hCraft {
 	
 	
 	/* 
-	 * Draws a line from @{pt1} to @{pt2} using the specified material.
-	 * Returns the total number of blocks modified.
+	 * Fills the rasterized shape in @{spans}, or returns -1 if rasterizing it
+	 * went over the block limit (@{complete} is false).
 	 */
-	int
-	draw_ops::line (vector3 pt1, vector3 pt2, blocki material, int max_blocks)
+	static int
+	_fill (edit_stage& es, const span_list& spans, bool complete, blocki material)
 	{
-		/* 
-		 * Bresenham's line algorithm modified to work in three dimensions.
-		 */
-		
-		int x1 = (int)(pt1.x);
-		int y1 = (int)(pt1.y);
-		int z1 = (int)(pt1.z);
-		int x2 = (int)(pt2.x);
-		int y2 = (int)(pt2.y);
-		int z2 = (int)(pt2.z);
-		
-		int xd, yd, zd;
-	  int x, y, z;
-	  int ax, ay, az;
-	  int sx, sy, sz;
-	  int dx, dy, dz;
-
-	  dx = x2 - x1;
-	  dy = y2 - y1;
-	  dz = z2 - z1;
-
-	  ax = utils::iabs (dx) << 1;
-	  ay = utils::iabs (dy) << 1;
-	  az = utils::iabs (dz) << 1;
-
-	  sx = utils::zsgn (dx);
-	  sy = utils::zsgn (dy);
-	  sz = utils::zsgn (dz);
-
-	  x = x1;
-	  y = y1;
-	  z = z1;
-	  
-	  int modified = 0;
-
-	  if (ax >= utils::max (ay, az))            /* x dominant */
-			{
-		    yd = ay - (ax >> 1);
-		    zd = az - (ax >> 1);
-		    for (;;)
-				  {
-			      this->es.set (x, y, z, material.id, material.meta);
-			      ++ modified;
-			      if (x == x2)
-					  	break;
-
-			      if (yd >= 0)
-					    {
-				        y += sy;
-				        yd -= ax;
-					    }
-
-			      if (zd >= 0)
-					    {
-				        z += sz;
-				        zd -= ax;
-					    }
-
-			      x += sx;
-			      yd += ay;
-			      zd += az;
-				  }
-			}
-	  else if (ay >= utils::max (ax, az))            /* y dominant */
-	  {
-      xd = ax - (ay >> 1);
-      zd = az - (ay >> 1);
-      for (;;)
-		    {
-	      	this->es.set (x, y, z, material.id, material.meta);
-	      	++ modified;
-	        if (y == y2)
-			    	break;
-
-	        if (xd >= 0)
-			      {
-		          x += sx;
-		          xd -= ay;
-			      }
-
-	        if (zd >= 0)
-			      {
-		          z += sz;
-		          zd -= ay;
-			      }
-
-	        y += sy;
-	        xd += ax;
-	        zd += az;
-		    }
-	  }
-	  else if (az >= utils::max (ax, ay))            /* z dominant */
-			{
-		    xd = ax - (az >> 1);
-		    yd = ay - (az >> 1);
-		    for (;;)
-				  {
-			      this->es.set (x, y, z, material.id, material.meta);
-			      ++ modified;
-			      if (z == z2)
-					    break;
-
-			      if (xd >= 0)
-					    {
-				        x += sx;
-				        xd -= az;
-					    }
-
-			      if (yd >= 0)
-					    {
-				        y += sy;
-				        yd -= az;
-					    }
-
-			      z += sz;
-			      xd += ax;
-			      yd += ay;
-				  }
-			}
+		if (!complete)
+			return -1;
 		
-		return modified;
+		es.fill_spans (spans, material.id, material.meta);
+		return (int)spans.volume ();
 	}
 	
 	
 	
-	// with t being in the range of 0-1
-	static inline vector3
-	lerp3 (vector3 a, vector3 b, float t)
+	/* 
+	 * Draws a line from @{pt1} to @{pt2} using the specified material.
+	 * Returns the total number of blocks modified.
+	 */
+	int
+	draw_ops::line (vector3 pt1, vector3 pt2, blocki material, int max_blocks)
 	{
-		return {
-			a.x + (b.x - a.x) * t,
-			a.y + (b.y - a.y) * t,
-			a.z + (b.z - a.z) * t };
+		span_list spans (max_blocks);
+		bool ok = raster::line (spans, pt1, pt2);
+		return _fill (this->es, spans, ok, material);
 	}
 	
-	static vector3
-	bezier_curve (std::vector<vector3>& points, double t, int start, int end)
-	{
-		int i, s = points.size ();
-		vector3 *arr = (vector3 *)alloca (s * sizeof (vector3));
-		for (i = 0; i < s; ++i)
-			arr[i] = points[i];
-		while (s > 2)
-			{
-				-- s;
-				for (i = 0; i < s; ++i)
-					arr[i] = lerp3 (arr[i], arr[i + 1], t);
-			}
-		return lerp3 (arr[0], arr[1], t);
-	}
+	
 	
 	/* 
 	 * Draws an N-th order bezier curve using the given list of N control points
@@ -200,23 +72,9 @@ namespace hCraft {
 	int
 	draw_ops::bezier (std::vector<vector3>& points, blocki material, int max_blocks)
 	{
-		if (points.size () == 1)
-			this->es.set (points[0].x, points[0].y, points[0].z, material.id, material.meta);
-		
-		int modified = 0;
-		double t = 0.0;
-		double inc =
-			1.0 / (points[points.size () - 1] - points[0]).magnitude ();
-		vector3 last_pt = points[0];
-		while (t <= 1.0)
-			{
-				vector3 pt = bezier_curve (points, t, 0, points.size () - 1);
-				modified += this->line (last_pt, pt, material);
-				last_pt = pt;
-				t += inc;
-			}
-		
-		return modified;
+		span_list spans (max_blocks);
+		bool ok = raster::bezier (spans, points);
+		return _fill (this->es, spans, ok, material);
 	}
 	
 	
@@ -432,51 +290,23 @@ namespace hCraft {
 	draw_ops::polygon (const std::vector<vector3>& points, blocki material, int max_blocks)
 	{
 		if (points.empty ()) return 0;
+		
+		span_list spans (max_blocks);
+		bool ok = true;
 		if (points.size () == 1)
+			ok = spans.add_point (points[0].x, points[0].y, points[0].z);
+		else
 			{
-				this->es.set (points[0].x, points[0].y, points[0].z, material.id, material.meta);
-				return 1;
+				for (int i = 0; ok && i < ((int)points.size () - 1); ++i)
+					ok = raster::line (spans, points[i], points[i + 1]);
+				ok = ok && raster::line (spans, points[points.size () - 1], points[0]);
 			}
 		
-		int modified = 0;
-		for (int i = 0; i < ((int)points.size () - 1); ++i)
-			modified += this->line (points[i], points[i + 1], material);
-		modified += this->line (points[points.size () - 1], points[0], material);
-		
-		return modified;
+		return _fill (this->es, spans, ok, material);
 	}
 	
 	
 	
-	static vector3
-	catmull_spline (vector3 p0, vector3 p1, vector3 p2, vector3 p3, double t)
-	{
-		return 0.5 * ( ((2 * p1)) +
-									 (t * (-p0 + p2)) +
-									 ((t*t) * (2*p0 - 5*p1 + 4*p2 - p3)) +
-									 ((t*t*t) * (-p0 + 3*p1 - 3*p2 + p3)) );
-	}
-	
-	static int
-	draw_curve_segment (draw_ops &draw, vector3 p0, vector3 p1, vector3 p2,
-		vector3 p3, blocki material)
-	{
-		int modified = 0;
-		
-		vector3 last = p1;
-		double t = 0.0;
-		double t_inc = 1.0 / (p2 - p1).magnitude ();
-		while (t <= 1.0)
-			{
-				vector3 next = catmull_spline (p0, p1, p2, p3, t);
-				modified += draw.line (last, next, material);
-				last = next;
-				t += t_inc;
-			}
-		
-		return modified;
-	}
-	
 	/* 
 	 * Approximates a curve between the given vector of points.
 	 * NOTE: The curve is guaranteed to pass through all BUT the first and last
@@ -486,32 +316,9 @@ namespace hCraft {
 	int
 	draw_ops::curve (const std::vector<vector3>& points, blocki material, int max_blocks)
 	{
-		int modified = 0;
-		
-		switch (points.size ())
-			{
-				case 0: return 0;
-				case 1:
-					this->es.set (points[0].x, points[0].y, points[0].z, material.id, material.meta);
-					return 1;
-				case 2:
-					this->es.set (points[1].x, points[1].y, points[1].z, material.id, material.meta);
-					return 1;
-				case 3:
-					return this->line (points[1], points[2], material);
-			}
-		
-		int j = points.size () - 3;
-		for (int i = 0; i < j; ++i)
-			{
-				modified += draw_curve_segment (*this,
-					points[i + 0],
-					points[i + 1],
-					points[i + 2],
-					points[i + 3], material);
-			}
-		
-		return modified;
+		span_list spans (max_blocks);
+		bool ok = raster::curve (spans, points);
+		return _fill (this->es, spans, ok, material);
 	}
 	
 	
@@ -523,25 +330,9 @@ namespace hCraft {
 	int
 	draw_ops::filled_cuboid (vector3 pt1, vector3 pt2, blocki material, int max_blocks)
 	{
-		int sx = utils::min ((int)pt1.x, (int)pt2.x);
-		int sy = utils::min ((int)pt1.y, (int)pt2.y);
-		int sz = utils::min ((int)pt1.z, (int)pt2.z);
-		int ex = utils::max ((int)pt1.x, (int)pt2.x);
-		int ey = utils::max ((int)pt1.y, (int)pt2.y);
-		int ez = utils::max ((int)pt1.z, (int)pt2.z);
-		
-		int c = 0;
-		for (int x = sx; x <= ex; ++x)
-			for (int y = sy; y <= ey; ++y)
-				for (int z = sz; z <= ez; ++z)
-					{
-						if (c >= max_blocks)
-							return -1;
-						this->es.set (x, y, z, material.id, material.meta);
-						++ c;
-					}
-		
-		return c;
+		span_list spans (max_blocks);
+		bool ok = raster::filled_cuboid (spans, pt1, pt2);
+		return _fill (this->es, spans, ok, material);
 	}
 	
 	
@@ -780,24 +571,9 @@ namespace hCraft {
 	int
 	draw_ops::filled_sphere (vector3 pt, double radius, blocki material, int max_blocks)
 	{
-		int rad = std::round (radius);
-		int srad = rad * rad;
-		
-		int cx = pt.x, cy = pt.y, cz = pt.z;
-		
-		int modified = 0;
-		for (int x = -rad; x <= rad; ++x)
-			for (int y = -rad; y <= rad; ++y)
-				for (int z = -rad; z <= rad; ++z)
-					{
-						if (x*x + y*y + z*z <= srad)
-							{
-								this->es.set (x + cx, y + cy, z + cz, material.id, material.meta);
-								++ modified;
-							}
-					}
-		
-		return modified;
+		span_list spans (max_blocks);
+		bool ok = raster::filled_sphere (spans, pt, radius);
+		return _fill (this->es, spans, ok, material);
 	}
 	
 	
@@ -809,26 +585,37 @@ namespace hCraft {
 	int
 	draw_ops::sphere (vector3 pt, double radius, blocki material, int max_blocks)
 	{
-		int srad = std::round (radius * radius);
-		int rad = std::round (radius);
-		int sradm1 = (rad - 1) * (rad - 1);
-		int cx = pt.x, cy = pt.y, cz = pt.z;
-		
-		int modified = 0;
-		int v;
-		for (int y = -rad; y <= rad; ++y)
-			for (int x = -rad; x <= rad; ++x)
-				for (int z = -rad; z <= rad; ++z)
-					{
-						v = x*x + y*y + z*z;
-						if (v <= srad && v > sradm1)
-							{
-								this->es.set (x + cx, y + cy, z + cz, material.id, material.meta);
-								++ modified;
-							}
-					}
-
-		return modified;
+		span_list spans (max_blocks);
+		bool ok = raster::hollow_sphere (spans, pt, radius);
+		return _fill (this->es, spans, ok, material);
+	}
+	
+	
+	
+	/* 
+	 * Fills the axis-aligned ellipsoid centered at @{pt} with the given radii.
+	 * Returns the total number of blocks modified.
+	 */
+	int
+	draw_ops::filled_ellipsoid (vector3 pt, double rx, double ry, double rz,
+		blocki material, int max_blocks)
+	{
+		span_list spans (max_blocks);
+		bool ok = raster::filled_ellipsoid (spans, pt, rx, ry, rz);
+		return _fill (this->es, spans, ok, material);
+	}
+	
+	/* 
+	 * Fills an upright cylinder whose bottom face is centered at @{pt}.
+	 * Returns the total number of blocks modified.
+	 */
+	int
+	draw_ops::filled_cylinder (vector3 pt, double radius, int height,
+		blocki material, int max_blocks)
+	{
+		span_list spans (max_blocks);
+		bool ok = raster::filled_cylinder (spans, pt, radius, height);
+		return _fill (this->es, spans, ok, material);
 	}
 }
 
@@ -17,13 +17,20 @@
  */
 
 #include "drawing/editstage.hpp"
+#include "drawing/raster.hpp"
+#include "util/utils.hpp"
 #include "world/world.hpp"
+#include "system/server.hpp"
 #include "world/chunk.hpp"
+#include "world/change_tracker.hpp"
 #include "player/player.hpp"
 #include "player/player_list.hpp"
 #include "physics/blocks/physics_block.hpp"
 #include <cstring>
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 #include <iostream> // DEBUG
 
@@ -61,6 +68,26 @@ namespace hCraft {
 	}
 	
 	
+	/* 
+	 * Bulk modification.
+	 */
+	void
+	edit_stage::fill_span (int y, int z, int x0, int x1, unsigned short id,
+		unsigned char meta, unsigned char ex)
+	{
+		for (int x = x0; x <= x1; ++x)
+			this->set (x, y, z, id, meta, ex);
+	}
+	
+	void
+	edit_stage::fill_spans (const span_list& spans, unsigned short id,
+		unsigned char meta, unsigned char ex)
+	{
+		for (const block_span& sp : spans)
+			this->fill_span (sp.y, sp.z, sp.x0, sp.x1, id, meta, ex);
+	}
+	
+	
 	
 //------------------------------------------------------------------------------
 	
@@ -92,6 +119,17 @@ namespace hCraft {
 		this->mod_count = 0;
 	}
 	
+	des_chunk::des_chunk (des_chunk&& other)
+	{
+		for (int i = 0; i < 16; ++i)
+			{
+				this->subs[i] = other.subs[i];
+				other.subs[i] = nullptr;
+			}
+		this->mod_count = other.mod_count;
+		other.mod_count = 0;
+	}
+	
 	des_chunk::~des_chunk ()
 	{
 		for (int i = 0; i < 16; ++i)
@@ -117,6 +155,22 @@ namespace hCraft {
 	{
 		int cx = x >> 4;
 		int cz = z >> 4;
+		
+		// resetting a block that was never modified is a no-op, so don't
+		// allocate anything for it.
+		if (id == ES_NONE)
+			{
+				auto itr = this->chunks.find ({cx, cz});
+				if (itr == this->chunks.end ())
+					return;
+				des_subchunk *sub = itr->second.subs[y >> 4];
+				if (!sub)
+					return;
+				int m_index = (((y & 0xF) >> 3) << 2) | (((z & 0xF) >> 3) << 1) | ((x & 0xF) >> 3);
+				if (!sub->micro[m_index])
+					return;
+			}
+		
 		des_chunk &ch = this->chunks[{cx, cz}];
 		
 		int sy = y >> 4;
@@ -150,49 +204,42 @@ namespace hCraft {
 	blocki
 	dense_edit_stage::get (int x, int y, int z)
 	{
-		int cx = x >> 4;
-		int cz = z >> 4;
+		blocki bl;
+		if (this->get_staged (x, y, z, bl))
+			return bl;
 		
-		des_chunk *ch;
-		auto itr = this->chunks.find ({cx, cz});
+		block_data bd = this->w->get_block (x, y, z);
+		return {bd.id, bd.meta};
+	}
+	
+	/* 
+	 * Like get (), but only succeeds if the block has been modified in this
+	 * edit stage (the underlying world is not looked at).
+	 */
+	bool
+	dense_edit_stage::get_staged (int x, int y, int z, blocki& out)
+	{
+		auto itr = this->chunks.find ({x >> 4, z >> 4});
 		if (itr == this->chunks.end ())
-			{
-				block_data bd = this->w->get_block (x, y, z);
-				return {bd.id, bd.meta};
-			}
-		else
-			ch = &itr->second;
+			return false;
 		
-		int sy = y >> 4;
-		des_subchunk *sub = ch->subs[sy];
+		des_subchunk *sub = itr->second.subs[y >> 4];
 		if (!sub)
-			{
-				block_data bd = this->w->get_block (x, y, z);
-				return {bd.id, bd.meta};
-			}
+			return false;
 		
-		int bx = x & 0xF;
-		int by = y & 0xF;
-		int bz = z & 0xF;
-		int m_index = ((by >> 3) << 2) | ((bz >> 3) << 1) | ((bx >> 3));
+		int m_index = (((y & 0xF) >> 3) << 2) | (((z & 0xF) >> 3) << 1) | ((x & 0xF) >> 3);
 		des_microchunk *micro = sub->micro[m_index];
 		if (!micro)
-			{
-				block_data bd = this->w->get_block (x, y, z);
-				return {bd.id, bd.meta};
-			}
+			return false;
 		
 		int b_index = ((y & 0x7) << 6) | ((z & 0x7) << 3) | ((x & 0x7));
 		unsigned short val = micro->data[b_index];
 		unsigned short id  = val >> 4;
-		unsigned char  ex  = micro->ex[b_index];
 		if (id == ES_NONE || id == ES_REM)
-			{
-				block_data bd = this->w->get_block (x, y, z);
-				return {bd.id, bd.meta};
-			}
+			return false;
 		
-		return {id, (unsigned char)(val & 0xF), ex};
+		out = {id, (unsigned char)(val & 0xF), micro->ex[b_index]};
+		return true;
 	}
 	
 	void
@@ -201,6 +248,34 @@ namespace hCraft {
 		this->set (x, y, z, ES_NONE, 0xF);
 	}
 	
+	/* 
+	 * Resets all blocks in the 8x8x8 microchunk that contains the specified
+	 * block.
+	 */
+	void
+	dense_edit_stage::reset_micro (int x, int y, int z)
+	{
+		auto itr = this->chunks.find ({x >> 4, z >> 4});
+		if (itr == this->chunks.end ())
+			return;
+		des_chunk& ch = itr->second;
+		
+		des_subchunk *sub = ch.subs[y >> 4];
+		if (!sub)
+			return;
+		
+		int m_index = (((y & 0xF) >> 3) << 2) | (((z & 0xF) >> 3) << 1) | ((x & 0xF) >> 3);
+		des_microchunk *micro = sub->micro[m_index];
+		if (!micro)
+			return;
+		
+		for (int i = 0; i < 512; ++i)
+			if ((micro->data[i] >> 4) != ES_NONE)
+				-- ch.mod_count;
+		delete micro;
+		sub->micro[m_index] = nullptr;
+	}
+	
 	int
 	dense_edit_stage::mod_count_at (int cx, int cz)
 	{
@@ -213,6 +288,277 @@ namespace hCraft {
 	
 	
 	
+	/* 
+	 * Sets the blocks [x0, x1] of row (y, z) in the given chunk, where all
+	 * coordinates are already known to lie within it.
+	 */
+	static void
+	_des_fill_row (des_chunk& ch, int y, int z, int x0, int x1, unsigned short val,
+		unsigned char ex)
+	{
+		des_subchunk *sub = ch.subs[y >> 4];
+		if (!sub)
+			sub = ch.subs[y >> 4] = new des_subchunk ();
+		
+		int m_yz = (((y & 0xF) >> 3) << 2) | (((z & 0xF) >> 3) << 1);
+		int b_yz = ((y & 0x7) << 6) | ((z & 0x7) << 3);
+		for (int x = x0; x <= x1;)
+			{
+				int m_index = m_yz | ((x & 0xF) >> 3);
+				des_microchunk *micro = sub->micro[m_index];
+				if (!micro)
+					micro = sub->micro[m_index] = new des_microchunk ();
+				
+				// up to the end of the microchunk
+				int end = utils::min (x1, x | 7);
+				for (; x <= end; ++x)
+					{
+						int b_index = b_yz | (x & 0x7);
+						if ((micro->data[b_index] >> 4) == ES_NONE)
+							++ ch.mod_count;
+						micro->data[b_index] = val;
+						micro->ex[b_index] = ex;
+					}
+			}
+	}
+	
+	/* 
+	 * Bulk modification.
+	 */
+	void
+	dense_edit_stage::fill_span (int y, int z, int x0, int x1, unsigned short id,
+		unsigned char meta, unsigned char ex)
+	{
+		if (id == ES_NONE)
+			{
+				// resets need the bookkeeping in set ()
+				edit_stage::fill_span (y, z, x0, x1, id, meta, ex);
+				return;
+			}
+		if (y < 0 || y > 255)
+			return;
+		
+		unsigned short val = (id << 4) | (meta & 0xF);
+		int cz = z >> 4;
+		for (int cx = x0 >> 4; cx <= (x1 >> 4); ++cx)
+			{
+				int sx = utils::max (x0, cx << 4);
+				int ex_ = utils::min (x1, (cx << 4) | 0xF);
+				_des_fill_row (this->chunks[{cx, cz}], y, z, sx, ex_, val, ex);
+			}
+	}
+	
+	void
+	dense_edit_stage::fill_spans (const span_list& spans, unsigned short id,
+		unsigned char meta, unsigned char ex)
+	{
+		if (id == ES_NONE)
+			{
+				edit_stage::fill_spans (spans, id, meta, ex);
+				return;
+			}
+		
+		// split spans at chunk boundaries, and group the pieces by chunk.
+		std::vector<std::vector<block_span>> groups;
+		std::vector<chunk_pos> group_pos;
+		spatial_map<chunk_pos, int, chunk_pos_hash> group_of;
+		for (const block_span& sp : spans)
+			{
+				if (sp.y < 0 || sp.y > 255)
+					continue;
+				
+				int cz = sp.z >> 4;
+				for (int cx = sp.x0 >> 4; cx <= (sp.x1 >> 4); ++cx)
+					{
+						auto res = group_of.try_emplace ({cx, cz});
+						if (res.second)
+							{
+								res.first->second = (int)groups.size ();
+								groups.emplace_back ();
+								group_pos.push_back ({cx, cz});
+							}
+						groups[res.first->second].push_back ({ sp.y, sp.z,
+							utils::max (sp.x0, cx << 4), utils::min (sp.x1, (cx << 4) | 0xF) });
+					}
+			}
+		if (groups.empty ())
+			return;
+		
+		// create all chunks up front: the map must not be modified (and rehashed)
+		// while chunks are being filled.
+		for (chunk_pos pos : group_pos)
+			this->chunks[pos];
+		std::vector<des_chunk *> targets;
+		targets.reserve (group_pos.size ());
+		for (chunk_pos pos : group_pos)
+			targets.push_back (&this->chunks.find (pos)->second);
+		
+		unsigned short val = (id << 4) | (meta & 0xF);
+		auto fill_group = [&] (std::size_t i)
+			{
+				des_chunk& ch = *targets[i];
+				for (const block_span& sp : groups[i])
+					_des_fill_row (ch, sp.y, sp.z, sp.x0, sp.x1, val, ex);
+			};
+		
+		// only spread out over threads when there's enough work to make up for
+		// starting them.
+		static const long long blocks_per_thread = 1 << 18;
+		long long thread_count = std::min ((long long)std::thread::hardware_concurrency (),
+			std::min ((long long)groups.size (), spans.volume () / blocks_per_thread));
+		if (thread_count <= 1)
+			{
+				for (std::size_t i = 0; i < groups.size (); ++i)
+					fill_group (i);
+				return;
+			}
+		
+		std::atomic<std::size_t> next {0};
+		auto worker = [&] ()
+			{
+				std::size_t i;
+				while ((i = next.fetch_add (1)) < groups.size ())
+					fill_group (i);
+			};
+		
+		std::vector<std::thread> threads;
+		for (long long i = 1; i < thread_count; ++i)
+			threads.emplace_back (worker);
+		worker ();
+		for (std::thread& th : threads)
+			th.join ();
+	}
+	
+	
+	
+	namespace {
+		
+		// how much of a microchunk is covered by modifications.
+		enum micro_coverage
+		{
+			MC_NONE,
+			MC_PARTIAL, // some blocks are untouched, or marked ES_REM.
+			MC_FULL,    // all 512 blocks are set.
+			MC_UNIFORM, // all 512 blocks are set to the same block.
+		};
+		
+		micro_coverage
+		_micro_coverage (des_microchunk *micro)
+		{
+			if (!micro)
+				return MC_NONE;
+			
+			unsigned short first = micro->data[0];
+			unsigned char  first_ex = micro->ex[0];
+			bool uniform = true;
+			for (int i = 0; i < 512; ++i)
+				{
+					unsigned short id = micro->data[i] >> 4;
+					if (id == ES_NONE || id == ES_REM)
+						return MC_PARTIAL;
+					if (micro->data[i] != first || micro->ex[i] != first_ex)
+						uniform = false;
+				}
+			
+			return uniform ? MC_UNIFORM : MC_FULL;
+		}
+		
+		/* 
+		 * The block players see in place of the given one.
+		 */
+		blocki
+		_client_block (unsigned short id, unsigned char meta)
+		{
+			physics_block *ph = physics_block::from_id (id);
+			return ph ? ph->vanilla_block () : blocki (id, meta);
+		}
+		
+		/* 
+		 * Records the changes a fully covered microchunk is about to make to the
+		 * world chunk @{wch}, before it gets overwritten.
+		 */
+		void
+		_mark_micro (chunk_change_tracker& tr, chunk *wch, int cx, int cz, int sy,
+			int mi, des_microchunk *micro)
+		{
+			int mx = (mi & 1) << 3;
+			int my = (sy << 4) | (((mi >> 2) & 1) << 3);
+			int mz = ((mi >> 1) & 1) << 3;
+			for (int i = 0; i < 512; ++i)
+				{
+					int x = mx | (i & 0x7);
+					int y = my | (i >> 6);
+					int z = mz | ((i >> 3) & 0x7);
+					
+					block_data old_bd = wch->get_block (x, y, z);
+					unsigned short val = micro->data[i];
+					tr.mark ((cx << 4) | x, y, (cz << 4) | z,
+						_client_block (old_bd.id, old_bd.meta), _client_block (val >> 4, val & 0xF));
+				}
+		}
+		
+		/* 
+		 * Copies the contents of fully covered microchunks in @{sub} into the
+		 * world subchunk at vertical position @{sy} using the subchunk's bulk
+		 * block routines. Partially covered microchunks are left for the caller
+		 * to handle block-by-block.
+		 */
+		void
+		_commit_full_micros (chunk *wch, int sy, des_subchunk *sub,
+			micro_coverage cov[8])
+		{
+			int full = 0;
+			for (int mi = 0; mi < 8; ++mi)
+				if (cov[mi] == MC_FULL || cov[mi] == MC_UNIFORM)
+					++ full;
+			if (full == 0)
+				return;
+			
+			// the whole subchunk is being set to the same block
+			if (full == 8)
+				{
+					bool same = true;
+					for (int mi = 0; mi < 8 && same; ++mi)
+						same = (cov[mi] == MC_UNIFORM)
+							&& (sub->micro[mi]->data[0] == sub->micro[0]->data[0])
+							&& (sub->micro[mi]->ex[0] == sub->micro[0]->ex[0]);
+					if (same)
+						{
+							unsigned short val = sub->micro[0]->data[0];
+							wch->fill_sub (sy, val >> 4, val & 0xF, sub->micro[0]->ex[0]);
+							return;
+						}
+				}
+			
+			subchunk *wsub = wch->create_sub (sy);
+			wch->modified = true;
+			for (int mi = 0; mi < 8; ++mi)
+				{
+					des_microchunk *micro = sub->micro[mi];
+					int mx = (mi & 1) << 3;
+					int my = ((mi >> 2) & 1) << 3; 
+					int mz = ((mi >> 1) & 1) << 3;
+					
+					if (cov[mi] == MC_UNIFORM)
+						{
+							unsigned short val = micro->data[0];
+							wsub->fill_box (mx, my, mz, mx + 7, my + 7, mz + 7,
+								val >> 4, val & 0xF, micro->ex[0], false);
+						}
+					else if (cov[mi] == MC_FULL)
+						{
+							for (int i = 0; i < 512; ++i)
+								wsub->set_block_raw (mx | (i & 0x7), my | ((i >> 6) & 0x7),
+									mz | ((i >> 3) & 0x7), micro->data[i] >> 4,
+									micro->data[i] & 0xF, micro->ex[i]);
+						}
+				}
+			
+			wsub->recalc_counts ();
+		}
+	}
+	
+	
 	void
 	dense_edit_stage::send_to_players (std::vector<player *>& _players,
 	  int cx, int cz, des_chunk& ch, bool restore, bool update_sbs)
@@ -326,14 +672,14 @@ namespace hCraft {
 	void
 	dense_edit_stage::commit (bool physics)
 	{
-		static const int chunk_cap = 3000;
-		
 		if (this->chunks.empty ())
 			return;
 		
 		block_pos bound_min = { 0x7FFFFFFF,  0x7FFFFFFF, 0x7FFFFFFF};
 		block_pos bound_max = {-0x7FFFFFFF, -0x7FFFFFFF,-0x7FFFFFFF};
 		
+		// keeps the affected players from being destroyed under us.
+		epoch_guard eg {this->w->get_server ().get_epochs ()};
 		std::vector<player *> affected_players;
 		auto& chunks_ref = this->chunks;
 		world *w = this->w;
@@ -357,6 +703,10 @@ namespace hCraft {
 		std::lock_guard<std::mutex> u_guard ((this->w->update_lock));
 		std::lock_guard<std::mutex> es_guard ((this->w->estage_lock));
 		std::lock_guard<std::mutex> lm_guard ((this->w->lm.get_lock ()));
+		
+		// players are updated the same way block updates made by the world are,
+		// see chunk_change_tracker.
+		chunk_change_tracker& tr = this->w->get_change_tracker ();
 		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
 			{
 				int cx = itr->first.x;
@@ -367,9 +717,6 @@ namespace hCraft {
 					continue;
 				des_chunk &ch = itr->second;
 				
-				std::vector<block_change_record> records;
-				bool add_records = (ch.mod_count < chunk_cap);
-				
 				std::bitset<256> column_changed;
 				
 				unsigned short id;
@@ -384,6 +731,17 @@ namespace hCraft {
 						if (!sub)
 							continue;
 						
+						// fully covered microchunks are written in bulk, so what they
+						// replace has to be recorded beforehand.
+						micro_coverage cov[8];
+						for (int mi = 0; mi < 8; ++mi)
+							{
+								cov[mi] = _micro_coverage (sub->micro[mi]);
+								if (cov[mi] == MC_FULL || cov[mi] == MC_UNIFORM)
+									_mark_micro (tr, wch, cx, cz, sy, mi, sub->micro[mi]);
+							}
+						_commit_full_micros (wch, sy, sub, cov);
+						
 						for (int mi = 0; mi < 8; ++mi)
 							{
 								des_microchunk *micro = sub->micro[mi];
@@ -393,6 +751,62 @@ namespace hCraft {
 								int mx = (mi & 1) << 3;
 								int my = ((mi >> 2) & 1) << 3; 
 								int mz = ((mi >> 1) & 1) << 3;
+								
+								if (cov[mi] == MC_FULL || cov[mi] == MC_UNIFORM)
+									{
+										/* 
+										 * Already written to the world by _commit_full_micros (),
+										 * and every block in it is known to be set, so the
+										 * bookkeeping is done for the microchunk as a whole.
+										 * Only lighting and physics remain per-block.
+										 */
+										int wx0 = (cx << 4) | mx;
+										int wy0 = yy | my;
+										int wz0 = (cz << 4) | mz;
+										
+										for (int z = 0; z < 8; ++z)
+											for (int x = 0; x < 8; ++x)
+												column_changed.set (((mz | z) << 4) | (mx | x));
+										
+										if (wx0 < bound_min.x) bound_min.x = wx0;
+										if (wx0 + 7 > bound_max.x) bound_max.x = wx0 + 7;
+										if (wy0 < bound_min.y) bound_min.y = wy0;
+										if (wy0 + 7 > bound_max.y) bound_max.y = wy0 + 7;
+										if (wz0 < bound_min.z) bound_min.z = wz0;
+										if (wz0 + 7 > bound_max.z) bound_max.z = wz0 + 7;
+										
+										this->w->estage.reset_micro (wx0, wy0, wz0);
+										
+										// a uniform microchunk either is all physics blocks, or has none.
+										bool micro_physics = physics;
+										physics_block *uph = nullptr;
+										if (micro_physics && (cov[mi] == MC_UNIFORM))
+											{
+												uph = physics_block::from_id (micro->data[0] >> 4);
+												micro_physics = (uph != nullptr);
+											}
+										
+										for (int i = 0; i < 512; ++i)
+											{
+												int x = i & 0x7;
+												int z = (i >> 3) & 0x7;
+												int y = i >> 6;
+												
+												// NOTE: we already acquired the lighting manager's lock.
+												this->w->queue_lighting_nolock (wx0 + x, wy0 + y, wz0 + z);
+												
+												if (micro_physics)
+													{
+														physics_block *ph = uph ? uph
+															: physics_block::from_id (micro->data[i] >> 4);
+														if (ph)
+															this->w->queue_physics (wx0 + x, wy0 + y, wz0 + z,
+																0, nullptr, ph->tick_rate ());
+													}
+											}
+										continue;
+									}
+								
 								for (int x = 0; x < 8; ++x)
 									for (int z = 0; z < 8; ++z)
 										for (int y = 0; y < 8; ++y)
@@ -420,17 +834,9 @@ namespace hCraft {
 																meta = bd.meta;
 															}
 														
-														if (add_records)
-															{
-																block_change_record rec;
-																rec.x = rx;
-																rec.z = rz;
-																rec.y = yy + ry;
-																rec.id = id;
-																rec.meta = meta;
-																records.push_back (rec);
-															}
-												
+														block_data old_bd = wch->get_block (rx, wy, rz);
+														tr.mark (wx, wy, wz, _client_block (old_bd.id, old_bd.meta),
+															_client_block (id, meta));
 														
 														this->w->estage.set (wx, wy, wz, ES_NONE, 0xF, 0);
 														
@@ -467,54 +873,11 @@ namespace hCraft {
 							if (column_changed.test ((z << 4) | x))
 								wch->recalc_heightmap (x, z);
 						}
-
-				if (ch.mod_count >= chunk_cap)
-					{
-						for (player *pl : affected_players)
-							{
-								if ((pl->get_world () == this->w) &&pl->can_see_chunk (cx, cz))
-									pl->send (packets::play::make_chunk (cx, cz, wch));
-							}
-					}
-				else if (ch.mod_count > 200)
-					{
-						packet *mbcp = packets::play::make_multi_block_change (cx, cz, records);
-						packet *cp   = packets::play::make_chunk (cx, cz, wch);
-		
-						// send the smaller between the two
-						if (mbcp->size < cp->size)
-							{
-								delete cp;
-								for (player *pl : affected_players)
-									{
-										if (pl->get_world () == this->w)
-											pl->send (new packet (*mbcp));
-									}
-								delete mbcp;
-							}
-						else
-							{
-								delete mbcp;
-								for (player *pl : affected_players)
-									{
-										if ((pl->get_world () == this->w) && pl->can_see_chunk (cx, cz))
-											pl->send (new packet (*cp));
-									}
-								delete cp;
-							}
-					}
-				else
-					{
-						packet *pack = packets::play::make_multi_block_change (cx, cz, records);
-						for (player *pl : affected_players)
-							{
-								if (pl->get_world () == this->w)
-									pl->send (new packet (*pack));
-							}
-						delete pack;
-					}
 			}
 		
+		// send everything out right away.
+		tr.flush (affected_players);
+		
 		// update player selections
 		for (player *pl : affected_players)
 			{
@@ -564,10 +927,15 @@ namespace hCraft {
 				if (!sub)
 					continue;
 				
+				micro_coverage cov[8];
+				for (int mi = 0; mi < 8; ++mi)
+					cov[mi] = _micro_coverage (sub->micro[mi]);
+				_commit_full_micros (wch, sy, sub, cov);
+				
 				for (int mi = 0; mi < 8; ++mi)
 					{
 						des_microchunk *micro = sub->micro[mi];
-						if (!micro)
+						if (!micro || cov[mi] != MC_PARTIAL)
 							continue;
 						
 						int mx = (mi & 1) << 3;
@@ -839,6 +1207,8 @@ namespace hCraft {
 	void
 	sparse_edit_stage::commit (bool physics)
 	{
+		// keeps the affected players from being destroyed under us.
+		epoch_guard eg {this->w->get_server ().get_epochs ()};
 		std::vector<player *> affected_players;
 		auto& chunks_ref = this->chunks;
 		this->w->get_players ().all (
@@ -863,11 +1233,13 @@ namespace hCraft {
 		unsigned short id;
 		unsigned char meta;
 		unsigned char ex;
-		std::vector<sb_correction> corrections;
 		
 		std::lock_guard<std::mutex> u_guard ((this->w->update_lock));
 		std::lock_guard<std::mutex> es_guard ((this->w->estage_lock));
 		std::lock_guard<std::mutex> lm_guard ((this->w->lm.get_lock ()));
+		
+		// like the dense stage, sent out the same way block updates are.
+		chunk_change_tracker& tr = this->w->get_change_tracker ();
 		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
 			{
 				int cx = itr->first.x;
@@ -878,7 +1250,6 @@ namespace hCraft {
 					continue;
 				ses_chunk &ch = itr->second;
 				
-				std::vector<block_change_record> records;
 				std::bitset<256> column_changed;
 				
 				for (auto bitr = ch.changes.begin (); bitr != ch.changes.end (); ++bitr)
@@ -902,18 +1273,10 @@ namespace hCraft {
 						column_changed.set ((z << 4) | x);
 						this->w->estage.set (wx, y, wz, ES_NONE, 0xF);
 						
-						// selection blocks
-						for (player *pl : affected_players)
-							if (pl->sb_exists (wx, y, wz))
-								corrections.emplace_back (pl, wx, y, wz);
-						
-						block_change_record rec;
-						rec.x = x;
-						rec.z = z;
-						rec.y = y;
-						rec.id = id;
-						rec.meta = meta;
-						records.push_back (rec);
+						// the tracker takes care of selection blocks.
+						block_data old_bd = wch->get_block (x, y, z);
+						tr.mark (wx, y, wz, _client_block (old_bd.id, old_bd.meta),
+							_client_block (id, meta));
 						
 						// update world
 						wch->set_block (x, y, z, id, meta, ex);
@@ -938,17 +1301,9 @@ namespace hCraft {
 							if (column_changed.test ((z << 4) | x))
 								wch->recalc_heightmap (x, z);
 						}
-				
-				// update players
-				packet *mbcp = packets::play::make_multi_block_change (cx, cz, records);
-				for (player *pl : affected_players)
-					pl->send (new packet (*mbcp));
-				delete mbcp;
-				
-				// resend modified selection blocks
-				for (sb_correction& sbc : corrections)
-					sbc.pl->sb_send (sbc.x, sbc.y, sbc.z);
 			}
+		
+		tr.flush (affected_players);
 	}
 	
 	/* 
@@ -1073,6 +1428,28 @@ namespace hCraft {
 		return this->es.mod_count_at (cx, cz);
 	}
 	
+	/* 
+	 * Tests every block of every span, and passes on the blocks that pass
+	 * as a new span list.
+	 */
+	void
+	cond_edit_stage::fill_spans (const span_list& spans, unsigned short id,
+		unsigned char meta, unsigned char ex)
+	{
+		world *w = this->es.get_world ();
+		span_list passed;
+		for (const block_span& sp : spans)
+			for (int x = sp.x0; x <= sp.x1; ++x)
+				{
+					if (this->test_fn (w, x, sp.y, sp.z, this->ctx))
+						passed.add_point (x, sp.y, sp.z);
+					else
+						++ this->bad_blocks;
+				}
+		
+		this->es.fill_spans (passed, id, meta, ex);
+	}
+	
 	
 	/* 
 	 * Sends all modified blocks to the specified player(s).
@@ -0,0 +1,450 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "drawing/raster.hpp"
+#include "util/utils.hpp"
+#include <alloca.h>
+#include <cmath>
+#include <limits>
+
+
+namespace hCraft {
+	
+	span_list::span_list (long long budget)
+	{
+		this->total = 0;
+		this->budget = budget;
+		this->over = false;
+	}
+	
+	
+	
+	/* 
+	 * Adds the span [x0, x1] at (y, z).  Returns false if that would go over
+	 * the budget, in which case nothing is added.
+	 */
+	bool
+	span_list::add (int y, int z, int x0, int x1)
+	{
+		if (x1 < x0)
+			return true;
+		
+		long long len = (long long)x1 - x0 + 1;
+		if (this->budget >= 0 && (this->total + len) > this->budget)
+			{
+				this->over = true;
+				return false;
+			}
+		
+		this->spans.push_back ({ y, z, x0, x1 });
+		this->total += len;
+		return true;
+	}
+	
+	/* 
+	 * Adds a single block, extending the last span if the block is right
+	 * next to it.
+	 */
+	bool
+	span_list::add_point (int x, int y, int z)
+	{
+		if (this->budget >= 0 && (this->total + 1) > this->budget)
+			{
+				this->over = true;
+				return false;
+			}
+		
+		if (!this->spans.empty ())
+			{
+				block_span& last = this->spans.back ();
+				if (last.y == y && last.z == z)
+					{
+						if (x == last.x1 + 1)
+							{ ++ last.x1; ++ this->total; return true; }
+						else if (x == last.x0 - 1)
+							{ -- last.x0; ++ this->total; return true; }
+					}
+			}
+		
+		this->spans.push_back ({ y, z, x, x });
+		++ this->total;
+		return true;
+	}
+	
+	void
+	span_list::clear ()
+	{
+		this->spans.clear ();
+		this->total = 0;
+		this->over = false;
+	}
+	
+	
+	
+//----
+	
+	namespace raster {
+		
+		// largest r such that r*r <= n (n >= 0).
+		static inline int
+		_isqrt (long long n)
+		{
+			long long r = (long long)std::sqrt ((double)n);
+			while (r * r > n)
+				-- r;
+			while ((r + 1) * (r + 1) <= n)
+				++ r;
+			return (int)r;
+		}
+		
+		
+		
+		/* 
+		 * A 3D Bresenham line from @{pt1} to @{pt2}.
+		 */
+		bool
+		line (span_list& out, vector3 pt1, vector3 pt2)
+		{
+			int x1 = (int)(pt1.x);
+			int y1 = (int)(pt1.y);
+			int z1 = (int)(pt1.z);
+			int x2 = (int)(pt2.x);
+			int y2 = (int)(pt2.y);
+			int z2 = (int)(pt2.z);
+			
+			int dx = x2 - x1;
+			int dy = y2 - y1;
+			int dz = z2 - z1;
+			
+			int ax = utils::iabs (dx) << 1;
+			int ay = utils::iabs (dy) << 1;
+			int az = utils::iabs (dz) << 1;
+			
+			int sx = utils::zsgn (dx);
+			int sy = utils::zsgn (dy);
+			int sz = utils::zsgn (dz);
+			
+			int x = x1, y = y1, z = z1;
+			int xd, yd, zd;
+			
+			if (ax >= utils::max (ay, az)) // x dominant
+				{
+					yd = ay - (ax >> 1);
+					zd = az - (ax >> 1);
+					for (;;)
+						{
+							if (!out.add_point (x, y, z))
+								return false;
+							if (x == x2)
+								break;
+							
+							if (yd >= 0) { y += sy; yd -= ax; }
+							if (zd >= 0) { z += sz; zd -= ax; }
+							x += sx;
+							yd += ay;
+							zd += az;
+						}
+				}
+			else if (ay >= utils::max (ax, az)) // y dominant
+				{
+					xd = ax - (ay >> 1);
+					zd = az - (ay >> 1);
+					for (;;)
+						{
+							if (!out.add_point (x, y, z))
+								return false;
+							if (y == y2)
+								break;
+							
+							if (xd >= 0) { x += sx; xd -= ay; }
+							if (zd >= 0) { z += sz; zd -= ay; }
+							y += sy;
+							xd += ax;
+							zd += az;
+						}
+				}
+			else // z dominant
+				{
+					xd = ax - (az >> 1);
+					yd = ay - (az >> 1);
+					for (;;)
+						{
+							if (!out.add_point (x, y, z))
+								return false;
+							if (z == z2)
+								break;
+							
+							if (xd >= 0) { x += sx; xd -= az; }
+							if (yd >= 0) { y += sy; yd -= az; }
+							z += sz;
+							xd += ax;
+							yd += ay;
+						}
+				}
+			
+			return true;
+		}
+		
+		
+		
+		// with t being in the range of 0-1
+		static inline vector3
+		_lerp3 (vector3 a, vector3 b, float t)
+		{
+			return {
+				a.x + (b.x - a.x) * t,
+				a.y + (b.y - a.y) * t,
+				a.z + (b.z - a.z) * t };
+		}
+		
+		static vector3
+		_bezier_point (const std::vector<vector3>& points, double t)
+		{
+			int i, s = points.size ();
+			vector3 *arr = (vector3 *)alloca (s * sizeof (vector3));
+			for (i = 0; i < s; ++i)
+				arr[i] = points[i];
+			while (s > 2)
+				{
+					-- s;
+					for (i = 0; i < s; ++i)
+						arr[i] = _lerp3 (arr[i], arr[i + 1], t);
+				}
+			return _lerp3 (arr[0], arr[1], t);
+		}
+		
+		/* 
+		 * An N-th order bezier curve through N control points, as a series of
+		 * lines.
+		 */
+		bool
+		bezier (span_list& out, const std::vector<vector3>& points)
+		{
+			if (points.empty ())
+				return true;
+			else if (points.size () == 1)
+				return out.add_point (points[0].x, points[0].y, points[0].z);
+			
+			double t = 0.0;
+			double inc =
+				1.0 / (points[points.size () - 1] - points[0]).magnitude ();
+			vector3 last_pt = points[0];
+			while (t <= 1.0)
+				{
+					vector3 pt = _bezier_point (points, t);
+					if (!line (out, last_pt, pt))
+						return false;
+					last_pt = pt;
+					t += inc;
+				}
+			
+			return true;
+		}
+		
+		
+		
+		static vector3
+		_catmull_spline (vector3 p0, vector3 p1, vector3 p2, vector3 p3, double t)
+		{
+			return 0.5 * ( ((2 * p1)) +
+										 (t * (-p0 + p2)) +
+										 ((t*t) * (2*p0 - 5*p1 + 4*p2 - p3)) +
+										 ((t*t*t) * (-p0 + 3*p1 - 3*p2 + p3)) );
+		}
+		
+		/* 
+		 * A Catmull-Rom curve through all but the first and last points.
+		 */
+		bool
+		curve (span_list& out, const std::vector<vector3>& points)
+		{
+			switch (points.size ())
+				{
+					case 0: return true;
+					case 1: return out.add_point (points[0].x, points[0].y, points[0].z);
+					case 2: return out.add_point (points[1].x, points[1].y, points[1].z);
+					case 3: return line (out, points[1], points[2]);
+				}
+			
+			int j = points.size () - 3;
+			for (int i = 0; i < j; ++i)
+				{
+					vector3 p0 = points[i + 0], p1 = points[i + 1],
+									p2 = points[i + 2], p3 = points[i + 3];
+					
+					vector3 last = p1;
+					double t = 0.0;
+					double t_inc = 1.0 / (p2 - p1).magnitude ();
+					while (t <= 1.0)
+						{
+							vector3 next = _catmull_spline (p0, p1, p2, p3, t);
+							if (!line (out, last, next))
+								return false;
+							last = next;
+							t += t_inc;
+						}
+				}
+			
+			return true;
+		}
+		
+		
+		
+		/* 
+		 * The box between two corners (inclusive).
+		 */
+		bool
+		filled_cuboid (span_list& out, vector3 pt1, vector3 pt2)
+		{
+			int sx = utils::min ((int)pt1.x, (int)pt2.x);
+			int sy = utils::min ((int)pt1.y, (int)pt2.y);
+			int sz = utils::min ((int)pt1.z, (int)pt2.z);
+			int ex = utils::max ((int)pt1.x, (int)pt2.x);
+			int ey = utils::max ((int)pt1.y, (int)pt2.y);
+			int ez = utils::max ((int)pt1.z, (int)pt2.z);
+			
+			for (int y = sy; y <= ey; ++y)
+				for (int z = sz; z <= ez; ++z)
+					if (!out.add (y, z, sx, ex))
+						return false;
+			return true;
+		}
+		
+		
+		
+		/* 
+		 * All blocks within round (radius) of the center.
+		 */
+		bool
+		filled_sphere (span_list& out, vector3 pt, double radius)
+		{
+			int rad = std::round (radius);
+			long long srad = (long long)rad * rad;
+			int cx = pt.x, cy = pt.y, cz = pt.z;
+			
+			for (int y = -rad; y <= rad; ++y)
+				for (int z = -rad; z <= rad; ++z)
+					{
+						long long c = (long long)y*y + (long long)z*z;
+						if (c > srad)
+							continue;
+						
+						int xm = _isqrt (srad - c);
+						if (!out.add (cy + y, cz + z, cx - xm, cx + xm))
+							return false;
+					}
+			return true;
+		}
+		
+		/* 
+		 * A one block thick sphere shell.
+		 */
+		bool
+		hollow_sphere (span_list& out, vector3 pt, double radius)
+		{
+			// same bounds as the old voxel loop: (rad - 1)^2 < d^2 <= round (r^2),
+			// with every coordinate within [-rad, rad].
+			long long srad = std::round (radius * radius);
+			int rad = std::round (radius);
+			long long sradm1 = (long long)(rad - 1) * (rad - 1);
+			int cx = pt.x, cy = pt.y, cz = pt.z;
+			
+			for (int y = -rad; y <= rad; ++y)
+				for (int z = -rad; z <= rad; ++z)
+					{
+						long long c = (long long)y*y + (long long)z*z;
+						if (c > srad)
+							continue;
+						
+						int xm = utils::min (_isqrt (srad - c), rad);
+						if (c > sradm1)
+							{
+								if (!out.add (cy + y, cz + z, cx - xm, cx + xm))
+									return false;
+								continue;
+							}
+						
+						// skip the inside of the shell
+						int xi = _isqrt (sradm1 - c) + 1;
+						if (xi > xm)
+							continue;
+						if (!out.add (cy + y, cz + z, cx - xm, cx - xi) ||
+								!out.add (cy + y, cz + z, cx + xi, cx + xm))
+							return false;
+					}
+			return true;
+		}
+		
+		
+		
+		// (v / r)^2, where a zero radius only admits v = 0.
+		static inline double
+		_axis_term (int v, double r)
+		{
+			if (r <= 0.0)
+				return (v == 0) ? 0.0 : std::numeric_limits<double>::infinity ();
+			return ((double)v * v) / (r * r);
+		}
+		
+		/* 
+		 * An axis-aligned ellipsoid with the given radii.
+		 */
+		bool
+		filled_ellipsoid (span_list& out, vector3 pt, double rx, double ry, double rz)
+		{
+			if (rx < 0.0 || ry < 0.0 || rz < 0.0)
+				return true;
+			
+			int cx = pt.x, cy = pt.y, cz = pt.z;
+			int iry = ry, irz = rz;
+			for (int y = -iry; y <= iry; ++y)
+				for (int z = -irz; z <= irz; ++z)
+					{
+						double t = 1.0 - _axis_term (y, ry) - _axis_term (z, rz);
+						if (t < 0.0)
+							continue;
+						
+						int xm = std::floor (rx * std::sqrt (t) + 1e-9);
+						if (!out.add (cy + y, cz + z, cx - xm, cx + xm))
+							return false;
+					}
+			return true;
+		}
+		
+		/* 
+		 * An upright cylinder whose bottom face is centered at @{pt}.
+		 */
+		bool
+		filled_cylinder (span_list& out, vector3 pt, double radius, int height)
+		{
+			int rad = std::round (radius);
+			long long srad = (long long)rad * rad;
+			int cx = pt.x, cy = pt.y, cz = pt.z;
+			
+			for (int y = cy; y < cy + height; ++y)
+				for (int z = -rad; z <= rad; ++z)
+					{
+						int xm = _isqrt (srad - (long long)z*z);
+						if (!out.add (y, cz + z, cx - xm, cx + xm))
+							return false;
+					}
+			return true;
+		}
+	}
+}
+
@@ -17,7 +17,7 @@
  */
 
 #include "physics/blocks/activewater.hpp"
-#include "world/world.hpp"
+#include "physics/context.hpp"
 
 
 namespace hCraft {
@@ -25,24 +25,26 @@ namespace hCraft {
 	namespace physics {
 		
 		void
-		active_water::tick (world &w, int x, int y, int z, int data, void *ptr,
+		active_water::tick (physics_context& ctx, int x, int y, int z, int data, void *ptr,
 			std::minstd_rand& rnd)
 		{
-			if (w.get_final_block (x, y, z).id != this->id ())
+			ctx.focus (x, y, z);
+			
+			if (ctx.get (x, y, z).id != this->id ())
 				return;
 			
-			//w.queue_update (x, y, z, BT_STILL_WATER);
+			//ctx.set (x, y, z, BT_STILL_WATER);
 			
-			if (y > 0 && w.get_final_block (x, y - 1, z).id == BT_AIR)
-				w.queue_update (x, y - 1, z, this->id ());
-			if (w.get_final_block (x - 1, y, z).id == BT_AIR)
-				w.queue_update (x - 1, y, z, this->id ());
-			if (w.get_final_block (x + 1, y, z).id == BT_AIR)
-				w.queue_update (x + 1, y, z, this->id ());
-			if (w.get_final_block (x, y, z - 1).id == BT_AIR)
-				w.queue_update (x, y, z - 1, this->id ());
-			if (w.get_final_block (x, y, z + 1).id == BT_AIR)
-				w.queue_update (x, y, z + 1, this->id ());
+			if (y > 0 && ctx.get (x, y - 1, z).id == BT_AIR)
+				ctx.set (x, y - 1, z, this->id ());
+			if (ctx.get (x - 1, y, z).id == BT_AIR)
+				ctx.set (x - 1, y, z, this->id ());
+			if (ctx.get (x + 1, y, z).id == BT_AIR)
+				ctx.set (x + 1, y, z, this->id ());
+			if (ctx.get (x, y, z - 1).id == BT_AIR)
+				ctx.set (x, y, z - 1, this->id ());
+			if (ctx.get (x, y, z + 1).id == BT_AIR)
+				ctx.set (x, y, z + 1, this->id ());
 		}
 	}
 }
@@ -17,6 +17,7 @@
  */
 
 #include "physics/blocks/physics_block.hpp"
+#include "physics/context.hpp"
 #include "util/cistring.hpp"
 #include <vector>
 #include <memory>
@@ -140,5 +141,21 @@ namespace hCraft {
 			}
 		return physics_block::from_name (str);
 	}
+	
+	
+	
+	/* 
+	 * The version of tick () actually called by the physics loop.  Blocks
+	 * that override this one read and modify the world through the given
+	 * context, which batches everything up.  By default, the context's
+	 * queued updates are submitted and the world version is called.
+	 */
+	void
+	physics_block::tick (physics_context& ctx, int x, int y, int z, int data,
+		void *ptr, std::minstd_rand& rnd)
+	{
+		ctx.submit ();
+		this->tick (ctx.get_world (), x, y, z, data, ptr, rnd);
+	}
 }
 
@@ -17,7 +17,7 @@
  */
 
 #include "physics/blocks/sand.hpp"
-#include "world/world.hpp"
+#include "physics/context.hpp"
 
 
 namespace hCraft {
@@ -25,41 +25,43 @@ namespace hCraft {
 	namespace physics {
 		
 		void
-		sand::tick (world &w, int x, int y, int z, int data, void *ptr,
+		sand::tick (physics_context& ctx, int x, int y, int z, int data, void *ptr,
 			std::minstd_rand& rnd)
 		{
+			ctx.focus (x, y, z);
+			
 			if (y <= 0)
-				{ w.queue_update (x, y, z, BT_AIR); return; }
-			if (w.get_id (x, y, z) != BT_SAND)
+				{ ctx.set (x, y, z, BT_AIR); return; }
+			if (ctx.get_id (x, y, z) != BT_SAND)
 				return;
 		
-			int below = w.get_id (x, y - 1, z);
+			int below = ctx.get_id (x, y - 1, z);
 			if (below == BT_AIR)
 				{
-					w.queue_update (x, y, z, BT_AIR);
-					w.queue_update (x, y - 1, z, BT_SAND);
+					ctx.set (x, y, z, BT_AIR);
+					ctx.set (x, y - 1, z, BT_SAND);
 				}
 			else
 				{
-					if (w.get_id (x - 1, y - 1, z) == BT_AIR && w.get_id (x - 1, y, z) == BT_AIR)
+					if (ctx.get_id (x - 1, y - 1, z) == BT_AIR && ctx.get_id (x - 1, y, z) == BT_AIR)
 						{
-							w.queue_update (x, y, z, BT_AIR);
-							w.queue_update (x - 1, y - 1, z, BT_SAND);
+							ctx.set (x, y, z, BT_AIR);
+							ctx.set (x - 1, y - 1, z, BT_SAND);
 						}
-					else if (w.get_id (x + 1, y - 1, z) == BT_AIR && w.get_id (x + 1, y, z) == BT_AIR)
+					else if (ctx.get_id (x + 1, y - 1, z) == BT_AIR && ctx.get_id (x + 1, y, z) == BT_AIR)
 						{
-							w.queue_update (x, y, z, BT_AIR);
-							w.queue_update (x + 1, y - 1, z, BT_SAND);
+							ctx.set (x, y, z, BT_AIR);
+							ctx.set (x + 1, y - 1, z, BT_SAND);
 						}
-					else if (w.get_id (x, y - 1, z - 1) == BT_AIR && w.get_id (x, y, z - 1) == BT_AIR)
+					else if (ctx.get_id (x, y - 1, z - 1) == BT_AIR && ctx.get_id (x, y, z - 1) == BT_AIR)
 						{
-							w.queue_update (x, y, z, BT_AIR);
-							w.queue_update (x, y - 1, z - 1, BT_SAND);
+							ctx.set (x, y, z, BT_AIR);
+							ctx.set (x, y - 1, z - 1, BT_SAND);
 						}
-					else if (w.get_id (x, y - 1, z + 1) == BT_AIR && w.get_id (x, y, z + 1) == BT_AIR)
+					else if (ctx.get_id (x, y - 1, z + 1) == BT_AIR && ctx.get_id (x, y, z + 1) == BT_AIR)
 						{
-							w.queue_update (x, y, z, BT_AIR);
-							w.queue_update (x, y - 1, z + 1, BT_SAND);
+							ctx.set (x, y, z, BT_AIR);
+							ctx.set (x, y - 1, z + 1, BT_SAND);
 						}
 				}
 		}
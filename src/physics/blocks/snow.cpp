@@ -17,7 +17,7 @@
  */
 
 #include "physics/blocks/snow.hpp"
-#include "world/world.hpp"
+#include "physics/context.hpp"
 
 
 namespace hCraft {
@@ -25,25 +25,27 @@ namespace hCraft {
 	namespace physics {
 		
 		void
-		snow::tick (world &w, int x, int y, int z, int data, void *ptr,
+		snow::tick (physics_context& ctx, int x, int y, int z, int data, void *ptr,
 			std::minstd_rand& rnd)
 		{
+			ctx.focus (x, y, z);
+			
 			if (y <= 0)
-				{ w.queue_update (x, y, z, BT_AIR); return; }
-			if (w.get_final_block (x, y, z).id != BT_SNOW_BLOCK)
+				{ ctx.set (x, y, z, BT_AIR); return; }
+			if (ctx.get (x, y, z).id != BT_SNOW_BLOCK)
 				return;
 			
-			int below = w.get_final_block (x, y - 1, z).id;
-			if (w.get_final_block (x, y - 1, z).id != BT_AIR)
+			int below = ctx.get (x, y - 1, z).id;
+			if (ctx.get (x, y - 1, z).id != BT_AIR)
 				{
 					if (below == BT_SNOW_BLOCK || below == BT_SNOW_COVER)
-						w.queue_update (x, y, z, BT_AIR);
+						ctx.set (x, y, z, BT_AIR);
 					else
-						w.queue_update (x, y, z, BT_SNOW_COVER);
+						ctx.set (x, y, z, BT_SNOW_COVER);
 				}
 			else
 				{
-					w.queue_update (x, y, z, BT_AIR);
+					ctx.set (x, y, z, BT_AIR);
 					
 					int nx = x, nz = z;
 					
@@ -57,10 +59,10 @@ namespace hCraft {
 							case 4: -- nz; break;
 						}
 					
-					if (w.get_final_block (nx, y - 1, nz) == BT_AIR)
-						w.queue_update (nx, y - 1, nz, BT_SNOW_BLOCK);
+					if (ctx.get (nx, y - 1, nz) == BT_AIR)
+						ctx.set (nx, y - 1, nz, BT_SNOW_BLOCK);
 					else
-						w.queue_update (x, y - 1, z, BT_SNOW_BLOCK);
+						ctx.set (x, y - 1, z, BT_SNOW_BLOCK);
 				}
 		}
 	}
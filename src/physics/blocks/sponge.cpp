@@ -17,7 +17,7 @@
  */
 
 #include "physics/blocks/sponge.hpp"
-#include "world/world.hpp"
+#include "physics/context.hpp"
 
 
 namespace hCraft {
@@ -33,51 +33,55 @@ namespace hCraft {
 		
 		
 		void
-		water_sponge::tick (world &w, int x, int y, int z, int data, void *ptr,
+		water_sponge::tick (physics_context& ctx, int x, int y, int z, int data, void *ptr,
 			std::minstd_rand& rnd)
 		{
-			if (w.get_final_block (x, y, z).id != 2001)
+			ctx.focus (x, y, z);
+			
+			if (ctx.get (x, y, z).id != 2001)
 				return;
 			
 			// spawn the initial agents
 			
-			if (y < 255 && is_water_block (w.get_final_block (x, y + 1, z).id))
-				w.queue_update (x, y + 1, z, 2002);
-			if (y > 0   && is_water_block (w.get_final_block (x, y - 1, z).id))
-				w.queue_update (x, y - 1, z, 2002);
-			if (is_water_block (w.get_final_block (x - 1, y, z).id))
-				w.queue_update (x - 1, y, z, 2002);
-			if (is_water_block (w.get_final_block (x + 1, y, z).id))
-				w.queue_update (x + 1, y, z, 2002);
-			if (is_water_block (w.get_final_block (x, y, z - 1).id))
-				w.queue_update (x, y, z - 1, 2002);
-			if (is_water_block (w.get_final_block (x, y, z + 1).id))
-				w.queue_update (x, y, z + 1, 2002);
+			if (y < 255 && is_water_block (ctx.get (x, y + 1, z).id))
+				ctx.set (x, y + 1, z, 2002);
+			if (y > 0   && is_water_block (ctx.get (x, y - 1, z).id))
+				ctx.set (x, y - 1, z, 2002);
+			if (is_water_block (ctx.get (x - 1, y, z).id))
+				ctx.set (x - 1, y, z, 2002);
+			if (is_water_block (ctx.get (x + 1, y, z).id))
+				ctx.set (x + 1, y, z, 2002);
+			if (is_water_block (ctx.get (x, y, z - 1).id))
+				ctx.set (x, y, z - 1, 2002);
+			if (is_water_block (ctx.get (x, y, z + 1).id))
+				ctx.set (x, y, z + 1, 2002);
 		}
 		
 		void
-		water_sponge_agent::tick (world &w, int x, int y, int z, int data, void *ptr,
+		water_sponge_agent::tick (physics_context& ctx, int x, int y, int z, int data, void *ptr,
 			std::minstd_rand& rnd)
 		{
-			if (w.get_final_block (x, y, z).id != 2002)
+			ctx.focus (x, y, z);
+			
+			if (ctx.get (x, y, z).id != 2002)
 				return;
 			
 			// spawn agents
-			if (y < 255 && is_water_block (w.get_final_block (x, y + 1, z).id))
-				w.queue_update (x, y + 1, z, 2002);
-			if (y > 0   && is_water_block (w.get_final_block (x, y - 1, z).id))
-				w.queue_update (x, y - 1, z, 2002);
-			if (is_water_block (w.get_final_block (x - 1, y, z).id))
-				w.queue_update (x - 1, y, z, 2002);
-			if (is_water_block (w.get_final_block (x + 1, y, z).id))
-				w.queue_update (x + 1, y, z, 2002);
-			if (is_water_block (w.get_final_block (x, y, z - 1).id))
-				w.queue_update (x, y, z - 1, 2002);
-			if (is_water_block (w.get_final_block (x, y, z + 1).id))
-				w.queue_update (x, y, z + 1, 2002);
+			if (y < 255 && is_water_block (ctx.get (x, y + 1, z).id))
+				ctx.set (x, y + 1, z, 2002);
+			if (y > 0   && is_water_block (ctx.get (x, y - 1, z).id))
+				ctx.set (x, y - 1, z, 2002);
+			if (is_water_block (ctx.get (x - 1, y, z).id))
+				ctx.set (x - 1, y, z, 2002);
+			if (is_water_block (ctx.get (x + 1, y, z).id))
+				ctx.set (x + 1, y, z, 2002);
+			if (is_water_block (ctx.get (x, y, z - 1).id))
+				ctx.set (x, y, z - 1, 2002);
+			if (is_water_block (ctx.get (x, y, z + 1).id))
+				ctx.set (x, y, z + 1, 2002);
 			
 			// replace self with air
-			w.queue_update (x, y, z, 0);
+			ctx.set (x, y, z, 0);
 		}
 	}
 }
@@ -17,7 +17,7 @@
  */
 
 #include "physics/blocks/water.hpp"
-#include "world/world.hpp"
+#include "physics/context.hpp"
 #include "slot/blocks.hpp"
 
 
@@ -26,14 +26,13 @@ namespace hCraft {
 	namespace physics {
 		
 		static bool
-		can_be_placed_at (world& w, int x, int y, int z, int lv)
+		can_be_placed_at (physics_context& ctx, int x, int y, int z, int lv)
 		{
 			if (y < 0)
 				return false;
 			
-			block_data bd = w.get_block (x, y, z);
-			block_info *binf = block_info::from_id (bd.id);
-			if (!binf->opaque)
+			blocki bd = ctx.get (x, y, z);
+			if (!block_props::is_opaque (bd.id))
 				return true;
 			
 			if (bd.id == BT_WATER)
@@ -46,10 +45,12 @@ namespace hCraft {
 		}
 		
 		void
-		water::tick (world &w, int x, int y, int z, int data, void *ptr,
+		water::tick (physics_context& ctx, int x, int y, int z, int data, void *ptr,
 			std::minstd_rand& rnd)
 		{
-			block_data bd = w.get_block (x, y, z);
+			ctx.focus (x, y, z);
+			
+			blocki bd = ctx.get (x, y, z);
 			if (bd.id != BT_WATER)
 				return;
 			
@@ -57,19 +58,19 @@ namespace hCraft {
 			if (lv > 8)
 				lv = 0;
 			
-			if (can_be_placed_at (w, x, y - 1, z, 8 | lv))
-				w.queue_update (x, y - 1, z, BT_WATER, 8 | lv);
+			if (can_be_placed_at (ctx, x, y - 1, z, 8 | lv))
+				ctx.set (x, y - 1, z, BT_WATER, 8 | lv);
 			else if (y != 0 && (lv & 7) != 7)
 				{
 					unsigned char next_lv = (lv & 7) + 1;
-					if (can_be_placed_at (w, x + 1, y, z, next_lv))
-						w.queue_update (x + 1, y, z, BT_WATER, next_lv);
-					if (can_be_placed_at (w, x - 1, y, z, next_lv))
-						w.queue_update (x - 1, y, z, BT_WATER, next_lv);
-					if (can_be_placed_at (w, x, y, z + 1, next_lv))
-						w.queue_update (x, y, z + 1, BT_WATER, next_lv);
-					if (can_be_placed_at (w, x, y, z - 1, next_lv))
-						w.queue_update (x, y, z - 1, BT_WATER, next_lv);
+					if (can_be_placed_at (ctx, x + 1, y, z, next_lv))
+						ctx.set (x + 1, y, z, BT_WATER, next_lv);
+					if (can_be_placed_at (ctx, x - 1, y, z, next_lv))
+						ctx.set (x - 1, y, z, BT_WATER, next_lv);
+					if (can_be_placed_at (ctx, x, y, z + 1, next_lv))
+						ctx.set (x, y, z + 1, BT_WATER, next_lv);
+					if (can_be_placed_at (ctx, x, y, z - 1, next_lv))
+						ctx.set (x, y, z - 1, BT_WATER, next_lv);
 				}
 		}
 		
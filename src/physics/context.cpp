@@ -0,0 +1,147 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "physics/context.hpp"
+
+
+namespace hCraft {
+	
+	// queued updates are handed over to the world once there are this many.
+	static const size_t max_batch_size = 4096;
+	
+	
+	
+	physics_context::physics_context (world &w)
+		: w (w)
+	{
+		this->focused = false;
+		this->fx = this->fy = this->fz = 0;
+	}
+	
+	physics_context::~physics_context ()
+	{
+		this->submit ();
+	}
+	
+	
+	
+	/* 
+	 * Reads a block from the edit stage, or from the underlying chunk if it
+	 * is not staged.  The world's estage and chunk locks must be held.
+	 */
+	blocki
+	physics_context::fetch_nolock (int x, int y, int z)
+	{
+		if (y < 0 || y > 255)
+			return blocki ();
+		
+		blocki bl;
+		if (this->w.estage.get_staged (x, y, z, bl))
+			return bl;
+		
+		chunk *ch = this->w.get_chunk_nolock (x >> 4, z >> 4);
+		if (!ch)
+			return blocki ();
+		
+		block_data bd = ch->get_block (x & 0xF, y, z & 0xF);
+		return {bd.id, bd.meta};
+	}
+	
+	
+	
+	/* 
+	 * Caches the 3x3x3 cube of blocks centered at the given coordinates.
+	 */
+	void
+	physics_context::focus (int x, int y, int z)
+	{
+		std::lock_guard<std::mutex> guard {this->w.estage_lock};
+		std::lock_guard<std::mutex> ch_guard {this->w.get_chunk_lock ()};
+		
+		int i = 0;
+		for (int yy = y - 1; yy <= y + 1; ++yy)
+			for (int zz = z - 1; zz <= z + 1; ++zz)
+				for (int xx = x - 1; xx <= x + 1; ++xx)
+					this->nbh[i++] = this->fetch_nolock (xx, yy, zz);
+		
+		this->fx = x;
+		this->fy = y;
+		this->fz = z;
+		this->focused = true;
+	}
+	
+	/* 
+	 * Returns the block at the given coordinates, taking queued updates
+	 * into account.
+	 */
+	blocki
+	physics_context::get (int x, int y, int z)
+	{
+		if (!this->written.empty ())
+			{
+				auto itr = this->written.find ({x, y, z});
+				if (itr != this->written.end ())
+					return itr->second;
+			}
+		
+		if (this->focused)
+			{
+				int dx = x - this->fx + 1, dy = y - this->fy + 1, dz = z - this->fz + 1;
+				if (((unsigned)dx | (unsigned)dy | (unsigned)dz) < 3)
+					return this->nbh[(dy * 9) + (dz * 3) + dx];
+			}
+		
+		std::lock_guard<std::mutex> guard {this->w.estage_lock};
+		std::lock_guard<std::mutex> ch_guard {this->w.get_chunk_lock ()};
+		return this->fetch_nolock (x, y, z);
+	}
+	
+	/* 
+	 * Queues an update to the block at the given coordinates.
+	 */
+	void
+	physics_context::set (int x, int y, int z, unsigned short id,
+		unsigned char meta, int extra)
+	{
+		if (!this->w.in_bounds (x, y, z))
+			return;
+		
+		this->batch.emplace_back (x, y, z, id, meta, extra, 0, nullptr, nullptr, true);
+		this->written[{x, y, z}] = blocki (id, meta, (unsigned char)extra);
+		if (this->batch.size () >= max_batch_size)
+			this->submit ();
+	}
+	
+	/* 
+	 * Hands all queued updates over to the world.
+	 */
+	void
+	physics_context::submit ()
+	{
+		if (this->batch.empty ())
+			return;
+		
+		this->w.queue_updates (this->batch);
+		this->batch.clear ();
+		this->written.clear ();
+		
+		// staged blocks might have changed under the cached neighbourhood.
+		this->focused = false;
+	}
+}
+
@@ -18,6 +18,7 @@
 
 #include "physics/physics.hpp"
 #include "physics/physics.hpp"
+#include "physics/context.hpp"
 #include "world/world.hpp"
 #include "util/utils.hpp"
 #include "system/server.hpp"
@@ -362,6 +363,10 @@ namespace hCraft {
 				if (paused)
 					continue;
 				
+				// block updates made by physics blocks are batched per world, and
+				// handed over whenever the worker moves on to another world.
+				std::unique_ptr<physics_context> ctx;
+				
 				fcount = 0; // failure counter
 				for (i = 0; i < updates_per_tick; ++i)
 					{
@@ -377,6 +382,7 @@ namespace hCraft {
 								continue;
 							}
 						
+						epoch_guard eg {this->man.srv.get_epochs ()};
 						world *w = this->man.srv.world_by_id (u.wid);
 						if (!w) continue;
 						
@@ -396,9 +402,13 @@ namespace hCraft {
 								auto blk = u.data.blk;
 								this->man.remove_block (w, blk.x, blk.y, blk.z);
 								
+								if (!ctx || &ctx->get_world () != w)
+									ctx.reset (new physics_context (*w));
+								
 								// does this block have a custom callback attached?
 								if (blk.cb)
 									{
+										ctx->submit ();
 										blk.cb (*w, blk.x, blk.y, blk.z, blk.data, rnd);
 									}
 								else
@@ -406,7 +416,7 @@ namespace hCraft {
 										// nope, use the one associated with its ID
 										physics_block *pb = w->get_physics_at (blk.x, blk.y, blk.z);
 										if (pb)
-											pb->tick (*w, blk.x, blk.y, blk.z, blk.data, nullptr, rnd);
+											pb->tick (*ctx, blk.x, blk.y, blk.z, blk.data, nullptr, rnd);
 									}
 							}
 						else if (u.type == PU_ENTITY)
@@ -443,8 +453,7 @@ namespace hCraft {
 		auto w_itr = this->block_mem.find (w);
 		if (w_itr == this->block_mem.end ())
 			return false;
-		std::unordered_map<chunk_pos, ph_mem_chunk, chunk_pos_hash>&
-			mem_chunks = w_itr->second;
+		ph_mem_map& mem_chunks = w_itr->second;
 		
 		auto ch_itr = mem_chunks.find ({x >> 4, z >> 4});
 		if (ch_itr == mem_chunks.end ())
@@ -461,8 +470,7 @@ namespace hCraft {
 	{
 		if (y < 0 || y > 255) return;
 		
-		std::unordered_map<chunk_pos, ph_mem_chunk, chunk_pos_hash>&
-			mem_chunks = this->block_mem[w];
+		ph_mem_map& mem_chunks = this->block_mem[w];
 		ph_mem_chunk& ch = mem_chunks[{x >> 4, z >> 4}];
 		ph_mem_subchunk* sub = ch.subs[y >> 4];
 		if (sub == nullptr)
@@ -499,8 +507,7 @@ namespace hCraft {
 		auto w_itr = this->block_mem.find (w);
 		if (w_itr == this->block_mem.end ())
 			return;
-		std::unordered_map<chunk_pos, ph_mem_chunk, chunk_pos_hash>&
-			mem_chunks = w_itr->second;
+		ph_mem_map& mem_chunks = w_itr->second;
 		
 		auto ch_itr = mem_chunks.find ({x >> 4, z >> 4});
 		if (ch_itr == mem_chunks.end ())
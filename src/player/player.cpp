@@ -84,7 +84,9 @@ namespace hCraft {
 		this->disconnecting = false;
 		this->reading = false;
 		this->writing = false;
+		this->out_bytes = 0;
 		this->handlers_scheduled = 0;
+		this->strand_running = false;
 		this->total_read = 0;
 		this->read_rem = 1;
 		this->dbid = -1;
@@ -110,6 +112,13 @@ namespace hCraft {
 		this->sb_block.set (BT_STILL_WATER);
 		this->need_new_chunks = false;
 		this->streaming_chunks = false;
+		this->chunks_in_flight = false;
+		this->view_dist = srv.get_config ().view_distance;
+		this->client_view_dist = 0;
+		this->send_cap = srv.get_config ().view_distance;
+		this->send_calm_checks = 0;
+		this->chunk_tokens = srv.get_config ().chunk_rate;
+		this->chunk_tokens_time = std::chrono::steady_clock::now ();
 		this->bundo = nullptr;
 		
 		this->curr_sel = nullptr;
@@ -160,6 +169,14 @@ namespace hCraft {
 		while (this->is_disconnecting ())
 			std::this_thread::sleep_for (std::chrono::milliseconds (1));
 		
+		{
+			std::lock_guard<std::mutex> guard {this->strand_lock};
+			for (unsigned char *data : this->strand_queue)
+				delete[] data;
+			this->strand_queue.clear ();
+			this->strand_tasks.clear ();
+		}
+		
 		{
 			std::lock_guard<std::mutex> guard {this->out_lock};
 			while (!this->out_queue.empty ())
@@ -188,53 +205,169 @@ namespace hCraft {
 	 */
 	
 	
-	struct handle_context
+	/* 
+	 * Drops movement packets (0x03-0x06) made redundant by the ones that follow
+	 * them in the same uninterrupted run of movement packets: a packet can go
+	 * if everything it carries (position and/or look) is sent again later in
+	 * the run, and the player's on-ground state does not change in between
+	 * (so that falls and jumps are still noticed).
+	 * Returns the number of packets dropped.
+	 */
+	static int
+	_coalesce_movement (std::vector<unsigned char *>& batch)
 	{
-		player *pl;
-		unsigned char **packets;
-		int count;
-	};
+		int dropped = 0;
+		bool in_run = false, has_pos = false, has_look = false;
+		int ground = -1;
+		for (size_t i = batch.size (); i-- > 0; )
+			{
+				packet_reader reader {batch[i]};
+				int length = reader.read_varint ();
+				unsigned int start = reader.seek (0);
+				reader.seek (start);
+				int op = reader.read_varint ();
+				if (op < 0x03 || op > 0x06)
+					{
+						in_run = has_pos = has_look = false;
+						ground = -1;
+						continue;
+					}
+				
+				bool pos = (op == 0x04 || op == 0x06);
+				bool look = (op == 0x05 || op == 0x06);
+				int on_ground = (batch[i][start + length - 1] != 0) ? 1 : 0;
+				if (in_run && (!pos || has_pos) && (!look || has_look) && (on_ground == ground))
+					{
+						delete[] batch[i];
+						batch[i] = nullptr;
+						++ dropped;
+						continue;
+					}
+				
+				in_run = true;
+				has_pos |= pos;
+				has_look |= look;
+				ground = on_ground;
+			}
+		
+		if (dropped > 0)
+			batch.erase (std::remove (batch.begin (), batch.end (), nullptr), batch.end ());
+		return dropped;
+	}
 	
 	/* 
-	 * Executed in a thread pool task, spawned by handle ().
+	 * Handles the packets in the player's strand queue until it is empty.
+	 * Ran as a thread pool task, with at most one instance per player.
 	 */
 	void
-	handle_func (void *ptr)
+	player::run_strand (void *ptr)
 	{
-		handle_context *ctx = static_cast<handle_context *> (ptr);
-		player *pl = ctx->pl;
-		unsigned char **packets = ctx->packets;
-		int count = ctx->count;
-		delete ctx; // no longer needed
-		
-		// this will destroy all pointers in case of failure
-		std::vector<std::unique_ptr<unsigned char []> > vec;
-		for (int i = 0; i < count; ++i)
-			vec.emplace_back (packets [i]);
-		delete[] packets;
-		
-		if (pl->srv.is_shutting_down ())
-			return;
+		player *pl = static_cast<player *> (ptr);
+		std::vector<unsigned char *> batch;
+		std::vector<std::function<void ()>> tasks;
 		
-		for (std::unique_ptr<unsigned char []>& data : vec)
+		for (;;)
 			{
-				try
+				bool done = false;
+				{
+					std::lock_guard<std::mutex> guard {pl->strand_lock};
+					if ((pl->strand_queue.empty () && pl->strand_tasks.empty ())
+						|| pl->srv.is_shutting_down () || pl->is_disconnecting ())
+						{
+							for (unsigned char *data : pl->strand_queue)
+								delete[] data;
+							pl->strand_queue.clear ();
+							pl->strand_tasks.clear ();
+							pl->strand_running = false;
+							done = true;
+						}
+					else
+						{
+							batch.swap (pl->strand_queue);
+							tasks.swap (pl->strand_tasks);
+						}
+				}
+				
+				if (done)
 					{
-						int err = pl->handle (data.get ());
+						// the player may be destroyed as soon as this reaches zero.
 						-- pl->handlers_scheduled;
-						if (pl->is_disconnecting ())
-							return;
-						else if (err != 0)
+						return;
+					}
+				
+				// handlers may look up other entities and worlds by ID.
+				epoch_guard eg {pl->srv.get_epochs ()};
+				
+				// packets piled up while the previous batch was being handled, or
+				// the client is flooding us: only the newest movement state matters.
+				if (pl->pstate == PS_PLAY && batch.size () > 1 && pl->rej_mov == 0)
+					{
+						int dropped = _coalesce_movement (batch);
+						if (dropped > 0)
+							pl->srv.moves_coalesced.inc (dropped);
+					}
+				
+				// posted tasks (e.g. query results) go first.
+				for (auto& task : tasks)
+					{
+						try
 							{
-								pl->disconnect ();
-								return;
+								task ();
+							}
+						catch (const std::exception& ex)
+							{
+								pl->log (LT_ERROR) << "Exception: " << ex.what () << std::endl;
 							}
+						if (pl->is_disconnecting ())
+							break;
 					}
-				catch (const std::exception& ex)
+				tasks.clear ();
+				
+				size_t i;
+				for (i = 0; i < batch.size (); ++i)
 					{
-						pl->log (LT_ERROR) << "Exception: " << ex.what () << std::endl;
-						pl->disconnect (false, false);
+						try
+							{
+								int err = pl->handle (batch[i]);
+								if (pl->is_disconnecting ())
+									break;
+								else if (err != 0)
+									{
+										pl->disconnect ();
+										break;
+									}
+							}
+						catch (const std::exception& ex)
+							{
+								pl->log (LT_ERROR) << "Exception: " << ex.what () << std::endl;
+								pl->disconnect (false, false);
+								break;
+							}
 					}
+				
+				for (unsigned char *data : batch)
+					delete[] data;
+				batch.clear ();
+			}
+	}
+
+	/* 
+	 * Queues @{fn} to be run on the player's strand.
+	 */
+	void
+	player::post (std::function<void ()>&& fn)
+	{
+		bool start = false;
+		{
+			std::lock_guard<std::mutex> guard {this->strand_lock};
+			this->strand_tasks.push_back (std::move (fn));
+			if (!this->strand_running)
+				start = this->strand_running = true;
+		}
+		if (start)
+			{
+				++ this->handlers_scheduled;
+				this->srv.get_thread_pool ().enqueue (&hCraft::player::run_strand, this);
 			}
 	}
 	
@@ -306,27 +439,21 @@ namespace hCraft {
 						/* finished reading packet */
 						unsigned char *data = new unsigned char [pl->total_read];
 						std::memcpy (data, pl->rdbuf, pl->total_read);
-						pl->exec_queue.push_back (data);
-						if (pl->test_packet_chain ())
+						
+						// hand the packet over to the player's strand, starting it if
+						// it is not already running.
+						bool start = false;
+						{
+							std::lock_guard<std::mutex> guard {pl->strand_lock};
+							pl->strand_queue.push_back (data);
+							if (!pl->strand_running)
+								start = pl->strand_running = true;
+						}
+						if (start)
 							{
-								// copy queue into an array, so we could use it in a pooled thread.
-								int packet_count = pl->exec_queue.size ();
-								unsigned char **packets = new unsigned char* [packet_count];
-								for (int i = 0; !pl->exec_queue.empty (); ++i)
-									{
-										packets[i] = pl->exec_queue.front ();
-										pl->exec_queue.pop_front ();
-									}
-								
-								// wrap everything up
-								handle_context *ctx = new handle_context;
-								ctx->pl = pl;
-								ctx->packets = packets;
-								ctx->count = packet_count;
-								
 								++ pl->handlers_scheduled;
 								pl->get_server ().get_thread_pool ().enqueue (
-									handle_func, ctx);
+									&hCraft::player::run_strand, pl);
 							}
 						
 						pl->total_read = 0;
@@ -352,6 +479,7 @@ namespace hCraft {
 				// dispose of the packet that we just completed sending.
 				packet *pack = pl->out_queue.front ();
 				pl->out_queue.pop ();
+				pl->out_bytes -= pack->size;
 				delete pack;
 				
 				if (pl->kicked && ((pl->pstate == PS_PLAY && opcode == 0x40)
@@ -368,6 +496,7 @@ namespace hCraft {
 								delete pack;
 								pl->out_queue.pop ();
 							}
+						pl->out_bytes = 0;
 						
 						pl->writing = false;
 						pl->disconnect (true);
@@ -417,6 +546,7 @@ namespace hCraft {
 		bufferevent_setcb (this->bufev, nullptr, nullptr, nullptr, nullptr);
 		
 		this->save_data ();
+		this->srv.get_sql_store ().flush_soon ();
 		
 		/*
 		// wait for the I/O to stop.
@@ -590,6 +720,7 @@ namespace hCraft {
 			}
 		
 		this->out_queue.push (pack);
+		this->out_bytes += pack->size;
 		if (this->out_queue.size () == 1)
 			{
 				// initiate write
@@ -616,6 +747,8 @@ namespace hCraft {
 		env.prev_world = prev_world;
 		env.curr_world = wr;
 	
+		// keeps the players in the vectors below from being destroyed under us.
+		epoch_guard eg {pl->get_server ().get_epochs ()};
 		std::vector<player *> new_players;
 		std::vector<player *> old_players;
 		std::vector<player *> others;
@@ -811,6 +944,7 @@ namespace hCraft {
 		
 		this->curr_world = w;
 		this->pos = destpos;
+		this->curr_world->wake ();
 		this->curr_world->get_players ().add (this);
 		this->load_tab_list ();
 		this->add_to_tab_list (false);
@@ -855,7 +989,7 @@ namespace hCraft {
 		std::lock_guard<std::mutex> wguard {this->world_lock};
 		for (auto itr = this->known_chunks.begin (); itr != this->known_chunks.end (); ++ itr)
 			{
-				known_chunk kc = *itr;
+				known_chunk kc = itr->second;
 				
 				this->send (packets::play::make_empty_chunk (kc.cx, kc.cz));
 				
@@ -895,28 +1029,42 @@ namespace hCraft {
 	
 //--
 	
+	// size of a column's uncompressed data in a chunk packet.
+	static size_t
+	_column_data_size (chunk *ch)
+	{
+		size_t size = 256; // biome array
+		for (int i = 0; i < 16; ++i)
+			{
+				subchunk *sub = ch->get_sub (i);
+				if (sub && !sub->all_air ())
+					size += 10240;
+			}
+		return size;
+	}
+	
 	/* 
 	 * Loads new close chunks to the player and unloads those that are too
 	 * far away.
 	 */
 	void
-	player::stream_chunks (int radius)
+	player::stream_chunks ()
 	{
-		if (this->streaming_chunks)
+		if (this->streaming_chunks.exchange (true))
 			return;
 		
 		std::lock_guard<std::mutex> wguard {this->world_lock};
-		this->streaming_chunks = true;
 		
 		std::vector<std::pair<known_chunk, bool>> unload_list;
 		world *w = this->curr_world;
+		int radius = this->chunk_radius ();
 		
 		if (this->need_new_chunks)
 			{
 				// compile a list of chunks that we no longer need
 				for (auto itr = this->known_chunks.begin (); itr != this->known_chunks.end (); )
 					{
-						known_chunk kc = *itr;
+						known_chunk kc = itr->second;
 						
 						if (!this->can_see_chunk (kc.cx, kc.cz))
 							{
@@ -931,76 +1079,81 @@ namespace hCraft {
 							}
 					}
 				
-				// get a sorted list of chunk coordinates.
+				// forget about requests that went out of range
+				for (auto itr = this->pending_chunks.begin (); itr != this->pending_chunks.end (); )
+					{
+						if ((itr->second.w != w) || !this->can_see_chunk (itr->second.cx, itr->second.cz))
+							itr = this->pending_chunks.erase (itr);
+						else
+							++ itr;
+					}
+				
+				// get a list of chunk coordinates, ordered by priority: chunks that
+				// are closer and in front of the player come first.
 				std::vector<chunk_pos> coords;
 				{
-					player *pl = this;
 					chunk_pos cp = this->pos;
+					double px = this->pos.x, pz = this->pos.z;
+					double yaw = this->pos.r * 3.14159265358979323846 / 180.0;
+					double fx = -std::sin (yaw), fz = std::cos (yaw);
 					
+					std::vector<std::pair<double, chunk_pos>> scored;
 					for (int cx = (cp.x - radius); cx <= (cp.x + radius); ++cx)
 						for (int cz = (cp.z - radius); cz <= (cp.z + radius); ++cz)
-							coords.emplace_back (cx, cz);
-					std::sort (coords.begin (), coords.end (),
-						[pl] (const chunk_pos a, const chunk_pos b) -> bool
 							{
-								double a_dx = (a.x * 16.0) - pl->pos.x;
-								double a_dz = (a.z * 16.0) - pl->pos.z;
-								double b_dx = (b.x * 16.0) - pl->pos.x;
-								double b_dz = (b.z * 16.0) - pl->pos.z;
+								double dx = (cx * 16.0 + 8.0) - px;
+								double dz = (cz * 16.0 + 8.0) - pz;
+								double d2 = dx*dx + dz*dz;
 								
-								return (a_dx*a_dx + a_dz*a_dz) < (b_dx*b_dx + b_dz*b_dz);
-							});
+								// the chunks immediately around the player are needed no
+								// matter which way they are looking.
+								double score = d2;
+								if (d2 > 24.0*24.0)
+									{
+										double d = std::sqrt (d2);
+										double dot = (dx*fx + dz*fz) / d;
+										score = d2 * (1.5 - 0.5 * dot);
+									}
+								
+								scored.emplace_back (score, chunk_pos (cx, cz));
+							}
+					std::sort (scored.begin (), scored.end (),
+						[] (const std::pair<double, chunk_pos>& a, const std::pair<double, chunk_pos>& b) -> bool
+							{ return a.first < b.first; });
+					
+					coords.reserve (scored.size ());
+					for (auto& p : scored)
+						coords.push_back (p.second);
 				}
 				
 				for (chunk_pos cpos : coords)
 					{
 						int cx = cpos.x, cz = cpos.z;
+						unsigned long long key = known_chunk::key (cx, cz);
 						
 						// do we already have this chunk in our known chunk list?
-						bool found = false;
-						for (auto itr = this->known_chunks.begin (); itr != this->known_chunks.end (); ++itr)
-							{
-								known_chunk kc = *itr;
-								if (kc.cx == cx && kc.cz == cz)
-									{
-										if (kc.w != w)
-											this->known_chunks.erase (itr);
-										else
-											found = true;
-										break;
-									}
-							}
-				
-						if (!found)
+						auto kitr = this->known_chunks.find (key);
+						if (kitr != this->known_chunks.end ())
 							{
-								bool p_found = false;
-								for (auto itr = this->pending_chunks.begin (); itr != this->pending_chunks.end (); ++itr)
-									{
-										known_chunk c = *itr;
-										if (c.cx == cx && c.cz == cz)
-											{
-												if (c.w == w) 
-													p_found = true;
-												else
-													this->pending_chunks.erase (itr);
-												break;
-											}
-									}
-								
-								if (!p_found)
-									{
-										// fetch all chunks around it first!
-										// to ensure that the world generator doesn't produce any
-										// glitched structures (such as trees cut in half)
-										for (int xx = (cx - 1); xx <= (cx + 1); ++xx)
-											for (int zz = (cz - 1); zz <= (cz + 1); ++zz)
-												if (!(xx == cx && zz == cz))
-													this->srv.cgen.request (w, xx, zz, this->eid, GFL_NODELIVER | GFL_NOABORT);
-										
-										this->srv.cgen.request (w, cx, cz, this->eid);
-										this->pending_chunks.push_back ({w, cx, cz});
-									}
+								if (kitr->second.w == w)
+									continue;
+								this->known_chunks.erase (kitr);
 							}
+						
+						// already requested?
+						if (this->pending_chunks.find (key) != this->pending_chunks.end ())
+							continue;
+						
+						// fetch all chunks around it first!
+						// to ensure that the world generator doesn't produce any
+						// glitched structures (such as trees cut in half)
+						for (int xx = (cx - 1); xx <= (cx + 1); ++xx)
+							for (int zz = (cz - 1); zz <= (cz + 1); ++zz)
+								if (!(xx == cx && zz == cz))
+									this->srv.cgen.request (w, xx, zz, this->eid, GFL_NODELIVER | GFL_NOABORT);
+						
+						this->srv.cgen.request (w, cx, cz, this->eid);
+						this->pending_chunks[key] = {w, cx, cz};
 					}
 				
 				this->need_new_chunks = false;
@@ -1017,87 +1170,211 @@ namespace hCraft {
 						gen_response resp = this->response_chunks.front ();
 						this->response_chunks.pop ();
 						
-						// remove from pending chunk list
-						for (auto itr = this->pending_chunks.begin (); itr != this->pending_chunks.end (); ++itr)
-							if (itr->cx == resp.cx && itr->cz == resp.cz)
-								{ this->pending_chunks.erase (itr); break; }
+						if (!resp.ch || resp.flags == GFL_ABORTED || resp.w != w)
+							{
+								// the chunk will have to be requested again if it is still
+								// needed.
+								auto itr = this->pending_chunks.find (known_chunk::key (resp.cx, resp.cz));
+								if (itr != this->pending_chunks.end () && itr->second.w == resp.w)
+									this->pending_chunks.erase (itr);
+								continue;
+							}
 						
-						if (!resp.ch || resp.flags == GFL_ABORTED)
-							continue;
+						this->ready_chunks.push_back (resp);
+					}
+			}
+		
+		// send out as many ready chunks as the rate limit and the client's
+		// connection allow.
+		if (!this->ready_chunks.empty ())
+			{
+				auto& cfg = this->srv.get_config ();
+				
+				auto now = std::chrono::steady_clock::now ();
+				double elapsed = std::chrono::duration_cast<std::chrono::milliseconds> (
+					now - this->chunk_tokens_time).count () / 1000.0;
+				this->chunk_tokens_time = now;
+				this->chunk_tokens = std::min ((double)cfg.chunk_rate,
+					this->chunk_tokens + elapsed * cfg.chunk_rate);
+				
+				// the chunk the player is standing in and its direct neighbours are
+				// always sent straight away, no matter how much of the budget is
+				// left, or how far back in the queue they are.
+				auto near = [my_cpos] (int cx, int cz) -> bool
+					{ return (std::abs (cx - my_cpos.x) <= 1) && (std::abs (cz - my_cpos.z) <= 1); };
+				
+				// pick the chunks that go out this round, in the order in which they
+				// were requested.
+				std::vector<std::pair<size_t, chunk_column>> picked;
+				bool exhausted = false;
+				for (size_t i = 0; i < this->ready_chunks.size (); ++i)
+					{
+						gen_response resp = this->ready_chunks[i];
+						unsigned long long key = known_chunk::key (resp.cx, resp.cz);
 						
-						if (resp.w != w)
-							continue; // wrong world
-					
 						// do we still need this chunk?
-						if (!this->can_see_chunk (resp.cx, resp.cz))
+						auto pitr = this->pending_chunks.find (key);
+						if (pitr == this->pending_chunks.end () || pitr->second.w != w
+							|| !this->can_see_chunk (resp.cx, resp.cz))
 							continue;
 						
-						// selection blocks / editstages
-						std::vector<edit_stage *> es_vec;
-						es_vec.push_back (&this->sb_updates);
-						for (edit_stage *es : this->edstages)
-							if (es->get_world () == w)
-								es_vec.push_back (es);
-							
-						this->send (packets::play::make_chunk (resp.cx, resp.cz, resp.ch, es_vec));
+						// the chunk could have been unloaded while it was waiting.
+						chunk *ch = w->get_chunk (resp.cx, resp.cz);
+						if (!ch)
+							{
+								this->pending_chunks.erase (pitr);
+								this->need_new_chunks = true;
+								continue;
+							}
 						
-						this->known_chunks.push_back ({w, resp.cx, resp.cz});
+						if (!near (resp.cx, resp.cz))
+							{
+								if (!exhausted && ((this->chunk_tokens < 1.0)
+									|| (!this->joining_world && (this->out_bytes > cfg.player_send_budget * 1024))))
+									exhausted = true;
+								if (exhausted)
+									continue;
+								this->chunk_tokens -= 1.0;
+							}
 						
-						// is this our new home chunk? (When switching between worlds)
-						if (this->joining_world && (my_cpos.x == resp.cx && my_cpos.z == resp.cz))
+						this->pending_chunks.erase (pitr);
+						picked.push_back (std::make_pair (i, chunk_column {resp.cx, resp.cz, ch}));
+					}
+				
+				// batches go out nearest-first, so the home chunk leads the first one.
+				std::stable_sort (picked.begin (), picked.end (),
+					[my_cpos] (const std::pair<size_t, chunk_column>& a,
+						const std::pair<size_t, chunk_column>& b) -> bool
+						{
+							int adx = a.second.x - my_cpos.x, adz = a.second.z - my_cpos.z;
+							int bdx = b.second.x - my_cpos.x, bdz = b.second.z - my_cpos.z;
+							return (adx*adx + adz*adz) < (bdx*bdx + bdz*bdz);
+						});
+				
+				// selection blocks / editstages
+				std::vector<edit_stage *> es_vec;
+				es_vec.push_back (&this->sb_updates);
+				for (edit_stage *es : this->edstages)
+					if (es->get_world () == w)
+						es_vec.push_back (es);
+				
+				// columns are grouped into Map Chunk Bulk packets of up to
+				// chunk_bulk_size KB of uncompressed data.
+				size_t bulk_budget = (size_t)cfg.chunk_bulk_size * 1024;
+				std::vector<chunk_column> batch;
+				for (size_t b = 0; b < picked.size (); )
+					{
+						// the rest will be sent once the client catches up.  Near chunks
+						// sort first, so none of them are held back.
+						if (b > 0 && !this->joining_world && !near (picked[b].second.x, picked[b].second.z)
+							&& (this->out_bytes > cfg.player_send_budget * 1024))
 							{
-								entity_pos epos = this->pos;
-								this->send (packets::play::make_player_pos_and_look (
-									epos.x, epos.y, epos.z, epos.r, epos.l, true));
-								this->rej_mov = 3; // reject the next 3 movement packets
-								
-								this->update_home_chunk ();
-								
-								this->joining_world = false;
+								for (; b < picked.size (); ++b)
+									{
+										const chunk_column& col = picked[b].second;
+										this->pending_chunks[known_chunk::key (col.x, col.z)] = {w, col.x, col.z};
+										this->chunk_tokens += 1.0;
+									}
+								break;
 							}
 						
-						// spawn entities to self and vice-versa
-						player *me = this;
-						(resp.ch)->all_entities (
-							[me] (entity *e)
-								{
-									e->spawn_to (me);
-									if (e->get_type () == ET_PLAYER)
+						size_t e = b, bytes = 0;
+						batch.clear ();
+						do
+							{
+								batch.push_back (picked[e].second);
+								bytes += _column_data_size (picked[e].second.ch);
+								++ e;
+							}
+						while (e < picked.size () && (bytes + _column_data_size (picked[e].second.ch)) <= bulk_budget);
+						
+						if (batch.size () == 1)
+							this->send (packets::play::make_chunk (batch[0].x, batch[0].z, batch[0].ch, es_vec));
+						else
+							this->send (packets::play::make_chunk_bulk (batch, es_vec));
+						
+						for (; b < e; ++b)
+							{
+								size_t i = picked[b].first;
+								chunk_column col = picked[b].second;
+								chunk *ch = col.ch;
+								unsigned long long key = known_chunk::key (col.x, col.z);
+								
+								this->known_chunks[key] = {w, col.x, col.z};
+								
+								// is this our new home chunk? (When switching between worlds)
+								if (this->joining_world && (my_cpos.x == col.x && my_cpos.z == col.z))
+									{
+										entity_pos epos = this->pos;
+										this->send (packets::play::make_player_pos_and_look (
+											epos.x, epos.y, epos.z, epos.r, epos.l, true));
+										this->rej_mov = 3; // reject the next 3 movement packets
+										
+										this->update_home_chunk ();
+										
+										this->joining_world = false;
+									}
+								
+								// spawn entities to self and vice-versa
+								player *me = this;
+								ch->all_entities (
+									[me] (entity *e)
 										{
-											player* pl = dynamic_cast<player *> (e);
-											if (pl == me) return;
-											me->spawn_to (pl);
-										}
-								});
+											e->spawn_to (me);
+											if (e->get_type () == ET_PLAYER)
+												{
+													player* pl = dynamic_cast<player *> (e);
+													if (pl == me) return;
+													me->spawn_to (pl);
+												}
+										});
 						
-						// send signs
-						{
-							std::lock_guard<std::mutex> guard {(resp.ch)->ly_signs.lock};
-							for (auto itr = (resp.ch)->ly_signs.signs.begin ();
-								itr != (resp.ch)->ly_signs.signs.end (); )
+								// send signs
 								{
-									block_pos pos = itr->first;
-									
-									int id = (resp.ch)->get_id (pos.x & 0xF, pos.y, pos.z & 0xF);
-									if (id != BT_SIGN_POST && id != BT_WALL_SIGN)
+									std::lock_guard<std::mutex> guard {ch->ly_signs.lock};
+									for (auto itr = ch->ly_signs.signs.begin ();
+										itr != ch->ly_signs.signs.end (); )
 										{
-											// sign got deleted
-											itr = (resp.ch)->ly_signs.signs.erase (itr);
-										}
-									else
-										{
-											auto& sign = itr->second;
+											block_pos pos = itr->first;
+									
+											int id = ch->get_id (pos.x & 0xF, pos.y, pos.z & 0xF);
+											if (id != BT_SIGN_POST && id != BT_WALL_SIGN)
+												{
+													// sign got deleted
+													itr = ch->ly_signs.signs.erase (itr);
+												}
+											else
+												{
+													auto& sign = itr->second;
 								
-											this->send (packets::play::make_update_sign (pos.x, pos.y, pos.z,
-												sign.l1.c_str (), sign.l2.c_str (), sign.l3.c_str (),
-												sign.l4.c_str ()));
-											++ itr;
+													this->send (packets::play::make_update_sign (pos.x, pos.y, pos.z,
+														sign.l1.c_str (), sign.l2.c_str (), sign.l3.c_str (),
+														sign.l4.c_str ()));
+													++ itr;
+												}
 										}
 								}
-						}
+						
+								// mark as handled
+								this->ready_chunks[i].ch = nullptr;
+							}
 					}
+				
+				// drop chunks that have been sent, or are no longer needed.
+				this->ready_chunks.erase (
+					std::remove_if (this->ready_chunks.begin (), this->ready_chunks.end (),
+						[this, w] (const gen_response& resp) -> bool
+							{
+								if (!resp.ch)
+									return true;
+								auto itr = this->pending_chunks.find (known_chunk::key (resp.cx, resp.cz));
+								return (itr == this->pending_chunks.end () || itr->second.w != w);
+							}),
+					this->ready_chunks.end ());
 			}
 		
+		this->chunks_in_flight = !this->pending_chunks.empty ();
+		
 		// unload chunks
 		for (auto p : unload_list)
 			{
@@ -1138,8 +1415,8 @@ namespace hCraft {
 	{
 		chunk_pos me_pos = this->pos;
 		return (
-			(utils::iabs (me_pos.x - x) <= player::chunk_radius ()) &&
-			(utils::iabs (me_pos.z - z) <= player::chunk_radius ()));
+			(utils::iabs (me_pos.x - x) <= this->chunk_radius ()) &&
+			(utils::iabs (me_pos.z - z) <= this->chunk_radius ()));
 	}
 	
 	/* 
@@ -1181,6 +1458,56 @@ namespace hCraft {
 	
 	
 	
+	/* 
+	 * Recomputes the player's view distance from the world's current cap,
+	 * the client's own setting and how much outbound data is queued up.
+	 */
+	void
+	player::update_view_distance ()
+	{
+		world *w = this->curr_world;
+		if (!w)
+			return;
+		
+		auto& cfg = this->srv.get_config ();
+		int max_vd = w->max_view_distance ();
+		
+		// back off while the client can not keep up with what we send it, and
+		// slowly recover once the backlog is gone.
+		int budget = cfg.player_send_budget * 1024;
+		if (this->out_bytes > budget)
+			{
+				if (this->send_cap > cfg.min_view_distance)
+					-- this->send_cap;
+				this->send_calm_checks = 0;
+			}
+		else if (this->out_bytes < (budget / 4))
+			{
+				if (this->send_cap < max_vd && ++ this->send_calm_checks >= 5)
+					{
+						++ this->send_cap;
+						this->send_calm_checks = 0;
+					}
+			}
+		if (this->send_cap > max_vd)
+			this->send_cap = max_vd;
+		
+		int vd = std::min (w->get_view_distance (), this->send_cap);
+		int client_vd = this->client_view_dist.load ();
+		if (client_vd > 0)
+			vd = std::min (vd, client_vd);
+		if (vd < cfg.min_view_distance)
+			vd = cfg.min_view_distance;
+		
+		if (vd != this->view_dist.load ())
+			{
+				this->view_dist = vd;
+				this->need_new_chunks = true;
+			}
+	}
+	
+	
+	
 	void
 	player::update_home_chunk ()
 	{
@@ -1470,8 +1797,8 @@ namespace hCraft {
 		chunk_pos pl_pos = pl->pos;
 		
 		return (
-			(utils::iabs (me_pos.x - pl_pos.x) <= player::chunk_radius ()) &&
-			(utils::iabs (me_pos.z - pl_pos.z) <= player::chunk_radius ()));
+			(utils::iabs (me_pos.x - pl_pos.x) <= pl->chunk_radius ()) &&
+			(utils::iabs (me_pos.z - pl_pos.z) <= pl->chunk_radius ()));
 	}
 	
 	
@@ -1770,133 +2097,162 @@ namespace hCraft {
 	bool
 	player::load_data ()
 	{
+		struct login_data
 		{
-			soci::session sql (this->get_server ().sql_pool ());
-			
-			if (sqlops::player_count (sql) == 0)
-				{
-					this->message ("§4Congratulations§c!");
-					this->message ("§cYou are the first player to log in§7, §cand thus you have been");
-					this->message ("§cgiven the highest rank and have been granted §4operator §cstatus§7.");
-					
-					this->op = true;
-					this->rnk.set (("@" + this->get_server ().get_groups ().highest ()->name).c_str (),
-						this->get_server ().get_groups ());
-				}
-			
-			this->log_last = std::time (nullptr);
-			
+			int player_count;
+			bool found;
 			sqlops::player_info pd;
-			bool found_player = false;
-			try
-				{
-					found_player = sqlops::player_data (sql, this->username, this->srv, pd);
-				}
-			catch (const std::exception& ex)
-				{
-					log (LT_ERROR) << "Failed to load player data! (\"" << this->username << ") [" << ex.what () << "]" << std::endl;
-					return false;
-				}
-			
-			// common fields
-			pd.last_login = this->log_last;
-			pd.ip.assign (this->ip);
-			
-			if (found_player)
-				{ 
-					if (pd.banned)
-						{
-							this->kick ("§c[ §4You are banned from this server §c]");
-							return true;
-						}
-					else if (sqlops::is_ip_banned (sql, this->ip))
-						{
-							this->kick ("§c[ §4You are §5IP§c-§4banned from this server §c]");
-							return true;
-						}
-					
-					// modify some fields
-					if (pd.login_count == 0)
-						pd.first_login = std::time (nullptr);
-					if (pd.name.compare (this->get_username ()) != 0)
-						{
-							// can happen
-							pd.name.assign (this->get_username ());
-							pd.nick.assign (this->get_username ());
-						}
-						
-					++ pd.login_count;
-					this->dbid = pd.id;
-				}
-			else
-				{
-					pd.name.assign (this->username);
-					pd.nick = pd.name;
-					pd.op = this->op;
-					pd.rnk = this->op ? this->rnk : this->srv.get_groups ().default_rank;
-					pd.blocks_destroyed = pd.blocks_created = pd.messages_sent = 0;
-					pd.first_login = std::time (nullptr);
-					pd.login_count = 1;
-					pd.balance = 0.0;
-					pd.banned = false;
-				}
-			
-			this->rnk = pd.rnk;
-			std::strcpy (this->nick, pd.nick.c_str ());
-			this->op = pd.op;
-			this->bl_destroyed = pd.blocks_destroyed;
-			this->bl_created = pd.blocks_created;
-			this->msgs_sent = pd.messages_sent;
-			this->log_first = pd.first_login;
-			this->log_count = pd.login_count;
-			this->bal = pd.balance;
-			this->banned = pd.banned;
-			
-			// save to db
-			try
-				{
-					sqlops::save_player_data (sql, this->username, this->srv, pd);
-					if (!found_player)
+			bool ip_banned;
+			bool has_logout;
+			sqlops::logout_info logout;
+		};
+		
+		sql_store& store = this->srv.get_sql_store ();
+		bool load_prev_pos = this->srv.get_config ().load_prev_pos;
+		
+		// queries go through the server's sql store, so that they see the
+		// record saved when the player last logged out, even if it has not
+		// been written yet.
+		login_data ld;
+		try
+			{
+				std::string name = this->username;
+				std::string ip = this->ip;
+				server *srv = &this->srv;
+				ld = store.call<login_data> (
+					[name, ip, srv, load_prev_pos] (soci::session& sql) -> login_data
 						{
-							this->dbid = sqlops::player_id (sql, this->username);
-						}
-				}
-			catch (const std::exception& ex)
-				{
-					log (LT_ERROR) << "Failed to save player data! (\"" << this->username << ") [" << ex.what () << "]" << std::endl;
-					this->message ("§c * §4Failed to save player data§c.");
-				}
-			
-			// load previous position
-			if (this->srv.get_config ().load_prev_pos)
-				{
-					std::string world;
-					double pos_x, pos_y, pos_z, pos_r, pos_l;
-					int gm;
+							login_data ld;
+							ld.player_count = sqlops::player_count (sql);
+							ld.found = sqlops::player_data (sql, name.c_str (), *srv, ld.pd);
+							ld.ip_banned = ld.found && sqlops::is_ip_banned (sql, ip.c_str ());
+							ld.has_logout = false;
+							if (load_prev_pos)
+								{
+									try
+										{
+											ld.has_logout = sqlops::logout_data (sql, name.c_str (), ld.logout);
+										}
+									catch (const std::exception& ex)
+										{ }
+								}
+							return ld;
+						}).get ();
+			}
+		catch (const std::exception& ex)
+			{
+				log (LT_ERROR) << "Failed to load player data! (\"" << this->username << ") [" << ex.what () << "]" << std::endl;
+				return false;
+			}
+		
+		if (ld.player_count == 0)
+			{
+				this->message ("§4Congratulations§c!");
+				this->message ("§cYou are the first player to log in§7, §cand thus you have been");
+				this->message ("§cgiven the highest rank and have been granted §4operator §cstatus§7.");
 				
-					try
-						{
-							sql << "SELECT world,pos_x,pos_y,pos_z,pos_r,pos_l,gm FROM `player-logout-data` WHERE `name`='" << this->get_username () << "'",
-								soci::into (world), soci::into (pos_x), soci::into (pos_y),
-								soci::into (pos_z), soci::into (pos_r), soci::into (pos_l), 
-								soci::into (gm);
-						}
-					catch (const std::exception& ex)
-						{ }
+				this->op = true;
+				this->rnk.set (("@" + this->get_server ().get_groups ().highest ()->name).c_str (),
+					this->get_server ().get_groups ());
+			}
+		
+		this->log_last = std::time (nullptr);
+		
+		sqlops::player_info& pd = ld.pd;
+		bool found_player = ld.found;
+		
+		// common fields
+		pd.last_login = this->log_last;
+		pd.ip.assign (this->ip);
+		
+		if (found_player)
+			{ 
+				if (pd.banned)
+					{
+						this->kick ("§c[ §4You are banned from this server §c]");
+						return true;
+					}
+				else if (ld.ip_banned)
+					{
+						this->kick ("§c[ §4You are §5IP§c-§4banned from this server §c]");
+						return true;
+					}
+				
+				// modify some fields
+				if (pd.login_count == 0)
+					pd.first_login = std::time (nullptr);
+				if (pd.name.compare (this->get_username ()) != 0)
+					{
+						// can happen
+						pd.name.assign (this->get_username ());
+						pd.nick.assign (this->get_username ());
+					}
 					
-					entity_pos last_pos = {pos_x, pos_y, pos_z, (float)pos_r, (float)pos_l, true};
-					this->curr_world = this->srv.get_worlds ().find (world.c_str ());
-					if (this->curr_world)
-						{
-							this->pos = last_pos;
-							this->curr_gamemode = (pd.login_count == 1) ? (gamemode_type)this->curr_world->def_gm : ((gm == 1) ? GT_CREATIVE : GT_SURVIVAL);
-						}
-					else
-						this->curr_gamemode = (gamemode_type)this->srv.get_main_world ()->def_gm;
-				}
-			else
-				this->curr_gamemode = (gamemode_type)this->srv.get_main_world ()->def_gm;
-		}
+				++ pd.login_count;
+				this->dbid = pd.id;
+			}
+		else
+			{
+				pd.name.assign (this->username);
+				pd.nick = pd.name;
+				pd.op = this->op;
+				pd.rnk = this->op ? this->rnk : this->srv.get_groups ().default_rank;
+				pd.blocks_destroyed = pd.blocks_created = pd.messages_sent = 0;
+				pd.first_login = std::time (nullptr);
+				pd.login_count = 1;
+				pd.balance = 0.0;
+				pd.banned = false;
+			}
+		
+		this->rnk = pd.rnk;
+		std::strcpy (this->nick, pd.nick.c_str ());
+		this->op = pd.op;
+		this->bl_destroyed = pd.blocks_destroyed;
+		this->bl_created = pd.blocks_created;
+		this->msgs_sent = pd.messages_sent;
+		this->log_first = pd.first_login;
+		this->log_count = pd.login_count;
+		this->bal = pd.balance;
+		this->banned = pd.banned;
+		
+		// save to db (new players need their database ID right away)
+		if (found_player)
+			store.save_player (pd);
+		else
+			{
+				try
+					{
+						std::string name = this->username;
+						server *srv = &this->srv;
+						sqlops::player_info info = pd;
+						this->dbid = store.call<int> (
+							[name, srv, info] (soci::session& sql) -> int
+								{
+									sqlops::save_player_data (sql, name.c_str (), *srv, info);
+									return sqlops::player_id (sql, name.c_str ());
+								}).get ();
+					}
+				catch (const std::exception& ex)
+					{
+						log (LT_ERROR) << "Failed to save player data! (\"" << this->username << ") [" << ex.what () << "]" << std::endl;
+						this->message ("§c * §4Failed to save player data§c.");
+					}
+			}
+		
+		// load previous position
+		if (load_prev_pos && ld.has_logout)
+			{
+				this->curr_world = this->srv.get_worlds ().find (ld.logout.world.c_str ());
+				if (this->curr_world)
+					{
+						this->pos = ld.logout.pos;
+						this->curr_gamemode = (pd.login_count == 1) ? (gamemode_type)this->curr_world->def_gm : ((ld.logout.gm == 1) ? GT_CREATIVE : GT_SURVIVAL);
+					}
+				else
+					this->curr_gamemode = (gamemode_type)this->srv.get_main_world ()->def_gm;
+			}
+		else
+			this->curr_gamemode = (gamemode_type)this->srv.get_main_world ()->def_gm;
 		
 		
 		std::string str;
@@ -1907,58 +2263,29 @@ namespace hCraft {
 		return true;
 	}
 	
+	/* 
+	 * Hands a snapshot of the player's record (and position) over to the
+	 * server's sql store, which writes it to the database in the background.
+	 */
 	void
 	player::save_data ()
 	{
 		if (this->pstate != PS_PLAY || !this->logged_in)
 			return;
 		
-		{
-			soci::session sql (this->get_server ().sql_pool ());
-			
-			sqlops::player_info pd;
-			this->player_data (pd);
-			try
-				{
-					sqlops::save_player_data (sql, this->username, this->srv, pd);
-				}
-			catch (const std::exception& ex)
-				{
-					log (LT_ERROR) << "Failed to save player data! (\"" << this->username << ") [" << ex.what () << "]" << std::endl;
-				}
-			
-			// save current position, world, etc...
-			if (this->logged_in && this->curr_world)
-				{
-					int count;
-					sql << "SELECT Count(*) FROM `player-logout-data`", soci::into (count);
-					if (count == 1)
-						{
-							sql.once << "UPDATE `player-logout-data` SET "
-								   "`world`='" << this->curr_world->get_name () << "'"
-								<< ", `pos_x`=" << this->pos.x
-								<< ", `pos_y`=" << this->pos.y
-								<< ", `pos_z`=" << this->pos.z
-								<< ", `pos_r`=" << this->pos.r
-								<< ", `pos_l`=" << this->pos.l
-								<< ", `gm`=" << ((this->curr_gamemode == GT_CREATIVE) ? 1 : 0)
-								<< " WHERE `name`='" << this->get_username () << "'";
-						}
-					else
-						{
-							sql.once << "INSERT INTO `player-logout-data` VALUES ("
-								<< "'" << this->get_username () << "'"
-								<< ", '" << this->curr_world->get_name () << "'"
-								<< ", " << this->pos.x
-								<< ", " << this->pos.y
-								<< ", " << this->pos.z
-								<< ", " << this->pos.r
-								<< ", " << this->pos.l
-								<< ", " << ((this->curr_gamemode == GT_CREATIVE) ? 1 : 0)
-								<< ")";
-						}
-				}
-		}
+		sqlops::player_info pd;
+		this->player_data (pd);
+		
+		if (this->curr_world)
+			{
+				sqlops::logout_info lo;
+				lo.world = this->curr_world->get_name ();
+				lo.pos = this->pos;
+				lo.gm = (this->curr_gamemode == GT_CREATIVE) ? 1 : 0;
+				this->srv.get_sql_store ().save_player (pd, &lo);
+			}
+		else
+			this->srv.get_sql_store ().save_player (pd);
 	}
 	
 	
@@ -1982,9 +2309,14 @@ namespace hCraft {
 		
 		if (modify_sql)
 			{
-				soci::session sql (this->get_server ().sql_pool ());
-				sql.once << "UPDATE `players` SET `nick`='" << nick << "' WHERE `name`='"
-					<< this->get_username () << "'";
+				std::string nstr = nick;
+				std::string name = this->get_username ();
+				this->srv.get_sql_store ().post (
+					[nstr, name] (soci::session& sql)
+						{
+							sql.once << "UPDATE `players` SET `nick`=:nick WHERE `name`=:name",
+								soci::use (nstr), soci::use (name);
+						});
 			}
 	}
 	
@@ -2418,8 +2750,8 @@ namespace hCraft {
 	player::got_known_chunks_for (world *w)
 	{
 		std::lock_guard<std::mutex> wguard {this->world_lock};
-		for (known_chunk kc : this->known_chunks)
-			if (kc.w == w)
+		for (auto& p : this->known_chunks)
+			if (p.second.w == w)
 				return true;
 		
 		return false;
@@ -2504,10 +2836,30 @@ namespace hCraft {
 				this->eating = false;
 			}
 		
-		// stream chunks
-		if (!this->streaming_chunks && (tick_counter % 10 == 0))
-			this->srv.get_thread_pool ().enqueue (
-				[] (void *ptr) { (static_cast<player *> (ptr))->stream_chunks (); }, this);
+		// view distance
+		if (this->tick_counter % 20 == 0)
+			this->update_view_distance ();
+		
+		// keep the database copy of the player's record reasonably fresh
+		if (this->tick_counter % 1200 == 1199)
+			this->save_data ();
+		
+		// stream chunks (more often while chunks are still on their way).
+		// the player may be destroyed before the task runs, so it is looked up
+		// again by ID, under an epoch guard.
+		if (!this->streaming_chunks && (tick_counter % (this->chunks_in_flight ? 2 : 10) == 0))
+			{
+				server *srv = &this->srv;
+				int eid = this->eid;
+				this->srv.get_thread_pool ().enqueue (
+					[srv, eid] (void *)
+						{
+							epoch_guard eg {srv->get_epochs ()};
+							player *pl = srv->player_by_id (eid);
+							if (pl && !pl->is_disconnecting ())
+								pl->stream_chunks ();
+						});
+			}
 		
 		// send time
 		if (this->tick_counter % 40 == 0)
@@ -4578,6 +4930,22 @@ namespace hCraft {
 		return 0;
 	}
 	
+	int
+	player::handle_pl_packet_15 (player *pl, packet_reader reader)
+	{
+		char locale[17];
+		if (reader.read_string (locale, 16) == -1)
+			return -1;
+		
+		int vd = (signed char)reader.read_byte ();
+		
+		// the client's setting is only ever used to lower the view distance,
+		// picked up on the next call to update_view_distance ().
+		pl->client_view_dist = (vd < 2) ? 2 : vd;
+		
+		return 0;
+	}
+	
 	int
 	player::handle_pl_packet_16 (player *pl, packet_reader reader)
 	{
@@ -4632,7 +5000,7 @@ namespace hCraft {
 				handle_packet_xx, handle_pl_packet_0d, handle_pl_packet_0e, handle_packet_xx, // 0x0F
 				
 				handle_pl_packet_10, handle_packet_xx, handle_pl_packet_12, handle_packet_xx, // 0x13
-				handle_packet_xx, handle_packet_xx, handle_pl_packet_16, handle_packet_xx, // 0x17
+				handle_packet_xx, handle_pl_packet_15, handle_pl_packet_16, handle_packet_xx, // 0x17
 				handle_packet_xx, handle_packet_xx, handle_packet_xx, handle_packet_xx, // 0x1B
 				handle_packet_xx, handle_packet_xx, handle_packet_xx, handle_packet_xx, // 0x1F
 				
@@ -4682,103 +5050,22 @@ namespace hCraft {
 					return login_handlers[opcode] (this, reader);
 				
 				case PS_PLAY:
-					if (opcode > 0x40)
-						{
-							this->log (LT_WARNING) << "Got invalid packet from player '" << this->get_username () << "' [play]" << std::endl;
-							return -1;
-						}
-					return play_handlers[opcode] (this, reader);
-				
-				default:
-					return -1;
-			}
-	}
-
-
-
-//----
-	
-	static bool
-	test_packet_00 (packet_reader reader, int length,
-		std::deque<unsigned char *>& equeue)
-	{
-		/* 
-		 * When a client connects, we expect two packets - the handshake packet
-		 * (opcode: 0x00), followed by a request/login start packet
-		 * (dpending on whether the client is trying to login, or check the server's
-		 * status.
-		 */
-		
-		return !equeue.empty ();
-	}
-	
-	static bool
-	test_packet_0e (packet_reader reader, int length,
-		std::deque<unsigned char *>& equeue)
-	{
-		reader.read_byte (); // wid
-		short slot = reader.read_short ();
-		char mbtn  = reader.read_byte ();
-		reader.read_short (); // action number
-		char mode = reader.read_byte ();
-		
-		if (mode == 5)
-			{
-				if (slot == -999 && ((mbtn == 2) || (mbtn == 6)))
-					return true;
-				
-				return false;
-			}			
-		
-		return true;
-	}
-	
-	/* 
-	 * Examines the queue that holds packets pending to be handled by
-	 * appropriate callback methods in-order to conclude whether it is safe
-	 * to handle the packets. 
-	 */
-	bool
-	player::test_packet_chain ()
-	{
-		// if the last packet is different compared to the previous ones,
-		// then consider it as the end of chain.
-		if (this->exec_queue.size () > 1)
-			{
-				int last_op = -1;
-				for (auto itr = this->exec_queue.rbegin (); itr != this->exec_queue.rend (); ++itr)
 					{
-						packet_reader reader {*itr};
-						reader.read_varint (); // skip length
-						
-						if (last_op == -1)
-							last_op = reader.read_varint ();
-						else
+						if (opcode > 0x40)
 							{
-								if (last_op != (int)reader.read_varint ())
-									return true;
+								this->log (LT_WARNING) << "Got invalid packet from player '" << this->get_username () << "' [play]" << std::endl;
+								return -1;
 							}
+						
+						auto start = std::chrono::steady_clock::now ();
+						int ret = play_handlers[opcode] (this, reader);
+						this->srv.packet_times[opcode].observe (start);
+						return ret;
 					}
-			} 
-		
-		// we only test the last packet
-		unsigned char *data = this->exec_queue.back ();
-		this->exec_queue.pop_back ();
-		
-		packet_reader reader {data};
-		int length = reader.read_varint ();
-		
-		bool ret = true;
-		switch (reader.read_varint ())
-			{
-				case 0x0E: ret = test_packet_0e (reader, length, this->exec_queue); break;
-				case 0x10: ret = false; break;
 				
-				case 0x00: ret = test_packet_00 (reader, length, this->exec_queue); break;
+				default:
+					return -1;
 			}
-		
-		this->exec_queue.push_back (data);
-		return ret;
 	}
 }
 
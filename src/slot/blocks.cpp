@@ -432,6 +432,12 @@ namespace hCraft {
 	
 	
 	
+	// info for physics blocks that do not share their ID with a vanilla block,
+	// filled in by block_props::init ().
+	static std::vector<block_info> phblock_list;
+	
+	
+	
 	/* 
 	 * Returns the block_info structure describing the block associated with the
 	 * specified ID number.
@@ -439,32 +445,14 @@ namespace hCraft {
 	block_info*
 	block_info::from_id (unsigned short id)
 	{
-		block_info *binf = nullptr;
 		if (id < block_list.size ())
-			binf = &block_list[id];
+			return &block_list[id];
 		
 		// handle physics blocks
-		if (!binf)
-			{
-				static std::vector<block_info> phblock_list;
-				physics_block *ph = physics_block::from_id (id);
-				if (ph)
-					{
-						// add it to our list if it's not already there
-						if (ph->id () >= (int)phblock_list.size ())
-							phblock_list.resize (ph->id () + 1);
-						if (phblock_list[id].id == 0)
-							{
-								// fill in using the associated vanilla block
-								phblock_list[id] = block_list[ph->vanilla_block ().id];
-								phblock_list[id].id = id;
-							}
-						
-						return &phblock_list[id];
-					}
-			}
+		if (id < phblock_list.size () && phblock_list[id].id == id)
+			return &phblock_list[id];
 		
-		return binf;
+		return nullptr;
 	}
 	
 	/* 
@@ -530,5 +518,112 @@ namespace hCraft {
 			return bl;
 		return itr->second;
 	}
+	
+	
+	
+//----
+	
+	unsigned char block_props::opacity_table[block_props::id_count];
+	unsigned char block_props::luminance_table[block_props::id_count];
+	unsigned char block_props::height_table[block_props::id_count];
+	unsigned char block_props::client_id_table[block_props::id_count];
+	unsigned char block_props::client_meta_table[block_props::id_count];
+	std::bitset<block_props::id_count> block_props::known_set;
+	std::bitset<block_props::id_count> block_props::solid_set;
+	std::bitset<block_props::id_count> block_props::opaque_set;
+	std::bitset<block_props::id_count> block_props::transparent_set;
+	std::bitset<block_props::id_count> block_props::physics_set;
+	std::bitset<block_props::id_count> block_props::neighbour_set;
+	
+	
+	static void
+	_set_props (const block_info& binf, unsigned short id)
+	{
+		block_props::opacity_table[id] = binf.opacity;
+		block_props::luminance_table[id] = binf.luminance;
+		block_props::known_set[id] = true;
+		block_props::solid_set[id] = (binf.state == BS_SOLID);
+		block_props::opaque_set[id] = binf.opaque;
+		block_props::transparent_set[id] = (binf.opacity == 0);
+	}
+	
+	/* 
+	 * (Re)builds the tables from the block list and from the registered
+	 * physics blocks.
+	 */
+	void
+	block_props::init ()
+	{
+		// unknown IDs behave like air
+		for (int id = 0; id < id_count; ++id)
+			{
+				opacity_table[id] = 0;
+				luminance_table[id] = 0;
+			}
+		known_set.reset ();
+		solid_set.reset ();
+		opaque_set.reset ();
+		transparent_set.set ();
+		physics_set.reset ();
+		neighbour_set.reset ();
+		
+		for (const block_info& binf : block_list)
+			if (binf.id < id_count)
+				_set_props (binf, binf.id);
+		
+		// physics blocks take the properties of the vanilla block they are
+		// displayed as.
+		std::vector<block_info> phlist;
+		for (int id = 0; id < id_count; ++id)
+			{
+				physics_block *ph = physics_block::from_id (id);
+				if (!ph)
+					continue;
+				
+				physics_set[id] = true;
+				neighbour_set[id] = ph->affected_by_neighbours ();
+				if (id < (int)block_list.size ())
+					continue;
+				
+				if (id >= (int)phlist.size ())
+					phlist.resize (id + 1);
+				phlist[id] = block_list[ph->vanilla_block ().id];
+				phlist[id].id = id;
+				_set_props (phlist[id], id);
+			}
+		phblock_list.swap (phlist);
+		
+		for (int id = 0; id < id_count; ++id)
+			{
+				height_table[id] = solid_set[id] && opaque_set[id];
+				
+				if (block_info::is_vanilla_id (id))
+					{
+						client_id_table[id] = id & 0xFF;
+						client_meta_table[id] = 0xFF;
+						continue;
+					}
+				
+				physics_block *ph = physics_block::from_id (id);
+				if (ph)
+					{
+						blocki vn = ph->vanilla_block ();
+						client_id_table[id] = vn.id & 0xFF;
+						client_meta_table[id] = vn.meta & 0xF;
+					}
+				else
+					{
+						client_id_table[id] = 0;
+						client_meta_table[id] = 0;
+					}
+			}
+	}
+	
+	
+	// build the vanilla part of the tables as early as possible, so that tools
+	// which never register physics blocks still get valid tables.
+	static struct _block_props_init {
+		_block_props_init () { block_props::init (); }
+	} _block_props_init_inst;
 }
 
@@ -17,6 +17,8 @@
  */
 
 #include "slot/slot.hpp"
+#include "util/nbt.hpp"
+#include "util/utils.hpp"
 
 
 namespace hCraft {
@@ -41,9 +43,10 @@ namespace hCraft {
 	slot_item::slot_item (const slot_item& other)
 	{
 		this->set (other.s_id, other.s_damage, other.s_amount);
-		this->enchants = other.enchants;
-		this->display_name = other.display_name;
-		this->lore = other.lore;
+		this->s_enchants = other.s_enchants;
+		this->s_display_name = other.s_display_name;
+		this->s_lore = other.s_lore;
+		this->s_meta = std::atomic_load (&other.s_meta);
 	}
 	
 	
@@ -55,22 +58,38 @@ namespace hCraft {
 	void
 	slot_item::set_enchants (const enchantment_list& enc)
 	{
-		this->enchants = enc;
+		this->s_enchants = enc;
+		std::atomic_store (&this->s_meta, {});
 	}
 	
 	void
 	slot_item::copy_enchants_from (const slot_item& other)
 	{
-		this->set_enchants (other.enchants);
+		this->set_enchants (other.s_enchants);
+	}
+	
+	void
+	slot_item::set_display_name (const std::string& name)
+	{
+		this->s_display_name = name;
+		std::atomic_store (&this->s_meta, {});
+	}
+	
+	void
+	slot_item::set_lore (const std::vector<std::string>& lore)
+	{
+		this->s_lore = lore;
+		std::atomic_store (&this->s_meta, {});
 	}
 	
 	void
 	slot_item::set (const slot_item& other)
 	{
 		this->set (other.s_id, other.s_damage, other.s_amount);
-		this->copy_enchants_from (other);
-		this->display_name = other.display_name;
-		this->lore = other.lore;
+		this->s_enchants = other.s_enchants;
+		this->s_display_name = other.s_display_name;
+		this->s_lore = other.s_lore;
+		std::atomic_store (&this->s_meta, std::atomic_load (&other.s_meta));
 	}
 	
 	void
@@ -118,6 +137,101 @@ namespace hCraft {
 		
 		
 	
+	static nbt_tag_compound*
+	_build_metadata (const slot_item& item)
+	{
+		nbt_tag_compound *root = new nbt_tag_compound ("");
+		
+		// display
+		if (!item.display_name ().empty () || !item.lore ().empty ())
+			{
+				nbt_tag_compound *display = new nbt_tag_compound ("display");
+				
+				if (!item.display_name ().empty ())
+					{
+						nbt_tag_string *name = new nbt_tag_string ("Name");
+						name->set (item.display_name ());
+						display->add (name);
+					}
+				
+				if (!item.lore ().empty ())
+					{
+						nbt_tag_list *lore = new nbt_tag_list ("Lore", TAG_STRING);
+						for (const std::string& str : item.lore ())
+							{
+								nbt_tag_string *t = new nbt_tag_string ("");
+								t->set (str);
+								lore->add (t);
+							}
+						display->add (lore);
+					}
+				
+				root->add (display);
+			}
+		
+		// enchantments
+		nbt_tag_list *ench_list = new nbt_tag_list ("ench", TAG_COMPOUND);
+		for (enchantment ench : item.enchants ())
+			{
+				nbt_tag_compound *t = new nbt_tag_compound ("");
+				
+				nbt_tag_short *t_id = new nbt_tag_short ("id");
+				t_id->value () = ench.eid;
+				t->add (t_id);
+				
+				nbt_tag_short *t_lvl = new nbt_tag_short ("lvl");
+				t_lvl->value () = ench.lvl;
+				t->add (t_lvl);
+				
+				ench_list->add (t);
+			}
+		root->add (ench_list);
+		
+		return root;
+	}
+	
+	/* 
+	 * Returns the item's metadata (name, lore and enchantments) as a gzipped
+	 * NBT compound, the way it is sent in slot data.
+	 */
+	std::shared_ptr<const std::vector<unsigned char>>
+	slot_item::encoded_metadata () const
+	{
+		if (!this->has_metadata ())
+			return nullptr;
+		
+		auto meta = std::atomic_load (&this->s_meta);
+		if (meta)
+			return meta;
+		
+		// the tree only lives for as long as it takes to encode it.
+		std::vector<unsigned char> data;
+		{
+			nbt_arena arena (1024);
+			nbt_arena_scope scope (arena);
+			
+			nbt_tag_compound *root = _build_metadata (*this);
+			data.resize (root->size ());
+			data.resize (root->encode (data.data ()));
+			delete root;
+		}
+		
+		long comp_size = 0;
+		unsigned char *comp = utils::gz_compress (data.data (), data.size (), comp_size);
+		if (!comp) // shouldn't happen
+			return nullptr;
+		
+		auto blob = std::make_shared<std::vector<unsigned char>> (comp, comp + comp_size);
+		delete[] comp;
+		
+		// if another thread got here first, either blob will do.
+		meta = blob;
+		std::atomic_store (&this->s_meta, meta);
+		return meta;
+	}
+	
+	
+	
 	const char*
 	slot_item::name () const
 	{
@@ -212,12 +326,7 @@ namespace hCraft {
 	slot_item&
 	slot_item::operator= (const slot_item& other)
 	{
-		this->set (other.s_id, other.s_damage, other.s_amount);
-		
-		this->enchants = other.enchants;
-		this->display_name = other.display_name;
-		this->lore = other.lore;
-			
+		this->set (other);
 		return *this;
 	}
 }
@@ -0,0 +1,493 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system/metrics.hpp"
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cerrno>
+#include <iomanip>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+
+namespace hCraft {
+	
+	metric_histogram::metric_histogram ()
+	{
+		for (int i = 0; i <= bucket_count; ++i)
+			this->buckets[i] = 0;
+		this->count = 0;
+		this->sum = 0;
+	}
+	
+	
+	
+	/* 
+	 * Estimates the given percentile (0-100) of all recorded samples, in
+	 * microseconds.
+	 */
+	double
+	metric_histogram::percentile (double p) const
+	{
+		unsigned long long total = this->get_count ();
+		if (total == 0)
+			return 0.0;
+		
+		double rank = total * (p / 100.0);
+		unsigned long long seen = 0;
+		for (int b = 0; b <= bucket_count; ++b)
+			{
+				unsigned long long n = this->get_bucket (b);
+				if (n == 0 || (seen + n) < rank)
+					{
+						seen += n;
+						continue;
+					}
+				
+				// interpolate within the bucket
+				double lo = (b == 0) ? 0.0 : (double)bucket_bound (b - 1);
+				double hi = (double)bucket_bound (b);
+				return lo + (hi - lo) * ((rank - seen) / n);
+			}
+		
+		return (double)bucket_bound (bucket_count);
+	}
+	
+	
+	
+	metric_window::metric_window ()
+	{
+		for (int i = 0; i < size; ++i)
+			this->samples[i] = 0;
+		this->pos = 0;
+	}
+	
+	/* 
+	 * Returns the given percentiles (0-100) of the samples currently in the
+	 * window, in microseconds.  All zeroes if nothing has been recorded.
+	 */
+	void
+	metric_window::percentiles (const double *ps, double *out, int count) const
+	{
+		unsigned int total = this->pos.load (std::memory_order_acquire);
+		int n = (total < (unsigned int)size) ? (int)total : size;
+		if (n == 0)
+			{
+				for (int i = 0; i < count; ++i)
+					out[i] = 0.0;
+				return;
+			}
+		
+		std::vector<unsigned int> vals (n);
+		for (int i = 0; i < n; ++i)
+			vals[i] = this->samples[i].load (std::memory_order_relaxed);
+		std::sort (vals.begin (), vals.end ());
+		
+		for (int i = 0; i < count; ++i)
+			{
+				int idx = (int)((ps[i] / 100.0) * (n - 1) + 0.5);
+				if (idx < 0) idx = 0;
+				if (idx >= n) idx = n - 1;
+				out[i] = vals[idx];
+			}
+	}
+	
+	
+	
+//----
+	
+	metrics_writer::~metrics_writer ()
+	{
+		for (family *f : this->families)
+			delete f;
+	}
+	
+	
+	
+	metrics_writer::family&
+	metrics_writer::get_family (const char *name, const char *type,
+		const char *help)
+	{
+		auto itr = this->index.find (name);
+		if (itr != this->index.end ())
+			return *itr->second;
+		
+		family *f = new family ();
+		f->name = name;
+		f->type = type;
+		f->help = help;
+		this->families.push_back (f);
+		this->index[name] = f;
+		return *f;
+	}
+	
+	
+	
+	/* 
+	 * Formats a single label pair, escaping the value as needed.
+	 */
+	std::string
+	metrics_writer::label (const char *key, const std::string& val)
+	{
+		std::string out = key;
+		out.append ("=\"");
+		for (char c : val)
+			{
+				if (c == '\\' || c == '"')
+					out.push_back ('\\');
+				else if (c == '\n')
+					{ out.append ("\\n"); continue; }
+				out.push_back (c);
+			}
+		out.push_back ('"');
+		return out;
+	}
+	
+	static void
+	_put_labels (std::ostringstream& ss, const std::string& labels,
+		const char *extra = nullptr)
+	{
+		if (labels.empty () && !extra)
+			return;
+		
+		ss << '{' << labels;
+		if (extra)
+			{
+				if (!labels.empty ())
+					ss << ',';
+				ss << extra;
+			}
+		ss << '}';
+	}
+	
+	/* 
+	 * Writes out a sample value.  Whole numbers (e.g. byte or chunk counts
+	 * passed as gauges) are printed as integers, and everything else with
+	 * enough digits to survive the round trip, instead of the stream's
+	 * default six significant digits.
+	 */
+	static void
+	_put_value (std::ostringstream& ss, double val)
+	{
+		if (std::isnan (val))
+			ss << "NaN";
+		else if (std::isinf (val))
+			ss << ((val > 0) ? "+Inf" : "-Inf");
+		else if (val == std::floor (val) && std::fabs (val) < 9007199254740992.0)
+			ss << (long long)val;
+		else
+			{
+				std::streamsize prec = ss.precision (17);
+				ss << val;
+				ss.precision (prec);
+			}
+	}
+	
+	void
+	metrics_writer::counter (const char *name, const char *help,
+		const std::string& labels, unsigned long long val)
+	{
+		family& f = this->get_family (name, "counter", help);
+		f.samples << name;
+		_put_labels (f.samples, labels);
+		f.samples << ' ' << val << '\n';
+	}
+	
+	void
+	metrics_writer::gauge (const char *name, const char *help,
+		const std::string& labels, double val)
+	{
+		family& f = this->get_family (name, "gauge", help);
+		f.samples << name;
+		_put_labels (f.samples, labels);
+		f.samples << ' ';
+		_put_value (f.samples, val);
+		f.samples << '\n';
+	}
+	
+	void
+	metrics_writer::histogram (const char *name, const char *help,
+		const std::string& labels, const metric_histogram& h)
+	{
+		family& f = this->get_family (name, "histogram", help);
+		
+		// read the buckets first, so that the count is never lower than the
+		// largest cumulative bucket.
+		unsigned long long cum = 0;
+		unsigned long long counts[metric_histogram::bucket_count + 1];
+		for (int b = 0; b <= metric_histogram::bucket_count; ++b)
+			counts[b] = h.get_bucket (b);
+		unsigned long long sum = h.get_sum ();
+		
+		char le[48];
+		for (int b = 0; b < metric_histogram::bucket_count; ++b)
+			{
+				cum += counts[b];
+				std::snprintf (le, sizeof le, "le=\"%g\"",
+					metric_histogram::bucket_bound (b) / 1000000.0);
+				f.samples << name << "_bucket";
+				_put_labels (f.samples, labels, le);
+				f.samples << ' ' << cum << '\n';
+			}
+		cum += counts[metric_histogram::bucket_count];
+		f.samples << name << "_bucket";
+		_put_labels (f.samples, labels, "le=\"+Inf\"");
+		f.samples << ' ' << cum << '\n';
+		
+		f.samples << name << "_sum";
+		_put_labels (f.samples, labels);
+		f.samples << ' ';
+		_put_value (f.samples, sum / 1000000.0);
+		f.samples << '\n';
+		f.samples << name << "_count";
+		_put_labels (f.samples, labels);
+		f.samples << ' ' << cum << '\n';
+	}
+	
+	
+	
+	std::string
+	metrics_writer::str () const
+	{
+		std::string out;
+		for (family *f : this->families)
+			{
+				out.append ("# HELP ").append (f->name).append (" ")
+					.append (f->help).append ("\n");
+				out.append ("# TYPE ").append (f->name).append (" ")
+					.append (f->type).append ("\n");
+				out.append (f->samples.str ());
+			}
+		return out;
+	}
+	
+	
+	
+//----
+	
+	metrics_exporter::metrics_exporter ()
+	{
+		this->fd = -1;
+		this->running = false;
+	}
+	
+	metrics_exporter::~metrics_exporter ()
+	{
+		this->stop ();
+	}
+	
+	
+	
+	/* 
+	 * Starts listening on @{addr}, which is either "host:port" or
+	 * "unix:/path/to/socket".
+	 */
+	bool
+	metrics_exporter::start (const std::string& addr,
+		std::function<std::string ()> collect, std::string& err)
+	{
+		if (this->running)
+			{ err = "already running"; return false; }
+		
+		if (addr.compare (0, 5, "unix:") == 0)
+			{
+				std::string path = addr.substr (5);
+				struct sockaddr_un sa;
+				if (path.empty () || path.size () >= sizeof sa.sun_path)
+					{ err = "invalid socket path"; return false; }
+				
+				std::memset (&sa, 0, sizeof sa);
+				sa.sun_family = AF_UNIX;
+				std::strcpy (sa.sun_path, path.c_str ());
+				
+				this->fd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+				if (this->fd == -1)
+					{ err = std::strerror (errno); return false; }
+				
+				::unlink (path.c_str ()); // left over from a previous run
+				if (::bind (this->fd, (struct sockaddr *)&sa, sizeof sa) != 0)
+					{
+						err = std::strerror (errno);
+						::close (this->fd);
+						this->fd = -1;
+						return false;
+					}
+				this->unix_path = path;
+			}
+		else
+			{
+				size_t colon = addr.rfind (':');
+				if (colon == std::string::npos)
+					{ err = "expected host:port or unix:path"; return false; }
+				
+				struct sockaddr_in sa;
+				std::memset (&sa, 0, sizeof sa);
+				sa.sin_family = AF_INET;
+				int port = std::atoi (addr.c_str () + colon + 1);
+				if (port <= 0 || port > 65535
+					|| inet_pton (AF_INET, addr.substr (0, colon).c_str (), &sa.sin_addr) != 1)
+					{ err = "invalid address"; return false; }
+				sa.sin_port = htons (port);
+				
+				this->fd = ::socket (AF_INET, SOCK_STREAM, 0);
+				if (this->fd == -1)
+					{ err = std::strerror (errno); return false; }
+				
+				int one = 1;
+				setsockopt (this->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+				if (::bind (this->fd, (struct sockaddr *)&sa, sizeof sa) != 0)
+					{
+						err = std::strerror (errno);
+						::close (this->fd);
+						this->fd = -1;
+						return false;
+					}
+			}
+		
+		if (::listen (this->fd, 8) != 0)
+			{
+				err = std::strerror (errno);
+				this->stop ();
+				return false;
+			}
+		
+		this->collect = collect;
+		this->running = true;
+		this->th = std::thread (std::bind (std::mem_fn (&hCraft::metrics_exporter::main_loop), this));
+		return true;
+	}
+	
+	void
+	metrics_exporter::stop ()
+	{
+		if (this->running)
+			{
+				this->running = false;
+				if (this->th.joinable ())
+					this->th.join ();
+			}
+		
+		if (this->fd != -1)
+			{
+				::close (this->fd);
+				this->fd = -1;
+			}
+		if (!this->unix_path.empty ())
+			{
+				::unlink (this->unix_path.c_str ());
+				this->unix_path.clear ();
+			}
+	}
+	
+	
+	
+	void
+	metrics_exporter::main_loop ()
+	{
+		while (this->running)
+			{
+				struct pollfd pfd;
+				pfd.fd = this->fd;
+				pfd.events = POLLIN;
+				if (::poll (&pfd, 1, 250) <= 0)
+					continue;
+				
+				int cfd = ::accept (this->fd, nullptr, nullptr);
+				if (cfd == -1)
+					continue;
+				
+				this->serve (cfd);
+				::close (cfd);
+			}
+	}
+	
+	static bool
+	_send_all (int fd, const char *data, size_t len)
+	{
+		while (len > 0)
+			{
+				ssize_t n = ::send (fd, data, len, MSG_NOSIGNAL);
+				if (n <= 0)
+					{
+						if (n < 0 && errno == EINTR)
+							continue;
+						return false;
+					}
+				data += n;
+				len -= n;
+			}
+		return true;
+	}
+	
+	void
+	metrics_exporter::serve (int cfd)
+	{
+		// read the request (if any) up to the end of its headers.
+		std::string req;
+		char buf[1024];
+		int wait = 200;
+		while (req.size () < 8192 && req.find ("\r\n\r\n") == std::string::npos)
+			{
+				struct pollfd pfd;
+				pfd.fd = cfd;
+				pfd.events = POLLIN;
+				if (::poll (&pfd, 1, wait) <= 0)
+					break;
+				
+				ssize_t n = ::recv (cfd, buf, sizeof buf, 0);
+				if (n <= 0)
+					break;
+				req.append (buf, n);
+				wait = 1000; // the client is talking, give it time to finish.
+			}
+		
+		if (req.empty ())
+			{
+				std::string body = this->collect ();
+				_send_all (cfd, body.data (), body.size ());
+				return;
+			}
+		
+		std::ostringstream hdr;
+		if (req.compare (0, 4, "GET ") != 0)
+			{
+				hdr << "HTTP/1.0 405 Method Not Allowed\r\nContent-Length: 0\r\n"
+					"Connection: close\r\n\r\n";
+				std::string s = hdr.str ();
+				_send_all (cfd, s.data (), s.size ());
+				return;
+			}
+		
+		std::string body = this->collect ();
+		hdr << "HTTP/1.0 200 OK\r\n"
+			"Content-Type: text/plain; version=0.0.4\r\n"
+			"Content-Length: " << body.size () << "\r\n"
+			"Connection: close\r\n\r\n";
+		std::string s = hdr.str ();
+		if (_send_all (cfd, s.data (), s.size ()))
+			_send_all (cfd, body.data (), body.size ());
+	}
+}
+
@@ -18,9 +18,9 @@
 
 #include "system/packet.hpp"
 #include "world/chunk.hpp"
+#include "world/chunk_kernels.hpp"
 #include "entities/entity.hpp"
 #include "util/utils.hpp"
-#include "util/nbt.hpp"
 #include "player/player.hpp"
 #include "drawing/editstage.hpp"
 #include "util/wordwrap.hpp"
@@ -29,6 +29,7 @@
 #include <cmath>
 #include <sstream>
 #include <string>
+#include <atomic>
 
 #include <cryptopp/queue.h>
 
@@ -319,68 +320,6 @@ namespace hCraft {
 	
 	
 	
-	static nbt_tag_compound*
-	build_slot_metadata (const slot_item& item)
-	{
-		nbt_tag_compound *root = new nbt_tag_compound ("");
-		
-		// display
-		if (!item.display_name.empty () || !item.lore.empty ())
-			{
-				nbt_tag_compound *display = new nbt_tag_compound ("display");
-				
-				if (!item.display_name.empty ())
-					{
-						nbt_tag_string *name = new nbt_tag_string ("Name");
-						name->set (item.display_name);
-						display->add (name);
-					}
-				
-				if (!item.lore.empty ())
-					{
-						nbt_tag_list *lore = new nbt_tag_list ("Lore", TAG_STRING);
-						for (const std::string& str : item.lore)
-							{
-								nbt_tag_string *t = new nbt_tag_string ("");
-								t->set (str);
-								lore->add (t);
-							}
-						display->add (lore);
-					}
-				
-				root->add (display);
-			}
-		
-		// enchantments
-		nbt_tag_list *ench_list = new nbt_tag_list ("ench", TAG_COMPOUND);
-		for (enchantment ench : item.enchants)
-			{
-				nbt_tag_compound *t = new nbt_tag_compound ("");
-				
-				nbt_tag_short *t_id = new nbt_tag_short ("id");
-				t_id->value () = ench.eid;
-				t->add (t_id);
-				
-				nbt_tag_short *t_lvl = new nbt_tag_short ("lvl");
-				t_lvl->value () = ench.lvl;
-				t->add (t_lvl);
-				
-				ench_list->add (t);
-			}
-		root->add (ench_list);
-		
-		return root;
-	}
-	
-	
-	
-	static bool
-	slot_has_metadata (const slot_item& item)
-	{
-		return (!item.enchants.empty () || !item.display_name.empty ()
-			|| !item.lore.empty ());
-	}
-	
 	void
 	packet::put_slot (const slot_item& item)
 	{
@@ -392,27 +331,14 @@ namespace hCraft {
 				this->put_byte ((item.amount () > 64) ? 64 : item.amount ());
 				this->put_short (item.damage ());
 				
-				// enchantments
-				if (!slot_has_metadata (item))
+				// enchantments, name and lore (encoded once per item).
+				auto meta = item.encoded_metadata ();
+				if (!meta)
 					this->put_short (-1);
 				else
 					{
-						nbt_tag_compound *t = build_slot_metadata (item);
-						unsigned char *data = new unsigned char [t->size ()];
-						int s = t->encode (data);
-						delete t;
-						
-						long comp_size = 0;
-						unsigned char *comp = utils::gz_compress (data, s, comp_size);
-						delete[] data;
-						if (!comp) // shouldn't happen
-							this->put_short (-1);
-						else
-							{
-								this->put_short (comp_size);
-								this->put_bytes (comp, comp_size);
-								delete[] comp;
-							}
+						this->put_short (meta->size ());
+						this->put_bytes (meta->data (), meta->size ());
 					}
 			}
 	}
@@ -668,20 +594,9 @@ namespace hCraft {
 			{
 				size += 5;
 				
-				if (slot_has_metadata (item))
-					{
-						// somewhat inefficient.. :X
-						nbt_tag_compound *t = build_slot_metadata (item);
-						unsigned char *data = new unsigned char [t->size ()];
-						int s = t->encode (data);
-						delete t;
-		
-						long comp_size = 0;
-						unsigned char *comp = utils::gz_compress (data, s, comp_size);
-						delete[] data;
-						if (comp)
-							size += comp_size;
-					}
+				auto meta = item.encoded_metadata ();
+				if (meta)
+					size += meta->size ();
 			}
 		
 		return size;
@@ -702,6 +617,25 @@ namespace hCraft {
 	
 	namespace packets {
 		
+		static std::atomic_int chunk_compression_level {Z_BEST_COMPRESSION};
+		
+		/* 
+		 * Gets\sets the zlib level (0-9) used to compress chunk data sent to
+		 * clients.
+		 */
+		int
+		get_chunk_compression_level ()
+			{ return chunk_compression_level.load (); }
+		
+		void
+		set_chunk_compression_level (int level)
+		{
+			if (level < 0) level = 0;
+			else if (level > 9) level = 9;
+			chunk_compression_level.store (level);
+		}
+		
+		
 		namespace play {
 		
 			packet*
@@ -1112,9 +1046,23 @@ namespace hCraft {
 			
 			
 			
-			packet*
-			make_chunk (int x, int z, chunk *och, const std::vector<edit_stage *> es_vec)
+			/* 
+			 * Appends the uncompressed data of a single chunk column, in the format
+			 * used by both Chunk Data and Map Chunk Bulk packets, to @{out}, and
+			 * returns the column's primary and add bitmaps.
+			 * 
+			 * If @{ground_up} is true, all non-empty sections are sent along with
+			 * the chunk's biome array. Otherwise, only the sections specified in
+			 * @{sections} are sent (empty ones included).
+			 */
+			static void
+			_chunk_column_data (int x, int z, chunk *och,
+				const std::vector<edit_stage *>& es_vec, bool ground_up,
+				unsigned short sections, std::vector<unsigned char>& out,
+				unsigned short& primary_out, unsigned short& add_out)
 			{
+				static subchunk empty_sub;
+				
 				chunk *ch = och;
 				for (edit_stage *es : es_vec)
 					if (es->mod_count_at (x, z) > 0)
@@ -1128,13 +1076,19 @@ namespace hCraft {
 				int data_size = 0, n = 0, i;
 				unsigned short primary_bitmap = 0, add_bitmap = 0;
 				int primary_count = 0;
+				subchunk *subs[16];
 				
 				// create bitmaps and calculate the size of the uncompressed data array.
-				data_size += 256; // biome array
+				if (ground_up)
+					data_size += 256; // biome array
 				for (i = 0; i < 16; ++i)
 					{
 						subchunk *sub = ch->get_sub (i);
-						if (sub && !sub->all_air ())
+						if (!ground_up && (sections & (1 << i)) && (!sub || sub->all_air ()))
+							sub = &empty_sub;
+						subs[i] = sub;
+						
+						if (ground_up ? (sub && !sub->all_air ()) : (sections & (1 << i)))
 							{
 								primary_bitmap |= (1 << i);
 								++ primary_count;
@@ -1147,7 +1101,9 @@ namespace hCraft {
 							}
 					}
 				
-				unsigned char *data = new unsigned char[data_size];
+				size_t base = out.size ();
+				out.resize (base + data_size);
+				unsigned char *data = out.data () + base;
 				
 				// fill the array.
 				
@@ -1162,7 +1118,18 @@ namespace hCraft {
 							// ID values that the vanilla client does NOT recognize. So we replace
 							// them with the their suitable equivalents.
 							
-							subchunk *sub = ch->get_sub (i);
+							subchunk *sub = subs[i];
+							if (!sub->add)
+								{
+									chunk_kernels::translate_ids (sub->ids, sub->meta, sub->custom,
+										block_props::client_id_table, block_props::client_meta_table,
+										data + n, data + (primary_count << 12) + (n >> 1));
+									n += 4096;
+									continue;
+								}
+							
+							// IDs with their upper 4 bits set are rare enough to be translated
+							// one at a time.
 							unsigned char *ids = sub->ids;
 							unsigned char *metas = sub->meta;
 							unsigned int *customs = sub->custom;
@@ -1232,45 +1199,76 @@ namespace hCraft {
 				
 				for (i = 0; i < 16; ++i)
 					if (primary_bitmap & (1 << i))
-						{ std::memcpy (data + n, ch->get_sub (i)->blight, 2048);
+						{ std::memcpy (data + n, subs[i]->blight, 2048);
 							n += 2048; }
 				
 				for (i = 0; i < 16; ++i)
 					if (primary_bitmap & (1 << i))
-						{ std::memcpy (data + n, ch->get_sub (i)->slight, 2048);
+						{ std::memcpy (data + n, subs[i]->slight, 2048);
 							n += 2048; }
 				
 				for (i = 0; i < 16; ++i)
 					if (add_bitmap & (1 << i))
-						{ std::memcpy (data + n, ch->get_sub (i)->add, 2048);
+						{ std::memcpy (data + n, subs[i]->add, 2048);
 							n += 2048; }
 				
-				std::memcpy (data + n, ch->get_biome_array (), 256);
-				n += 256;
+				if (ground_up)
+					{
+						std::memcpy (data + n, ch->get_biome_array (), 256);
+						n += 256;
+					}
+				
+				if (ch != och)
+					delete ch;
 				
-				// compress.
-				unsigned long compressed_size = compressBound (data_size);
+				primary_out = primary_bitmap;
+				add_out = add_bitmap;
+			}
+			
+			/* 
+			 * Compresses column data at the chunk compression level into a newly
+			 * allocated array, or returns null on failure.
+			 */
+			static unsigned char*
+			_compress_chunk_data (const std::vector<unsigned char>& data,
+				unsigned long& compressed_size)
+			{
+				compressed_size = compressBound (data.size ());
 				unsigned char *compressed = new unsigned char[compressed_size];
-				if (compress2 (compressed, &compressed_size, data, data_size,
-					Z_BEST_COMPRESSION) != Z_OK)
+				if (compress2 (compressed, &compressed_size, data.data (), data.size (),
+					chunk_compression_level.load ()) != Z_OK)
 					{
 						delete[] compressed;
-						delete[] data;
 						return nullptr;
 					}
 				
-				delete[] data;
-				if (ch != och)
-					delete ch;
+				return compressed;
+			}
+			
+			static packet*
+			_make_chunk (int x, int z, chunk *ch,
+				const std::vector<edit_stage *>& es_vec, bool ground_up,
+				unsigned short sections)
+			{
+				std::vector<unsigned char> data;
+				unsigned short primary_bitmap, add_bitmap;
+				_chunk_column_data (x, z, ch, es_vec, ground_up, sections, data,
+					primary_bitmap, add_bitmap);
+				
+				unsigned long compressed_size;
+				unsigned char *compressed = _compress_chunk_data (data, compressed_size);
+				if (!compressed)
+					return nullptr;
 				
 				// and finally, create the packet.
-				packet* pack = new packet (20 + compressed_size);
+				// (the length prefix can take up to 3 bytes)
+				packet* pack = new packet (21 + compressed_size);
 				
 				pack->put_varint (18 + compressed_size);
 				pack->put_varint (0x21);
 				pack->put_int (x);
 				pack->put_int (z);
-				pack->put_bool (true); // ground-up continuous
+				pack->put_bool (ground_up); // ground-up continuous
 				pack->put_short (primary_bitmap);
 				pack->put_short (add_bitmap);
 				pack->put_int (compressed_size);
@@ -1280,6 +1278,12 @@ namespace hCraft {
 				return pack;
 			}
 			
+			packet*
+			make_chunk (int x, int z, chunk *ch, const std::vector<edit_stage *> es_vec)
+			{
+				return _make_chunk (x, z, ch, es_vec, true, 0xFFFF);
+			}
+			
 			packet*
 			make_chunk (int x, int z, chunk *ch)
 			{
@@ -1287,6 +1291,56 @@ namespace hCraft {
 				return packets::play::make_chunk (x, z, ch, vec);
 			}
 			
+			packet*
+			make_chunk_sections (int x, int z, chunk *ch, unsigned short sections,
+				const std::vector<edit_stage *>& es_vec)
+			{
+				return _make_chunk (x, z, ch, es_vec, false, sections);
+			}
+			
+			/* 
+			 * Packs several full chunk columns into one Map Chunk Bulk packet, so
+			 * that they all share a single deflate stream.  Sky light is always
+			 * included.
+			 */
+			packet*
+			make_chunk_bulk (const std::vector<chunk_column>& cols,
+				const std::vector<edit_stage *>& es_vec)
+			{
+				std::vector<unsigned char> data;
+				std::vector<unsigned short> bitmaps (cols.size () * 2);
+				data.reserve (cols.size () * 65536);
+				for (size_t i = 0; i < cols.size (); ++i)
+					_chunk_column_data (cols[i].x, cols[i].z, cols[i].ch, es_vec, true,
+						0xFFFF, data, bitmaps[i * 2], bitmaps[i * 2 + 1]);
+				
+				unsigned long compressed_size;
+				unsigned char *compressed = _compress_chunk_data (data, compressed_size);
+				if (!compressed)
+					return nullptr;
+				
+				int body_size = 8 + compressed_size + (12 * cols.size ());
+				packet *pack = new packet (3 + body_size);
+				
+				pack->put_varint (body_size);
+				pack->put_varint (0x26);
+				pack->put_short (cols.size ());
+				pack->put_int (compressed_size);
+				pack->put_bool (true); // sky light sent
+				pack->put_bytes (compressed, compressed_size);
+				delete[] compressed;
+				
+				for (size_t i = 0; i < cols.size (); ++i)
+					{
+						pack->put_int (cols[i].x);
+						pack->put_int (cols[i].z);
+						pack->put_short (bitmaps[i * 2]);
+						pack->put_short (bitmaps[i * 2 + 1]);
+					}
+				
+				return pack;
+			}
+			
 			packet*
 			make_empty_chunk (int x, int z)
 			{
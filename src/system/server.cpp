@@ -20,6 +20,8 @@
 #include "util/utils.hpp"
 #include "physics/blocks/physics_block.hpp"
 #include "util/config.hpp"
+#include "util/codec.hpp"
+#include "world/providers/hwprovider.hpp"
 #include <memory>
 #include <fstream>
 #include <cstring>
@@ -28,7 +30,12 @@
 #include <sys/stat.h>
 #include <algorithm>
 #include <event2/thread.h>
+#ifdef HCRAFT_USE_MYSQL
 #include <soci/mysql/soci-mysql.h>
+#endif
+#ifdef HCRAFT_USE_SQLITE
+#include <soci/sqlite3/soci-sqlite3.h>
+#endif
 
 #include <iostream> // DEBUG
 
@@ -78,6 +85,7 @@ namespace hCraft {
 	server::server (logger &log)
 		: log (log), 
 			spool (SQL_POOL_SIZE),
+			sstore (*this, spool),
 			perms (),
 			groups (perms),
 			global_physics (*this)
@@ -128,7 +136,12 @@ namespace hCraft {
 			std::bind (std::mem_fn (&hCraft::server::init_irc), this),
 			std::bind (std::mem_fn (&hCraft::server::destroy_irc), this)));
 		
+		this->inits.push_back (initializer (
+			std::bind (std::mem_fn (&hCraft::server::init_metrics), this),
+			std::bind (std::mem_fn (&hCraft::server::destroy_metrics), this)));
+		
 		this->running = false;
+		this->sql_open = false;
 		this->ircc = nullptr;
 	}
 	
@@ -237,21 +250,28 @@ namespace hCraft {
 		if (!srv.is_running () || srv.is_shutting_down ())
 			return;
 		
-		// destroy all players that have been idle (no I/O) for over a minute.
-		std::lock_guard<std::mutex> guard {srv.player_lock};
-		for (auto itr = std::begin (srv.to_destroy); itr != std::end (srv.to_destroy);)
-			{
-				player *pl = *itr;
-				if (((std::chrono::system_clock::now () - pl->disconnection_time ()) >
-					std::chrono::seconds (30)) && !pl->is_reading () && !pl->is_writing ()
-					&& !pl->is_handling_packets ())
-					{
-						itr = srv.to_destroy.erase (itr);
-						delete pl;
-					}
-				else
-					++ itr;
-			}
+		// destroy all players that have no I/O or tasks left.  the player's ID
+		// has been released on disconnect, so no new lookup can find it, but
+		// a thread might still be using a pointer it got earlier - the actual
+		// deletion is deferred until that is no longer possible.
+		{
+			std::lock_guard<std::mutex> guard {srv.player_lock};
+			for (auto itr = std::begin (srv.to_destroy); itr != std::end (srv.to_destroy);)
+				{
+					player *pl = *itr;
+					if (!pl->is_reading () && !pl->is_writing () && !pl->is_handling_packets ()
+						&& !pl->is_streaming_chunks ())
+						{
+							itr = srv.to_destroy.erase (itr);
+							srv.deregister_entity (pl);
+							srv.epochs.retire ([pl] () { delete pl; });
+						}
+					else
+						++ itr;
+				}
+		}
+		
+		srv.epochs.collect ();
 	}
 	
 	/* 
@@ -364,12 +384,7 @@ namespace hCraft {
 	int
 	server::register_entity (entity *e)
 	{
-		std::lock_guard<std::mutex> guard {this->id_lock};
-		int id = this->entity_id_counter ++;
-		if (this->entity_id_counter < 0)
-			this->entity_id_counter = 0; // overflow.
-		this->entity_map[id] = e;
-		return id;
+		return this->entity_map.insert (e);
 	}
 	
 	/* 
@@ -384,10 +399,7 @@ namespace hCraft {
 	void
 	server::deregister_entity (int eid)
 	{
-		std::lock_guard<std::mutex> guard {this->id_lock};
-		auto itr = this->entity_map.find (eid);
-		if (itr != this->entity_map.end ())
-			this->entity_map.erase (itr);
+		this->entity_map.erase (eid);
 	}
 	
 	
@@ -397,10 +409,7 @@ namespace hCraft {
 	entity*
 	server::entity_by_id (int id)
 	{
-		auto itr = this->entity_map.find (id);
-		if (itr == this->entity_map.end ())
-			return nullptr;
-		return itr->second;
+		return this->entity_map.find (id);
 	}
 	
 	player*
@@ -417,16 +426,10 @@ namespace hCraft {
 	bool
 	server::register_world (world *w)
 	{
-		std::lock_guard<std::mutex> guard {this->id_lock};
-		int id = this->world_id_counter ++;
-		if (this->world_id_counter < 0)
-			this->world_id_counter = 0; // overflow.
-		this->world_map[id] = w;
-		
+		int id = this->world_map.insert (w);
 		if (!this->get_worlds ().add (w))
 			{
 				this->world_map.erase (id);
-				-- this->world_id_counter;
 				return false;
 			}
 		
@@ -437,19 +440,13 @@ namespace hCraft {
 	void
 	server::deregister_world (world *w)
 	{
-		std::lock_guard<std::mutex> guard {this->id_lock};
-		auto itr = this->world_map.find (w->id);
-		if (itr != this->world_map.end ())
-			this->world_map.erase (itr);
+		this->world_map.erase (w->id);
 	}
 	
 	world*
 	server::world_by_id (int id)
 	{
-		auto itr = this->world_map.find (id);
-		if (itr == this->world_map.end ())
-			return nullptr;
-		return itr->second;
+		return this->world_map.find (id);
 	}
 	
 	
@@ -602,6 +599,9 @@ namespace hCraft {
 		out.self_highlight_color = 'a';
 		out.name_highlight_color = 'd';
 		
+		out.db_backend = "mysql";
+		out.db_file = "data/hCraft.db";
+		out.db_flush_interval = 10;
 		out.db_name = "hCraftDB1";
 		out.db_user = "root";
 		out.db_pass = "";
@@ -614,6 +614,23 @@ namespace hCraft {
 		out.irc_chan = "#channel";
 		out.irc_nick = "hCraftBot";
 		
+		out.chunk_codec = CODEC_ZLIB;
+		out.chunk_level = 6;
+		out.chunk_bg_codec = CODEC_ZLIB;
+		out.packet_level = 6;
+		
+		out.world_chunk_budget = 0;
+		out.total_chunk_budget = 0;
+		
+		out.view_distance = 5;
+		out.min_view_distance = 2;
+		out.tick_budget = 80;
+		out.player_send_budget = 512;
+		out.chunk_rate = 50;
+		out.chunk_bulk_size = 256;
+		
+		out.metrics_listen = "";
+		
 		out.dcmds.clear ();
 		out.dcmds.insert ("realm");
 		out.dcmds.insert ("money");
@@ -660,6 +677,9 @@ namespace hCraft {
 		{
 			cfg::group *grp_sql = new cfg::group ();
 		
+			grp_sql->add_string ("backend", in.db_backend);
+			grp_sql->add_string ("file", in.db_file);
+			grp_sql->add_integer ("flush-interval", in.db_flush_interval);
 			grp_sql->add_string ("database", in.db_name);
 			grp_sql->add_string ("user", in.db_user);
 			grp_sql->add_string ("pass", in.db_pass);
@@ -681,6 +701,47 @@ namespace hCraft {
 			root.add ("irc", grp_irc);
 		}
 		
+		{
+			cfg::group *grp_compression = new cfg::group ();
+			
+			grp_compression->add_string ("world-codec", codec::name (in.chunk_codec));
+			grp_compression->add_integer ("world-level", in.chunk_level);
+			grp_compression->add_string ("world-background-codec", codec::name (in.chunk_bg_codec));
+			grp_compression->add_integer ("packet-level", in.packet_level);
+			
+			root.add ("compression", grp_compression);
+		}
+		
+		{
+			cfg::group *grp_memory = new cfg::group ();
+			
+			grp_memory->add_integer ("world-chunk-budget", in.world_chunk_budget);
+			grp_memory->add_integer ("total-chunk-budget", in.total_chunk_budget);
+			
+			root.add ("memory", grp_memory);
+		}
+		
+		{
+			cfg::group *grp_streaming = new cfg::group ();
+			
+			grp_streaming->add_integer ("view-distance", in.view_distance);
+			grp_streaming->add_integer ("min-view-distance", in.min_view_distance);
+			grp_streaming->add_integer ("tick-budget", in.tick_budget);
+			grp_streaming->add_integer ("player-send-budget", in.player_send_budget);
+			grp_streaming->add_integer ("chunk-rate", in.chunk_rate);
+			grp_streaming->add_integer ("chunk-bulk-size", in.chunk_bulk_size);
+			
+			root.add ("streaming", grp_streaming);
+		}
+		
+		{
+			cfg::group *grp_metrics = new cfg::group ();
+			
+			grp_metrics->add_string ("listen", in.metrics_listen);
+			
+			root.add ("metrics", grp_metrics);
+		}
+		
 		{
 			cfg::array *arr_dcmds = new cfg::array ();
 			
@@ -893,6 +954,38 @@ namespace hCraft {
 		long long int num;
 		bool error = false;
 		
+		// backend
+		if (grp_sql->try_get_string ("backend", str))
+			{
+				if (str == "mysql" || str == "sqlite")
+					out.db_backend = str;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"sql\":" << std::endl;
+						log (LT_INFO) << " - \"backend\" must be either \"mysql\" or \"sqlite\"." << std::endl;
+						error = true;
+					}
+			}
+		
+		// database file (sqlite)
+		if (grp_sql->try_get_string ("file", str) && !str.empty ())
+			out.db_file = str;
+		
+		// write-behind interval
+		if (grp_sql->try_get_integer ("flush-interval", num))
+			{
+				if (num >= 1 && num <= 600)
+					out.db_flush_interval = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"sql\":" << std::endl;
+						log (LT_INFO) << " - \"flush-interval\" must be in the range of 1-600 (seconds)." << std::endl;
+						error = true;
+					}
+			}
+		
 		// database
 		if (grp_sql->try_get_string ("database", str))
 			{
@@ -1022,6 +1115,210 @@ namespace hCraft {
 			}
 	}
 	
+	static void
+	_cfg_read_compression_grp (logger& log, cfg::group *grp_compression, server_config& out)
+	{
+		std::string str;
+		long long int num;
+		bool error = false;
+		int id;
+		
+		// world codec
+		if (grp_compression->try_get_string ("world-codec", str))
+			{
+				if ((id = codec::from_name (str.c_str ())) != -1 && codec::available (id))
+					out.chunk_codec = id;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"compression\":" << std::endl;
+						log (LT_INFO) << " - \"world-codec\" is not a supported codec." << std::endl;
+						error = true;
+					}
+			}
+		
+		// world level
+		if (grp_compression->try_get_integer ("world-level", num))
+			{
+				if (num >= 0 && num <= 9)
+					out.chunk_level = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"compression\":" << std::endl;
+						log (LT_INFO) << " - \"world-level\" must be in the range of 0-9." << std::endl;
+						error = true;
+					}
+			}
+		
+		// world background codec
+		if (grp_compression->try_get_string ("world-background-codec", str))
+			{
+				if ((id = codec::from_name (str.c_str ())) != -1 && codec::available (id))
+					out.chunk_bg_codec = id;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"compression\":" << std::endl;
+						log (LT_INFO) << " - \"world-background-codec\" is not a supported codec." << std::endl;
+						error = true;
+					}
+			}
+		
+		// packet level
+		if (grp_compression->try_get_integer ("packet-level", num))
+			{
+				if (num >= 0 && num <= 9)
+					out.packet_level = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"compression\":" << std::endl;
+						log (LT_INFO) << " - \"packet-level\" must be in the range of 0-9." << std::endl;
+						error = true;
+					}
+			}
+	}
+	
+	static void
+	_cfg_read_memory_grp (logger& log, cfg::group *grp_memory, server_config& out)
+	{
+		long long int num;
+		bool error = false;
+		
+		// per-world chunk budget
+		if (grp_memory->try_get_integer ("world-chunk-budget", num))
+			{
+				if (num >= 0 && num <= 1048576)
+					out.world_chunk_budget = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"memory\":" << std::endl;
+						log (LT_INFO) << " - \"world-chunk-budget\" must be in the range of 0-1048576 (MB)." << std::endl;
+						error = true;
+					}
+			}
+		
+		// global chunk budget
+		if (grp_memory->try_get_integer ("total-chunk-budget", num))
+			{
+				if (num >= 0 && num <= 1048576)
+					out.total_chunk_budget = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"memory\":" << std::endl;
+						log (LT_INFO) << " - \"total-chunk-budget\" must be in the range of 0-1048576 (MB)." << std::endl;
+						error = true;
+					}
+			}
+	}
+	
+	static void
+	_cfg_read_streaming_grp (logger& log, cfg::group *grp_streaming, server_config& out)
+	{
+		long long int num;
+		bool error = false;
+		
+		// view distance
+		if (grp_streaming->try_get_integer ("view-distance", num))
+			{
+				if (num >= 2 && num <= 15)
+					out.view_distance = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"streaming\":" << std::endl;
+						log (LT_INFO) << " - \"view-distance\" must be in the range of 2-15 (chunks)." << std::endl;
+						error = true;
+					}
+			}
+		
+		// minimum view distance
+		if (grp_streaming->try_get_integer ("min-view-distance", num))
+			{
+				if (num >= 1 && num <= 15)
+					out.min_view_distance = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"streaming\":" << std::endl;
+						log (LT_INFO) << " - \"min-view-distance\" must be in the range of 1-15 (chunks)." << std::endl;
+						error = true;
+					}
+			}
+		
+		// tick budget
+		if (grp_streaming->try_get_integer ("tick-budget", num))
+			{
+				if (num >= 1 && num <= 1000)
+					out.tick_budget = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"streaming\":" << std::endl;
+						log (LT_INFO) << " - \"tick-budget\" must be in the range of 1-1000 (% of a tick)." << std::endl;
+						error = true;
+					}
+			}
+		
+		// per-player outbound budget
+		if (grp_streaming->try_get_integer ("player-send-budget", num))
+			{
+				if (num >= 16 && num <= 65536)
+					out.player_send_budget = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"streaming\":" << std::endl;
+						log (LT_INFO) << " - \"player-send-budget\" must be in the range of 16-65536 (KB)." << std::endl;
+						error = true;
+					}
+			}
+		
+		// chunk send rate
+		if (grp_streaming->try_get_integer ("chunk-rate", num))
+			{
+				if (num >= 1 && num <= 1000)
+					out.chunk_rate = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"streaming\":" << std::endl;
+						log (LT_INFO) << " - \"chunk-rate\" must be in the range of 1-1000 (chunks per second)." << std::endl;
+						error = true;
+					}
+			}
+		
+		// map chunk bulk packets
+		if (grp_streaming->try_get_integer ("chunk-bulk-size", num))
+			{
+				if (num >= 0 && num <= 1024)
+					out.chunk_bulk_size = num;
+				else
+					{
+						if (!error)
+							log (LT_ERROR) << "Config: at group \"streaming\":" << std::endl;
+						log (LT_INFO) << " - \"chunk-bulk-size\" must be in the range of 0-1024 (KB)." << std::endl;
+						error = true;
+					}
+			}
+		
+		if (out.min_view_distance > out.view_distance)
+			out.min_view_distance = out.view_distance;
+	}
+	
+	static void
+	_cfg_read_metrics_grp (logger& log, cfg::group *grp_metrics, server_config& out)
+	{
+		std::string str;
+		
+		// listen address
+		if (grp_metrics->try_get_string ("listen", str))
+			out.metrics_listen = str;
+	}
+	
 	static void
 	_cfg_read_dcmds_arr (logger& log, cfg::array *arr_dcmds, server_config& out)
 	{
@@ -1094,6 +1391,50 @@ namespace hCraft {
 				log (LT_WARNING) << "Config: Group \"irc\" not found or invalid, using defaults" << std::endl;
 			}
 		
+		try
+			{
+				cfg::group *grp_compression = root->find_group ("compression");
+				if (!grp_compression) throw server_error ("not found");
+				_cfg_read_compression_grp (log, grp_compression, out);
+			}
+		catch (const std::exception& ex)
+			{
+				log (LT_WARNING) << "Config: Group \"compression\" not found or invalid, using defaults" << std::endl;
+			}
+		
+		try
+			{
+				cfg::group *grp_memory = root->find_group ("memory");
+				if (!grp_memory) throw server_error ("not found");
+				_cfg_read_memory_grp (log, grp_memory, out);
+			}
+		catch (const std::exception& ex)
+			{
+				log (LT_WARNING) << "Config: Group \"memory\" not found or invalid, using defaults" << std::endl;
+			}
+		
+		try
+			{
+				cfg::group *grp_streaming = root->find_group ("streaming");
+				if (!grp_streaming) throw server_error ("not found");
+				_cfg_read_streaming_grp (log, grp_streaming, out);
+			}
+		catch (const std::exception& ex)
+			{
+				log (LT_WARNING) << "Config: Group \"streaming\" not found or invalid, using defaults" << std::endl;
+			}
+		
+		try
+			{
+				cfg::group *grp_metrics = root->find_group ("metrics");
+				if (!grp_metrics) throw server_error ("not found");
+				_cfg_read_metrics_grp (log, grp_metrics, out);
+			}
+		catch (const std::exception& ex)
+			{
+				log (LT_WARNING) << "Config: Group \"metrics\" not found or invalid, using defaults" << std::endl;
+			}
+		
 		try
 			{
 				cfg::array *arr_dcmds = root->find_array ("disabled-commands");
@@ -1314,6 +1655,10 @@ namespace hCraft {
 					log () << "Configuration file does not exist, saving default." << std::endl;
 					write_config (this->log, this->cfg);
 				}
+			
+			hw_provider::set_default_codec (this->cfg.chunk_codec,
+				this->cfg.chunk_level, this->cfg.chunk_bg_codec);
+			packets::set_chunk_compression_level (this->cfg.packet_level);
 		}
 		
 		// data/messages.cfg
@@ -1349,29 +1694,64 @@ namespace hCraft {
 	void
 	server::init_sql ()
 	{
-		log () << "Opening SQL database" << std::endl;
-		
-		std::string conn_str;
-		{
-			std::ostringstream ss;
-			ss << "dbname=" << this->cfg.db_name << " user=" << this->cfg.db_user
-			   << " pass='" << this->cfg.db_pass << "' host=" << this->cfg.db_host
-			   << " port=" << this->cfg.db_port;
-			conn_str.assign (ss.str ());
-		}
+		bool sqlite = (this->cfg.db_backend == "sqlite");
+		log () << "Opening SQL database (" << this->cfg.db_backend << ")" << std::endl;
 		
 		// initialize pool sessions
-		for (size_t i = 0; i < SQL_POOL_SIZE; ++i)
+		if (sqlite)
 			{
-				soci::session& sql = this->spool.at (i);
-				sql.open (soci::mysql, conn_str);
+#ifdef HCRAFT_USE_SQLITE
+				std::string conn_str = "db=" + this->cfg.db_file + " timeout=10";
+				for (size_t i = 0; i < SQL_POOL_SIZE; ++i)
+					{
+						soci::session& sql = this->spool.at (i);
+						sql.open (soci::sqlite3, conn_str);
+					}
+				
+				// let readers and the writer work side by side.
+				soci::session sql (this->spool);
+				sql << "PRAGMA journal_mode=WAL";
+				sql << "PRAGMA synchronous=NORMAL";
+#else
+				throw server_error ("hCraft was built without SQLite support");
+#endif
+			}
+		else
+			{
+#ifdef HCRAFT_USE_MYSQL
+				std::string conn_str;
+				{
+					std::ostringstream ss;
+					ss << "dbname=" << this->cfg.db_name << " user=" << this->cfg.db_user
+					   << " pass='" << this->cfg.db_pass << "' host=" << this->cfg.db_host
+					   << " port=" << this->cfg.db_port;
+					conn_str.assign (ss.str ());
+				}
+				
+				for (size_t i = 0; i < SQL_POOL_SIZE; ++i)
+					{
+						soci::session& sql = this->spool.at (i);
+						sql.open (soci::mysql, conn_str);
+					}
+#else
+				throw server_error ("hCraft was built without MySQL support");
+#endif
 			}
+		this->sql_open = true;
+		
+		// the only differences between the two dialects that matter here.
+		const char *players_id = sqlite
+			? "`id` INTEGER PRIMARY KEY AUTOINCREMENT, "
+			: "`id` INT UNSIGNED UNIQUE AUTO_INCREMENT PRIMARY KEY, ";
+		const char *id = sqlite
+			? "`id` INTEGER PRIMARY KEY AUTOINCREMENT, "
+			: "`id` INTEGER PRIMARY KEY NOT NULL AUTO_INCREMENT, ";
 		
 		{
 			soci::session sql (this->spool);
 			
 			sql.once << "CREATE TABLE IF NOT EXISTS `players` ("
-				"`id` INT UNSIGNED UNIQUE AUTO_INCREMENT PRIMARY KEY, "
+				<< players_id <<
 				"`name` TEXT, "
 				"`nick` TEXT, "
 				"`ip` TEXT, "
@@ -1387,7 +1767,7 @@ namespace hCraft {
 				"`banned` TINYINT)";
 			
 			sql.once << "CREATE TABLE IF NOT EXISTS `kicks` ("
-				"`id` INTEGER PRIMARY KEY NOT NULL AUTO_INCREMENT, "
+				<< id <<
 				"`target` INT UNSIGNED NOT NULL, "
 				"`kicker` INT UNSIGNED NOT NULL, "
 				"`reason` TEXT, "
@@ -1396,7 +1776,7 @@ namespace hCraft {
 				"FOREIGN KEY (`kicker`) REFERENCES `players`(`id`))";
 			
 			sql.once << "CREATE TABLE IF NOT EXISTS `bans` ("
-				"`id` INTEGER PRIMARY KEY NOT NULL AUTO_INCREMENT, "
+				<< id <<
 				"`target` INT UNSIGNED NOT NULL, "
 				"`banner` INT UNSIGNED NOT NULL, "
 				"`reason` TEXT, "
@@ -1405,7 +1785,7 @@ namespace hCraft {
 				"FOREIGN KEY (`banner`) REFERENCES `players`(`id`))";
 			
 			sql.once << "CREATE TABLE IF NOT EXISTS `ip-bans` ("
-				"`id` INTEGER PRIMARY KEY NOT NULL AUTO_INCREMENT, "
+				<< id <<
 				"`ip` TEXT, "
 				"`banner` INT UNSIGNED NOT NULL, "
 				"`reason` TEXT, "
@@ -1413,7 +1793,7 @@ namespace hCraft {
 				"FOREIGN KEY (`banner`) REFERENCES `players`(`id`))";
 			
 			sql.once << "CREATE TABLE IF NOT EXISTS `unbans` ("
-				"`id` INTEGER PRIMARY KEY NOT NULL AUTO_INCREMENT, "
+				<< id <<
 				"`target` INT UNSIGNED NOT NULL, "
 				"`unbanner` INT UNSIGNED NOT NULL, "
 				"`reason` TEXT, "
@@ -1441,11 +1821,16 @@ namespace hCraft {
 				
 			sql.once << "CREATE TABLE IF NOT EXISTS `autoload-worlds` (`name` TEXT)";
 		}
+		
+		this->sstore.start (this->cfg.db_flush_interval);
 	}
 	
 	void
 	server::destroy_sql ()
 	{
+		// write out everything that is still pending.
+		this->sstore.stop ();
+		this->sql_open = false;
 		// TODO: clear SQL pool
 	}
 	
@@ -1491,13 +1876,12 @@ namespace hCraft {
 		this->sched.start ();
 		
 		this->players = new player_list ();
-		this->entity_id_counter = 0;
-		this->world_id_counter = 0;
 		
 		physics_block::init_blocks ();
+		block_props::init ();
 		
 		this->get_scheduler ().new_task (hCraft::server::cleanup_players, this)
-			.run_forever (10 * 1000);
+			.run_forever (1 * 1000);
 		
 		this->get_scheduler ().new_task (hCraft::server::handle_muted, this)
 			.run_forever (1 * 1000);
@@ -1510,12 +1894,16 @@ namespace hCraft {
 		
 		// create pooled threads
 		this->tpool.start (6);
+		
+		// world ticks
+		this->wtick.start (4);
 	}
 	
 	void
 	server::destroy_core ()
 	{
 		log (LT_SYSTEM) << "Stopping threading pools and schedulers" << std::endl;
+		this->wtick.stop ();
 		this->tpool.stop ();
 		physics_block::destroy_blocks ();
 		this->sched.stop ();
@@ -1711,6 +2099,7 @@ namespace hCraft {
 		grp_admin->add ("command.admin.gm");
 		grp_admin->add ("command.admin.rank");
 		grp_admin->add ("command.info.status.*");
+		grp_admin->add ("command.info.perf");
 		grp_admin->add ("command.info.money.*");
 		grp_admin->add ("command.admin.kick");
 		grp_admin->add ("command.admin.ban");
@@ -1723,6 +2112,7 @@ namespace hCraft {
 		grp_admin->add ("command.world.world.change-members");
 		grp_admin->add ("command.world.world.change-owners");
 		grp_admin->add ("command.world.world.time");
+		grp_admin->add ("command.world.world.view-distance");
 		grp_admin->add ("place.sign.colors");
 		
 		grp_admin->text_color = 'c';
@@ -2096,6 +2486,159 @@ namespace hCraft {
 	
 	
 	
+//----
+	// init_metrics (), destroy_metrics ():
+	/* 
+	 * Starts serving metrics on the address specified in the configuration
+	 * file, if any.
+	 */
+	
+	void
+	server::init_metrics ()
+	{
+		if (this->cfg.metrics_listen.empty ())
+			return;
+		
+		std::string err;
+		if (!this->mexp.start (this->cfg.metrics_listen,
+			std::bind (std::mem_fn (&hCraft::server::collect_metrics), this), err))
+			{
+				log (LT_ERROR) << "Failed to serve metrics on \"" << this->cfg.metrics_listen
+					<< "\": " << err << std::endl;
+				return;
+			}
+		
+		log (LT_SYSTEM) << "Serving metrics on " << this->cfg.metrics_listen << std::endl;
+	}
+	
+	void
+	server::destroy_metrics ()
+	{
+		this->mexp.stop ();
+	}
+	
+	
+	
+	/* 
+	 * Gathers the server's metrics in the Prometheus text format.
+	 */
+	std::string
+	server::collect_metrics ()
+	{
+		metrics_writer mw;
+		
+		// worlds
+		this->worlds.all (
+			[&mw] (world *w)
+				{
+					std::string lb = metrics_writer::label ("world", w->get_name ());
+					mw.histogram ("hcraft_world_tick_seconds", "Time taken by world ticks.",
+						lb, w->tick_times);
+					mw.histogram ("hcraft_world_save_seconds", "Time taken to save worlds.",
+						lb, w->save_times);
+					mw.histogram ("hcraft_world_tick_phase_seconds", "Time taken by each phase of world ticks.",
+						lb + "," + metrics_writer::label ("phase", "updates"), w->update_times);
+					mw.histogram ("hcraft_world_tick_phase_seconds", "Time taken by each phase of world ticks.",
+						lb + "," + metrics_writer::label ("phase", "lighting"), w->light_times);
+					mw.histogram ("hcraft_world_tick_phase_seconds", "Time taken by each phase of world ticks.",
+						lb + "," + metrics_writer::label ("phase", "maintenance"), w->maint_times);
+					mw.counter ("hcraft_world_shed_ticks_total", "Ticks that skipped low-priority work to catch up.",
+						lb, w->shed_ticks.get ());
+					mw.gauge ("hcraft_world_tick_lag", "Ticks the world is running behind schedule.",
+						lb, w->get_tick_lag ());
+					
+					static const double qs[] = { 50.0, 95.0, 99.0 };
+					static const char *qnames[] = { "0.5", "0.95", "0.99" };
+					double qv[3];
+					w->recent_tick_times.percentiles (qs, qv, 3);
+					for (int i = 0; i < 3; ++i)
+						mw.gauge ("hcraft_world_recent_tick_seconds", "Percentiles of the world's last ticks.",
+							lb + "," + metrics_writer::label ("quantile", qnames[i]), qv[i] / 1000000.0);
+					mw.gauge ("hcraft_world_block_updates", "Block updates waiting to be processed.",
+						lb, w->update_backlog ());
+					mw.gauge ("hcraft_world_light_updates", "Lighting updates waiting to be processed.",
+						lb, w->lm.backlog ());
+					mw.gauge ("hcraft_world_physics_updates", "Physics updates queued in the world's own physics manager.",
+						lb, w->physics.updates.unsafe_size ());
+					mw.gauge ("hcraft_world_players", "Players in the world.",
+						lb, w->get_players ().count ());
+					mw.gauge ("hcraft_world_hibernating", "Whether the world is hibernating.",
+						lb, w->is_hibernating () ? 1 : 0);
+				});
+		mw.gauge ("hcraft_physics_updates", "Physics updates queued in the global physics manager.",
+			"", this->global_physics.updates.unsafe_size ());
+		
+		// players
+		std::vector<std::pair<int, size_t>> depths;
+		this->cgen.queue_depths (depths);
+		std::unordered_map<int, size_t> depth_map (depths.begin (), depths.end ());
+		
+		mw.gauge ("hcraft_players", "Players connected.", "",
+			this->players->count ());
+		this->players->all (
+			[&mw, &depth_map] (player *pl)
+				{
+					std::string lb = metrics_writer::label ("player", pl->get_username ());
+					mw.gauge ("hcraft_player_outbound_bytes", "Bytes queued for sending to the player.",
+						lb, pl->get_outbound_bytes ());
+					
+					auto itr = depth_map.find (pl->get_eid ());
+					mw.gauge ("hcraft_player_chunk_requests", "Chunk generation requests pending for the player.",
+						lb, (itr == depth_map.end ()) ? 0 : itr->second);
+					mw.gauge ("hcraft_player_ping_seconds", "Keep-alive round trip time.",
+						lb, pl->get_ping () / 1000.0);
+				});
+		
+		// packet handlers
+		for (int op = 0; op < 0x100; ++op)
+			{
+				const metric_histogram& h = this->packet_times[op];
+				if (h.get_count () == 0)
+					continue;
+				
+				char opstr[8];
+				std::snprintf (opstr, sizeof opstr, "0x%02x", op);
+				mw.histogram ("hcraft_packet_handler_seconds", "Time spent handling incoming packets, by opcode.",
+					metrics_writer::label ("opcode", opstr), h);
+			}
+		mw.counter ("hcraft_moves_coalesced_total", "Movement packets skipped because newer ones superseded them.",
+			"", this->moves_coalesced.get ());
+		
+		// chunk memory pools
+		{
+			std::vector<slab_stats> pools;
+			slab_pool::all_stats (pools);
+			for (slab_stats& st : pools)
+				{
+					std::string lb = metrics_writer::label ("pool", st.name);
+					mw.gauge ("hcraft_slab_objects", "Objects in a slab pool, by state.",
+						lb + "," + metrics_writer::label ("state", "live"), st.live);
+					mw.gauge ("hcraft_slab_objects", "Objects in a slab pool, by state.",
+						lb + "," + metrics_writer::label ("state", "free"), st.free);
+					mw.gauge ("hcraft_slab_peak_objects", "Highest number of live objects in a slab pool.",
+						lb, st.peak);
+					mw.gauge ("hcraft_slab_bytes", "Memory held by the live and free objects of a slab pool.",
+						lb, (double)((st.live + st.free) * st.obj_size));
+				}
+		}
+		
+		// database
+		mw.histogram ("hcraft_sql_query_seconds", "Time taken by queued database queries.",
+			"", this->sstore.query_times);
+		mw.histogram ("hcraft_sql_flush_seconds", "Time taken to write out dirty player records.",
+			"", this->sstore.flush_times);
+		mw.counter ("hcraft_sql_records_flushed_total", "Player records written by the write-behind cache.",
+			"", this->sstore.records_flushed.get ());
+		mw.counter ("hcraft_sql_flush_failures_total", "Write-behind flushes that failed and were retried.",
+			"", this->sstore.flush_failures.get ());
+		mw.gauge ("hcraft_sql_queue", "Database queries waiting to be run.",
+			"", this->sstore.backlog.get ());
+		
+		return mw.str ();
+	}
+	
+	
+	
 //----
 	// final_cleanup (), initial_cleanup ():
 	/* 
@@ -2143,6 +2686,9 @@ namespace hCraft {
 			log (LT_INFO) << "  - " << remove_vec.size () << " instance(s)." << std::endl;
 			for (player *pl : remove_vec)
 				delete pl;
+			
+			// players that had been retired but not yet deleted.
+			this->epochs.drain ();
 			log (LT_INFO) << "  - All player instances have been destroyed." << std::endl;
 		}
 	}
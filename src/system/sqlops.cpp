@@ -19,6 +19,7 @@
 #include "system/sqlops.hpp"
 #include "system/server.hpp"
 #include <ctime>
+#include <cstdlib>
 
 
 namespace hCraft {
@@ -119,11 +120,11 @@ namespace hCraft {
 	static bool
 	_fill_player_info (soci::row& r, server &srv, sqlops::player_info& out)
 	{
-		out.id = r.get<unsigned int> (0);
+		out.id = (int)sqlops::column_int (r, 0);
 		out.name = r.get<std::string> (1);
 		out.nick = r.get<std::string> (2);
 		out.ip = r.get<std::string> (3);
-		out.op = (r.get<int> (4) == 1);
+		out.op = (sqlops::column_int (r, 4) == 1);
 		
 		try
 			{
@@ -136,16 +137,16 @@ namespace hCraft {
 				srv.get_logger () (LT_ERROR) << "Player \"" << out.name << "\" has an invalid rank." << std::endl;
 			}
 		
-		out.blocks_destroyed = r.get<int> (6);
-		out.blocks_created = r.get<int> (7);
-		out.messages_sent = r.get<int> (8);
+		out.blocks_destroyed = (int)sqlops::column_int (r, 6);
+		out.blocks_created = (int)sqlops::column_int (r, 7);
+		out.messages_sent = (int)sqlops::column_int (r, 8);
 		
-		out.first_login = (std::time_t)r.get<unsigned long long> (9);
-		out.first_login = (std::time_t)r.get<unsigned long long> (10);
-		out.login_count = r.get<int> (11);
+		out.first_login = (std::time_t)sqlops::column_int (r, 9);
+		out.last_login = (std::time_t)sqlops::column_int (r, 10);
+		out.login_count = (int)sqlops::column_int (r, 11);
 		
 		out.balance = r.get<double> (12);
-		out.banned = (r.get<int> (13) == 1);
+		out.banned = (sqlops::column_int (r, 13) == 1);
 		return true;
 	}
 	
@@ -249,6 +250,76 @@ namespace hCraft {
 	
 	
 	
+	/* 
+	 * Loads\saves the position the given player logged out at.
+	 */
+	
+	bool
+	sqlops::logout_data (soci::session& sql, const char *name, logout_info& out)
+	{
+		double pos_x, pos_y, pos_z, pos_r, pos_l;
+		sql << "SELECT `world`, `pos_x`, `pos_y`, `pos_z`, `pos_r`, `pos_l`, `gm` "
+			"FROM `player-logout-data` WHERE `name`=:n",
+			soci::into (out.world), soci::into (pos_x), soci::into (pos_y),
+			soci::into (pos_z), soci::into (pos_r), soci::into (pos_l),
+			soci::into (out.gm), soci::use (std::string (name));
+		if (!sql.got_data ())
+			return false;
+		
+		out.pos = entity_pos (pos_x, pos_y, pos_z, (float)pos_r, (float)pos_l, true);
+		return true;
+	}
+	
+	void
+	sqlops::save_logout_data (soci::session& sql, const char *name,
+		const logout_info& in)
+	{
+		int count;
+		sql << "SELECT Count(*) FROM `player-logout-data` WHERE `name`=:n",
+			soci::into (count), soci::use (std::string (name));
+		
+		double pos_r = in.pos.r, pos_l = in.pos.l;
+		if (count > 0)
+			sql << "UPDATE `player-logout-data` SET `world`=:w, `pos_x`=:x, "
+				"`pos_y`=:y, `pos_z`=:z, `pos_r`=:r, `pos_l`=:l, `gm`=:gm WHERE `name`=:n",
+				soci::use (in.world), soci::use (in.pos.x), soci::use (in.pos.y),
+				soci::use (in.pos.z), soci::use (pos_r), soci::use (pos_l),
+				soci::use (in.gm), soci::use (std::string (name));
+		else
+			sql << "INSERT INTO `player-logout-data` VALUES (:n, :w, :x, :y, :z, :r, :l, :gm)",
+				soci::use (std::string (name)), soci::use (in.world), soci::use (in.pos.x),
+				soci::use (in.pos.y), soci::use (in.pos.z), soci::use (pos_r),
+				soci::use (pos_l), soci::use (in.gm);
+	}
+	
+	
+	
+	/* 
+	 * Returns the integer stored in column @{col} of the given row.
+	 */
+	long long
+	sqlops::column_int (const soci::row& r, std::size_t col)
+	{
+		switch (r.get_properties (col).get_data_type ())
+			{
+				case soci::dt_integer:
+					return r.get<int> (col);
+				case soci::dt_long_long:
+					return r.get<long long> (col);
+				case soci::dt_unsigned_long_long:
+					return (long long)r.get<unsigned long long> (col);
+				case soci::dt_double:
+					return (long long)r.get<double> (col);
+				case soci::dt_string:
+					return std::strtoll (r.get<std::string> (col).c_str (), nullptr, 10);
+				
+				default:
+					return 0;
+			}
+	}
+	
+	
+	
 	/* 
 	 * Player name-related:
 	 */
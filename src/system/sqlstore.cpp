@@ -0,0 +1,317 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system/sqlstore.hpp"
+#include "system/server.hpp"
+#include "player/player.hpp"
+
+
+namespace hCraft {
+	
+	sql_store::sql_store (server& srv, soci::connection_pool& pool)
+		: srv (srv), pool (pool)
+	{
+		this->running = false;
+		this->flush_requested = false;
+		this->flush_interval = std::chrono::seconds (10);
+	}
+	
+	sql_store::~sql_store ()
+	{
+		this->stop ();
+	}
+	
+	
+	
+	/* 
+	 * Starts the database thread.
+	 */
+	void
+	sql_store::start (int flush_interval)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		if (this->running)
+			return;
+		
+		this->flush_interval = std::chrono::seconds ((flush_interval < 1) ? 1 : flush_interval);
+		this->running = true;
+		this->th = std::thread (std::bind (std::mem_fn (&hCraft::sql_store::main_loop), this));
+	}
+	
+	/* 
+	 * Runs all queued jobs, writes all dirty records and stops the thread.
+	 */
+	void
+	sql_store::stop ()
+	{
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			if (!this->running)
+				return;
+			this->running = false;
+		}
+		
+		this->cv.notify_all ();
+		if (this->th.joinable ())
+			this->th.join ();
+	}
+	
+	
+	
+	/* 
+	 * The function ran by the database thread.
+	 */
+	void
+	sql_store::main_loop ()
+	{
+		auto last_flush = std::chrono::steady_clock::now ();
+		
+		for (;;)
+			{
+				job_fn job;
+				bool do_flush = false;
+				bool quit = false;
+				
+				{
+					std::unique_lock<std::mutex> guard {this->lock};
+					for (;;)
+						{
+							auto now = std::chrono::steady_clock::now ();
+							bool flush_due = !this->dirty.empty ()
+								&& (this->flush_requested || (now - last_flush) >= this->flush_interval);
+							if (!this->running || !this->jobs.empty () || flush_due)
+								break;
+							
+							if (this->dirty.empty ())
+								this->cv.wait (guard);
+							else
+								this->cv.wait_until (guard, last_flush + this->flush_interval);
+						}
+					
+					// queued jobs must see every record saved before them.
+					do_flush = !this->dirty.empty ();
+					this->flush_requested = false;
+					
+					if (!this->jobs.empty ())
+						{
+							job = std::move (this->jobs.front ());
+							this->jobs.pop_front ();
+							this->backlog.add (-1);
+						}
+					else if (!this->running)
+						quit = true;
+				}
+				
+				try
+					{
+						soci::session sql (this->pool);
+						if (do_flush)
+							{
+								this->flush (sql);
+								last_flush = std::chrono::steady_clock::now ();
+							}
+						
+						if (job)
+							{
+								auto start = std::chrono::steady_clock::now ();
+								job (sql);
+								this->query_times.observe (start);
+							}
+					}
+				catch (const std::exception& ex)
+					{
+						this->srv.get_logger () (LT_ERROR) << "SQL: " << ex.what () << std::endl;
+					}
+				
+				if (quit)
+					break;
+			}
+	}
+	
+	
+	
+	/* 
+	 * Writes all dirty player records to the database.
+	 */
+	void
+	sql_store::flush (soci::session& sql)
+	{
+		std::unordered_map<std::string, player_record> batch;
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			batch.swap (this->dirty);
+		}
+		if (batch.empty ())
+			return;
+		
+		auto start = std::chrono::steady_clock::now ();
+		try
+			{
+				soci::transaction tr (sql);
+				for (auto& p : batch)
+					{
+						player_record& rec = p.second;
+						sqlops::save_player_data (sql, p.first.c_str (), this->srv, rec.info);
+						if (rec.has_logout)
+							sqlops::save_logout_data (sql, p.first.c_str (), rec.logout);
+					}
+				tr.commit ();
+			}
+		catch (const std::exception& ex)
+			{
+				this->flush_failures.inc ();
+				this->srv.get_logger () (LT_ERROR) << "SQL: Failed to save "
+					<< batch.size () << " player record(s) [" << ex.what () << "]" << std::endl;
+				
+				// try again later, unless newer snapshots were saved meanwhile.
+				std::lock_guard<std::mutex> guard {this->lock};
+				for (auto& p : batch)
+					if (this->dirty.find (p.first) == this->dirty.end ())
+						this->dirty.insert (std::move (p));
+				return;
+			}
+		
+		this->flush_times.observe (start);
+		this->records_flushed.inc (batch.size ());
+	}
+	
+	
+	
+	/* 
+	 * Queues @{job} for the database thread.
+	 */
+	void
+	sql_store::post (job_fn&& job)
+	{
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			if (this->running)
+				{
+					this->jobs.push_back (std::move (job));
+					this->backlog.add (1);
+					this->cv.notify_one ();
+					return;
+				}
+		}
+		
+		// no database thread, run it here.
+		try
+			{
+				soci::session sql (this->pool);
+				job (sql);
+			}
+		catch (const std::exception& ex)
+			{
+				this->srv.get_logger () (LT_ERROR) << "SQL: " << ex.what () << std::endl;
+			}
+	}
+	
+	/* 
+	 * Runs @{job} on the database thread, then @{resume} on @{pl}'s strand.
+	 */
+	void
+	sql_store::submit_for (player *pl, job_fn&& job, std::function<void ()>&& resume)
+	{
+		// keeps the player from being destroyed until the result is delivered.
+		++ pl->handlers_scheduled;
+		
+		job_fn j = std::move (job);
+		std::function<void ()> r = std::move (resume);
+		server *srv = &this->srv;
+		this->post (
+			[srv, pl, j, r] (soci::session& sql)
+				{
+					j (sql);
+					
+					// all players are destroyed during shutdown regardless.
+					if (srv->is_shutting_down ())
+						return;
+					
+					std::function<void ()> fn = r;
+					pl->post (std::move (fn));
+					-- pl->handlers_scheduled;
+				});
+	}
+	
+	
+	
+	/* 
+	 * Stores a snapshot of a player's record, to be written by the next flush.
+	 */
+	void
+	sql_store::save_player (const sqlops::player_info& pd,
+		const sqlops::logout_info *logout)
+	{
+		bool write_now = false;
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			if (this->running)
+				{
+					player_record& rec = this->dirty[pd.name];
+					rec.info = pd;
+					if (logout)
+						{
+							rec.has_logout = true;
+							rec.logout = *logout;
+						}
+					this->cv.notify_one ();
+				}
+			else
+				write_now = true;
+		}
+		
+		if (write_now)
+			{
+				sqlops::player_info info = pd;
+				bool has_logout = (logout != nullptr);
+				sqlops::logout_info lo;
+				if (logout)
+					lo = *logout;
+				server *srv = &this->srv;
+				this->post (
+					[srv, info, has_logout, lo] (soci::session& sql)
+						{
+							sqlops::save_player_data (sql, info.name.c_str (), *srv, info);
+							if (has_logout)
+								sqlops::save_logout_data (sql, info.name.c_str (), lo);
+						});
+			}
+	}
+	
+	/* 
+	 * Makes the database thread write all dirty records as soon as possible.
+	 */
+	void
+	sql_store::flush_soon ()
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		this->flush_requested = true;
+		this->cv.notify_one ();
+	}
+	
+	/* 
+	 * Number of jobs waiting to be run.
+	 */
+	size_t
+	sql_store::pending ()
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		return this->jobs.size ();
+	}
+}
+
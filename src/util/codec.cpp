@@ -0,0 +1,185 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "util/codec.hpp"
+#include <zlib.h>
+#include <cstring>
+
+#ifdef HCRAFT_USE_LZ4
+#include <lz4.h>
+#endif
+
+
+namespace hCraft {
+	
+	namespace codec {
+		
+		/* 
+		 * Returns true if the specified codec was compiled in.
+		 */
+		bool
+		available (int id)
+		{
+			switch (id)
+				{
+				case CODEC_ZLIB:
+				case CODEC_RAW:
+					return true;
+				
+			#ifdef HCRAFT_USE_LZ4
+				case CODEC_LZ4:
+					return true;
+			#endif
+				
+				default:
+					return false;
+				}
+		}
+		
+		/* 
+		 * Returns the name of the given codec (e.g. "zlib"), or "unknown".
+		 */
+		const char*
+		name (int id)
+		{
+			switch (id)
+				{
+				case CODEC_ZLIB: return "zlib";
+				case CODEC_RAW:  return "raw";
+				case CODEC_LZ4:  return "lz4";
+				default:         return "unknown";
+				}
+		}
+		
+		/* 
+		 * Returns the ID of the codec that has the specified name, or -1 if
+		 * there is no such codec.
+		 */
+		int
+		from_name (const char *name)
+		{
+			if (std::strcmp (name, "zlib") == 0)
+				return CODEC_ZLIB;
+			else if (std::strcmp (name, "raw") == 0)
+				return CODEC_RAW;
+			else if (std::strcmp (name, "lz4") == 0)
+				return CODEC_LZ4;
+			return -1;
+		}
+		
+		
+		
+		/* 
+		 * Returns the maximum number of bytes compress () may produce for an
+		 * input of @{len} bytes.
+		 */
+		unsigned long
+		bound (int id, unsigned long len)
+		{
+			switch (id)
+				{
+				case CODEC_ZLIB: return compressBound (len);
+				case CODEC_RAW:  return len;
+				
+			#ifdef HCRAFT_USE_LZ4
+				case CODEC_LZ4: return LZ4_compressBound (len);
+			#endif
+				
+				default:
+					return 0;
+				}
+		}
+		
+		/* 
+		 * Compresses @{slen} bytes from @{src} into @{dest}, which must be at least
+		 * bound (id, slen) bytes long. @{dlen} receives the compressed size.
+		 */
+		bool
+		compress (int id, int level, const unsigned char *src,
+			unsigned long slen, unsigned char *dest, unsigned long& dlen)
+		{
+			switch (id)
+				{
+				case CODEC_ZLIB:
+					{
+						if (level < -1 || level > 9)
+							level = Z_DEFAULT_COMPRESSION;
+						dlen = compressBound (slen);
+						return (compress2 (dest, &dlen, src, slen, level) == Z_OK);
+					}
+				
+				case CODEC_RAW:
+					std::memcpy (dest, src, slen);
+					dlen = slen;
+					return true;
+				
+			#ifdef HCRAFT_USE_LZ4
+				case CODEC_LZ4:
+					{
+						int n = LZ4_compress_default ((const char *)src, (char *)dest,
+							slen, LZ4_compressBound (slen));
+						if (n <= 0)
+							return false;
+						dlen = n;
+						return true;
+					}
+			#endif
+				
+				default:
+					return false;
+				}
+		}
+		
+		/* 
+		 * Decompresses @{slen} bytes from @{src} into @{dest}.
+		 */
+		bool
+		decompress (int id, const unsigned char *src, unsigned long slen,
+			unsigned char *dest, unsigned long& dlen)
+		{
+			switch (id)
+				{
+				case CODEC_ZLIB:
+					return (uncompress (dest, &dlen, src, slen) == Z_OK);
+				
+				case CODEC_RAW:
+					if (slen > dlen)
+						return false;
+					std::memcpy (dest, src, slen);
+					dlen = slen;
+					return true;
+				
+			#ifdef HCRAFT_USE_LZ4
+				case CODEC_LZ4:
+					{
+						int n = LZ4_decompress_safe ((const char *)src, (char *)dest,
+							slen, dlen);
+						if (n < 0)
+							return false;
+						dlen = n;
+						return true;
+					}
+			#endif
+				
+				default:
+					return false;
+				}
+		}
+	}
+}
+
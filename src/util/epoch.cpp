@@ -0,0 +1,176 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "util/epoch.hpp"
+#include <stdexcept>
+
+
+namespace hCraft {
+	
+	namespace {
+		
+		/* 
+		 * Every thread that enters a guard is given an index into the records
+		 * of all epoch managers, which it gives back when it exits.
+		 */
+		std::mutex _slot_lock;
+		bool _slot_used[epoch_manager::max_threads] = { false };
+		
+		struct thread_slot
+		{
+			int index;
+			
+			thread_slot ()
+			{
+				std::lock_guard<std::mutex> guard {_slot_lock};
+				for (int i = 0; i < epoch_manager::max_threads; ++i)
+					if (!_slot_used[i])
+						{
+							_slot_used[i] = true;
+							this->index = i;
+							return;
+						}
+				throw std::runtime_error ("epoch_manager: too many threads");
+			}
+			
+			~thread_slot ()
+			{
+				std::lock_guard<std::mutex> guard {_slot_lock};
+				_slot_used[this->index] = false;
+			}
+		};
+		
+		inline int
+		_thread_index ()
+		{
+			static thread_local thread_slot slot;
+			return slot.index;
+		}
+	}
+	
+	
+	
+	epoch_manager::epoch_manager ()
+		: global_epoch (1)
+	{
+		for (int i = 0; i < max_threads; ++i)
+			{
+				this->records[i].epoch.store (0, std::memory_order_relaxed);
+				this->records[i].depth = 0;
+			}
+	}
+	
+	epoch_manager::~epoch_manager ()
+	{
+		this->drain ();
+	}
+	
+	
+	
+	void
+	epoch_manager::enter ()
+	{
+		thread_record& rec = this->records[_thread_index ()];
+		if (rec.depth ++ == 0)
+			rec.epoch.store (this->global_epoch.load ());
+	}
+	
+	void
+	epoch_manager::leave ()
+	{
+		thread_record& rec = this->records[_thread_index ()];
+		if (-- rec.depth == 0)
+			rec.epoch.store (0, std::memory_order_release);
+	}
+	
+	
+	
+	/* 
+	 * Queues @{fn} to be run once no thread can still be using the object it
+	 * destroys.
+	 */
+	void
+	epoch_manager::retire (std::function<void ()>&& fn)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		this->pending.push_back ({ this->global_epoch.load (), std::move (fn) });
+	}
+	
+	/* 
+	 * Runs all retired functions that are safe to run.
+	 */
+	int
+	epoch_manager::collect ()
+	{
+		// a function retired at epoch E is safe once every thread inside a guard
+		// has entered it after E.
+		std::uint64_t safe = this->global_epoch.fetch_add (1) + 1;
+		for (int i = 0; i < max_threads; ++i)
+			{
+				std::uint64_t e = this->records[i].epoch.load ();
+				if (e != 0 && e < safe)
+					safe = e;
+			}
+		
+		std::vector<retired> ready;
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			for (auto itr = this->pending.begin (); itr != this->pending.end ();)
+				{
+					if (itr->epoch < safe)
+						{
+							ready.push_back (std::move (*itr));
+							itr = this->pending.erase (itr);
+						}
+					else
+						++ itr;
+				}
+		}
+		
+		for (retired& r : ready)
+			r.fn ();
+		return (int)ready.size ();
+	}
+	
+	/* 
+	 * Runs all retired functions, regardless of guards.
+	 */
+	void
+	epoch_manager::drain ()
+	{
+		std::vector<retired> ready;
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			ready.swap (this->pending);
+		}
+		
+		for (retired& r : ready)
+			r.fn ();
+	}
+	
+	/* 
+	 * Returns the number of retired functions that have not been run yet.
+	 */
+	int
+	epoch_manager::backlog ()
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		return (int)this->pending.size ();
+	}
+}
+
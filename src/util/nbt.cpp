@@ -18,10 +18,132 @@
 
 #include "util/nbt.hpp"
 #include <cstring>
+#include <new>
 
 
 namespace hCraft {
 	
+	static thread_local nbt_arena *_cur_arena = nullptr;
+	
+	// placed in front of every tag, so that operator delete knows where the
+	// tag's memory came from.
+	union alloc_header
+	{
+		nbt_arena *arena;
+		std::max_align_t align;
+	};
+	
+	static const std::size_t _arena_align = alignof (std::max_align_t);
+	
+	
+	
+	nbt_arena::nbt_arena (std::size_t block_size)
+		: head (nullptr), block_size (block_size)
+		{ }
+	
+	nbt_arena::~nbt_arena ()
+	{
+		block *blk = this->head;
+		while (blk)
+			{
+				block *next = blk->next;
+				::operator delete (blk);
+				blk = next;
+			}
+	}
+	
+	
+	
+	/* 
+	 * Returns @{n} bytes of suitably aligned memory.
+	 */
+	void*
+	nbt_arena::alloc (std::size_t n)
+	{
+		// the block header is padded so that the data following it is aligned.
+		static const std::size_t hdr = (sizeof (block) + _arena_align - 1) & ~(_arena_align - 1);
+		n = (n + _arena_align - 1) & ~(_arena_align - 1);
+		
+		block *blk = this->head;
+		if (!blk || (blk->size - blk->used) < n)
+			{
+				std::size_t size = (n > this->block_size) ? n : this->block_size;
+				blk = static_cast<block *> (::operator new (hdr + size));
+				blk->size = size;
+				blk->used = 0;
+				blk->next = this->head;
+				this->head = blk;
+			}
+		
+		void *ptr = reinterpret_cast<unsigned char *> (blk) + hdr + blk->used;
+		blk->used += n;
+		return ptr;
+	}
+	
+	/* 
+	 * Releases everything allocated so far.  The first block is kept around
+	 * for reuse.
+	 */
+	void
+	nbt_arena::reset ()
+	{
+		if (!this->head)
+			return;
+		
+		block *blk = this->head->next;
+		while (blk)
+			{
+				block *next = blk->next;
+				::operator delete (blk);
+				blk = next;
+			}
+		this->head->next = nullptr;
+		this->head->used = 0;
+	}
+	
+	
+	
+	nbt_arena_scope::nbt_arena_scope (nbt_arena& arena)
+	{
+		this->prev = _cur_arena;
+		_cur_arena = &arena;
+	}
+	
+	nbt_arena_scope::~nbt_arena_scope ()
+	{
+		_cur_arena = this->prev;
+	}
+	
+	
+	
+//----
+	
+	void*
+	nbt_tag::operator new (std::size_t size)
+	{
+		alloc_header *hdr;
+		if (_cur_arena)
+			hdr = static_cast<alloc_header *> (_cur_arena->alloc (sizeof (alloc_header) + size));
+		else
+			hdr = static_cast<alloc_header *> (::operator new (sizeof (alloc_header) + size));
+		hdr->arena = _cur_arena;
+		return hdr + 1;
+	}
+	
+	void
+	nbt_tag::operator delete (void *ptr)
+	{
+		if (!ptr)
+			return;
+		
+		alloc_header *hdr = static_cast<alloc_header *> (ptr) - 1;
+		if (!hdr->arena)
+			::operator delete (hdr);
+		// arena memory is released along with the arena.
+	}
+	
+	
+	
 	nbt_tag::nbt_tag (const char *name)
 		: tag_name (name)
 		{ }
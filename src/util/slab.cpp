@@ -0,0 +1,240 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "util/slab.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+
+namespace hCraft {
+	
+	namespace {
+		
+		std::mutex _pools_lock;
+		slab_pool *_pools[slab_pool::max_pools] = { nullptr };
+		int _pool_count = 0;
+		
+		
+		/* 
+		 * Free objects are stored with their lowest bit set if they have never
+		 * been handed out (and so are still zero).  Objects are always aligned
+		 * to at least alignof (std::max_align_t), so the bit is free.
+		 */
+		
+		inline void*
+		_tag_clean (void *ptr)
+			{ return reinterpret_cast<void *> (reinterpret_cast<std::uintptr_t> (ptr) | 1); }
+		
+		inline bool
+		_is_clean (void *ptr)
+			{ return reinterpret_cast<std::uintptr_t> (ptr) & 1; }
+		
+		inline void*
+		_untag (void *ptr)
+			{ return reinterpret_cast<void *> (reinterpret_cast<std::uintptr_t> (ptr) & ~(std::uintptr_t)1); }
+	}
+	
+	
+	/* 
+	 * Objects freed by a thread are kept here first, so that the common
+	 * free-then-allocate pattern (e.g. evicting one chunk and loading another)
+	 * does not touch any shared state.
+	 */
+	struct slab_thread_cache
+	{
+		static const int max_cap = 64;
+		
+		void *objs[slab_pool::max_pools][max_cap];
+		int count[slab_pool::max_pools];
+		
+		slab_thread_cache ()
+		{
+			for (int i = 0; i < slab_pool::max_pools; ++i)
+				this->count[i] = 0;
+		}
+		
+		~slab_thread_cache ()
+		{
+			// give everything back to the pools when the thread exits.
+			for (int i = 0; i < slab_pool::max_pools; ++i)
+				if (this->count[i] > 0)
+					_pools[i]->release (this->objs[i], this->count[i]);
+		}
+	};
+	
+	static thread_local slab_thread_cache _cache;
+	
+	
+	
+	/* 
+	 * Creates a pool for objects of @{obj_size} bytes, allocating memory
+	 * @{slab_size} bytes at a time.
+	 */
+	slab_pool::slab_pool (const char *name, std::size_t obj_size,
+		std::size_t slab_size)
+		: live (0), peak (0), carved (0)
+	{
+		this->name = name;
+		
+		// keep objects aligned for anything they might contain.
+		const std::size_t align = alignof (std::max_align_t);
+		this->obj_size = (std::max (obj_size, sizeof (void *)) + align - 1) & ~(align - 1);
+		this->slab_size = std::max (slab_size, this->obj_size * 4);
+		this->bump = nullptr;
+		this->bump_left = 0;
+		
+		// cache up to ~256KB worth of objects per thread.
+		this->cache_cap = (int)std::min<std::size_t> (slab_thread_cache::max_cap,
+			std::max<std::size_t> (4, (256 * 1024) / this->obj_size));
+		
+		std::lock_guard<std::mutex> guard {_pools_lock};
+		if (_pool_count == max_pools)
+			throw std::bad_alloc ();
+		this->index = _pool_count;
+		_pools[_pool_count ++] = this;
+	}
+	
+	
+	
+	// moves up to @{n} objects from the pool into @{out}, and returns how many.
+	int
+	slab_pool::refill (void **out, int n)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		
+		int got = 0;
+		while (got < n && !this->free_list.empty ())
+			{
+				out[got ++] = this->free_list.back ();
+				this->free_list.pop_back ();
+			}
+		if (got > 0)
+			return got;
+		
+		// carve new objects out of the current slab, or a new one.
+		if (this->bump_left == 0)
+			{
+				// calloc () hands large blocks straight from mmap (), so the pages
+				// are only zeroed and committed when first used.
+				unsigned char *slab = static_cast<unsigned char *> (std::calloc (1, this->slab_size));
+				if (!slab)
+					throw std::bad_alloc ();
+				this->slabs.push_back (slab);
+				this->bump = slab;
+				this->bump_left = this->slab_size / this->obj_size;
+			}
+		
+		while (got < n && this->bump_left > 0)
+			{
+				out[got ++] = _tag_clean (this->bump);
+				this->bump += this->obj_size;
+				-- this->bump_left;
+			}
+		this->carved.fetch_add (got, std::memory_order_relaxed);
+		return got;
+	}
+	
+	// gives @{n} objects back to the pool.
+	void
+	slab_pool::release (void **objs, int n)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		this->free_list.insert (this->free_list.end (), objs, objs + n);
+	}
+	
+	
+	
+	/* 
+	 * Returns uninitialized memory for a single object.  If @{zeroed} is not
+	 * null, it is set to true if the memory is known to be all zero.
+	 */
+	void*
+	slab_pool::alloc (bool *zeroed)
+	{
+		int& count = _cache.count[this->index];
+		void **objs = _cache.objs[this->index];
+		if (count == 0)
+			count = this->refill (objs, (this->cache_cap + 1) / 2);
+		
+		long long now = this->live.fetch_add (1, std::memory_order_relaxed) + 1;
+		long long prev = this->peak.load (std::memory_order_relaxed);
+		while (now > prev && !this->peak.compare_exchange_weak (prev, now,
+			std::memory_order_relaxed))
+			;
+		
+		void *obj = objs[-- count];
+		if (zeroed)
+			*zeroed = _is_clean (obj);
+		return _untag (obj);
+	}
+	
+	/* 
+	 * Returns an object allocated with alloc () to the pool.
+	 */
+	void
+	slab_pool::free (void *ptr)
+	{
+		if (!ptr)
+			return;
+		this->live.fetch_sub (1, std::memory_order_relaxed);
+		
+		int& count = _cache.count[this->index];
+		void **objs = _cache.objs[this->index];
+		if (count == this->cache_cap)
+			{
+				// keep the most recently freed half (likely still in cache).
+				int half = count / 2;
+				this->release (objs, half);
+				std::copy (objs + half, objs + count, objs);
+				count -= half;
+			}
+		objs[count ++] = ptr;
+	}
+	
+	
+	
+	slab_stats
+	slab_pool::stats ()
+	{
+		slab_stats st;
+		st.name = this->name;
+		st.obj_size = this->obj_size;
+		st.live = this->live.load (std::memory_order_relaxed);
+		st.free = this->carved.load (std::memory_order_relaxed) - st.live;
+		st.peak = this->peak.load (std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			st.slabs = this->slabs.size ();
+		}
+		return st;
+	}
+	
+	/* 
+	 * Fills @{out} with the statistics of every pool created so far.
+	 */
+	void
+	slab_pool::all_stats (std::vector<slab_stats>& out)
+	{
+		std::lock_guard<std::mutex> guard {_pools_lock};
+		for (int i = 0; i < _pool_count; ++i)
+			out.push_back (_pools[i]->stats ());
+	}
+}
+
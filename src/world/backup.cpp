@@ -0,0 +1,733 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "world/backup.hpp"
+#include "world/world.hpp"
+#include "world/providers/worldprovider.hpp"
+#include <set>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <ctime>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#ifdef __linux__
+#	include <sys/ioctl.h>
+#	include <sys/syscall.h>
+#	include <linux/fs.h>
+#endif
+
+
+namespace hCraft {
+	
+	#define BACKUP_BLOCK_SIZE					4096
+	#define BACKUP_IDX_MAGIC		0x4B425748 // "HWBK"
+	#define BACKUP_IDX_VERSION					 1
+	
+	
+	// worlds that are currently being backed up or restored.
+	static std::mutex _busy_lock;
+	static std::set<std::string> _busy;
+	
+	static bool
+	_acquire (const std::string& name)
+	{
+		std::lock_guard<std::mutex> guard {_busy_lock};
+		return _busy.insert (name).second;
+	}
+	
+	static void
+	_release (const std::string& name)
+	{
+		std::lock_guard<std::mutex> guard {_busy_lock};
+		_busy.erase (name);
+	}
+	
+	
+	
+//----
+	
+	static bool
+	_copy_plain (int in, off_t in_off, int out, off_t out_off, size_t len)
+	{
+		std::vector<unsigned char> buf (len < 524288 ? len : 524288);
+		while (len > 0)
+			{
+				size_t need = (len < buf.size ()) ? len : buf.size ();
+				ssize_t r = ::pread (in, buf.data (), need, in_off);
+				if (r < 0)
+					{
+						if (errno == EINTR)
+							continue;
+						return false;
+					}
+				if (r == 0)
+					return true; // end of input
+				
+				ssize_t done = 0;
+				while (done < r)
+					{
+						ssize_t w = ::pwrite (out, buf.data () + done, r - done, out_off + done);
+						if (w < 0)
+							{
+								if (errno == EINTR)
+									continue;
+								return false;
+							}
+						done += w;
+					}
+				
+				in_off += r;
+				out_off += r;
+				len -= r;
+			}
+		
+		return true;
+	}
+	
+	/* 
+	 * Copies up to @{len} bytes between two files (less if the input ends
+	 * first), in the kernel if possible.
+	 */
+	static bool
+	_copy_range (int in, off_t in_off, int out, off_t out_off, size_t len)
+	{
+#if defined(__linux__) && defined(SYS_copy_file_range)
+		while (len > 0)
+			{
+				loff_t ioff = in_off, ooff = out_off;
+				ssize_t r = ::syscall (SYS_copy_file_range, in, &ioff, out, &ooff, len, 0);
+				if (r == 0)
+					return true; // end of input
+				if (r < 0)
+					{
+						if (errno == EINTR)
+							continue;
+						if (errno == ENOSYS || errno == EXDEV || errno == EINVAL
+							|| errno == EOPNOTSUPP)
+							break; // not supported here
+						return false;
+					}
+				
+				in_off += r;
+				out_off += r;
+				len -= r;
+			}
+		if (len == 0)
+			return true;
+#endif
+		
+		return _copy_plain (in, in_off, out, out_off, len);
+	}
+	
+	/* 
+	 * Replaces the contents of @{out} with those of @{in}, sharing the
+	 * underlying extents if the filesystem supports reflinks.
+	 */
+	static bool
+	_clone_file (int in, int out, unsigned long long size)
+	{
+#if defined(__linux__) && defined(FICLONE)
+		if (::ioctl (out, FICLONE, in) == 0)
+			return ::ftruncate (out, size) == 0;
+#endif
+		
+		return (::ftruncate (out, 0) == 0) && _copy_range (in, 0, out, 0, size)
+			&& (::ftruncate (out, size) == 0);
+	}
+	
+	/* 
+	 * Copies 4KB blocks between two files.  Each pair in @{moves} maps a block
+	 * in @{in} to a block in @{out}; runs of consecutive blocks are copied
+	 * together.
+	 */
+	static bool
+	_copy_blocks (int in, int out,
+		const std::vector<std::pair<unsigned int, unsigned int>>& moves)
+	{
+		size_t i = 0;
+		while (i < moves.size ())
+			{
+				size_t j = i + 1;
+				while (j < moves.size ()
+					&& moves[j].first == moves[j - 1].first + 1
+					&& moves[j].second == moves[j - 1].second + 1)
+					++ j;
+				
+				if (!_copy_range (in, (off_t)moves[i].first * BACKUP_BLOCK_SIZE,
+					out, (off_t)moves[i].second * BACKUP_BLOCK_SIZE,
+					(j - i) * BACKUP_BLOCK_SIZE))
+					return false;
+				i = j;
+			}
+		
+		return true;
+	}
+	
+	
+	
+//----
+	
+	static void
+	_put_int (std::vector<unsigned char>& out, unsigned int val)
+	{
+		for (int i = 0; i < 4; ++i)
+			out.push_back ((val >> (i * 8)) & 0xFF);
+	}
+	
+	static void
+	_put_long (std::vector<unsigned char>& out, unsigned long long val)
+	{
+		for (int i = 0; i < 8; ++i)
+			out.push_back ((val >> (i * 8)) & 0xFF);
+	}
+	
+	static unsigned long long
+	_get (const unsigned char *data, int bytes)
+	{
+		unsigned long long val = 0;
+		for (int i = 0; i < bytes; ++i)
+			val |= (unsigned long long)data[i] << (i * 8);
+		return val;
+	}
+	
+	
+	static std::string
+	_backup_path (const std::string& dir, int num, const char *ext)
+	{
+		std::ostringstream ss;
+		ss << dir << "/" << num << ext;
+		return ss.str ();
+	}
+	
+	static bool
+	_write_idx (const std::string& path, const backup_info& inf,
+		const std::vector<unsigned int>& blocks)
+	{
+		std::vector<unsigned char> data;
+		_put_int (data, BACKUP_IDX_MAGIC);
+		_put_int (data, BACKUP_IDX_VERSION);
+		data.push_back (inf.base ? 1 : 0);
+		_put_int (data, inf.parent);
+		_put_long (data, inf.file_size);
+		_put_long (data, inf.time);
+		_put_int (data, blocks.size ());
+		for (unsigned int b : blocks)
+			_put_int (data, b);
+		
+		std::string tmp = path + ".tmp";
+		FILE *f = std::fopen (tmp.c_str (), "wb");
+		if (!f)
+			return false;
+		bool ok = std::fwrite (data.data (), 1, data.size (), f) == data.size ();
+		ok = (std::fflush (f) == 0) && ok;
+		ok = (::fsync (fileno (f)) == 0) && ok;
+		std::fclose (f);
+		
+		if (!ok || std::rename (tmp.c_str (), path.c_str ()) != 0)
+			{
+				std::remove (tmp.c_str ());
+				return false;
+			}
+		return true;
+	}
+	
+	static bool
+	_read_idx (const std::string& path, backup_info& inf,
+		std::vector<unsigned int> *blocks)
+	{
+		FILE *f = std::fopen (path.c_str (), "rb");
+		if (!f)
+			return false;
+		
+		unsigned char hdr[37];
+		if (std::fread (hdr, 1, sizeof hdr, f) != sizeof hdr
+			|| _get (hdr, 4) != BACKUP_IDX_MAGIC || _get (hdr + 4, 4) != BACKUP_IDX_VERSION)
+			{
+				std::fclose (f);
+				return false;
+			}
+		
+		inf.base = hdr[8] != 0;
+		inf.parent = (int)_get (hdr + 9, 4);
+		inf.file_size = _get (hdr + 13, 8);
+		inf.time = (long long)_get (hdr + 21, 8);
+		inf.block_count = (unsigned int)_get (hdr + 29, 4);
+		
+		bool ok = true;
+		if (blocks && !inf.base)
+			{
+				std::vector<unsigned char> data (inf.block_count * 4);
+				ok = std::fread (data.data (), 1, data.size (), f) == data.size ();
+				blocks->resize (inf.block_count);
+				for (unsigned int i = 0; ok && i < inf.block_count; ++i)
+					(*blocks)[i] = (unsigned int)_get (data.data () + i * 4, 4);
+			}
+		
+		std::fclose (f);
+		return ok;
+	}
+	
+	
+	
+//----
+	
+	/* 
+	 * Backups used to be kept in a directory named after the world exactly as
+	 * it was typed.  Moves the contents of such a directory over to the
+	 * lowercase one, so that old backups are neither lost nor have their
+	 * numbers reused.
+	 */
+	static void
+	_migrate_backup_dir (const std::string& old_dir, const std::string& dir)
+	{
+		if (old_dir == dir)
+			return;
+		
+		DIR *d = opendir (old_dir.c_str ());
+		if (!d)
+			return;
+		
+		mkdir ("data/backups", 0744);
+		if (std::rename (old_dir.c_str (), dir.c_str ()) == 0)
+			{
+				closedir (d);
+				return;
+			}
+		
+		// both exist, move the files one by one.
+		mkdir (dir.c_str (), 0744);
+		bool left_over = false;
+		struct dirent *ent;
+		while ((ent = readdir (d)))
+			{
+				if (std::strcmp (ent->d_name, ".") == 0 || std::strcmp (ent->d_name, "..") == 0)
+					continue;
+				
+				std::string from = old_dir + "/" + ent->d_name;
+				std::string to = dir + "/" + ent->d_name;
+				struct stat st;
+				if (stat (to.c_str (), &st) == 0 || std::rename (from.c_str (), to.c_str ()) != 0)
+					left_over = true;
+			}
+		closedir (d);
+		
+		if (!left_over)
+			rmdir (old_dir.c_str ());
+	}
+	
+	backup_chain::backup_chain (const char *world_name)
+		: world_name (world_name)
+	{
+		for (char& c : this->world_name)
+			c = std::tolower (c);
+		this->dir = "data/backups/" + this->world_name;
+		
+		std::lock_guard<std::mutex> guard {_busy_lock};
+		if (_busy.find (this->world_name) == _busy.end ())
+			_migrate_backup_dir ("data/backups/" + std::string (world_name), this->dir);
+	}
+	
+	
+	
+	/* 
+	 * Returns the path of the old full-copy backup @{num} of the world file
+	 * named @{file_name} (e.g. "world.hw").
+	 */
+	std::string
+	backup_chain::legacy_path (const char *file_name, int num) const
+	{
+		std::ostringstream ss;
+		ss << this->dir << "/" << file_name << "." << num;
+		return ss.str ();
+	}
+	
+	
+	
+	/* 
+	 * Fills @{out} with all backups in the chain, ordered by number.
+	 */
+	void
+	backup_chain::list (std::vector<backup_info>& out)
+	{
+		DIR *d = opendir (this->dir.c_str ());
+		if (!d)
+			return;
+		
+		struct dirent *ent;
+		while ((ent = readdir (d)))
+			{
+				const char *name = ent->d_name;
+				char *end;
+				long num = std::strtol (name, &end, 10);
+				if (end == name || num <= 0 || std::strcmp (end, ".idx") != 0)
+					continue;
+				
+				backup_info inf;
+				if (this->find ((int)num, inf))
+					out.push_back (inf);
+			}
+		closedir (d);
+		
+		std::sort (out.begin (), out.end (),
+			[] (const backup_info& a, const backup_info& b)
+				{ return a.num < b.num; });
+	}
+	
+	/* 
+	 * Reads the description of backup @{num} into @{out}.
+	 */
+	bool
+	backup_chain::find (int num, backup_info& out)
+	{
+		out.num = num;
+		return _read_idx (_backup_path (this->dir, num, ".idx"), out, nullptr);
+	}
+	
+	/* 
+	 * Returns true if a backup or restore of the world is in progress.
+	 */
+	bool
+	backup_chain::busy ()
+	{
+		std::lock_guard<std::mutex> guard {_busy_lock};
+		return _busy.find (this->world_name) != _busy.end ();
+	}
+	
+	
+	
+//----
+	
+	/* 
+	 * Marks blocks taken from the provider as modified again, so that the
+	 * next backup picks them up.
+	 */
+	static void
+	_remark (world &w, std::vector<unsigned int> blocks, bool all,
+		unsigned long long size)
+	{
+		if (all)
+			{
+				blocks.clear ();
+				for (unsigned long long b = 0; b < (size + BACKUP_BLOCK_SIZE - 1) / BACKUP_BLOCK_SIZE; ++b)
+					blocks.push_back ((unsigned int)b);
+			}
+		
+		w.freeze_provider (
+			[&blocks] (world_provider *prov)
+				{ prov->mark_dirty_blocks (blocks); });
+	}
+	
+	/* 
+	 * Writes out backup @{num} of world @{w}.
+	 * 
+	 * The world file is first copied while it is still being written to,
+	 * and every block written to in the meantime is then copied again while
+	 * writes are held off, which leaves a copy of the file as it was at that
+	 * moment.
+	 */
+	static bool
+	_make_backup (world &w, const std::string& dir, backup_info& inf,
+		std::string& err)
+	{
+		w.save_all ();
+		
+		std::vector<unsigned int> blocks; // blocks stored by a delta, in slot order
+		std::vector<unsigned int> taken;  // everything taken from the provider
+		unsigned long long size = 0;
+		bool tracked = false;
+		std::string path;
+		w.freeze_provider (
+			[&] (world_provider *prov)
+				{
+					tracked = prov->take_dirty_blocks (taken, size);
+					path = prov->get_path ();
+				});
+		if (!tracked)
+			inf.base = true;
+		
+		std::string blk_path = _backup_path (dir, inf.num, ".blk");
+		std::string tmp_path = blk_path + ".tmp";
+		int out = ::open (tmp_path.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		int in = ::open (path.c_str (), O_RDONLY);
+		if (in == -1 || out == -1)
+			{
+				if (in != -1) ::close (in);
+				if (out != -1) ::close (out);
+				std::remove (tmp_path.c_str ());
+				_remark (w, taken, inf.base, size);
+				err = "could not open files";
+				return false;
+			}
+		
+		// first pass, concurrent with writes to the world file.
+		bool ok;
+		if (inf.base)
+			{
+				struct stat st;
+				if (::fstat (in, &st) == 0)
+					size = st.st_size;
+				ok = _clone_file (in, out, size);
+			}
+		else
+			{
+				blocks = taken;
+				std::sort (blocks.begin (), blocks.end ());
+				
+				std::vector<std::pair<unsigned int, unsigned int>> moves;
+				for (unsigned int i = 0; i < blocks.size (); ++i)
+					moves.push_back ({blocks[i], i});
+				ok = _copy_blocks (in, out, moves);
+			}
+		::close (in);
+		
+		// second pass, with writes held off.
+		if (ok)
+			w.freeze_provider (
+				[&] (world_provider *prov)
+					{
+						std::vector<unsigned int> more;
+						unsigned long long new_size = 0;
+						bool known = prov->take_dirty_blocks (more, new_size);
+						taken.insert (taken.end (), more.begin (), more.end ());
+						
+						in = ::open (prov->get_path (), O_RDONLY);
+						if (in == -1)
+							{ ok = false; return; }
+						
+						if (!known)
+							{
+								// no telling what changed (or the file was replaced), so copy
+								// all of it again, now that it cannot change.
+								struct stat st;
+								ok = (::fstat (in, &st) == 0);
+								new_size = st.st_size;
+								inf.base = true;
+								blocks.clear ();
+								ok = ok && _clone_file (in, out, new_size);
+							}
+						else if (inf.base)
+							{
+								std::vector<std::pair<unsigned int, unsigned int>> moves;
+								for (unsigned int b : more)
+									moves.push_back ({b, b});
+								ok = _copy_blocks (in, out, moves)
+									&& (::ftruncate (out, new_size) == 0);
+							}
+						else
+							{
+								std::unordered_map<unsigned int, unsigned int> slots;
+								for (unsigned int i = 0; i < blocks.size (); ++i)
+									slots[blocks[i]] = i;
+								
+								std::vector<std::pair<unsigned int, unsigned int>> moves;
+								for (unsigned int b : more)
+									{
+										auto itr = slots.find (b);
+										if (itr != slots.end ())
+											moves.push_back ({b, itr->second});
+										else
+											{
+												moves.push_back ({b, (unsigned int)blocks.size ()});
+												blocks.push_back (b);
+											}
+									}
+								ok = _copy_blocks (in, out, moves);
+							}
+						
+						::close (in);
+						size = new_size;
+					});
+		
+		ok = ok && (::fsync (out) == 0);
+		::close (out);
+		
+		inf.file_size = size;
+		inf.time = std::time (nullptr);
+		if (inf.base)
+			{
+				inf.parent = 0;
+				inf.block_count = (size + BACKUP_BLOCK_SIZE - 1) / BACKUP_BLOCK_SIZE;
+			}
+		else
+			inf.block_count = blocks.size ();
+		
+		// the index file is written last, which commits the backup.
+		ok = ok && (std::rename (tmp_path.c_str (), blk_path.c_str ()) == 0);
+		ok = ok && _write_idx (_backup_path (dir, inf.num, ".idx"), inf,
+			inf.base ? std::vector<unsigned int> () : blocks);
+		if (!ok)
+			{
+				std::remove (tmp_path.c_str ());
+				std::remove (blk_path.c_str ());
+				_remark (w, taken, inf.base, size);
+				err = "failed to copy world file";
+				return false;
+			}
+		
+		return true;
+	}
+	
+	/* 
+	 * Backs up world @{w} in the background.
+	 */
+	bool
+	backup_chain::start (world &w, std::function<void (int, const std::string&)> done)
+	{
+		if (!_acquire (this->world_name))
+			return false;
+		
+		mkdir ("data/backups", 0744);
+		mkdir (this->dir.c_str (), 0744);
+		
+		std::vector<backup_info> chain;
+		this->list (chain);
+		
+		// backup numbers continue from those of old full-copy backups
+		// (<world>.hw.<num>), which can still be restored.
+		int last = chain.empty () ? 0 : chain.back ().num;
+		DIR *d = opendir (this->dir.c_str ());
+		if (d)
+			{
+				struct dirent *ent;
+				while ((ent = readdir (d)))
+					{
+						const char *dot = std::strrchr (ent->d_name, '.');
+						if (!dot || dot == ent->d_name || !std::isdigit (dot[1]))
+							continue;
+						int num = std::atoi (dot + 1);
+						if (num > last)
+							last = num;
+					}
+				closedir (d);
+			}
+		
+		backup_info inf;
+		inf.num = last + 1;
+		inf.parent = chain.empty () ? 0 : chain.back ().num;
+		inf.base = true;
+		if (!chain.empty ())
+			{
+				int deltas = 0;
+				for (auto itr = chain.rbegin (); itr != chain.rend () && !itr->base; ++itr)
+					++ deltas;
+				inf.base = (deltas >= backup_chain::base_interval - 1);
+			}
+		
+		std::string dir = this->dir;
+		std::string name = this->world_name;
+		w.run_async (
+			[&w, dir, name, inf, done] () mutable
+				{
+					std::string err;
+					bool ok = _make_backup (w, dir, inf, err);
+					_release (name);
+					done (ok ? inf.num : -1, err);
+				});
+		return true;
+	}
+	
+	
+	
+	/* 
+	 * Rebuilds the world file as it was at backup @{num} from the chain, and
+	 * writes it out to @{dest_path}.
+	 */
+	bool
+	backup_chain::restore (int num, const char *dest_path, std::string& err)
+	{
+		if (!_acquire (this->world_name))
+			{
+				err = "a backup of the world is in progress";
+				return false;
+			}
+		
+		// walk back to the closest base.
+		std::vector<backup_info> chain;
+		for (int n = num; ; )
+			{
+				backup_info inf;
+				if (!this->find (n, inf) || (int)chain.size () > 4096)
+					{
+						std::ostringstream ss;
+						ss << "backup #" << n << " is missing or damaged";
+						err = ss.str ();
+						_release (this->world_name);
+						return false;
+					}
+				
+				chain.push_back (inf);
+				if (inf.base)
+					break;
+				n = inf.parent;
+			}
+		std::reverse (chain.begin (), chain.end ());
+		
+		std::string tmp_path = std::string (dest_path) + ".restore";
+		int out = ::open (tmp_path.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		bool ok = (out != -1);
+		for (size_t i = 0; ok && i < chain.size (); ++i)
+			{
+				const backup_info& inf = chain[i];
+				int in = ::open (_backup_path (this->dir, inf.num, ".blk").c_str (), O_RDONLY);
+				if (in == -1)
+					{ ok = false; break; }
+				
+				if (inf.base)
+					ok = _clone_file (in, out, inf.file_size);
+				else
+					{
+						backup_info dinf;
+						std::vector<unsigned int> blocks;
+						ok = _read_idx (_backup_path (this->dir, inf.num, ".idx"), dinf, &blocks);
+						
+						std::vector<std::pair<unsigned int, unsigned int>> moves;
+						for (unsigned int j = 0; j < blocks.size (); ++j)
+							moves.push_back ({j, blocks[j]});
+						ok = ok && _copy_blocks (in, out, moves);
+					}
+				::close (in);
+			}
+		
+		if (ok)
+			ok = (::ftruncate (out, chain.back ().file_size) == 0) && (::fsync (out) == 0);
+		if (out != -1)
+			::close (out);
+		
+		ok = ok && (std::rename (tmp_path.c_str (), dest_path) == 0);
+		if (!ok)
+			{
+				std::remove (tmp_path.c_str ());
+				err = "failed to rebuild world file";
+			}
+		
+		_release (this->world_name);
+		return ok;
+	}
+}
+
@@ -0,0 +1,230 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "world/change_tracker.hpp"
+#include "world/world.hpp"
+#include "world/chunk.hpp"
+#include "player/player.hpp"
+#include "system/packet.hpp"
+#include <mutex>
+
+
+namespace hCraft {
+	
+	/* 
+	 * Approximate on-wire costs (in bytes) of the packets the tracker can
+	 * choose from. Section costs also account for the time spent compressing
+	 * them.
+	 */
+	static const int block_change_cost  = 13;
+	static const int mbc_base_cost      = 17;
+	static const int mbc_record_cost    = 4;
+	static const int chunk_base_cost    = 20;
+	static const int chunk_section_cost = 3072;
+	
+	
+	
+	chunk_change_tracker::chunk_change_tracker (world *w)
+		: w (w)
+		{ }
+	
+	
+	
+	/* 
+	 * Records a change made to the block at the specified coordinates.
+	 * The given block types should be the ones that players see (i.e.
+	 * vanilla equivalents of physics blocks).
+	 */
+	void
+	chunk_change_tracker::mark (int x, int y, int z, blocki old_bl,
+		blocki new_bl, bool forced)
+	{
+		if (y < 0 || y > 255)
+			return;
+		
+		tracked_chunk& tch = this->chunks[{x >> 4, z >> 4}];
+		unsigned short key = (y << 8) | ((z & 0xF) << 4) | (x & 0xF);
+		
+		auto itr = tch.blocks.find (key);
+		if (itr == tch.blocks.end ())
+			tch.blocks[key] = {old_bl, new_bl, forced};
+		else
+			{
+				itr->second.new_bl = new_bl;
+				itr->second.forced |= forced;
+			}
+	}
+	
+	
+	
+	namespace {
+		
+		enum change_method
+		{
+			CM_BLOCK_CHANGE,
+			CM_MULTI_BLOCK_CHANGE,
+			CM_SECTIONS,
+		};
+		
+		change_method
+		_pick_method (int records, unsigned short dirty, chunk *ch)
+		{
+			int mbc_cost = mbc_base_cost + records * mbc_record_cost;
+			if (records * block_change_cost <= mbc_cost)
+				return CM_BLOCK_CHANGE;
+			if (!ch)
+				return CM_MULTI_BLOCK_CHANGE;
+			
+			/* 
+			 * A full chunk packet is never cheaper than resending just the dirty
+			 * sections: it carries every non-empty section plus biome data.
+			 */
+			int dirty_count = 0;
+			for (int i = 0; i < 16; ++i)
+				if (dirty & (1 << i))
+					++ dirty_count;
+			
+			int sect_cost = chunk_base_cost + dirty_count * chunk_section_cost;
+			if (records <= 65535 && mbc_cost <= sect_cost)
+				return CM_MULTI_BLOCK_CHANGE;
+			return CM_SECTIONS;
+		}
+	}
+	
+	void
+	chunk_change_tracker::send_chunk (std::vector<player *>& _players, int cx,
+		int cz, tracked_chunk& tch)
+	{
+		std::vector<block_change_record> records;
+		unsigned short dirty = 0;
+		for (auto itr = tch.blocks.begin (); itr != tch.blocks.end (); ++itr)
+			{
+				tracked_block& tb = itr->second;
+				if (!tb.forced && (tb.old_bl.id == tb.new_bl.id)
+					&& (tb.old_bl.meta == tb.new_bl.meta))
+					continue; // block got reverted back to its original state
+				
+				unsigned short key = itr->first;
+				records.push_back ({(unsigned char)(key & 0xF), (unsigned char)(key >> 8),
+					(unsigned char)((key >> 4) & 0xF), tb.new_bl.id, tb.new_bl.meta});
+				dirty |= 1 << (key >> 12);
+			}
+		if (records.empty ())
+			return;
+		
+		std::vector<player *> players;
+		for (player *pl : _players)
+			if ((pl->get_world () == this->w) && pl->can_see_chunk (cx, cz))
+				players.push_back (pl);
+		if (players.empty ())
+			return;
+		
+		chunk *ch = this->w->get_chunk (cx, cz);
+		if (ch == this->w->get_edge_chunk ())
+			ch = nullptr;
+		
+		change_method method = _pick_method (records.size (), dirty, ch);
+		switch (method)
+			{
+			case CM_BLOCK_CHANGE:
+				for (block_change_record& rec : records)
+					{
+						int x = (cx << 4) | rec.x;
+						int z = (cz << 4) | rec.z;
+						for (player *pl : players)
+							if (!pl->sb_exists (x, rec.y, z))
+								pl->send (packets::play::make_block_change (x, rec.y, z,
+									rec.id, rec.meta));
+					}
+				break;
+			
+			case CM_MULTI_BLOCK_CHANGE:
+				// selection blocks are filtered out on a per-player basis.
+				for (player *pl : players)
+					pl->send (packets::play::make_multi_block_change (cx, cz, records, pl));
+				break;
+			
+			case CM_SECTIONS:
+				{
+					std::vector<edit_stage *> es_vec;
+					packet *pack = packets::play::make_chunk_sections (cx, cz, ch, dirty, es_vec);
+					if (!pack)
+						return;
+					
+					for (player *pl : players)
+						{
+							pl->send (new packet (*pack));
+							
+							// the resent sections wiped out any selection blocks the player
+							// had in them.
+							std::lock_guard<std::mutex> guard {pl->sb_lock};
+							for (auto& sb : pl->sel_blocks)
+								if (((sb.x >> 4) == cx) && ((sb.z >> 4) == cz)
+									&& (dirty & (1 << (sb.y >> 4))))
+									pl->sb_send (sb.x, sb.y, sb.z);
+						}
+					delete pack;
+					
+					// and signs too.
+					std::lock_guard<std::mutex> guard {ch->ly_signs.lock};
+					for (auto itr = ch->ly_signs.signs.begin ();
+						itr != ch->ly_signs.signs.end (); ++itr)
+						{
+							block_pos pos = itr->first;
+							if (!(dirty & (1 << (pos.y >> 4))))
+								continue;
+							
+							auto& sign = itr->second;
+							packet *sp = packets::play::make_update_sign (pos.x, pos.y, pos.z,
+								sign.l1.c_str (), sign.l2.c_str (), sign.l3.c_str (),
+								sign.l4.c_str ());
+							for (player *pl : players)
+								pl->send (new packet (*sp));
+							delete sp;
+						}
+				}
+				break;
+			}
+	}
+	
+	
+	
+	/* 
+	 * Sends all recorded changes to the specified players, and clears the
+	 * tracker.
+	 */
+	void
+	chunk_change_tracker::flush (std::vector<player *>& players)
+	{
+		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+			this->send_chunk (players, itr->first.x, itr->first.z, itr->second);
+		this->clear ();
+	}
+	
+	
+	
+	/* 
+	 * Discards all recorded changes.
+	 */
+	void
+	chunk_change_tracker::clear ()
+	{
+		this->chunks.clear ();
+	}
+}
+
@@ -18,7 +18,9 @@
 
 #include "world/chunk.hpp"
 #include "world/world.hpp"
+#include "world/chunk_kernels.hpp"
 #include <cstring>
+#include <algorithm>
 
 #include <iostream> // DEBUG
 
@@ -81,25 +83,37 @@ namespace hCraft {
 	
 //-------------------------------------------------------------
 	
+	// set by subchunk::operator new () when the pool hands out memory that is
+	// still all zero, and consumed by the constructor that runs right after.
+	static thread_local bool _sub_zeroed = false;
+	
 	/* 
 	 * Constructs a new empty subchunk, with all blocks set to air.
 	 */
 	subchunk::subchunk (bool init)
 	{
+		bool zeroed = _sub_zeroed;
+		_sub_zeroed = false;
+		
 		if (init)
 			{
-				std::memset (this->ids, 0x00, 4096);
-				std::memset (this->meta, 0x00, 2048);
-				std::memset (this->blight, 0x00, 2048);
+				// fresh pool memory only needs the non-zero parts set, which
+				// leaves the rest of its pages untouched until they are written.
+				if (!zeroed)
+					{
+						std::memset (this->ids, 0x00, 4096);
+						std::memset (this->meta, 0x00, 2048);
+						std::memset (this->blight, 0x00, 2048);
+						std::memset (this->extra, 0x00, 4096);
+						
+						for (int i = 0; i < 128; ++i)
+							this->custom[i] = 0;
+					}
 				std::memset (this->slight, 0xFF, 2048);
 				this->add = nullptr;
-				std::memset (this->extra, 0x00, 4096);
 		
 				this->add_count = 0;
 				this->air_count = 4096;
-				
-				for (int i = 0; i < 128; ++i)
-					this->custom[i] = 0;
 			}
 	}
 	
@@ -108,6 +122,8 @@ namespace hCraft {
 	 */
 	subchunk::subchunk (const subchunk& sub)
 	{
+		_sub_zeroed = false;
+		
 		std::memcpy (this->ids, sub.ids, 4096);
 		std::memcpy (this->meta, sub.meta, 2048);
 		std::memcpy (this->blight, sub.blight, 2048);
@@ -119,6 +135,7 @@ namespace hCraft {
 			}
 		else
 			this->add = nullptr;
+		std::memcpy (this->extra, sub.extra, 4096);
 		
 		this->add_count = sub.add_count;
 		this->air_count = sub.air_count;
@@ -136,6 +153,24 @@ namespace hCraft {
 	}
 	
 	
+	void*
+	subchunk::operator new (std::size_t size)
+	{
+		if (size != sizeof (subchunk))
+			return ::operator new (size);
+		return chunk::subchunk_pool ().alloc (&_sub_zeroed);
+	}
+	
+	void
+	subchunk::operator delete (void *ptr, std::size_t size)
+	{
+		if (size != sizeof (subchunk))
+			::operator delete (ptr);
+		else
+			chunk::subchunk_pool ().free (ptr);
+	}
+	
+	
 	
 //----
 	
@@ -389,6 +424,175 @@ namespace hCraft {
 	
 	
 	
+//----
+	
+	/* 
+	 * Fills nibbles [from, to] (inclusive) of the given nibble array.
+	 */
+	static void
+	_fill_nibbles (unsigned char *arr, unsigned int from, unsigned int to,
+		unsigned char val)
+	{
+		val &= 0xF;
+		if (from & 1)
+			{
+				arr[from >> 1] &= 0x0F;
+				arr[from >> 1] |= (val << 4);
+				++ from;
+			}
+		if (from > to)
+			return;
+		
+		if (!(to & 1))
+			{
+				arr[to >> 1] &= 0xF0;
+				arr[to >> 1] |= val;
+				if (to == 0)
+					return;
+				-- to;
+			}
+		if (from < to)
+			std::memset (arr + (from >> 1), val | (val << 4), ((to - from) >> 1) + 1);
+	}
+	
+	
+	void
+	subchunk::fill (unsigned short id, unsigned char meta, unsigned char ex)
+	{
+		unsigned char hi = id >> 8;
+		
+		std::memset (this->ids, id & 0xFF, 4096);
+		std::memset (this->meta, (meta & 0xF) | (meta << 4), 2048);
+		std::memset (this->extra, ex, 4096);
+		
+		if (hi)
+			{
+				if (!this->add)
+					this->add = new unsigned char[2048];
+				std::memset (this->add, hi | (hi << 4), 2048);
+				this->add_count = 4096;
+			}
+		else
+			{
+				delete[] this->add;
+				this->add = nullptr;
+				this->add_count = 0;
+			}
+		
+		this->air_count = id ? 0 : 4096;
+		std::memset (this->custom, block_info::is_vanilla_id (id) ? 0x00 : 0xFF,
+			sizeof this->custom);
+	}
+	
+	void
+	subchunk::fill_box (int x1, int y1, int z1, int x2, int y2, int z2,
+		unsigned short id, unsigned char meta, unsigned char ex, bool recount)
+	{
+		if (x1 > x2) std::swap (x1, x2);
+		if (y1 > y2) std::swap (y1, y2);
+		if (z1 > z2) std::swap (z1, z2);
+		
+		if (x1 == 0 && y1 == 0 && z1 == 0 && x2 == 15 && y2 == 15 && z2 == 15)
+			{
+				this->fill (id, meta, ex);
+				return;
+			}
+		
+		unsigned char lo = id & 0xFF;
+		unsigned char hi = id >> 8;
+		if (hi && !this->add)
+			{
+				this->add = new unsigned char[2048];
+				std::memset (this->add, 0x00, 2048);
+			}
+		
+		int len = x2 - x1 + 1;
+		for (int y = y1; y <= y2; ++y)
+			for (int z = z1; z <= z2; ++z)
+				{
+					unsigned int row = (y << 8) | (z << 4);
+					std::memset (this->ids + row + x1, lo, len);
+					std::memset (this->extra + row + x1, ex, len);
+					_fill_nibbles (this->meta, row + x1, row + x2, meta);
+					if (this->add)
+						_fill_nibbles (this->add, row + x1, row + x2, hi);
+				}
+		
+		if (recount)
+			this->recalc_counts ();
+	}
+	
+	void
+	subchunk::set_block_raw (int x, int y, int z, unsigned short id,
+		unsigned char meta, unsigned char ex)
+	{
+		unsigned int index = (y << 8) | (z << 4) | x; 
+		unsigned int half = index >> 1;
+		
+		unsigned short hi = id >> 8;
+		if (hi && !this->add)
+			{
+				this->add = new unsigned char[2048];
+				std::memset (this->add, 0x00, 2048);
+			}
+		
+		this->ids[index] = id & 0xFF;
+		this->extra[index] = ex;
+		if (index & 1)
+			{
+				this->meta[half] = (this->meta[half] & 0x0F) | (meta << 4);
+				if (this->add)
+					this->add[half] = (this->add[half] & 0x0F) | (hi << 4);
+			}
+		else
+			{
+				this->meta[half] = (this->meta[half] & 0xF0) | (meta & 0xF);
+				if (this->add)
+					this->add[half] = (this->add[half] & 0xF0) | hi;
+			}
+	}
+	
+	
+	/* 
+	 * Rebuilds the air\add counts and the custom block bitmap from the
+	 * subchunk's ID arrays.
+	 */
+	void
+	subchunk::recalc_counts ()
+	{
+		// lower 8 bits first, as if there were no add array.
+		int air = 4096 - chunk_kernels::classify_ids (this->ids, this->custom);
+		
+		// then correct for blocks that have their upper 4 bits set.
+		int adds = 0;
+		if (this->add)
+			{
+				for (int i = 0; i < 4096; ++i)
+					{
+						unsigned char hi = (i & 1) ? (this->add[i >> 1] >> 4)
+																			 : (this->add[i >> 1] & 0xF);
+						if (hi)
+							{
+								++ adds;
+								if (!this->ids[i])
+									-- air;
+								this->custom[i >> 5] |= (1U << (i & 0x1F));
+							}
+					}
+				
+				if (adds == 0)
+					{
+						delete[] this->add;
+						this->add = nullptr;
+					}
+			}
+		
+		this->air_count = air;
+		this->add_count = adds;
+	}
+	
+	
+	
 //----
 	
 	/* 
@@ -407,6 +611,7 @@ namespace hCraft {
 		std::memset (this->biomes, BI_PLAINS, 256);
 		this->modified = true;
 		this->generated = false;
+		this->last_access = 0;
 		
 		this->north = this->south = this->east = this->west = nullptr;
 	}
@@ -424,6 +629,43 @@ namespace hCraft {
 	}
 	
 	
+	void*
+	chunk::operator new (std::size_t size)
+	{
+		if (size != sizeof (chunk))
+			return ::operator new (size);
+		return chunk::chunk_pool ().alloc ();
+	}
+	
+	void
+	chunk::operator delete (void *ptr, std::size_t size)
+	{
+		if (size != sizeof (chunk))
+			::operator delete (ptr);
+		else
+			chunk::chunk_pool ().free (ptr);
+	}
+	
+	/* 
+	 * Returns the pools used to allocate chunks and subchunks.
+	 * They are never destroyed, since chunks may outlive static destructors.
+	 */
+	slab_pool&
+	chunk::chunk_pool ()
+	{
+		static slab_pool *pool = new slab_pool ("chunk", sizeof (chunk));
+		return *pool;
+	}
+	
+	slab_pool&
+	chunk::subchunk_pool ()
+	{
+		// ~20KB subchunks: 2MB slabs hold about a hundred.
+		static slab_pool *pool = new slab_pool ("subchunk", sizeof (subchunk), 2 << 20);
+		return *pool;
+	}
+	
+	
 	
 	/* 
 	 * Creates (if does not already exist) and returns the sub-chunk located at
@@ -623,6 +865,65 @@ namespace hCraft {
 	
 	 
 	
+	/* 
+	 * Bulk block interaction:
+	 */
+	
+	void
+	chunk::fill_sub (int sy, unsigned short id, unsigned char meta, unsigned char ex)
+	{
+		subchunk *sub = this->subs[sy];
+		if (!sub)
+			{
+				if (id == 0 && ex == 0)
+					return;
+				else
+					sub = this->subs[sy] = new subchunk ();
+			}
+		
+		this->modified = true;
+		sub->fill (id, meta, ex);
+	}
+	
+	void
+	chunk::copy_sub (int sy, const subchunk& sub)
+	{
+		subchunk *prev = this->subs[sy];
+		if (prev == &sub)
+			return;
+		
+		this->subs[sy] = new subchunk (sub);
+		delete prev;
+		this->modified = true;
+	}
+	
+	void
+	chunk::fill_box (int x1, int y1, int z1, int x2, int y2, int z2,
+		unsigned short id, unsigned char meta, unsigned char ex)
+	{
+		if (y1 > y2) std::swap (y1, y2);
+		
+		for (int sy = (y1 >> 4); sy <= (y2 >> 4); ++sy)
+			{
+				int sy1 = (sy == (y1 >> 4)) ? (y1 & 0xF) : 0;
+				int sy2 = (sy == (y2 >> 4)) ? (y2 & 0xF) : 15;
+				
+				subchunk *sub = this->subs[sy];
+				if (!sub)
+					{
+						if (id == 0 && ex == 0)
+							continue;
+						sub = this->subs[sy] = new subchunk ();
+					}
+				
+				sub->fill_box (x1, sy1, z1, x2, sy2, z2, id, meta, ex);
+			}
+		
+		this->modified = true;
+	}
+	
+	
+	
 //----
 	
 	/* 
@@ -660,8 +961,8 @@ namespace hCraft {
 		short h;
 		for (h = 255; h >= 0; --h)
 			{ 
-				block_info *binf = block_info::from_id (this->get_id (x, h, z));
-				if (binf->state == BS_SOLID && binf->opaque)
+				unsigned short id = this->get_id (x, h, z);
+				if (block_props::is_solid (id) && block_props::is_opaque (id))
 					break;
 			}
 		this->set_height (x, z, h + 1);
@@ -671,9 +972,23 @@ namespace hCraft {
 	void
 	chunk::recalc_heightmap ()
 	{
-		for (int x = 0; x < 16; ++x)
-			for (int z = 0; z < 16; ++z)
-				this->recalc_heightmap (x, z);
+		const unsigned char *ids[16];
+		for (int i = 0; i < 16; ++i)
+			{
+				subchunk *sub = this->subs[i];
+				if (sub && sub->has_add ())
+					{
+						// the kernel only looks at the lower 8 bits of IDs.
+						for (int x = 0; x < 16; ++x)
+							for (int z = 0; z < 16; ++z)
+								this->recalc_heightmap (x, z);
+						return;
+					}
+				
+				ids[i] = (sub && !sub->all_air ()) ? sub->ids : nullptr;
+			}
+		
+		chunk_kernels::heightmap (ids, block_props::height_table, this->heightmap);
 	}
 	
 	
@@ -711,10 +1026,42 @@ namespace hCraft {
 			f (e);
 	}
 	
+	/* 
+	 * Checks whether the chunk's entity list is non-empty.
+	 */
+	bool
+	chunk::has_entities ()
+	{
+		std::lock_guard<std::mutex> guard {this->entity_lock};
+		return !this->entities.empty ();
+	}
+	
 	
 	
 //----
 	
+	/* 
+	 * Returns the approximate amount of heap memory (in bytes) used by this
+	 * chunk and its sub-chunks.
+	 */
+	size_t
+	chunk::memory_usage ()
+	{
+		size_t total = sizeof (chunk);
+		for (int i = 0; i < 16; ++i)
+			{
+				subchunk *sub = this->subs[i];
+				if (sub)
+					{
+						total += sizeof (subchunk);
+						if (sub->add)
+							total += 2048;
+					}
+			}
+		
+		return total;
+	}
+	
 	/* 
 	 * Returns a copy of this chunk.
 	 * NOTE: Only block data is copied.
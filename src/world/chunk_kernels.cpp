@@ -0,0 +1,631 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "world/chunk_kernels.hpp"
+#include "slot/blocks.hpp"
+#include <cstring>
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#	define HCRAFT_KERNELS_X86
+#	include <cpuid.h>
+#	include <immintrin.h>
+#	define _TARGET_SSE2 __attribute__ ((target ("sse2")))
+#	define _TARGET_AVX2 __attribute__ ((target ("avx2")))
+#endif
+
+
+namespace hCraft {
+	
+	namespace chunk_kernels {
+		
+		/* 
+		 * Scalar kernels:
+		 * 
+		 * These define what the other versions must produce, and are used as is
+		 * on CPUs without SSE2.
+		 */
+		
+		static int
+		_classify_ids_scalar (const unsigned char *ids, unsigned int *custom)
+		{
+			int nonair = 0;
+			for (int i = 0; i < 4096; i += 32)
+				{
+					unsigned int bits = 0;
+					for (int j = 0; j < 32; ++j)
+						{
+							unsigned char id = ids[i + j];
+							if (id)
+								++ nonair;
+							if (!block_info::is_vanilla_id (id))
+								bits |= (1U << j);
+						}
+					custom[i >> 5] = bits;
+				}
+			
+			return nonair;
+		}
+		
+		static void
+		_heightmap_scalar (const unsigned char *const *subs,
+			const unsigned char *table, int *heights)
+		{
+			for (int c = 0; c < 256; ++c)
+				{
+					int h = 0;
+					for (int s = 15; (s >= 0) && !h; --s)
+						{
+							const unsigned char *ids = subs[s];
+							if (!ids)
+								continue;
+							
+							for (int y = 15; y >= 0; --y)
+								if (table[ids[(y << 8) | c]])
+									{ h = (s << 4) + y + 1; break; }
+						}
+					
+					heights[c] = h;
+				}
+		}
+		
+		static void
+		_translate_ids_scalar (const unsigned char *ids, const unsigned char *meta,
+			const unsigned int *custom, const unsigned char *id_table,
+			const unsigned char *meta_table, unsigned char *out_ids,
+			unsigned char *out_meta)
+		{
+			for (int g = 0; g < 128; ++g)
+				{
+					const unsigned char *gi = ids + (g << 5);
+					const unsigned char *gm = meta + (g << 4);
+					unsigned char *oi = out_ids + (g << 5);
+					unsigned char *om = out_meta + (g << 4);
+					
+					if (!custom[g])
+						{
+							std::memcpy (oi, gi, 32);
+							std::memcpy (om, gm, 16);
+							continue;
+						}
+					
+					for (int j = 0; j < 32; j += 2)
+						{
+							unsigned char a = gi[j], b = gi[j + 1];
+							unsigned char ma = meta_table[a], mb = meta_table[b];
+							unsigned char m = gm[j >> 1];
+							
+							oi[j] = id_table[a];
+							oi[j + 1] = id_table[b];
+							om[j >> 1] = ((ma == 0xFF) ? (m & 0xF) : ma)
+								| (((mb == 0xFF) ? (m >> 4) : mb) << 4);
+						}
+				}
+		}
+		
+		static void
+		_pack_nibbles_scalar (const unsigned char *in, unsigned char *out,
+			int count)
+		{
+			for (int i = 0; i < (count >> 1); ++i)
+				out[i] = (in[i << 1] & 0xF) | ((in[(i << 1) + 1] & 0xF) << 4);
+		}
+		
+		static void
+		_unpack_nibbles_scalar (const unsigned char *in, unsigned char *out,
+			int count)
+		{
+			for (int i = 0; i < (count >> 1); ++i)
+				{
+					out[i << 1] = in[i] & 0xF;
+					out[(i << 1) + 1] = in[i] >> 4;
+				}
+		}
+		
+		
+		
+#ifdef HCRAFT_KERNELS_X86
+	//----
+		/* 
+		 * SSE2 kernels:
+		 */
+		
+		// sets the bytes of IDs that are not recognized by the vanilla client
+		// (0xA5-0xA9 and 0xB0 and above).
+		_TARGET_SSE2 static inline __m128i
+		_custom_mask_sse2 (__m128i v)
+		{
+			__m128i ge_a5 = _mm_cmpeq_epi8 (_mm_max_epu8 (v, _mm_set1_epi8 ((char)0xA5)), v);
+			__m128i le_a9 = _mm_cmpeq_epi8 (_mm_min_epu8 (v, _mm_set1_epi8 ((char)0xA9)), v);
+			__m128i ge_b0 = _mm_cmpeq_epi8 (_mm_max_epu8 (v, _mm_set1_epi8 ((char)0xB0)), v);
+			return _mm_or_si128 (_mm_and_si128 (ge_a5, le_a9), ge_b0);
+		}
+		
+		// 16 packed bytes -> 32 nibbles.
+		_TARGET_SSE2 static inline void
+		_unpack16_sse2 (__m128i v, __m128i& lo, __m128i& hi)
+		{
+			const __m128i mask = _mm_set1_epi8 (0x0F);
+			__m128i l = _mm_and_si128 (v, mask);
+			__m128i h = _mm_and_si128 (_mm_srli_epi16 (v, 4), mask);
+			lo = _mm_unpacklo_epi8 (l, h);
+			hi = _mm_unpackhi_epi8 (l, h);
+		}
+		
+		// 32 nibbles -> 16 packed bytes.
+		_TARGET_SSE2 static inline __m128i
+		_pack32_sse2 (__m128i lo, __m128i hi)
+		{
+			const __m128i mask = _mm_set1_epi8 (0x0F);
+			const __m128i low_bytes = _mm_set1_epi16 (0x00FF);
+			lo = _mm_and_si128 (lo, mask);
+			hi = _mm_and_si128 (hi, mask);
+			lo = _mm_and_si128 (_mm_or_si128 (lo, _mm_srli_epi16 (lo, 4)), low_bytes);
+			hi = _mm_and_si128 (_mm_or_si128 (hi, _mm_srli_epi16 (hi, 4)), low_bytes);
+			return _mm_packus_epi16 (lo, hi);
+		}
+		
+		_TARGET_SSE2 static int
+		_classify_ids_sse2 (const unsigned char *ids, unsigned int *custom)
+		{
+			const __m128i zero = _mm_setzero_si128 ();
+			int air = 0;
+			for (int i = 0; i < 4096; i += 32)
+				{
+					__m128i v0 = _mm_loadu_si128 ((const __m128i *)(ids + i));
+					__m128i v1 = _mm_loadu_si128 ((const __m128i *)(ids + i + 16));
+					air += __builtin_popcount (_mm_movemask_epi8 (_mm_cmpeq_epi8 (v0, zero)));
+					air += __builtin_popcount (_mm_movemask_epi8 (_mm_cmpeq_epi8 (v1, zero)));
+					
+					custom[i >> 5] = (unsigned int)_mm_movemask_epi8 (_custom_mask_sse2 (v0))
+						| ((unsigned int)_mm_movemask_epi8 (_custom_mask_sse2 (v1)) << 16);
+				}
+			
+			return 4096 - air;
+		}
+		
+		/* 
+		 * Walks the chunk one 16x16 layer at a time from the top, keeping a mask
+		 * of the columns whose height is still unknown, and only looks up the
+		 * non-air blocks of those columns.
+		 */
+		_TARGET_SSE2 static void
+		_heightmap_sse2 (const unsigned char *const *subs,
+			const unsigned char *table, int *heights)
+		{
+			if (table[0])
+				{ _heightmap_scalar (subs, table, heights); return; }
+			
+			const __m128i zero = _mm_setzero_si128 ();
+			unsigned int pending[16];
+			for (int g = 0; g < 16; ++g)
+				pending[g] = 0xFFFF;
+			int left = 256;
+			std::memset (heights, 0, 256 * sizeof (int));
+			
+			for (int s = 15; s >= 0; --s)
+				{
+					const unsigned char *ids = subs[s];
+					if (!ids)
+						continue;
+					
+					for (int y = 15; y >= 0; --y)
+						{
+							const unsigned char *layer = ids + (y << 8);
+							for (int g = 0; g < 16; ++g)
+								{
+									if (!pending[g])
+										continue;
+									
+									const unsigned char *row = layer + (g << 4);
+									__m128i v = _mm_loadu_si128 ((const __m128i *)row);
+									unsigned int nz = ~(unsigned int)_mm_movemask_epi8 (
+										_mm_cmpeq_epi8 (v, zero)) & pending[g];
+									while (nz)
+										{
+											int b = __builtin_ctz (nz);
+											nz &= nz - 1;
+											if (table[row[b]])
+												{
+													heights[(g << 4) | b] = (s << 4) + y + 1;
+													pending[g] &= ~(1U << b);
+													-- left;
+												}
+										}
+								}
+							
+							if (left == 0)
+								return;
+						}
+				}
+		}
+		
+		_TARGET_SSE2 static void
+		_translate_ids_sse2 (const unsigned char *ids, const unsigned char *meta,
+			const unsigned int *custom, const unsigned char *id_table,
+			const unsigned char *meta_table, unsigned char *out_ids,
+			unsigned char *out_meta)
+		{
+			const __m128i keep = _mm_set1_epi8 ((char)0xFF);
+			unsigned char tm[32];
+			
+			for (int g = 0; g < 128; ++g)
+				{
+					const unsigned char *gi = ids + (g << 5);
+					const unsigned char *gm = meta + (g << 4);
+					unsigned char *oi = out_ids + (g << 5);
+					unsigned char *om = out_meta + (g << 4);
+					
+					if (!custom[g])
+						{
+							_mm_storeu_si128 ((__m128i *)oi, _mm_loadu_si128 ((const __m128i *)gi));
+							_mm_storeu_si128 ((__m128i *)(oi + 16), _mm_loadu_si128 ((const __m128i *)(gi + 16)));
+							_mm_storeu_si128 ((__m128i *)om, _mm_loadu_si128 ((const __m128i *)gm));
+							continue;
+						}
+					
+					// there is no byte gather, so the table lookups stay scalar.
+					for (int j = 0; j < 32; ++j)
+						{
+							oi[j] = id_table[gi[j]];
+							tm[j] = meta_table[gi[j]];
+						}
+					
+					__m128i n0, n1;
+					_unpack16_sse2 (_mm_loadu_si128 ((const __m128i *)gm), n0, n1);
+					__m128i t0 = _mm_loadu_si128 ((const __m128i *)tm);
+					__m128i t1 = _mm_loadu_si128 ((const __m128i *)(tm + 16));
+					__m128i k0 = _mm_cmpeq_epi8 (t0, keep);
+					__m128i k1 = _mm_cmpeq_epi8 (t1, keep);
+					n0 = _mm_or_si128 (_mm_and_si128 (k0, n0), _mm_andnot_si128 (k0, t0));
+					n1 = _mm_or_si128 (_mm_and_si128 (k1, n1), _mm_andnot_si128 (k1, t1));
+					_mm_storeu_si128 ((__m128i *)om, _pack32_sse2 (n0, n1));
+				}
+		}
+		
+		_TARGET_SSE2 static void
+		_pack_nibbles_sse2 (const unsigned char *in, unsigned char *out,
+			int count)
+		{
+			int i = 0;
+			for (; i + 32 <= count; i += 32)
+				{
+					__m128i lo = _mm_loadu_si128 ((const __m128i *)(in + i));
+					__m128i hi = _mm_loadu_si128 ((const __m128i *)(in + i + 16));
+					_mm_storeu_si128 ((__m128i *)(out + (i >> 1)), _pack32_sse2 (lo, hi));
+				}
+			_pack_nibbles_scalar (in + i, out + (i >> 1), count - i);
+		}
+		
+		_TARGET_SSE2 static void
+		_unpack_nibbles_sse2 (const unsigned char *in, unsigned char *out,
+			int count)
+		{
+			int i = 0;
+			for (; i + 32 <= count; i += 32)
+				{
+					__m128i lo, hi;
+					_unpack16_sse2 (_mm_loadu_si128 ((const __m128i *)(in + (i >> 1))), lo, hi);
+					_mm_storeu_si128 ((__m128i *)(out + i), lo);
+					_mm_storeu_si128 ((__m128i *)(out + i + 16), hi);
+				}
+			_unpack_nibbles_scalar (in + (i >> 1), out + i, count - i);
+		}
+		
+		
+		
+	//----
+		/* 
+		 * AVX2 kernels:
+		 */
+		
+		_TARGET_AVX2 static inline __m256i
+		_custom_mask_avx2 (__m256i v)
+		{
+			__m256i ge_a5 = _mm256_cmpeq_epi8 (_mm256_max_epu8 (v, _mm256_set1_epi8 ((char)0xA5)), v);
+			__m256i le_a9 = _mm256_cmpeq_epi8 (_mm256_min_epu8 (v, _mm256_set1_epi8 ((char)0xA9)), v);
+			__m256i ge_b0 = _mm256_cmpeq_epi8 (_mm256_max_epu8 (v, _mm256_set1_epi8 ((char)0xB0)), v);
+			return _mm256_or_si256 (_mm256_and_si256 (ge_a5, le_a9), ge_b0);
+		}
+		
+		// 16 packed bytes -> 32 nibbles, in order.
+		_TARGET_AVX2 static inline __m256i
+		_unpack16_avx2 (__m128i v)
+		{
+			const __m128i mask = _mm_set1_epi8 (0x0F);
+			__m128i l = _mm_and_si128 (v, mask);
+			__m128i h = _mm_and_si128 (_mm_srli_epi16 (v, 4), mask);
+			return _mm256_inserti128_si256 (
+				_mm256_castsi128_si256 (_mm_unpacklo_epi8 (l, h)),
+				_mm_unpackhi_epi8 (l, h), 1);
+		}
+		
+		// 32 nibbles -> 16 packed bytes.
+		_TARGET_AVX2 static inline __m128i
+		_pack32_avx2 (__m256i v)
+		{
+			v = _mm256_and_si256 (v, _mm256_set1_epi8 (0x0F));
+			v = _mm256_and_si256 (_mm256_or_si256 (v, _mm256_srli_epi16 (v, 4)),
+				_mm256_set1_epi16 (0x00FF));
+			return _mm_packus_epi16 (_mm256_castsi256_si128 (v),
+				_mm256_extracti128_si256 (v, 1));
+		}
+		
+		_TARGET_AVX2 static int
+		_classify_ids_avx2 (const unsigned char *ids, unsigned int *custom)
+		{
+			const __m256i zero = _mm256_setzero_si256 ();
+			int air = 0;
+			for (int i = 0; i < 4096; i += 32)
+				{
+					__m256i v = _mm256_loadu_si256 ((const __m256i *)(ids + i));
+					air += __builtin_popcount ((unsigned int)_mm256_movemask_epi8 (
+						_mm256_cmpeq_epi8 (v, zero)));
+					custom[i >> 5] = (unsigned int)_mm256_movemask_epi8 (_custom_mask_avx2 (v));
+				}
+			
+			return 4096 - air;
+		}
+		
+		/* 
+		 * Same walk as the SSE2 version, but 32 columns at a time, and the table
+		 * lookups are done in registers: the table is turned into a 256-bit set,
+		 * and two byte shuffles pick the byte and the bit for each ID.
+		 */
+		_TARGET_AVX2 static void
+		_heightmap_avx2 (const unsigned char *const *subs,
+			const unsigned char *table, int *heights)
+		{
+			unsigned char set[32];
+			std::memset (set, 0, sizeof set);
+			for (int id = 0; id < 256; ++id)
+				if (table[id])
+					set[id >> 3] |= (1 << (id & 7));
+			
+			const __m256i set_lo = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)set));
+			const __m256i set_hi = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)(set + 16)));
+			const __m256i bits = _mm256_setr_epi8 (
+				1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0,
+				1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+			const __m256i c_1f = _mm256_set1_epi8 (0x1F);
+			const __m256i c_0f = _mm256_set1_epi8 (0x0F);
+			const __m256i c_07 = _mm256_set1_epi8 (0x07);
+			const __m256i zero = _mm256_setzero_si256 ();
+			
+			unsigned int pending[8];
+			for (int g = 0; g < 8; ++g)
+				pending[g] = 0xFFFFFFFFU;
+			int left = 8;
+			std::memset (heights, 0, 256 * sizeof (int));
+			
+			for (int s = 15; s >= 0; --s)
+				{
+					const unsigned char *ids = subs[s];
+					if (!ids)
+						continue;
+					
+					for (int y = 15; y >= 0; --y)
+						{
+							const unsigned char *layer = ids + (y << 8);
+							for (int g = 0; g < 8; ++g)
+								{
+									if (!pending[g])
+										continue;
+									
+									__m256i v = _mm256_loadu_si256 ((const __m256i *)(layer + (g << 5)));
+									__m256i idx = _mm256_and_si256 (_mm256_srli_epi16 (v, 3), c_1f);
+									__m256i byte = _mm256_blendv_epi8 (
+										_mm256_shuffle_epi8 (set_lo, idx),
+										_mm256_shuffle_epi8 (set_hi, idx),
+										_mm256_cmpgt_epi8 (idx, c_0f));
+									__m256i bit = _mm256_shuffle_epi8 (bits, _mm256_and_si256 (v, c_07));
+									__m256i miss = _mm256_cmpeq_epi8 (_mm256_and_si256 (byte, bit), zero);
+									
+									unsigned int hit = ~(unsigned int)_mm256_movemask_epi8 (miss) & pending[g];
+									if (!hit)
+										continue;
+									
+									pending[g] &= ~hit;
+									if (!pending[g])
+										-- left;
+									
+									int h = (s << 4) + y + 1;
+									while (hit)
+										{
+											heights[(g << 5) | __builtin_ctz (hit)] = h;
+											hit &= hit - 1;
+										}
+								}
+							
+							if (left == 0)
+								return;
+						}
+				}
+		}
+		
+		_TARGET_AVX2 static void
+		_translate_ids_avx2 (const unsigned char *ids, const unsigned char *meta,
+			const unsigned int *custom, const unsigned char *id_table,
+			const unsigned char *meta_table, unsigned char *out_ids,
+			unsigned char *out_meta)
+		{
+			const __m256i keep = _mm256_set1_epi8 ((char)0xFF);
+			unsigned char tm[32];
+			
+			for (int g = 0; g < 128; ++g)
+				{
+					const unsigned char *gi = ids + (g << 5);
+					const unsigned char *gm = meta + (g << 4);
+					unsigned char *oi = out_ids + (g << 5);
+					unsigned char *om = out_meta + (g << 4);
+					
+					if (!custom[g])
+						{
+							_mm256_storeu_si256 ((__m256i *)oi, _mm256_loadu_si256 ((const __m256i *)gi));
+							_mm_storeu_si128 ((__m128i *)om, _mm_loadu_si128 ((const __m128i *)gm));
+							continue;
+						}
+					
+					for (int j = 0; j < 32; ++j)
+						{
+							oi[j] = id_table[gi[j]];
+							tm[j] = meta_table[gi[j]];
+						}
+					
+					__m256i n = _unpack16_avx2 (_mm_loadu_si128 ((const __m128i *)gm));
+					__m256i t = _mm256_loadu_si256 ((const __m256i *)tm);
+					n = _mm256_blendv_epi8 (t, n, _mm256_cmpeq_epi8 (t, keep));
+					_mm_storeu_si128 ((__m128i *)om, _pack32_avx2 (n));
+				}
+		}
+		
+		_TARGET_AVX2 static void
+		_pack_nibbles_avx2 (const unsigned char *in, unsigned char *out,
+			int count)
+		{
+			int i = 0;
+			for (; i + 32 <= count; i += 32)
+				_mm_storeu_si128 ((__m128i *)(out + (i >> 1)),
+					_pack32_avx2 (_mm256_loadu_si256 ((const __m256i *)(in + i))));
+			_pack_nibbles_scalar (in + i, out + (i >> 1), count - i);
+		}
+		
+		_TARGET_AVX2 static void
+		_unpack_nibbles_avx2 (const unsigned char *in, unsigned char *out,
+			int count)
+		{
+			int i = 0;
+			for (; i + 32 <= count; i += 32)
+				_mm256_storeu_si256 ((__m256i *)(out + i),
+					_unpack16_avx2 (_mm_loadu_si128 ((const __m128i *)(in + (i >> 1)))));
+			_unpack_nibbles_scalar (in + (i >> 1), out + i, count - i);
+		}
+#endif
+		
+		
+		
+	//----
+		
+		static const kernel_set _scalar_set = {
+			SIMD_SCALAR,
+			_classify_ids_scalar, _heightmap_scalar, _translate_ids_scalar,
+			_pack_nibbles_scalar, _unpack_nibbles_scalar,
+		};
+		
+#ifdef HCRAFT_KERNELS_X86
+		static const kernel_set _sse2_set = {
+			SIMD_SSE2,
+			_classify_ids_sse2, _heightmap_sse2, _translate_ids_sse2,
+			_pack_nibbles_sse2, _unpack_nibbles_sse2,
+		};
+		
+		static const kernel_set _avx2_set = {
+			SIMD_AVX2,
+			_classify_ids_avx2, _heightmap_avx2, _translate_ids_avx2,
+			_pack_nibbles_avx2, _unpack_nibbles_avx2,
+		};
+		
+		
+		static unsigned long long
+		_xgetbv0 ()
+		{
+			unsigned int lo, hi;
+			__asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+			return ((unsigned long long)hi << 32) | lo;
+		}
+#endif
+		
+		
+		/* 
+		 * Returns the best instruction set supported by the CPU.
+		 */
+		simd_level
+		detect ()
+		{
+#ifdef HCRAFT_KERNELS_X86
+			unsigned int a, b, c, d;
+			if (!__get_cpuid (1, &a, &b, &c, &d))
+				return SIMD_SCALAR;
+			if (!(d & (1U << 26))) // SSE2
+				return SIMD_SCALAR;
+			
+			// AVX2 also needs the OS to save the YMM registers on context
+			// switches (OSXSAVE set, and XCR0 bits 1-2).
+			bool avx = (c & (1U << 27)) && (c & (1U << 28)) && ((_xgetbv0 () & 6) == 6);
+			if (avx && __get_cpuid_max (0, nullptr) >= 7)
+				{
+					__cpuid_count (7, 0, a, b, c, d);
+					if (b & (1U << 5)) // AVX2
+						return SIMD_AVX2;
+				}
+			
+			return SIMD_SSE2;
+#else
+			return SIMD_SCALAR;
+#endif
+		}
+		
+		/* 
+		 * Returns the name of the given level ("scalar", "sse2" or "avx2").
+		 */
+		const char*
+		level_name (simd_level level)
+		{
+			switch (level)
+				{
+				case SIMD_SCALAR: return "scalar";
+				case SIMD_SSE2: return "sse2";
+				case SIMD_AVX2: return "avx2";
+				}
+			
+			return "unknown";
+		}
+		
+		/* 
+		 * Returns the kernels written for the specified instruction set, or null
+		 * if they were not compiled in or the CPU cannot run them.
+		 */
+		const kernel_set*
+		get (simd_level level)
+		{
+			static const simd_level supported = detect ();
+			if (level > supported)
+				return nullptr;
+			
+			switch (level)
+				{
+				case SIMD_SCALAR: return &_scalar_set;
+#ifdef HCRAFT_KERNELS_X86
+				case SIMD_SSE2: return &_sse2_set;
+				case SIMD_AVX2: return &_avx2_set;
+#endif
+				default: return nullptr;
+				}
+		}
+		
+		/* 
+		 * Returns the fastest set of kernels the CPU can run.
+		 */
+		const kernel_set&
+		best ()
+		{
+			static const kernel_set& ks = *get (detect ());
+			return ks;
+		}
+	}
+}
+
@@ -0,0 +1,424 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "world/forge.hpp"
+#include "world/world.hpp"
+#include "world/chunk.hpp"
+#include "world/zone.hpp"
+#include "world/portal.hpp"
+#include "world/providers/worldprovider.hpp"
+#include "world/providers/hwprovider.hpp"
+#include "world/generation/worldgenerator.hpp"
+#include "system/server.hpp"
+#include "system/logger.hpp"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <unordered_set>
+
+
+namespace hCraft {
+	
+	// tile dimensions (in chunks).
+	static const int tile_width = 8;
+	static const int tile_depth = 4;
+	
+	// number of chunks converted at a time.
+	static const int convert_batch = 256;
+	
+	
+	
+	/* 
+	 * Calls @{fn} with every index in [0, count) (and the index of the thread
+	 * it runs on), spreading the work across @{threads} threads.
+	 */
+	static void
+	_parallel_for (int count, int threads, const std::function<void (int, int)>& fn)
+	{
+		if (count <= 0)
+			return;
+		if (threads > count)
+			threads = count;
+		
+		std::atomic<int> next {0};
+		auto body = [&next, count, &fn] (int tid)
+			{
+				int i;
+				while ((i = next++) < count)
+					fn (i, tid);
+			};
+		
+		std::vector<std::thread> ths;
+		for (int t = 1; t < threads; ++t)
+			ths.emplace_back (body, t);
+		body (0);
+		for (std::thread& th : ths)
+			th.join ();
+	}
+	
+	static unsigned long long
+	_morton (int x, int z)
+	{
+		unsigned int ux = (unsigned int)x ^ 0x80000000U;
+		unsigned int uz = (unsigned int)z ^ 0x80000000U;
+		
+		unsigned long long m = 0;
+		for (int i = 31; i >= 0; --i)
+			m = (m << 2) | (((uz >> i) & 1) << 1) | ((ux >> i) & 1);
+		return m;
+	}
+	
+	static unsigned long long
+	_chunk_key (int x, int z)
+	{
+		return ((unsigned long long)(unsigned int)x << 32) | (unsigned int)z;
+	}
+	
+	
+	
+	world_forge::world_forge (world &w, const forge_options& opts)
+		: w (w), opts (opts)
+		{ }
+	
+	
+	
+	int
+	world_forge::thread_count () const
+	{
+		if (this->opts.threads > 0)
+			return this->opts.threads;
+		
+		int n = std::thread::hardware_concurrency ();
+		return (n > 0) ? n : 1;
+	}
+	
+	void
+	world_forge::apply_codec ()
+	{
+		if (this->opts.codec < 0)
+			return;
+		
+		hw_provider *hw = dynamic_cast<hw_provider *> (this->w.get_provider ());
+		if (hw)
+			hw->set_codec (this->opts.codec, this->opts.level, this->opts.codec);
+	}
+	
+	
+	
+	/* 
+	 * Generates all chunks in the given tile row.
+	 */
+	void
+	world_forge::generate_row (int row, int x_chunks, int z_chunks)
+	{
+		int z1 = row * tile_depth;
+		int z2 = std::min (z1 + tile_depth, z_chunks);
+		int tiles = (x_chunks + tile_width - 1) / tile_width;
+		
+		// even tiles first, then odd ones.  tiles generated at the same time are
+		// at least a tile apart, so decorations (trees, etc...) spilling into
+		// neighbouring chunks never touch a chunk another thread is working on.
+		for (int parity = 0; parity < 2; ++parity)
+			{
+				int count = (tiles - parity + 1) / 2;
+				_parallel_for (count, (int)this->gens.size (),
+					[this, parity, x_chunks, z1, z2] (int i, int tid)
+						{
+							world_generator *gen = this->gens[tid];
+							int x1 = (i * 2 + parity) * tile_width;
+							int x2 = std::min (x1 + tile_width, x_chunks);
+							
+							for (int cz = z1; cz < z2; ++cz)
+								for (int cx = x1; cx < x2; ++cx)
+									{
+										chunk *ch = this->w.get_chunk (cx, cz);
+										if (!ch)
+											{
+												ch = new chunk ();
+												this->w.put_chunk (cx, cz, ch);
+											}
+										else if (ch->generated)
+											continue;
+										
+										gen->generate (this->w, ch, cx, cz);
+										ch->generated = true;
+										ch->recalc_heightmap ();
+									}
+						});
+			}
+	}
+	
+	/* 
+	 * Lights, saves and unloads all chunks in the given tile row.
+	 */
+	void
+	world_forge::finish_row (int row, int x_chunks, int z_chunks)
+	{
+		int z1 = row * tile_depth;
+		int z2 = std::min (z1 + tile_depth, z_chunks);
+		
+		// tile by tile, so that chunks close to each other are written close to
+		// each other.
+		std::vector<tagged_chunk> chunks;
+		for (int x1 = 0; x1 < x_chunks; x1 += tile_width)
+			for (int cz = z1; cz < z2; ++cz)
+				for (int cx = x1; cx < std::min (x1 + tile_width, x_chunks); ++cx)
+					{
+						chunk *ch = this->w.get_chunk (cx, cz);
+						if (ch)
+							chunks.push_back ({cx, cz, ch});
+					}
+		
+		_parallel_for ((int)chunks.size (), this->thread_count (),
+			[this, &chunks] (int i, int tid)
+				{
+					this->w.lm.relight_chunk (chunks[i].ch);
+				});
+		
+		world_provider *prov = this->w.get_provider ();
+		prov->open (this->w);
+		for (tagged_chunk& tch : chunks)
+			{
+				prov->save (this->w, tch.ch, tch.cx, tch.cz);
+				tch.ch->modified = false;
+			}
+		prov->close ();
+		
+		for (tagged_chunk& tch : chunks)
+			this->w.remove_chunk (tch.cx, tch.cz, false);
+		this->w.dispose_bad_chunks ();
+	}
+	
+	
+	
+	/* 
+	 * Generates, lights and saves every chunk of the (bounded) world.
+	 * 
+	 * Chunks are generated in rows of 8x4-chunk tiles, two tile rows at a
+	 * time, and written out tile by tile so that neighbouring chunks end up
+	 * next to each other in the world file.  If the world file already
+	 * contains some of the rows (from an interrupted run), generation
+	 * resumes from the first incomplete one.
+	 * 
+	 * Returns the number of chunks generated.
+	 */
+	int
+	world_forge::pregenerate ()
+	{
+		int x_chunks = this->w.get_width () / 16;
+		int z_chunks = this->w.get_depth () / 16;
+		if (x_chunks <= 0 || z_chunks <= 0 || !this->w.get_generator ())
+			return 0;
+		
+		int rows = (z_chunks + tile_depth - 1) / tile_depth;
+		int total = x_chunks * z_chunks;
+		
+		this->apply_codec ();
+		world_provider *prov = this->w.get_provider ();
+		prov->save_empty (this->w);
+		
+		// find the first row that has not been completely written out yet.
+		int first = 0, done = 0;
+		{
+			std::vector<std::pair<int, int>> existing;
+			prov->list_chunks (existing);
+			
+			std::vector<int> row_counts (rows, 0);
+			for (auto& p : existing)
+				if (p.first >= 0 && p.first < x_chunks && p.second >= 0 && p.second < z_chunks)
+					++ row_counts[p.second / tile_depth];
+			
+			while (first < rows &&
+				row_counts[first] == x_chunks * std::min (tile_depth, z_chunks - first * tile_depth))
+				done += row_counts[first++];
+		}
+		
+		if (first == rows)
+			return 0;
+		
+		// decorations from the first row we generate may reach into the last
+		// complete one, so it has to be in memory (and is written out again).
+		if (first > 0)
+			{
+				int z1 = (first - 1) * tile_depth;
+				for (int cz = z1; cz < z1 + tile_depth; ++cz)
+					for (int cx = 0; cx < x_chunks; ++cx)
+						this->w.load_chunk (cx, cz);
+			}
+		
+		world_generator *wgen = this->w.get_generator ();
+		int threads = this->thread_count ();
+		for (int i = 0; i < threads; ++i)
+			this->gens.push_back (world_generator::create (wgen->name (), wgen->seed ()));
+		
+		int generated = 0;
+		for (int r = first; r < rows; ++r)
+			{
+				this->generate_row (r, x_chunks, z_chunks);
+				if (r > 0)
+					this->finish_row (r - 1, x_chunks, z_chunks);
+				
+				int n = x_chunks * (std::min (r * tile_depth + tile_depth, z_chunks) - r * tile_depth);
+				generated += n;
+				done += n;
+				if (this->opts.progress)
+					this->opts.progress (done, total);
+			}
+		this->finish_row (rows - 1, x_chunks, z_chunks);
+		
+		for (world_generator *gen : this->gens)
+			delete gen;
+		this->gens.clear ();
+		
+		this->w.prepare_spawn (0, true);
+		this->w.save_all ();
+		return generated;
+	}
+	
+	
+	
+	/* 
+	 * Copies every chunk stored by world @{srcw} into the forge's world, along
+	 * with its portals, zones and security settings.  Chunks the destination
+	 * already has are skipped, so an interrupted conversion can be resumed.
+	 * 
+	 * Returns the number of chunks copied (nothing is copied if the source
+	 * provider cannot enumerate its chunks).
+	 */
+	int
+	world_forge::convert (world &srcw)
+	{
+		world_provider *src = srcw.get_provider ();
+		world_provider *dest = this->w.get_provider ();
+		
+		this->apply_codec ();
+		dest->save_empty (this->w);
+		
+		std::vector<std::pair<int, int>> coords;
+		src->list_chunks (coords);
+		int total = coords.size ();
+		
+		// skip chunks copied by a previous run.
+		{
+			std::vector<std::pair<int, int>> have;
+			dest->list_chunks (have);
+			if (!have.empty ())
+				{
+					std::unordered_set<unsigned long long> keys;
+					for (auto& p : have)
+						keys.insert (_chunk_key (p.first, p.second));
+					coords.erase (std::remove_if (coords.begin (), coords.end (),
+						[&keys] (const std::pair<int, int>& p)
+							{ return keys.count (_chunk_key (p.first, p.second)) != 0; }),
+						coords.end ());
+				}
+		}
+		
+		std::sort (coords.begin (), coords.end (),
+			[] (const std::pair<int, int>& a, const std::pair<int, int>& b)
+				{ return _morton (a.first, a.second) < _morton (b.first, b.second); });
+		
+		int threads = src->concurrent_loads () ? this->thread_count () : 1;
+		if (!src->concurrent_loads ())
+			src->open (srcw);
+		
+		int done = total - coords.size ();
+		int copied = 0;
+		std::vector<chunk *> batch;
+		for (size_t start = 0; start < coords.size (); start += convert_batch)
+			{
+				int count = std::min ((size_t)convert_batch, coords.size () - start);
+				batch.assign (count, nullptr);
+				
+				_parallel_for (count, threads,
+					[this, src, &srcw, &coords, &batch, start] (int i, int tid)
+						{
+							const std::pair<int, int>& p = coords[start + i];
+							chunk *ch = new chunk ();
+							try
+								{
+									if (!src->load (srcw, ch, p.first, p.second))
+										{ delete ch; return; }
+								}
+							catch (const std::exception& ex)
+								{
+									this->w.get_server ().get_logger () (LT_WARNING)
+										<< "Forge: skipping chunk (" << p.first << ", " << p.second
+										<< "): " << ex.what () << std::endl;
+									delete ch;
+									return;
+								}
+							
+							if (this->opts.relight)
+								this->w.lm.relight_chunk (ch);
+							batch[i] = ch;
+						});
+				
+				dest->open (this->w);
+				for (int i = 0; i < count; ++i)
+					if (batch[i])
+						{
+							const std::pair<int, int>& p = coords[start + i];
+							dest->save (this->w, batch[i], p.first, p.second);
+							delete batch[i];
+							++ copied;
+						}
+				dest->close ();
+				
+				done += count;
+				if (this->opts.progress)
+					this->opts.progress (done, total);
+			}
+		
+		if (!src->concurrent_loads ())
+			src->close ();
+		
+		// everything else
+		{
+			std::vector<portal *> portals;
+			std::vector<zone *> zones;
+			
+			src->open (srcw);
+			src->load_portals (srcw, portals);
+			src->load_zones (srcw, zones);
+			src->load_security (srcw, this->w.security ());
+			src->close ();
+			
+			for (portal *ptl : portals)
+				this->w.add_portal (ptl);
+			for (zone *zn : zones)
+				this->w.get_zones ().add (zn);
+		}
+		
+		this->w.set_spawn (srcw.get_spawn ());
+		this->w.set_time (srcw.get_time ());
+		if (srcw.is_time_frozen ())
+			this->w.stop_time ();
+		this->w.def_gm = srcw.def_gm;
+		this->w.def_inv = srcw.def_inv;
+		this->w.use_def_inv = srcw.use_def_inv;
+		this->w.view_dist = srcw.view_dist;
+		
+		// save_all () only writes world information if there are loaded chunks.
+		block_pos spawn = this->w.get_spawn ();
+		this->w.load_chunk_at (spawn.x, spawn.z);
+		this->w.save_all ();
+		return copied;
+	}
+}
+
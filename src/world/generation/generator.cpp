@@ -133,6 +133,7 @@ namespace hCraft {
 								world *w = req.w;
 								int flags = req.flags;
 						
+								epoch_guard eg {w->get_server ().get_epochs ()};
 								player *pl = w->get_server ().player_by_id (req.pid);
 								if (!pl) continue;
 						
@@ -214,5 +215,18 @@ namespace hCraft {
 				q->requests = valid_reqs;
 			}
 	}
+	
+	/* 
+	 * Fills @{out} with the number of pending requests of every player that
+	 * has any.
+	 */
+	void
+	chunk_generator::queue_depths (std::vector<std::pair<int, size_t>>& out)
+	{
+		std::lock_guard<std::mutex> guard {this->request_mutex};
+		for (generator_queue *q : this->queues)
+			if (!q->requests.empty ())
+				out.push_back ({q->pid, q->requests.size ()});
+	}
 }
 
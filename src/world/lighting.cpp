@@ -118,15 +118,11 @@ namespace hCraft {
 		for (; y >= 0; --y)
 			{
 				int id = ch->get_id (bx, y, bz);
-				block_info *binf = block_info::from_id (id);
-				if (binf->state == BS_SOLID)
+				if (block_props::is_solid (id) && !block_props::is_transparent (id) && (id != 0))
 					{
-						if ((binf->opacity != 0) && (id != 0))
-							{
-								if (y != 255)
-									++ y;
-								break;
-							}
+						if (y != 255)
+							++ y;
+						break;
 					}
 			}
 		
@@ -149,8 +145,7 @@ namespace hCraft {
 			{ bz = 15; ch = ch->north; if (!ch) return 0; }
 		
 		block_data bd = ch->get_block (bx, by, bz);
-		block_info *binf = block_info::from_id (bd.id);
-		if (binf->opaque && (binf->luminance == 0))
+		if (block_props::is_opaque (bd.id) && (block_props::luminance (bd.id) == 0))
 			return 0;
 		return bd.bl;
 	}
@@ -160,18 +155,17 @@ namespace hCraft {
 	calc_chunk_sky_light (chunk *ch, int x, int y, int z, fn_enqueue enq, void *p)
 	{
 		block_data this_block = ch->get_block (x, y, z);
-		block_info *this_info = block_info::from_id (this_block.id);
 		char nl;
 		
 		int h = ch->get_height (x, z);
 		int hh = _compute_height (ch, x, z, h);
-		if (this_info->opacity == 15)
+		if (block_props::opacity (this_block.id) == 15)
 			{
 				nl = 0;
 			}
 		else if (y >= hh)
 			{
-				nl = ((y < 255) ? ch->get_sky_light (x, y + 1, z) : 15) - this_info->opacity;
+				nl = ((y < 255) ? ch->get_sky_light (x, y + 1, z) : 15) - block_props::opacity (this_block.id);
 				if (nl < 0)
 					nl = 0;
 			}
@@ -189,7 +183,7 @@ namespace hCraft {
 														 : (ch->north ? ch->north->get_sky_light (x, y, 15) : 0);
 				
 				char brightest = _max (sle, _max (slw, _max (slu, _max (sld, _max (sls, _max (sln, 0))))));
-				nl = brightest - this_info->opacity - 1;
+				nl = brightest - block_props::opacity (this_block.id) - 1;
 				if (nl < 0) nl = 0;
 			}
 		
@@ -212,12 +206,11 @@ namespace hCraft {
 	calc_chunk_block_light (chunk *ch, int x, int y, int z, fn_enqueue enq, void *p)
 	{
 		block_data this_block = ch->get_block (x, y, z);
-		block_info *this_info = block_info::from_id (this_block.id);
 		char nl;
 		
-		if (this_info->opaque)
+		if (block_props::is_opaque (this_block.id))
 			{
-				nl = this_info->luminance;
+				nl = block_props::luminance (this_block.id);
 			}
 		else
 			{
@@ -229,7 +222,7 @@ namespace hCraft {
 				char bln = get_neighbour_bl (ch, x, y, z - 1);
 		
 				char brightest = _max (ble, _max (blw, _max (blu, _max (bld, _max (bls, _max (bln, 0))))));
-				nl = brightest - 1 + this_info->luminance;
+				nl = brightest - 1 + block_props::luminance (this_block.id);
 				if (nl <  0) nl = 0;
 				else if (nl > 15) nl = 15;
 			}
@@ -264,18 +257,17 @@ namespace hCraft {
 		if (!ch) return 0;
 		
 		block_data this_block = ch->get_block (bx, y, bz);
-		block_info *this_info = block_info::from_id (this_block.id);
 		char nl;
 		
 		int h = ch->get_height (bx, bz);
 		int hh = _compute_height (ch, bx, bz, h);
-		if (this_info->opacity == 15)
+		if (block_props::opacity (this_block.id) == 15)
 			{
 				nl = 0;
 			}
 		else if (y >= hh)
 			{
-				nl = ((y < 255) ? ch->get_sky_light (bx, y + 1, bz) : 15) - this_info->opacity;
+				nl = ((y < 255) ? ch->get_sky_light (bx, y + 1, bz) : 15) - block_props::opacity (this_block.id);
 				if (nl < 0)
 					nl = 0;
 			}
@@ -294,7 +286,7 @@ namespace hCraft {
 				
 				char brightest = _max (sle, _max (slw, _max (slu, _max (sld, _max (sls, _max (sln, 0))))));
 				nl = brightest;
-				nl -= this_info->opacity + 1;
+				nl -= block_props::opacity (this_block.id) + 1;
 				if (nl < 0) nl = 0;
 			}
 		
@@ -326,12 +318,11 @@ namespace hCraft {
 		if (!ch) return 0;
 		
 		block_data this_block = ch->get_block (bx, y, bz);
-		block_info *this_info = block_info::from_id (this_block.id);
 		char nl;
 		
-		if (this_info->opaque)
+		if (block_props::is_opaque (this_block.id))
 			{
-				nl = this_info->luminance;
+				nl = block_props::luminance (this_block.id);
 			}
 		else
 			{
@@ -343,7 +334,7 @@ namespace hCraft {
 				char bln = get_neighbour_bl (ch, bx, y, bz - 1);
 		
 				char brightest = _max (ble, _max (blw, _max (blu, _max (bld, _max (bls, _max (bln, 0))))));
-				nl = brightest - 1 + this_info->luminance;
+				nl = brightest - 1 + block_props::luminance (this_block.id);
 				if (nl <  0) nl = 0;
 				else if (nl > 15) nl = 15;
 			}
@@ -398,15 +389,14 @@ namespace hCraft {
 					char curr_opacity = 15;
 					for (int y = 254; y >= 0; --y)
 						{
+							id = ch->get_id (x, y, z);
 							if (curr_opacity > 0)
-								curr_opacity -= block_info::from_id (ch->get_id (x, y, z))->opacity;
+								curr_opacity -= block_props::opacity (id);
 							
 							// TODO: accept all transparent blocks
-							id = ch->get_id (x, y,z);
 							if (id != BT_AIR)
 								{
-									block_info *binf = block_info::from_id (id);
-									if (binf && binf->luminance > 0)
+									if (block_props::luminance (id) > 0)
 										{
 											bl_updates.emplace (x, y, z);
 										}
@@ -459,9 +449,11 @@ namespace hCraft {
 	 * Returns the total amount of updates handled.
 	 */
 	int
-	lighting_manager::update (int max_updates)
+	lighting_manager::update (int max_updates,
+		std::chrono::steady_clock::time_point deadline)
 	{
 		std::lock_guard<std::mutex> guard {this->lock};
+		bool timed = (deadline != std::chrono::steady_clock::time_point::max ());
 		
 		//std::cout << "A" << std::flush;
 		int updated = 0;
@@ -469,6 +461,9 @@ namespace hCraft {
 		// sky light updates
 		while (!this->sl_updates.empty () && (updated++ < max_updates))
 			{
+				if (timed && ((updated & 0x3F) == 0) && (std::chrono::steady_clock::now () > deadline))
+					break;
+				
 				light_update u = this->sl_updates.front ();
 				this->sl_updates.pop ();
 				
@@ -483,6 +478,9 @@ namespace hCraft {
 		updated = 0;
 		while (!this->bl_updates.empty () && (updated++ < max_updates))
 			{
+				if (timed && ((updated & 0x3F) == 0) && (std::chrono::steady_clock::now () > deadline))
+					break;
+				
 				light_update u = this->bl_updates.front ();
 				this->bl_updates.pop ();
 				
@@ -494,5 +492,25 @@ namespace hCraft {
 		//std::cout << "C" << std::flush;
 		return updated;
 	}
+	
+	/* 
+	 * Checks whether there are no queued updates.
+	 */
+	bool
+	lighting_manager::idle ()
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		return this->sl_updates.empty () && this->bl_updates.empty ();
+	}
+	
+	/* 
+	 * Returns the number of queued updates.
+	 */
+	size_t
+	lighting_manager::backlog ()
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		return this->sl_updates.size () + this->bl_updates.size ();
+	}
 }
 
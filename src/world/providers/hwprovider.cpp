@@ -23,6 +23,7 @@
 #include "world/zone.hpp"
 #include "drawing/selection/world_selection.hpp"
 #include "util/position.hpp"
+#include "util/codec.hpp"
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
@@ -31,6 +32,13 @@
 #include <zlib.h>
 #include <stdexcept>
 #include <iostream>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <iterator>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 
 namespace hCraft {
@@ -44,6 +52,9 @@ namespace hCraft {
 	
 	#define HW_CURR_REV												4
 	
+	// offset of the codec byte within a chunk's header
+	#define HW_CHUNK_CODEC_OFFSET						 1028
+	
 	
 	inline int
 	fast_floor (double x)
@@ -197,12 +208,30 @@ namespace hCraft {
 	{
 		std::ostream& strm;
 		int written;
+		hw_dirty_map *dmap;
+		
+	private:
+		inline void
+		touch (unsigned int len)
+			{
+				if (this->dmap->cursor < 0)
+					{
+						this->dmap->cursor = this->strm.tellp ();
+						if (this->dmap->cursor < 0)
+							{ this->dmap->mark_all (); return; }
+					}
+				this->dmap->advance (len);
+			}
 		
 	public:
-		binary_writer () : strm (std::cout) { }
-		binary_writer (std::ostream& strm)
-			: strm (strm), written (0)
-			{ }
+		binary_writer () : strm (std::cout), dmap (nullptr) { }
+		binary_writer (std::ostream& strm, hw_dirty_map *dmap = nullptr)
+			: strm (strm), written (0), dmap (dmap)
+			{
+				// the stream might have been read from since it was last written to.
+				if (dmap)
+					dmap->cursor = -1;
+			}
 		
 		//---
 		inline void
@@ -211,6 +240,8 @@ namespace hCraft {
 				this->strm.seekp (off, dir);
 				if (dir == std::ios_base::end)
 					this->written = this->tell ();
+				if (this->dmap)
+					this->dmap->cursor = (dir == std::ios_base::beg) ? (long long)off : -1;
 			}
 		
 		inline std::ostream::pos_type
@@ -224,7 +255,10 @@ namespace hCraft {
 		//---
 		inline void
 		write_byte (unsigned char val)
-			{ this->strm.put (val); ++ written; }
+			{
+				if (this->dmap) this->touch (1);
+				this->strm.put (val); ++ written;
+			}
 		
 		inline void
 		write_short (unsigned short val)
@@ -280,6 +314,7 @@ namespace hCraft {
 		inline void
 		write_bytes (const unsigned char *data, unsigned int len)
 		{
+			if (this->dmap && len > 0) this->touch (len);
 			this->strm.write ((const char *)data, len);
 			this->written += len;
 		}
@@ -301,9 +336,497 @@ namespace hCraft {
 	
 	
 	
+//----
+	
+	/* 
+	 * A small direct-mapped cache of raw 4KB chunk sectors, so that chunks
+	 * that are unloaded and then reloaded shortly after (players walking back
+	 * and forth over a region border, teleports) do not hit the disk again.
+	 */
+	class hw_sector_cache
+	{
+		struct slot
+		{
+			unsigned int sector; // in 512-byte units, 0xFFFFFFFF if unused
+			unsigned char data[4096];
+		};
+		
+		slot *slots;
+		unsigned int mask;
+		unsigned int gen;
+		std::mutex lock;
+		
+	private:
+		inline unsigned int
+		index_of (unsigned int sector)
+			{ return ((sector * 2654435761U) >> 16) & this->mask; }
+		
+	public:
+		hw_sector_cache (unsigned int count)
+		{
+			this->slots = new slot[count];
+			this->mask = count - 1;
+			this->gen = 0;
+			for (unsigned int i = 0; i < count; ++i)
+				this->slots[i].sector = 0xFFFFFFFFU;
+		}
+		
+		~hw_sector_cache ()
+		{
+			delete[] this->slots;
+		}
+		
+		
+		
+		/* 
+		 * Returns a number that changes whenever a sector is invalidated.
+		 * Readers sample it before issuing a read, and pass it back to put (), so
+		 * that data read concurrently with a write never makes it into the cache.
+		 */
+		unsigned int
+		generation ()
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			return this->gen;
+		}
+		
+		bool
+		get (unsigned int sector, unsigned char *out)
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			slot& s = this->slots[this->index_of (sector)];
+			if (s.sector != sector)
+				return false;
+			std::memcpy (out, s.data, 4096);
+			return true;
+		}
+		
+		void
+		put (unsigned int sector, const unsigned char *data, unsigned int gen)
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			if (gen != this->gen)
+				return;
+			slot& s = this->slots[this->index_of (sector)];
+			s.sector = sector;
+			std::memcpy (s.data, data, 4096);
+		}
+		
+		void
+		invalidate (unsigned int sector)
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			slot& s = this->slots[this->index_of (sector)];
+			if (s.sector == sector)
+				s.sector = 0xFFFFFFFFU;
+			++ this->gen;
+		}
+		
+		void
+		clear ()
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			for (unsigned int i = 0; i <= this->mask; ++i)
+				this->slots[i].sector = 0xFFFFFFFFU;
+			++ this->gen;
+		}
+	};
+	
+	
+	static inline unsigned long long
+	_chunk_index_key (int x, int z)
+	{
+		return ((unsigned long long)(unsigned int)x << 32) | (unsigned int)z;
+	}
+	
+	static inline unsigned long long
+	_spread_bits (unsigned int v)
+	{
+		unsigned long long x = v;
+		x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+		x = (x | (x << 8))  & 0x00FF00FF00FF00FFULL;
+		x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+		x = (x | (x << 2))  & 0x3333333333333333ULL;
+		x = (x | (x << 1))  & 0x5555555555555555ULL;
+		return x;
+	}
+	
+	/* 
+	 * Z-order (Morton) code of a chunk key, so that chunks that are close to
+	 * each other in the world end up close to each other in the file.
+	 */
+	static inline unsigned long long
+	_chunk_morton (unsigned long long key)
+	{
+		unsigned int x = (unsigned int)(key >> 32) ^ 0x80000000U;
+		unsigned int z = (unsigned int)(key & 0xFFFFFFFFU) ^ 0x80000000U;
+		return _spread_bits (x) | (_spread_bits (z) << 1);
+	}
+	
+	
+	
+//----
+	
+	hw_free_map::hw_free_map ()
+	{
+		this->readers = 0;
+		this->total = 0;
+		this->dirty = false;
+	}
+	
+	
+	
+	void
+	hw_free_map::insert (unsigned int off, unsigned int len)
+	{
+		if (len == 0)
+			return;
+		
+		// never count the same space twice.
+		this->reserve (off, len);
+		this->total += len;
+		this->dirty = true;
+		
+		// merge with neighbouring extents
+		auto next = this->extents.lower_bound (off);
+		if (next != this->extents.begin ())
+			{
+				auto prev = std::prev (next);
+				if (prev->first + prev->second == off)
+					{
+						off = prev->first;
+						len += prev->second;
+						this->extents.erase (prev);
+					}
+			}
+		if (next != this->extents.end () && (off + len) == next->first)
+			{
+				len += next->second;
+				this->extents.erase (next);
+			}
+		
+		this->extents[off] = len;
+	}
+	
+	void
+	hw_free_map::release_limbo ()
+	{
+		if (this->readers > 0 || this->limbo.empty ())
+			return;
+		
+		for (auto& p : this->limbo)
+			this->insert (p.first, p.second);
+		this->limbo.clear ();
+	}
+	
+	
+	
+	/* 
+	 * Finds the smallest free extent that can hold @{len} units and carves
+	 * the requested space out of it. Returns 0 if there is no such extent.
+	 */
+	unsigned int
+	hw_free_map::alloc (unsigned int len)
+	{
+		this->release_limbo ();
+		
+		auto best = this->extents.end ();
+		for (auto itr = this->extents.begin (); itr != this->extents.end (); ++itr)
+			if (itr->second >= len && (best == this->extents.end () || itr->second < best->second))
+				{
+					best = itr;
+					if (itr->second == len)
+						break;
+				}
+		if (best == this->extents.end ())
+			return 0;
+		
+		unsigned int off = best->first;
+		unsigned int rem = best->second - len;
+		this->extents.erase (best);
+		if (rem > 0)
+			this->extents[off + len] = rem;
+		this->total -= len;
+		this->dirty = true;
+		return off;
+	}
+	
+	/* 
+	 * Like alloc (), but picks the lowest-addressed extent that fits, and
+	 * only if it begins before @{below}.
+	 */
+	unsigned int
+	hw_free_map::alloc_below (unsigned int len, unsigned int below)
+	{
+		this->release_limbo ();
+		
+		for (auto itr = this->extents.begin ();
+			itr != this->extents.end () && itr->first < below; ++itr)
+			if (itr->second >= len)
+				{
+					unsigned int off = itr->first;
+					unsigned int rem = itr->second - len;
+					this->extents.erase (itr);
+					if (rem > 0)
+						this->extents[off + len] = rem;
+					this->total -= len;
+					this->dirty = true;
+					return off;
+				}
+		
+		return 0;
+	}
+	
+	/* 
+	 * Marks the given range as unused.
+	 */
+	void
+	hw_free_map::free (unsigned int off, unsigned int len)
+	{
+		if (off == 0 || len == 0)
+			return;
+		
+		if (this->readers > 0)
+			{
+				this->limbo.emplace_back (off, len);
+				this->dirty = true;
+			}
+		else
+			this->insert (off, len);
+	}
+	
+	/* 
+	 * Removes the given range from the map, if any of it is marked free.
+	 */
+	void
+	hw_free_map::reserve (unsigned int off, unsigned int len)
+	{
+		unsigned long long end = (unsigned long long)off + len;
+		
+		auto itr = this->extents.upper_bound (off);
+		if (itr != this->extents.begin ())
+			-- itr;
+		while (itr != this->extents.end () && itr->first < end)
+			{
+				unsigned int e_off = itr->first;
+				unsigned long long e_end = (unsigned long long)e_off + itr->second;
+				if (e_end <= off)
+					{ ++ itr; continue; }
+				
+				itr = this->extents.erase (itr);
+				this->total -= (e_end - e_off);
+				if (e_off < off)
+					{
+						this->extents[e_off] = off - e_off;
+						this->total += off - e_off;
+					}
+				if (e_end > end)
+					{
+						itr = this->extents.emplace ((unsigned int)end, (unsigned int)(e_end - end)).first;
+						this->total += e_end - end;
+						++ itr;
+					}
+				this->dirty = true;
+			}
+	}
+	
+	/* 
+	 * If the last extent ends exactly at @{end}, it is removed and its
+	 * offset returned (so that the file can be truncated). Otherwise,
+	 * returns @{end}.
+	 */
+	unsigned int
+	hw_free_map::trim_tail (unsigned int end)
+	{
+		if (this->extents.empty ())
+			return end;
+		
+		auto last = std::prev (this->extents.end ());
+		if (last->first + last->second != end)
+			return end;
+		
+		unsigned int off = last->first;
+		this->total -= last->second;
+		this->extents.erase (last);
+		this->dirty = true;
+		return off;
+	}
+	
+	
+	
+	void
+	hw_free_map::begin_read ()
+	{
+		++ this->readers;
+	}
+	
+	void
+	hw_free_map::end_read ()
+	{
+		if (-- this->readers == 0)
+			this->release_limbo ();
+	}
+	
+	
+	
+	void
+	hw_free_map::clear ()
+	{
+		this->extents.clear ();
+		this->limbo.clear ();
+		this->total = 0;
+		this->dirty = true;
+	}
+	
+	
+	
+	unsigned int
+	hw_free_map::serialized_size () const
+	{
+		return 4 + 8 * (this->extents.size () + this->limbo.size ());
+	}
+	
+	unsigned int
+	hw_free_map::serialize (unsigned char *out) const
+	{
+		unsigned int n = 0;
+		
+		unsigned int count = this->extents.size () + this->limbo.size ();
+		out[n++] = count & 0xFF;
+		out[n++] = (count >> 8) & 0xFF;
+		out[n++] = (count >> 16) & 0xFF;
+		out[n++] = (count >> 24) & 0xFF;
+		
+		auto put = [out, &n] (unsigned int v)
+			{
+				out[n++] = v & 0xFF;
+				out[n++] = (v >> 8) & 0xFF;
+				out[n++] = (v >> 16) & 0xFF;
+				out[n++] = (v >> 24) & 0xFF;
+			};
+		for (auto& p : this->extents)
+			{ put (p.first); put (p.second); }
+		for (auto& p : this->limbo)
+			{ put (p.first); put (p.second); }
+		
+		return n;
+	}
+	
+	void
+	hw_free_map::deserialize (const unsigned char *data, unsigned int len)
+	{
+		this->clear ();
+		if (len < 4)
+			return;
+		
+		auto get = [data] (unsigned int pos) -> unsigned int
+			{
+				return (unsigned int)data[pos]
+					| ((unsigned int)data[pos + 1] << 8)
+					| ((unsigned int)data[pos + 2] << 16)
+					| ((unsigned int)data[pos + 3] << 24);
+			};
+		
+		unsigned int count = get (0);
+		for (unsigned int i = 0; i < count && (4 + i * 8 + 8) <= len; ++i)
+			this->insert (get (4 + i * 8), get (4 + i * 8 + 4));
+	}
+	
+	
+	
+//----
+	
+	hw_dirty_map::hw_dirty_map ()
+	{
+		this->all = true; // nothing is known about past writes
+		this->last_block = ~0ULL;
+		this->cursor = -1;
+	}
+	
+	
+	
+	void
+	hw_dirty_map::mark_blocks (unsigned long long first, unsigned long long last)
+	{
+		if (this->bits.size () <= (last >> 6))
+			this->bits.resize ((last >> 6) + 1, 0);
+		for (unsigned long long b = first; b <= last; ++b)
+			this->bits[b >> 6] |= 1ULL << (b & 63);
+		this->last_block = last;
+	}
+	
+	void
+	hw_dirty_map::mark_all ()
+	{
+		this->all = true;
+		this->bits.clear ();
+		this->last_block = ~0ULL;
+	}
+	
+	bool
+	hw_dirty_map::take (std::vector<unsigned int>& out)
+	{
+		bool was_all = this->all;
+		if (!was_all)
+			{
+				for (size_t i = 0; i < this->bits.size (); ++i)
+					{
+						unsigned long long w = this->bits[i];
+						while (w)
+							{
+								int b = __builtin_ctzll (w);
+								out.push_back ((unsigned int)(i * 64 + b));
+								w &= w - 1;
+							}
+					}
+			}
+		
+		this->all = false;
+		this->bits.clear ();
+		this->last_block = ~0ULL;
+		return !was_all;
+	}
+	
+	
+	
+//----
+	
+	static std::atomic_int default_codec {CODEC_ZLIB};
+	static std::atomic_int default_codec_level {Z_BEST_COMPRESSION};
+	static std::atomic_int default_bg_codec {CODEC_ZLIB};
+	
+	/* 
+	 * Sets the codec (CODEC_*) and level used by providers constructed from
+	 * this point on when saving chunks.
+	 */
+	void
+	hw_provider::set_default_codec (int codec, int level, int bg_codec)
+	{
+		default_codec.store (codec);
+		default_codec_level.store (level);
+		default_bg_codec.store (bg_codec);
+	}
+	
+	/* 
+	 * Changes the codec used by this provider for subsequent saves.
+	 */
+	void
+	hw_provider::set_codec (int codec, int level, int bg_codec)
+	{
+		std::lock_guard<std::mutex> guard {this->idx_lock};
+		this->codec = codec::available (codec) ? codec : CODEC_ZLIB;
+		this->codec_level = level;
+		this->bg_codec = codec::available (bg_codec) ? bg_codec : CODEC_ZLIB;
+	}
+	
+	
+	
 //----
 		
 	static void read_file (world_information&, hw_superblock **, binary_reader); // forward def
+	static int _read_int (const unsigned char *data, unsigned int& pos); // forward def
+	static void build_chunk_index (hw_superblock **,
+		std::unordered_map<unsigned long long, hw_chunk *>&); // forward def
 	
 	/* 
 	 * Constructs a new world provider for the HWv1 format.
@@ -311,12 +834,20 @@ namespace hCraft {
 	hw_provider::hw_provider (const char *path, const char *world_name)
 		: out_path (path), inf ()
 	{
+		this->rfd = -1;
+		this->scache = new hw_sector_cache (512);
+		this->save_counter = 0;
+		this->compact_pos = 0;
+		this->set_codec (default_codec.load (), default_codec_level.load (),
+			default_bg_codec.load ());
+		
 		if (this->out_path[this->out_path.size () - 1] != '/')
 			this->out_path.push_back ('/');
 		this->out_path.append (hw_provider_naming ().make_name (world_name));
 		
 		for (int i = 0; i < 4096; ++i)
 			this->sblocks[i] = nullptr;
+		this->inf.view_dist = 0;
 		
 		// read tables if the world file already exists
 		{
@@ -326,7 +857,23 @@ namespace hCraft {
 				{
 					binary_reader reader {strm};
 					read_file (this->inf, this->sblocks, reader);
+					build_chunk_index (this->sblocks, this->cindex);
 					this->read_layer_table (strm);
+					this->validate_free_map (strm);
+					
+					unsigned int vd_size = 0;
+					unsigned char *vd = this->read_layer (strm, "view-distance", vd_size);
+					if (vd)
+						{
+							unsigned int pos = 0;
+							if (vd_size >= 4)
+								this->inf.view_dist = _read_int (vd, pos);
+							delete[] vd;
+						}
+					
+					for (auto& p : this->cindex)
+						if (p.second->codec == CODEC_RAW)
+							this->raw_pending.push_back (p.first);
 					strm.close ();
 				}
 		}
@@ -342,6 +889,10 @@ namespace hCraft {
 		for (hw_layer& ly : this->layers)
 			delete[] ly.offsets;
 		this->close ();
+		
+		if (this->rfd != -1)
+			::close (this->rfd);
+		delete this->scache;
 	}
 	
 	
@@ -365,6 +916,7 @@ namespace hCraft {
  	void
  	hw_provider::open (world &wr)
  	{
+ 		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
  		if (this->strm.is_open ())
  			return;
  		
@@ -384,6 +936,7 @@ namespace hCraft {
 	void
 	hw_provider::close ()
 	{
+		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
 		if (this->strm.is_open ())
 			{
 				this->strm.flush ();
@@ -624,7 +1177,8 @@ namespace hCraft {
 	
 	static hw_chunk*
 	find_or_create_chunk (int x, int z, hw_superblock **sblocks,
-		binary_writer writer, bool create = true, bool* got_created = nullptr)
+		binary_writer writer, bool create = true, bool* got_created = nullptr,
+		hw_free_map *fmap = nullptr)
 	{
 		if (got_created) *got_created = false;
 		hw_region *region = find_or_create_region (
@@ -661,15 +1215,24 @@ namespace hCraft {
 				region->chunks[hash_m] = new hw_chunk (x, z);
 				ch = region->chunks[hash_m];
 		
-				// create the chunk
-				writer.seek (0, std::ios_base::end);
-				ch->offset = writer.tell () / 512;
+				// create the chunk (reusing free space if we can)
+				ch->offset = fmap ? fmap->alloc (3) : 0;
+				bool appended = (ch->offset == 0);
+				if (appended)
+					{
+						writer.seek (0, std::ios_base::end);
+						ch->offset = writer.tell () / 512;
+					}
+				else
+					writer.seek ((std::ostream::off_type)ch->offset * 512);
 				
 				writer.write_int (ch->size);
 				for (int j = 0; j < 256; ++j)
 					writer.write_int (ch->sector_table[j]);
+				writer.write_byte (ch->codec);
 					
-				writer.pad_to (512);
+				if (appended)
+					writer.pad_to (512);
 		
 				// update file
 				writer.seek ((region->offset * 512) + (12 * hash_m));
@@ -929,66 +1492,47 @@ namespace hCraft {
 	
 	
 	
+	/* 
+	 * Writes the chunk's (compressed) data into a fresh run of sectors
+	 * (best-fit from the free map, or appended to the end of the file), and
+	 * releases the sectors it used before.
+	 * 
+	 * Sectors are never overwritten in place: loads read them without the
+	 * index lock, and the free map holds on to released sectors until those
+	 * reads are done, so a load sees either the old data or the new one.
+	 */
 	static void
-	write_to_sector (hw_chunk *hch, unsigned int index, unsigned char *data,
-		unsigned int len, binary_writer writer)
+	write_in_sectors (hw_chunk *hch, unsigned char *data, unsigned int data_size,
+		binary_writer writer, hw_free_map& fmap)
 	{
-		unsigned int sectors_used = hch->size / 4096;
-		if (hch->size % 4096 != 0)
-			++ sectors_used;
+		static const unsigned char zeroes[4096] = { 0 };
 		
-		if (index >= sectors_used)
+		unsigned int sectors_used = (hch->size + 4095) / 4096;
+		unsigned int sectors_needed = (data_size + 4095) / 4096;
+		unsigned int i;
+		
+		unsigned int off = fmap.alloc (sectors_needed * 8);
+		if (off == 0)
 			{
-				int sector_offset;
-				
-				// create the sector
 				writer.seek (0, std::ios_base::end);
-				sector_offset = writer.tell () / 512;
-				writer.write_bytes (data, len);
-				if (len < 4096)
-					{
-						int rem = 4096 - len;
-						while (rem-- > 0)
-							writer.write_byte (0);
-					}
-				
-				hch->sector_table[index] = sector_offset;
-				
-				// update file
-				writer.seek ((hch->offset * 512) + 4 + (index * 4));
-				writer.write_int (sector_offset);
+				writer.pad_to (512);
+				off = writer.tell () / 512;
 			}
 		else
-			{
-				// overwrite existing sector
-				writer.seek (hch->sector_table[index] * 512);
-				writer.write_bytes (data, len);
-			}
-	}
-	
-	static void
-	write_in_sectors (hw_chunk *hch, unsigned char *data, unsigned int data_size,
-		binary_writer writer)
-	{
-		unsigned int sectors_needed = data_size / 4096;
+			writer.seek ((std::ostream::off_type)off * 512);
+		
+		writer.write_bytes (data, data_size);
 		if (data_size % 4096 != 0)
-			++ sectors_needed;
+			writer.write_bytes (zeroes, 4096 - (data_size % 4096));
 		
-		size_t i, sector_size;
+		for (i = 0; i < sectors_used; ++i)
+			fmap.free (hch->sector_table[i], 8);
+		for (i = 0; i < 256; ++i)
+			hch->sector_table[i] = (i < sectors_needed) ? (off + (i * 8)) : 0;
 		
-		for (i = 0; i < sectors_needed; ++i)
-			{
-				if (i == (sectors_needed - 1))
-					{
-						sector_size = data_size % 4096;
-						if (sector_size == 0)
-							sector_size = 4096;
-					}
-				else
-					sector_size = 4096;
-				
-				write_to_sector (hch, i, data + (4096 * i), sector_size, writer);
-			}
+		writer.seek ((hch->offset * 512) + 4);
+		for (i = 0; i < 256; ++i)
+			writer.write_int (hch->sector_table[i]);
 		
 		if ((unsigned int)hch->size != data_size)
 			{
@@ -1000,7 +1544,9 @@ namespace hCraft {
 	
 	static void
 	save_chunk (chunk *ch, int x, int z, hw_superblock **sblocks,
-		world_information& inf, binary_writer writer)
+		std::unordered_map<unsigned long long, hw_chunk *>& cindex,
+		hw_sector_cache *scache, hw_free_map& fmap, world_information& inf,
+		int codec_id, int level, binary_writer writer)
 	{
 		unsigned char *compressed;
 		unsigned long compressed_size;
@@ -1008,10 +1554,10 @@ namespace hCraft {
 		unsigned int data_size = 0;
 		unsigned char *data = make_chunk_data (ch, &data_size);
 		
-		compressed_size = compressBound (data_size);
+		compressed_size = codec::bound (codec_id, data_size);
 		compressed = new unsigned char[compressed_size];
-		if (compress2 (compressed, &compressed_size, data, data_size,
-			Z_BEST_COMPRESSION) != Z_OK)
+		if (!codec::compress (codec_id, level, data, data_size, compressed,
+			compressed_size))
 			{
 				delete[] data;
 				delete[] compressed;
@@ -1020,12 +1566,30 @@ namespace hCraft {
 		delete[] data;
 		
 		bool created = false;
-		hw_chunk *hch = find_or_create_chunk (x, z, sblocks, writer, true, &created);
+		hw_chunk *hch = find_or_create_chunk (x, z, sblocks, writer, true, &created,
+			&fmap);
 		if (hch)
-			write_in_sectors (hch, compressed, compressed_size, writer);
+			{
+				write_in_sectors (hch, compressed, compressed_size, writer, fmap);
+				if (hch->codec != codec_id)
+					{
+						hch->codec = codec_id;
+						writer.seek ((hch->offset * 512) + HW_CHUNK_CODEC_OFFSET);
+						writer.write_byte (codec_id);
+					}
+				writer.flush ();
+				
+				// drop stale copies of the sectors we have just overwritten.
+				unsigned int sectors_used = (hch->size + 4095) / 4096;
+				for (unsigned int i = 0; i < sectors_used; ++i)
+					scache->invalidate (hch->sector_table[i]);
+			}
 		
 		if (created)
 			{
+				if (hch)
+					cindex[_chunk_index_key (x, z)] = hch;
+				
 				// update chunk count
 				writer.seek (44);
 				writer.write_int (++ (inf.chunk_count));
@@ -1042,6 +1606,7 @@ namespace hCraft {
 	void
 	hw_provider::save (world& wr, chunk *ch, int x, int z)
 	{
+		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
 		bool close_when_done = false;
 		if (!this->strm.is_open ())
 			{
@@ -1051,8 +1616,16 @@ namespace hCraft {
 				close_when_done = true;
 			}
 		
-		binary_writer writer {this->strm};
-		save_chunk (ch, x, z, this->sblocks, this->inf, writer);
+		binary_writer writer {this->strm, &this->dmap};
+		{
+			std::lock_guard<std::mutex> guard {this->idx_lock};
+			save_chunk (ch, x, z, this->sblocks, this->cindex, this->scache,
+				this->fmap, this->inf, this->codec, this->codec_level, writer);
+			
+			++ this->save_counter;
+			if (this->codec == CODEC_RAW && this->bg_codec != CODEC_RAW)
+				this->raw_pending.push_back (_chunk_index_key (x, z));
+		}
 		//rewrite_header (wr, strm);
 		
 		if (close_when_done)
@@ -1067,7 +1640,8 @@ namespace hCraft {
 	void
 	hw_provider::save_info (world &w, const world_information &info)
 	{
-		binary_writer writer (strm);
+		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
+		binary_writer writer (this->strm, &this->dmap);
 		writer.seek (8);
 		
 		// world dimensions
@@ -1096,8 +1670,27 @@ namespace hCraft {
 		writer.write_long (info.time);
 		writer.write_byte (info.time_frozen ? 1 : 0);
 		
-		writer.flush ();
-		this->inf = info;
+		writer.flush ();
+		this->inf = info;
+		
+		// persist the free map (validated against the index on the next load).
+		std::vector<unsigned char> fm;
+		{
+			std::lock_guard<std::mutex> guard {this->idx_lock};
+			if (this->fmap.dirty)
+				{
+					fm.resize (this->fmap.serialized_size ());
+					this->fmap.serialize (fm.data ());
+					this->fmap.dirty = false;
+				}
+		}
+		if (!fm.empty ())
+			this->write_layer ("free-sectors", fm.data (), fm.size ());
+		
+		// settings added after the header's layout was fixed are kept in layers.
+		unsigned char vd[4];
+		_write_int (vd, info.view_dist);
+		this->write_layer ("view-distance", vd, 4);
 	}
 	
 	
@@ -1195,8 +1788,25 @@ namespace hCraft {
 		if (!strm)
 			throw std::runtime_error ("failed to open world file");
 		
+		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
+		std::lock_guard<std::mutex> guard {this->idx_lock};
 		save_empty_imp (wr, strm, this->sblocks);
 		strm.close ();
+		this->dmap.mark_all ();
+		
+		this->cindex.clear ();
+		this->raw_pending.clear ();
+		this->scache->clear ();
+		this->fmap.clear ();
+		this->compact_queue.clear ();
+		this->compact_pos = 0;
+		
+		// the file might have been deleted and recreated under us.
+		if (this->rfd != -1)
+			{
+				::close (this->rfd);
+				this->rfd = -1;
+			}
 	}
 	
 	
@@ -1248,6 +1858,71 @@ namespace hCraft {
 			}
 	}	
 	
+	/* 
+	 * Loads the free map saved in the "free-sectors" layer, and removes from
+	 * it anything that is actually in use according to the index, in case
+	 * the server went down before the map could be saved.
+	 */
+	void
+	hw_provider::validate_free_map (std::fstream& strm)
+	{
+		unsigned int data_size = 0;
+		unsigned char *data = this->read_layer (strm, "free-sectors", data_size);
+		if (data)
+			{
+				this->fmap.deserialize (data, data_size);
+				delete[] data;
+			}
+		
+		// file header, super-block table and layer table
+		this->fmap.reserve (0, (HW_LAYER_TABLE_OFFSET + 8 + (12 * HW_LAYER_SIZE) + 511) / 512);
+		
+		for (int i = 0; i < 4096; ++i)
+			{
+				hw_superblock *sblock = this->sblocks[i];
+				if (!sblock) continue;
+				this->fmap.reserve (sblock->offset, 2);
+				for (int j = 0; j < 64; ++j)
+					{
+						hw_block *block = sblock->blocks[j];
+						if (!block) continue;
+						this->fmap.reserve (block->offset, 24);
+						for (int k = 0; k < 1024; ++k)
+							{
+								hw_region *region = block->regions[k];
+								if (!region) continue;
+								this->fmap.reserve (region->offset, 24);
+								for (int l = 0; l < 1024; ++l)
+									{
+										hw_chunk *ch = region->chunks[l];
+										if (!ch) continue;
+										this->fmap.reserve (ch->offset, 3);
+										
+										unsigned int sectors = (ch->size + 4095) / 4096;
+										for (unsigned int m = 0; m < sectors; ++m)
+											this->fmap.reserve (ch->sector_table[m], 8);
+									}
+							}
+					}
+			}
+		
+		for (hw_layer& ly : this->layers)
+			{
+				unsigned int pages = ly.size / HW_LAYER_PAGE_DATA_SIZE
+					+ !!(ly.size % HW_LAYER_PAGE_DATA_SIZE);
+				for (unsigned int i = 0; i < pages; ++i)
+					this->fmap.reserve (ly.offsets[i], 2);
+			}
+		
+		// and anything past the end of the file
+		strm.clear ();
+		strm.seekg (0, std::ios_base::end);
+		unsigned long long file_size = strm.tellg ();
+		this->fmap.reserve (file_size / 512, 0xFFFFFFFFU - (file_size / 512));
+		
+		this->fmap.dirty = false;
+	}
+	
 	static void
 	read_tables (hw_superblock **sblocks, binary_reader reader)
 	{
@@ -1333,6 +2008,7 @@ namespace hCraft {
 										ch->size = reader.read_int ();
 										for (int i = 0; i < 256; ++i)
 											ch->sector_table[i] = reader.read_int ();
+										ch->codec = reader.read_byte (); // zero (zlib) in older files
 										
 										reader.seek (saved_pos);
 									}
@@ -1393,30 +2069,86 @@ namespace hCraft {
 		read_tables (sblocks, reader);
 	}
 	
+	static void
+	build_chunk_index (hw_superblock **sblocks,
+		std::unordered_map<unsigned long long, hw_chunk *>& cindex)
+	{
+		cindex.clear ();
+		for (int i = 0; i < 4096; ++i)
+			{
+				hw_superblock *sblock = sblocks[i];
+				if (!sblock) continue;
+				for (int j = 0; j < 64; ++j)
+					{
+						hw_block *block = sblock->blocks[j];
+						if (!block) continue;
+						for (int k = 0; k < 1024; ++k)
+							{
+								hw_region *region = block->regions[k];
+								if (!region) continue;
+								for (int l = 0; l < 1024; ++l)
+									{
+										hw_chunk *ch = region->chunks[l];
+										if (ch)
+											cindex[_chunk_index_key (ch->x, ch->z)] = ch;
+									}
+							}
+					}
+			}
+	}
+	
 	
 	
-	static unsigned char*
-	combine_sectors (hw_chunk *hch, binary_reader reader, unsigned int *out_size)
+	static bool
+	_pread_full (int fd, unsigned char *out, size_t len, off_t off, size_t& got)
 	{
-		unsigned int compressed_size = hch->size;
-		*out_size = compressed_size;
-		
-		unsigned char *compressed = new unsigned char[compressed_size];
-		unsigned int n = 0;
-		
-		int sector_index = 0;
-		while (compressed_size > 0)
+		got = 0;
+		while (got < len)
+			{
+				ssize_t r = ::pread (fd, out + got, len - got, off + got);
+				if (r < 0)
+					return false;
+				else if (r == 0)
+					break; // EOF
+				got += r;
+			}
+		return true;
+	}
+	
+	/* 
+	 * Reads the sectors that make up a chunk into @{out}, which must be able to
+	 * hold (@{sector_count} * 4096) bytes.  Runs of consecutive sectors that
+	 * are not cached are fetched with a single pread ().
+	 */
+	static bool
+	read_sectors (int fd, hw_sector_cache *scache, unsigned int gen,
+		const unsigned int *sectors, unsigned int sector_count,
+		unsigned int size, unsigned char *out)
+	{
+		unsigned int i = 0, j;
+		while (i < sector_count)
 			{
-				int need = (compressed_size >= 4096) ? 4096 : compressed_size;
-				reader.seek (hch->sector_table[sector_index] * 512);
-				reader.read_bytes (compressed + n, need);
+				if (scache->get (sectors[i], out + (i * 4096)))
+					{ ++ i; continue; }
+				
+				for (j = i + 1; j < sector_count; ++j)
+					if (sectors[j] != sectors[j - 1] + 8)
+						break;
 				
-				n += need;
-				compressed_size -= need;
-				++ sector_index;
+				size_t len = (j - i) * 4096;
+				size_t need = (j == sector_count) ? (size - (i * 4096)) : len;
+				size_t got;
+				if (!_pread_full (fd, out + (i * 4096), len,
+					(off_t)sectors[i] * 512, got) || got < need)
+					return false;
+				
+				for (unsigned int k = i; (k < j) && ((k - i + 1) * 4096 <= got); ++k)
+					scache->put (sectors[k], out + (k * 4096), gen);
+				
+				i = j;
 			}
 		
-		return compressed;
+		return true;
 	}
 	
 	
@@ -1494,45 +2226,18 @@ namespace hCraft {
 			if (primary_bitmap & (1 << i))
 				{ std::memcpy (ch->get_sub (i)->extra, data + n, 4096); n += 4096; }
 		
-		// custom blocks
+		// custom block bitmap, add\air count
 		for (i = 0; i < 16; ++i)
 			{
 				subchunk *sub = ch->get_sub (i);
-				if (!sub) continue;
-				
-				for (int i = 0; i < 128; ++i)
-					sub->custom[i] = 0;
-				
-				for (int i = 0; i < 4096; ++i)
-					if (!block_info::is_vanilla_id (sub->ids[i]))
-						sub->custom[i >> 5] |=  (1 << (i & 0x1F));
+				if (sub)
+					sub->recalc_counts ();
 			}
 		
 		// biomes
 		std::memcpy (ch->get_biome_array (), data + n, 256);
 		n += 256;
 		
-		// calculate add\air count
-		for (i = 0; i < 16; ++i)
-			{
-				subchunk *sub = ch->get_sub (i);
-				if (sub)
-					{
-						for (int j = 0; j < 4096; ++j)
-							{
-								if (sub->ids[j] != 0)
-									-- sub->air_count;
-								if (sub->add && sub->add[j >> 1] != 0)
-									{
-										if (sub->add[j >> 1] >> 4)
-											++ sub->add_count;
-										if (sub->add[j >> 1] & 0xF)
-											++ sub->add_count;
-									}
-							}
-					}
-			}
-		
 		// and finally, layers
 		n = _fill_ly_signs (ch, data, n);
 	}
@@ -1545,41 +2250,450 @@ namespace hCraft {
 	bool
 	hw_provider::load (world &wr, chunk *ch, int x, int z)
 	{
-		if (!this->strm.is_open ())
-			return false;
+		// reused across loads on the same thread.
+		static thread_local std::vector<unsigned char> compressed;
+		static thread_local std::vector<unsigned char> data;
+		
+		int fd;
+		int codec_id;
+		unsigned int gen;
+		unsigned int compressed_size;
+		unsigned int sector_count;
+		unsigned int sectors[256];
+		
+		// copy what we need out of the index, and do the actual I\O unlocked.
+		{
+			std::lock_guard<std::mutex> guard {this->idx_lock};
+			auto itr = this->cindex.find (_chunk_index_key (x, z));
+			if (itr == this->cindex.end ())
+				return false;
+			
+			hw_chunk *hch = itr->second;
+			if (hch->size <= 0)
+				return false;
+			
+			if (this->rfd == -1)
+				{
+					this->rfd = ::open (this->out_path.c_str (), O_RDONLY);
+					if (this->rfd == -1)
+						return false;
+				}
+			
+			fd = this->rfd;
+			gen = this->scache->generation ();
+			codec_id = hch->codec;
+			compressed_size = hch->size;
+			sector_count = (compressed_size + 4095) / 4096;
+			std::memcpy (sectors, hch->sector_table, sector_count * sizeof (unsigned int));
+			
+			// keep these sectors from being handed out until we are done.
+			this->fmap.begin_read ();
+		}
 		
-		binary_writer writer; // not actually used
-		hw_chunk *hch = find_or_create_chunk (x, z, this->sblocks, writer, false);
-		if (!hch) return false;
+		if (compressed.size () < sector_count * 4096)
+			compressed.resize (sector_count * 4096);
+		bool read_ok = read_sectors (fd, this->scache, gen, sectors, sector_count,
+			compressed_size, compressed.data ());
+		{
+			std::lock_guard<std::mutex> guard {this->idx_lock};
+			this->fmap.end_read ();
+		}
+		if (!read_ok)
+			throw std::runtime_error ("failed to read chunk");
 		
-		binary_reader reader {this->strm};
+		if (data.size () < 524288)
+			data.resize (524288);
+		unsigned long data_size = data.size ();
+		if (!codec::decompress (codec_id, compressed.data (), compressed_size,
+			data.data (), data_size))
+			throw std::runtime_error ("failed to decompress chunk");
 		
-		unsigned int compressed_size = 0;
-		unsigned char *compressed = combine_sectors (hch, reader, &compressed_size);
+		fill_chunk (ch, data.data ());
+		return true;
+	}
+	
+	/* 
+	 * Fills @{out} with the coordinates of every chunk stored in the world.
+	 */
+	void
+	hw_provider::list_chunks (std::vector<std::pair<int, int>>& out)
+	{
+		std::lock_guard<std::mutex> guard {this->idx_lock};
+		out.reserve (out.size () + this->cindex.size ());
+		for (auto itr = this->cindex.begin (); itr != this->cindex.end (); ++itr)
+			{
+				if (itr->second->size <= 0)
+					continue;
+				out.emplace_back ((int)(itr->first >> 32), (int)(itr->first & 0xFFFFFFFFU));
+			}
+	}
+	
+	
+	
+	static bool
+	_pwrite_full (int fd, const unsigned char *data, size_t len, off_t off)
+	{
+		size_t done = 0;
+		while (done < len)
+			{
+				ssize_t r = ::pwrite (fd, data + done, len - done, off + done);
+				if (r <= 0)
+					return false;
+				done += r;
+			}
+		return true;
+	}
+	
+	/* 
+	 * Recompresses a few chunks that were stored raw (if the world was
+	 * configured to do so) with the background codec.
+	 */
+	void
+	hw_provider::idle (world &wr)
+	{
+		const static int max_chunks = 16; // per call
 		
-		unsigned long data_size = 524288;
-		unsigned char *data = new unsigned char[data_size];
-		if (uncompress (data, &data_size, compressed, compressed_size) != Z_OK)
+		int fd = -1;
+		for (int i = 0; i < max_chunks; ++i)
 			{
-				delete[] compressed;
-				delete[] data;
-				throw std::runtime_error ("failed to decompress chunk");
+				unsigned long long key;
+				unsigned int sectors[256];
+				unsigned int size, sector_count, gen, save_count;
+				int bg, level;
+				
+				{
+					std::lock_guard<std::mutex> guard {this->idx_lock};
+					if (this->raw_pending.empty ())
+						break;
+					key = this->raw_pending.back ();
+					this->raw_pending.pop_back ();
+					
+					auto itr = this->cindex.find (key);
+					if (itr == this->cindex.end ())
+						continue;
+					hw_chunk *hch = itr->second;
+					if (hch->codec != CODEC_RAW || hch->size <= 0)
+						continue;
+					
+					bg = this->bg_codec;
+					level = this->codec_level;
+					size = hch->size;
+					sector_count = (size + 4095) / 4096;
+					std::memcpy (sectors, hch->sector_table, sector_count * sizeof (unsigned int));
+					gen = this->scache->generation ();
+					save_count = this->save_counter;
+					this->fmap.begin_read ();
+				}
+				
+				if (fd == -1)
+					fd = ::open (this->out_path.c_str (), O_RDWR);
+				
+				// read and compress without holding the index lock.
+				std::vector<unsigned char> raw (sector_count * 4096);
+				bool read_ok = (fd != -1) && read_sectors (fd, this->scache, gen,
+					sectors, sector_count, size, raw.data ());
+				{
+					std::lock_guard<std::mutex> guard {this->idx_lock};
+					this->fmap.end_read ();
+				}
+				if (fd == -1)
+					return;
+				if (!read_ok)
+					continue;
+				
+				unsigned long comp_size = codec::bound (bg, size);
+				std::vector<unsigned char> comp (comp_size);
+				if (!codec::compress (bg, level, raw.data (), size, comp.data (), comp_size))
+					continue;
+				if (comp_size >= size)
+					continue; // leave it as is
+				
+				std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
+				std::lock_guard<std::mutex> guard {this->idx_lock};
+				if (this->save_counter != save_count)
+					{
+						// the chunk might have been rewritten while we were busy, try
+						// again later.
+						this->raw_pending.push_back (key);
+						break;
+					}
+				
+				auto itr = this->cindex.find (key);
+				if (itr == this->cindex.end ())
+					continue;
+				hw_chunk *hch = itr->second;
+				
+				// write the result to fresh sectors (see write_in_sectors ()), so that
+				// loads still reading the raw copy are not affected.
+				unsigned int new_sectors = (comp_size + 4095) / 4096;
+				comp.resize (new_sectors * 4096);
+				std::fill (comp.begin () + comp_size, comp.end (), 0);
+				
+				unsigned int off = this->fmap.alloc (new_sectors * 8);
+				if (off == 0)
+					{
+						struct stat st;
+						if (fstat (fd, &st) != 0)
+							continue;
+						off = (st.st_size + 511) / 512;
+					}
+				
+				bool ok = _pwrite_full (fd, comp.data (), new_sectors * 4096, (off_t)off * 512);
+				this->dmap.mark ((unsigned long long)off * 512, new_sectors * 4096);
+				for (unsigned int j = 0; j < new_sectors; ++j)
+					this->scache->invalidate (off + (j * 8));
+				
+				unsigned int table[256];
+				for (unsigned int j = 0; j < 256; ++j)
+					table[j] = (j < new_sectors) ? (off + (j * 8)) : 0;
+				
+				if (ok)
+					{
+						unsigned char tbl[1024];
+						for (unsigned int j = 0; j < 256; ++j)
+							_write_int (tbl + (j * 4), table[j]);
+						unsigned char hdr[4];
+						_write_int (hdr, comp_size);
+						unsigned char cb = bg;
+						ok = _pwrite_full (fd, tbl, 1024, (off_t)hch->offset * 512 + 4)
+							&& _pwrite_full (fd, hdr, 4, (off_t)hch->offset * 512)
+							&& _pwrite_full (fd, &cb, 1, (off_t)hch->offset * 512 + HW_CHUNK_CODEC_OFFSET);
+						this->dmap.mark ((unsigned long long)hch->offset * 512, HW_CHUNK_CODEC_OFFSET + 1);
+					}
+				if (!ok)
+					{
+						// the old copy is left untouched.
+						this->fmap.free (off, new_sectors * 8);
+						continue;
+					}
+				
+				for (unsigned int j = 0; j < sector_count; ++j)
+					{
+						this->scache->invalidate (hch->sector_table[j]);
+						this->fmap.free (hch->sector_table[j], 8);
+					}
+				std::memcpy (hch->sector_table, table, sizeof table);
+				hch->size = comp_size;
+				hch->codec = bg;
 			}
-		delete[] compressed;
 		
-		fill_chunk (ch, data);
-		delete[] data;
-		return true;
+		if (fd == -1)
+			fd = ::open (this->out_path.c_str (), O_RDWR);
+		if (fd != -1)
+			{
+				this->compact_some (fd, 32);
+				::close (fd);
+			}
+	}
+	
+	
+	
+	/* 
+	 * Moves up to @{max_moves} chunks into free space closer to the front of
+	 * the file, visiting chunks in Z-order, so that over time chunks that are
+	 * near each other in the world end up next to each other on disk, and the
+	 * file shrinks. Returns true if anything was moved.
+	 * 
+	 * The index lock is only held while picking destinations and while
+	 * committing a move; the sectors themselves are copied without it, so
+	 * that loads are not stalled behind the I/O.
+	 */
+	bool
+	hw_provider::compact_some (int fd, int max_moves)
+	{
+		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
+		
+		// appends made through @{strm} must be on disk before we look at (and
+		// possibly cut) the end of the file.
+		if (this->strm.is_open ())
+			this->strm.flush ();
+		
+		struct stat st;
+		if (fstat (fd, &st) != 0)
+			return false;
+		unsigned int file_units = st.st_size / 512;
+		
+		unsigned int packed_end;
+		{
+			std::lock_guard<std::mutex> guard {this->idx_lock};
+			if (this->compact_pos >= this->compact_queue.size ())
+				{
+					this->compact_queue.clear ();
+					this->compact_pos = 0;
+					
+					// only start a new pass once there is a meaningful amount of free
+					// space (at least 1MB and an eighth of the file).
+					unsigned long long free_units = this->fmap.free_units ();
+					if (free_units < 2048 || (free_units * 8) < file_units)
+						return false;
+					
+					this->compact_queue.reserve (this->cindex.size ());
+					for (auto& p : this->cindex)
+						this->compact_queue.push_back (p.first);
+					std::sort (this->compact_queue.begin (), this->compact_queue.end (),
+						[] (unsigned long long a, unsigned long long b)
+							{ return _chunk_morton (a) < _chunk_morton (b); });
+				}
+			
+			packed_end = file_units - (unsigned int)this->fmap.free_units ();
+		}
+		
+		std::vector<unsigned char> buf (4096);
+		int moves = 0;
+		for (;;)
+			{
+				unsigned long long key;
+				unsigned int n, size;
+				int offset;
+				unsigned int src[256], dest[256];
+				unsigned int j;
+				
+				// pick the next chunk to move and reserve its destination.
+				{
+					std::lock_guard<std::mutex> guard {this->idx_lock};
+					if (moves >= max_moves || this->compact_pos >= this->compact_queue.size ())
+						break;
+					
+					key = this->compact_queue[this->compact_pos ++];
+					auto itr = this->cindex.find (key);
+					if (itr == this->cindex.end ())
+						continue;
+					hw_chunk *hch = itr->second;
+					if (hch->size <= 0)
+						continue;
+					
+					size = hch->size;
+					offset = hch->offset;
+					n = (size + 4095) / 4096;
+					std::memcpy (src, hch->sector_table, n * sizeof (unsigned int));
+					
+					bool any = false;
+					
+					// prefer moving the whole chunk into a single run of sectors.
+					unsigned int off = this->fmap.alloc_below (n * 8, src[0]);
+					if (off != 0)
+						{
+							for (j = 0; j < n; ++j)
+								dest[j] = off + (j * 8);
+							any = true;
+						}
+					else
+						{
+							// if the chunk sits past the point the file would end at were it
+							// fully packed, evacuate its sectors one by one.
+							for (j = 0; j < n; ++j)
+								{
+									dest[j] = src[j];
+									if (src[j] >= packed_end)
+										{
+											unsigned int s = this->fmap.alloc_below (8, packed_end);
+											if (s != 0)
+												{ dest[j] = s; any = true; }
+										}
+								}
+						}
+					if (!any)
+						continue;
+					++ moves;
+				}
+				
+				// copy the sectors over.
+				bool ok = true;
+				for (j = 0; j < n && ok; ++j)
+					{
+						if (dest[j] == src[j])
+							continue;
+						
+						size_t got;
+						size_t need = (j == n - 1) ? (size - (j * 4096)) : 4096;
+						ok = _pread_full (fd, buf.data (), 4096, (off_t)src[j] * 512, got)
+							&& (got >= need)
+							&& _pwrite_full (fd, buf.data (), 4096, (off_t)dest[j] * 512);
+						this->dmap.mark ((unsigned long long)dest[j] * 512, 4096);
+					}
+				
+				// commit, unless the chunk changed in the meantime.
+				std::lock_guard<std::mutex> guard {this->idx_lock};
+				auto itr = this->cindex.find (key);
+				hw_chunk *hch = (itr == this->cindex.end ()) ? nullptr : itr->second;
+				if (ok)
+					ok = hch && ((unsigned int)hch->size == size) && (hch->offset == offset)
+						&& (std::memcmp (hch->sector_table, src, n * sizeof (unsigned int)) == 0);
+				if (ok)
+					{
+						unsigned char tbl[1024];
+						for (j = 0; j < n; ++j)
+							_write_int (tbl + (j * 4), dest[j]);
+						ok = _pwrite_full (fd, tbl, n * 4, (off_t)offset * 512 + 4);
+						this->dmap.mark ((unsigned long long)offset * 512 + 4, n * 4);
+					}
+				
+				for (j = 0; j < n; ++j)
+					{
+						if (dest[j] == src[j])
+							continue;
+						
+						this->scache->invalidate (dest[j]);
+						if (!ok)
+							{
+								// leave the chunk where it is
+								this->fmap.free (dest[j], 8);
+								continue;
+							}
+						
+						this->scache->invalidate (src[j]);
+						this->fmap.free (src[j], 8);
+						hch->sector_table[j] = dest[j];
+					}
+			}
+		
+		if ((st.st_size % 512) == 0)
+			{
+				unsigned int new_end = file_units;
+				{
+					std::lock_guard<std::mutex> guard {this->idx_lock};
+					if (this->compact_pos < this->compact_queue.size ())
+						return moves > 0;
+					
+					// pass complete, give trailing free space back to the filesystem.
+					new_end = this->fmap.trim_tail (file_units);
+				}
+				
+				if (new_end < file_units)
+					{
+						// only cut the file if nothing was appended to it since we
+						// looked; otherwise just hand the space back.
+						struct stat st2;
+						bool same_end = (fstat (fd, &st2) == 0) && (st2.st_size == st.st_size);
+						if (!same_end || ftruncate (fd, (off_t)new_end * 512) != 0)
+							{
+								std::lock_guard<std::mutex> guard {this->idx_lock};
+								this->fmap.free (new_end, file_units - new_end);
+							}
+					}
+			}
+		
+		return moves > 0;
 	}
 	
 	
 	
 	static unsigned int
-	_create_layer_page (binary_writer writer)
+	_create_layer_page (binary_writer writer, hw_free_map& fmap, std::mutex& idx_lock)
 	{
-		writer.seek (0, std::ios_base::end);
-		writer.pad_to (512);
-		unsigned int page_offset = (unsigned int)writer.tell ();
+		unsigned int page_offset;
+		{
+			std::lock_guard<std::mutex> guard {idx_lock};
+			page_offset = fmap.alloc (HW_LAYER_PAGE_SIZE / 512) * 512;
+		}
+		if (page_offset == 0)
+			{
+				writer.seek (0, std::ios_base::end);
+				writer.pad_to (512);
+				page_offset = (unsigned int)writer.tell ();
+			}
+		else
+			writer.seek (page_offset);
 		writer.write_int (0); // offset to next page
 		
 		unsigned int left = HW_LAYER_PAGE_DATA_SIZE;
@@ -1596,12 +2710,13 @@ namespace hCraft {
 	hw_provider::write_layer (const char *layer_name, const unsigned char *data,
 		unsigned int layer_size)
 	{
+		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
 		int ly_index = -1;
 		for (size_t i = 0; i < this->layers.size (); ++i)
 			if (this->layers[i].name.compare (layer_name) == 0)
 				{ ly_index = i;  break; }
 		
-		binary_writer writer {this->strm};
+		binary_writer writer {this->strm, &this->dmap};
 		unsigned int written = 0;
 		
 		hw_layer *ly;
@@ -1609,7 +2724,7 @@ namespace hCraft {
 		if (ly_index == -1)
 			{
 				// create the initial page
-				init_page_offset = _create_layer_page (writer);
+				init_page_offset = _create_layer_page (writer, this->fmap, this->idx_lock);
 				
 				// link this page to the layer table.
 				ly_index = this->layers.size ();
@@ -1654,6 +2769,14 @@ namespace hCraft {
 						for (; i < new_page_count; ++i)
 							new_offsets[i] = 0;
 						
+						// release pages the layer no longer needs.
+						if (old_page_count > new_page_count)
+							{
+								std::lock_guard<std::mutex> guard {this->idx_lock};
+								for (i = (new_page_count > 1) ? new_page_count : 1; i < old_page_count; ++i)
+									this->fmap.free (ly->offsets[i], HW_LAYER_PAGE_SIZE / 512);
+							}
+						
 						delete[] ly->offsets;
 						ly->offsets = new_offsets;
 						
@@ -1692,7 +2815,7 @@ namespace hCraft {
 						if (ly->offsets[page_index] == 0)
 							{
 								// allocate another page
-								unsigned int next_page_offset = _create_layer_page (writer);
+								unsigned int next_page_offset = _create_layer_page (writer, this->fmap, this->idx_lock);
 								writer.seek (curr_page_offset);
 								writer.write_int (next_page_offset / 512);
 								writer.seek (next_page_offset + 4);
@@ -1710,6 +2833,13 @@ namespace hCraft {
 	
 	unsigned char*
 	hw_provider::read_layer (const char *layer_name, unsigned int& data_size)
+	{
+		return this->read_layer (this->strm, layer_name, data_size);
+	}
+	
+	unsigned char*
+	hw_provider::read_layer (std::fstream& strm, const char *layer_name,
+		unsigned int& data_size)
 	{
 		int ly_index = -1;
 		for (size_t i = 0; i < this->layers.size (); ++i)
@@ -1725,7 +2855,7 @@ namespace hCraft {
 		unsigned char *data = new unsigned char [this->layers[ly_index].size];
 		
 		hw_layer &ly = this->layers[ly_index];
-		binary_reader reader {this->strm};
+		binary_reader reader {strm};
 		
 		int page_index = 0;
 		unsigned int left = ly.size;
@@ -2075,5 +3205,53 @@ namespace hCraft {
 		
 		delete[] data;
 	}
+	
+	
+	
+//----
+	
+	/* 
+	 * Moves the indices of all blocks modified since the last call into
+	 * @{out} and stores the current size of the world file in @{file_size}.
+	 */
+	bool
+	hw_provider::take_dirty_blocks (std::vector<unsigned int>& out,
+		unsigned long long& file_size)
+	{
+		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
+		
+		struct stat st;
+		if (stat (this->out_path.c_str (), &st) != 0)
+			{
+				this->dmap.mark_all ();
+				return false;
+			}
+		file_size = st.st_size;
+		
+		return this->dmap.take (out);
+	}
+	
+	/* 
+	 * Marks the specified blocks as modified again.
+	 */
+	void
+	hw_provider::mark_dirty_blocks (const std::vector<unsigned int>& blocks)
+	{
+		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
+		for (unsigned int b : blocks)
+			this->dmap.mark ((unsigned long long)b << 12, 4096);
+	}
+	
+	/* 
+	 * Calls @{fn} with all writes to the world file held off.
+	 */
+	void
+	hw_provider::freeze (const std::function<void ()>& fn)
+	{
+		std::lock_guard<std::recursive_mutex> wguard {this->write_lock};
+		if (this->strm.is_open ())
+			this->strm.flush ();
+		fn ();
+	}
 }
 
@@ -0,0 +1,245 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "world/tick_executor.hpp"
+#include "world/world.hpp"
+
+
+namespace hCraft {
+	
+	// ticks a world may fall behind before its backlog is dropped.
+	static const int max_tick_lag = 20;
+	
+	// consecutive idle ticks after which a world is put to sleep (~60 seconds).
+	static const int hibernate_after = 12000;
+	
+	
+	
+	tick_executor::tick_executor ()
+	{
+		this->running = false;
+	}
+	
+	tick_executor::~tick_executor ()
+	{
+		this->stop ();
+	}
+	
+	
+	
+	/* 
+	 * Starts the specified amount of threads.
+	 */
+	void
+	tick_executor::start (int thread_count)
+	{
+		if (this->running)
+			return;
+		
+		this->running = true;
+		for (int i = 0; i < thread_count; ++i)
+			this->threads.emplace_back (
+				std::bind (std::mem_fn (&hCraft::tick_executor::main_loop), this));
+	}
+	
+	/* 
+	 * Waits for ticks in progress to finish, and stops all threads.
+	 */
+	void
+	tick_executor::stop ()
+	{
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			if (!this->running)
+				return;
+			this->running = false;
+		}
+		
+		this->cv.notify_all ();
+		for (std::thread& th : this->threads)
+			if (th.joinable ())
+				th.join ();
+		this->threads.clear ();
+		
+		std::lock_guard<std::mutex> guard {this->lock};
+		while (!this->runq.empty ())
+			{
+				entry *e = this->runq.top ().second;
+				this->runq.pop ();
+				if (e->removed)
+					delete e;
+			}
+		for (auto itr = this->entries.begin (); itr != this->entries.end (); ++itr)
+			delete itr->second;
+		this->entries.clear ();
+	}
+	
+	
+	
+	void
+	tick_executor::push_nolock (entry *e)
+	{
+		e->queued = true;
+		this->runq.push (std::make_pair (e->next, e));
+		this->cv.notify_one ();
+	}
+	
+	/* 
+	 * Starts ticking the specified world.
+	 */
+	void
+	tick_executor::add (world *w)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		if (this->entries.find (w) != this->entries.end ())
+			return;
+		
+		entry *e = new entry ();
+		e->w = w;
+		e->next = clock::now ();
+		e->idle_ticks = 0;
+		e->busy = e->queued = e->sleeping = e->removed = false;
+		this->entries[w] = e;
+		this->push_nolock (e);
+	}
+	
+	/* 
+	 * Stops ticking the given world.  If the world is being ticked, the
+	 * function blocks until the tick completes (and so must not be called
+	 * from within the world's tick).
+	 */
+	void
+	tick_executor::remove (world *w)
+	{
+		std::unique_lock<std::mutex> guard {this->lock};
+		auto itr = this->entries.find (w);
+		if (itr == this->entries.end ())
+			return;
+		
+		entry *e = itr->second;
+		this->entries.erase (itr);
+		e->removed = true;
+		
+		while (e->busy)
+			this->done_cv.wait (guard);
+		
+		// entries still in the run queue are freed once they reach its top.
+		if (!e->queued)
+			delete e;
+	}
+	
+	/* 
+	 * Resumes ticking a hibernating world.
+	 */
+	void
+	tick_executor::wake (world *w)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		auto itr = this->entries.find (w);
+		if (itr == this->entries.end ())
+			return;
+		
+		entry *e = itr->second;
+		e->idle_ticks = 0;
+		if (e->sleeping)
+			{
+				e->sleeping = false;
+				e->next = clock::now ();
+				this->push_nolock (e);
+			}
+	}
+	
+	
+	
+	/* 
+	 * The function ran by each of the executor's threads.
+	 */
+	void
+	tick_executor::main_loop ()
+	{
+		std::unique_lock<std::mutex> guard {this->lock};
+		while (this->running)
+			{
+				if (this->runq.empty ())
+					{
+						this->cv.wait (guard);
+						continue;
+					}
+				
+				queued_entry top = this->runq.top ();
+				entry *e = top.second;
+				if (e->removed)
+					{
+						this->runq.pop ();
+						delete e;
+						continue;
+					}
+				
+				if (top.first > clock::now ())
+					{
+						this->cv.wait_until (guard, top.first);
+						continue;
+					}
+				
+				this->runq.pop ();
+				e->queued = false;
+				e->busy = true;
+				guard.unlock ();
+				
+				bool slept = false;
+				auto tick_start = std::chrono::steady_clock::now ();
+				int lag = (int)((tick_start - e->next) / tick_period);
+				bool idle = e->w->tick (lag);
+				e->w->tick_times.observe (tick_start);
+				e->w->recent_tick_times.observe (tick_start);
+				if (idle)
+					{
+						if (++ e->idle_ticks >= hibernate_after)
+							{
+								e->idle_ticks = 0;
+								slept = e->w->hibernate ();
+							}
+					}
+				else
+					e->idle_ticks = 0;
+				
+				guard.lock ();
+				e->busy = false;
+				if (e->removed)
+					{
+						this->done_cv.notify_all ();
+						continue;
+					}
+				
+				// the world might have been woken up while it was hibernating.
+				if (slept && e->w->is_hibernating ())
+					{
+						e->sleeping = true;
+						continue;
+					}
+				
+				// fixed timestep
+				clock::time_point now = clock::now ();
+				e->next += tick_period;
+				if (e->next < now - max_tick_lag * tick_period)
+					e->next = now;
+				this->push_nolock (e);
+			}
+	}
+}
+
@@ -17,6 +17,8 @@
  */
 
 #include "world/world.hpp"
+#include "world/tick_executor.hpp"
+#include "world/change_tracker.hpp"
 #include "system/server.hpp"
 #include "player/player_list.hpp"
 #include "player/player.hpp"
@@ -42,11 +44,47 @@ namespace hCraft {
 	chunk_coords (unsigned long long key, int* x, int* z)
 		{ *x = key & 0xFFFFFFFFU; *z = key >> 32; }
 	
+	/* 
+	 * Detaches the specified chunk from its neighbours.
+	 */
+	static void
+	unlink_chunk (chunk *ch)
+	{
+		if (ch->north) ch->north->south = nullptr;
+		if (ch->south) ch->south->north = nullptr;
+		if (ch->west) ch->west->east = nullptr;
+		if (ch->east) ch->east->west = nullptr;
+		ch->north = ch->south = ch->west = ch->east = nullptr;
+	}
+	
+	// chunk memory used by all worlds, as of their last eviction passes.
+	static std::atomic<long long> _total_chunk_mem {0};
+	
+	/* 
+	 * Time budgets for the phases of a world tick.  Ticks are 5ms apart (see
+	 * tick_executor), so this leaves some room for the other worlds sharing
+	 * the executor's threads.
+	 */
+	static const std::chrono::microseconds _block_update_budget {2500};
+	static const std::chrono::microseconds _light_update_budget {1000};
+	static const std::chrono::microseconds _shed_light_update_budget {200};
+	
+	// worlds lagging this many ticks behind cut back on lighting and skip
+	// maintenance work until they catch up.
+	static const int _shed_lag = 4;
+	
+	// wall time between two increments of the world's time (20 per second).
+	static const std::chrono::milliseconds _wtime_period {50};
+	
 	
 	
 	static void
 	_init_sql_tables (world *w, server &srv)
 	{
+		// offline tools (e.g. hcraft-forge) run without a database.
+		if (!srv.has_sql ())
+			return;
+		
 		soci::session sql (srv.sql_pool ());
 		
 		// block history table
@@ -79,6 +117,7 @@ namespace hCraft {
 		assert (world::is_valid_name (name));
 		std::strcpy (this->name, name);
 		
+		this->id = -1; // set by server::register_world ()
 		this->typ = typ;
 		
 		this->gen = gen;
@@ -88,14 +127,25 @@ namespace hCraft {
 		this->prov = provider;
 		this->edge_chunk = nullptr;
 		this->last_chunk = {0, 0, nullptr};
+		this->pending_tasks = 0;
+		this->chunk_mem = 0;
 		
 		this->players = new player_list ();
-		this->th_running = false;
+		this->ticking = false;
+		this->hibernating = false;
+		this->chtr = new chunk_change_tracker (this);
 		this->auto_lighting = true;
 		this->ticks = this->wtime = 0;
 		this->wtime_frozen = false;
+		this->wtime_clock = std::chrono::steady_clock::now ();
+		this->tick_lag = 0;
 		this->use_def_inv = false;
 		this->def_gm = GT_SURVIVAL;
+		this->view_dist = 0;
+		this->view_cap = srv.get_config ().view_distance;
+		this->vd_tick_count = this->vd_tick_sum = 0;
+		this->vd_clock = std::chrono::steady_clock::now ();
+		this->vd_calm_checks = 0;
 		
 		this->ph_state = PHY_OFF;
 		//this->physics.set_thread_count (0);
@@ -112,6 +162,9 @@ namespace hCraft {
 		this->srv.cgen.cancel_requests (this);
 		
 		this->stop ();
+		this->wait_for_tasks ();
+		_total_chunk_mem -= this->chunk_mem;
+		delete this->chtr;
 		delete this->players;
 		
 		delete this->gen;
@@ -195,6 +248,8 @@ namespace hCraft {
 		wr->use_def_inv = winf.use_def_inv;
 		wr->wtime = winf.time;
 		wr->wtime_frozen = winf.time_frozen;
+		wr->view_dist = winf.view_dist;
+		wr->view_cap = wr->max_view_distance ();
 		
 		wr->prov->open (*wr);
 		wr->prov->load_portals (*wr, wr->portals);
@@ -221,6 +276,9 @@ namespace hCraft {
 	void
 	world::reload_world (const char *name)
 	{
+		// nothing queued before the reload may reach the new provider.
+		this->discard_pending_saves ();
+		
 		{
 			// acquire all locks
 			std::lock_guard<std::mutex> ch_guard {this->chunk_lock};
@@ -273,7 +331,12 @@ namespace hCraft {
 			 */
 			delete this->gen;
 			if (this->prov)
-				delete this->prov;
+				{
+					// chunk loads might still be reading through the old provider
+					// (see load_chunk_nolock ()).
+					world_provider *old_prov = this->prov;
+					this->srv.get_epochs ().retire ([old_prov] () { delete old_prov; });
+				}
 			
 			for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
 				{
@@ -286,6 +349,15 @@ namespace hCraft {
 				}
 			this->chunks.clear ();
 			
+			// anything evicted since discard_pending_saves () is dropped too.
+			for (auto itr = this->evicting.begin (); itr != this->evicting.end (); ++itr)
+				{
+					int cx, cz;
+					chunk_coords (itr->first, &cx, &cz);
+					this->bad_chunks.push_back ({cx, cz, itr->second});
+				}
+			this->evicting.clear ();
+			
 			for (portal *ptl : this->portals)
 				delete ptl;
 			this->portals.clear ();
@@ -302,6 +374,8 @@ namespace hCraft {
 			this->use_def_inv = winf.use_def_inv;
 			this->wtime = winf.time;
 			this->wtime_frozen = winf.time_frozen;
+			this->view_dist = winf.view_dist;
+			this->view_cap = this->max_view_distance ();
 			
 			this->prov->open (*this);
 			this->prov->load_portals (*this, this->portals);
@@ -479,37 +553,33 @@ namespace hCraft {
 	
 	
 	/* 
-	 * Starts the world's "physics"-handling thread.
+	 * Starts ticking the world on the server's tick executor.
 	 */
 	void
 	world::start ()
 	{
-		if (this->typ == WT_LIGHT)
-			return;
-		if (this->th_running)
+		if (this->ticking)
 			return;
 		
 		this->start_physics ();
-		this->th_running = true;
-		this->th.reset (new std::thread (
-			std::bind (std::mem_fn (&hCraft::world::worker), this)));
+		this->ticking = true;
+		this->hibernating = false;
+		this->srv.get_tick_executor ().add (this);
 	}
 	
 	/* 
-	 * Stops the world's thread.
+	 * Stops ticking the world.
 	 */
 	void
 	world::stop ()
 	{
-		if (!this->th_running)
+		if (!this->ticking)
 			return;
 		
 		this->stop_physics ();
 		
-		this->th_running = false;
-		if (this->th->joinable ())
-			this->th->join ();
-		this->th.reset ();
+		this->srv.get_tick_executor ().remove (this);
+		this->ticking = false;
 	}
 	
 	
@@ -575,201 +645,365 @@ namespace hCraft {
 	
 	
 	/* 
-	 * The function ran by the world's thread.
+	 * Frees chunks removed from the world that no player can see anymore.
 	 */
 	void
-	world::worker ()
+	world::dispose_bad_chunks ()
+	{
+		std::lock_guard<std::mutex> guard {this->bad_chunk_lock};
+		for (auto itr = this->bad_chunks.begin (); itr != this->bad_chunks.end (); )
+			{
+				auto tch = *itr;
+				
+				// make sure there aren't any players near this chunk
+				bool used = false;
+				this->get_players ().all (
+					[&used, tch] (player *pl)
+						{
+							if (used) return;
+							
+							if (pl->can_see_chunk (tch.cx, tch.cz))
+								used = true;
+						});
+				
+				if (!used)
+					{
+						delete tch.ch;
+						itr = this->bad_chunks.erase (itr);
+					}
+				else
+					++ itr;
+			}
+	}
+	
+	/* 
+	 * Performs a single world tick (block and lighting updates, chunk
+	 * disposal, etc...).  Called by the server's tick executor, with @{lag}
+	 * being the number of ticks the world is running behind; lighting and
+	 * maintenance work is cut back while the world is trying to catch up.
+	 * Returns true if the world had nothing to do (no players, no queued
+	 * updates), in which case it may be put to sleep.
+	 */
+	bool
+	world::tick (int lag)
 	{
 		const static int block_update_cap = 10000; // per tick
 		const static int light_update_cap = 10000; // per tick
 		
 		int update_count;
-		dense_edit_stage pl_tr {this};
+		chunk_change_tracker& pl_tr = *this->chtr;
 		
-		this->ticks = 0;
-		while (this->th_running)
-			{
-				++ this->ticks;
+		bool shedding = (lag >= _shed_lag);
+		this->tick_lag = lag;
+		if (shedding)
+			this->shed_ticks.inc ();
+		
+		++ this->ticks;
+		auto phase_start = std::chrono::steady_clock::now ();
+		{
+			std::lock_guard<std::mutex> guard {this->update_lock};
+			
+			/* 
+			 * Block updates.
+			 * These are what players see respond to their actions, so they are
+			 * never shed, only limited to their time budget.
+			 */
+			if (!this->updates.empty ())
 				{
-					std::lock_guard<std::mutex> guard {this->update_lock};
-					
-					/* 
-					 * Dispose of unused chunks.
-					 */
-					{
-						std::lock_guard<std::mutex> guard {this->bad_chunk_lock};
-						for (auto itr = this->bad_chunks.begin (); itr != this->bad_chunks.end (); )
-							{
-								auto tch = *itr;
-								
-								// make sure there aren't any players near this chunk
-								bool used = false;
-								this->get_players ().all (
-									[&used, tch] (player *pl)
-										{
-											if (used) return;
-											
-											if (pl->can_see_chunk (tch.cx, tch.cz))
-												used = true;
-										});
-								
-								if (!used)
-									{
-										delete tch.ch;
-										itr = this->bad_chunks.erase (itr);
-									}
-								else
-									++ itr;
-							}
-					}
+					std::lock_guard<std::mutex> lm_guard {this->lm.get_lock ()};
 					
+					// keeps the players in pl_vc from being destroyed under us.
+					epoch_guard eg {this->srv.get_epochs ()};
+					std::vector<player *> pl_vc;
+					this->get_players ().populate (pl_vc);
 					
-					/* 
-					 * Block updates.
-					 */
-					if (!this->updates.empty ())
+					auto deadline = phase_start + _block_update_budget;
+					update_count = 0;
+					while (!this->updates.empty () && (update_count++ < block_update_cap))
 						{
-							std::lock_guard<std::mutex> lm_guard {this->lm.get_lock ()};
+							if (((update_count & 0xFF) == 0) && (std::chrono::steady_clock::now () > deadline))
+								break;
 							
-							std::vector<player *> pl_vc;
-							this->get_players ().populate (pl_vc);
+							block_update &u = this->updates.front ();
 							
-							update_count = 0;
-							while (!this->updates.empty () && (update_count++ < block_update_cap))
+							if (((this->width > 0) && ((u.x >= this->width) || (u.x < 0))) ||
+								((this->depth > 0) && ((u.z >= this->depth) || (u.z < 0))) ||
+								((u.y < 0) || (u.y > 255)))
 								{
-									block_update &u = this->updates.front ();
-									
-									if (((this->width > 0) && ((u.x >= this->width) || (u.x < 0))) ||
-										((this->depth > 0) && ((u.z >= this->depth) || (u.z < 0))) ||
-										((u.y < 0) || (u.y > 255)))
-										{
-											this->updates.pop_front ();
-											continue;
-										}
-									
-									block_data old_bd = this->get_block (u.x, u.y, u.z);
-									if (old_bd.id == u.id && old_bd.meta == u.meta && old_bd.ex == u.extra)
+									this->updates.pop_front ();
+									continue;
+								}
+							
+							block_data old_bd = this->get_block (u.x, u.y, u.z);
+							if (old_bd.id == u.id && old_bd.meta == u.meta && old_bd.ex == u.extra)
+								{
+									// nothing modified
+									this->updates.pop_front ();
+									continue;
+								}
+							
+							// doors
+							if (u.id == BT_AIR && u.pl)
+								{
+									if (_try_door_nolock (*this, u.x, u.y, u.z, old_bd))
 										{
-											// nothing modified
 											this->updates.pop_front ();
 											continue;
 										}
-									
-									// doors
-									if (u.id == BT_AIR && u.pl)
-										{
-											if (_try_door_nolock (*this, u.x, u.y, u.z, old_bd))
-												{
-													this->updates.pop_front ();
-													continue;
-												}
-										}
-									
-									block_info *old_inf = block_info::from_id (old_bd.id);
-									block_info *new_inf = block_info::from_id (u.id);
+								}
 							
-									physics_block *ph = physics_block::from_id (u.id);
+							physics_block *ph = physics_block::from_id (u.id);
 
+							
+							unsigned short old_id = this->get_id (u.x, u.y, u.z);
+							unsigned char old_meta = this->get_meta (u.x, u.y, u.z);
+							physics_block *old_ph = physics_block::from_id (old_id);
+							if (old_ph && (!old_ph->breakable () && (u.id == 0)))
+								{
+									old_ph->on_break_attempt (*this, u.x, u.y, u.z);
+									(u.pl)->send (packets::play::make_block_change (u.x, u.y, u.z, old_id, old_meta));
+									this->updates.pop_front ();
+									continue;
+								}
+							
+							if ((old_id == u.id) && (old_meta == u.meta))
+								{
+									this->updates.pop_front ();
+									continue;
+								}
+							
+							this->set_block (u.x, u.y, u.z, u.id, u.meta, u.extra);
+							if (u.pl)
+								{
+									// block history
+									this->blhi.insert (u.x, u.y, u.z, old_bd, {u.id, u.meta, (unsigned char)u.extra}, u.pl);
 									
-									unsigned short old_id = this->get_id (u.x, u.y, u.z);
-									unsigned char old_meta = this->get_meta (u.x, u.y, u.z);
-									physics_block *old_ph = physics_block::from_id (old_id);
-									if (old_ph && (!old_ph->breakable () && (u.id == 0)))
-										{
-											old_ph->on_break_attempt (*this, u.x, u.y, u.z);
-											(u.pl)->send (packets::play::make_block_change (u.x, u.y, u.z, old_id, old_meta));
-											this->updates.pop_front ();
-											continue;
-										}
-									
-									if ((old_id == u.id) && (old_meta == u.meta))
+									// block undo
+									(u.pl)->bundo->insert ({u.x, u.y, u.z, old_bd.id, old_bd.meta, old_bd.ex,
+										u.id, u.meta, (unsigned char)u.extra, std::time (nullptr)});
+								}
+					
+							chunk *ch = this->get_chunk_at (u.x, u.z);
+							if (block_props::is_opaque (u.id) != block_props::is_opaque (old_bd.id))
+								ch->recalc_heightmap (u.x & 0xF, u.z & 0xF);
+							
+							// update players
+							pl_tr.mark (u.x, u.y, u.z,
+								old_ph ? old_ph->vanilla_block () : blocki (old_id, old_meta),
+								ph ? ph->vanilla_block () : blocki (u.id, u.meta),
+								u.pl != nullptr);
+							
+							if (ch)
+								{
+									if (auto_lighting)
 										{
-											this->updates.pop_front ();
-											continue;
+											this->lm.enqueue_nolock (u.x, u.y, u.z);
 										}
 									
-									this->set_block (u.x, u.y, u.z, u.id, u.meta, u.extra);
-									if (u.pl)
+									// physics
+									if (old_id != u.id || old_meta != u.meta)
 										{
-											// block history
-											this->blhi.insert (u.x, u.y, u.z, old_bd, {u.id, u.meta, (unsigned char)u.extra}, u.pl);
-											
-											// block undo
-											(u.pl)->bundo->insert ({u.x, u.y, u.z, old_bd.id, old_bd.meta, old_bd.ex,
-												u.id, u.meta, (unsigned char)u.extra, std::time (nullptr)});
+											if (old_ph)
+												old_ph->on_modified (*this, u.x, u.y, u.z);
 										}
-							
-									chunk *ch = this->get_chunk_at (u.x, u.z);
-									if (new_inf->opaque != old_inf->opaque)
-										ch->recalc_heightmap (u.x & 0xF, u.z & 0xF);
-									
-									// update players
-									pl_tr.set (u.x, u.y, u.z,
-										ph ? ph->vanilla_block ().id : u.id, 
-										ph ? ph->vanilla_block ().meta : u.meta);
-									
-									if (ch)
+									if (ph && u.physics)
 										{
-											if (auto_lighting)
-												{
-													this->lm.enqueue_nolock (u.x, u.y, u.z);
-												}
-											
-											// physics
-											if (old_id != u.id || old_meta != u.meta)
-												{
-													if (old_ph)
-														old_ph->on_modified (*this, u.x, u.y, u.z);
-												}
-											if (ph && u.physics)
-												{
-													this->queue_physics (u.x, u.y, u.z, u.data, u.ptr,
-														ph->tick_rate ());
-												}
-											
-											// check neighbouring blocks
-											{
-												physics_block *nph;
-											
-												int xx, yy, zz;
-												for (xx = (u.x - 1); xx <= (u.x + 1); ++xx)
-													for (yy = (u.y - 1); yy <= (u.y + 1); ++yy)
-														for (zz = (u.z - 1); zz <= (u.z + 1); ++zz)
-															{
-																if (xx == u.x && yy == u.y && zz == u.z)
-																	continue;
-																if ((yy < 0) || (yy > 255))
-																	continue;
-															
-																nph = this->get_physics_at (xx, yy, zz);
-																if (nph && nph->affected_by_neighbours ())
-																	{
-																		nph->on_neighbour_modified (*this, xx, yy, zz,
-																			u.x, u.y, u.z);
-																	}
-															}
-											}
+											this->queue_physics (u.x, u.y, u.z, u.data, u.ptr,
+												ph->tick_rate ());
 										}
 									
-									this->updates.pop_front ();
+									// check neighbouring blocks
+									{
+										int xx, yy, zz;
+										for (xx = (u.x - 1); xx <= (u.x + 1); ++xx)
+											for (yy = (u.y - 1); yy <= (u.y + 1); ++yy)
+												for (zz = (u.z - 1); zz <= (u.z + 1); ++zz)
+													{
+														if (xx == u.x && yy == u.y && zz == u.z)
+															continue;
+														if ((yy < 0) || (yy > 255))
+															continue;
+													
+														unsigned short nid = this->get_id (xx, yy, zz);
+														if (!block_props::affected_by_neighbours (nid))
+															continue;
+														
+														physics_block *nph = physics_block::from_id (nid);
+														if (nph)
+															nph->on_neighbour_modified (*this, xx, yy, zz,
+																u.x, u.y, u.z);
+													}
+									}
 								}
 							
-							// send updates to players
-							pl_tr.preview (pl_vc);
-							pl_tr.clear ();
+							this->updates.pop_front ();
 						}
 					
-				} // release of update lock
-				
-				/* 
-				 * Lighting updates.
-				 */
-				this->lm.update (light_update_cap);
+					// send updates to players
+					pl_tr.flush (pl_vc);
+				}
+			
+		} // release of update lock
+		this->update_times.observe (phase_start);
+		
+		/* 
+		 * Lighting updates.
+		 * Can lag behind a little without anyone noticing, so this is the first
+		 * thing to go when the world is overloaded.
+		 */
+		phase_start = std::chrono::steady_clock::now ();
+		this->lm.update (light_update_cap, phase_start
+			+ (shedding ? _shed_light_update_budget : _light_update_budget));
+		this->light_times.observe (phase_start);
+		
+		/* 
+		 * Maintenance.
+		 */
+		phase_start = std::chrono::steady_clock::now ();
+		if (!shedding)
+			{
+				// dispose of unused chunks.
+				{
+					std::lock_guard<std::mutex> guard {this->update_lock};
+					this->dispose_bad_chunks ();
+				}
 				
-				std::this_thread::sleep_for (std::chrono::milliseconds (5));
-				if (!this->wtime_frozen && ((this->ticks % 10) == 0))
+				// provider maintenance (e.g. recompressing chunks saved raw).
+				if ((this->ticks % 200) == 0)
+					{
+						// reload_world () swaps the provider under the chunk lock, and
+						// retires the old one (see load_chunk_nolock ()).
+						epoch_guard eg {this->srv.get_epochs ()};
+						world_provider *prov;
+						{
+							std::lock_guard<std::mutex> ch_guard {this->chunk_lock};
+							prov = this->prov;
+						}
+						if (prov)
+							prov->idle (*this);
+					}
+			}
+		
+		// unload cold chunks if over the memory budget.
+		if ((this->ticks % 200) == 100)
+			this->evict_cold_chunks ();
+		
+		// the view distance is checked once a second, regardless of how many
+		// ticks that took.
+		if ((phase_start - this->vd_clock) >= std::chrono::seconds (1))
+			{
+				this->vd_clock = phase_start;
+				this->adjust_view_distance ();
+			}
+		this->maint_times.observe (phase_start);
+		
+		/* 
+		 * World time follows the wall clock rather than the tick count, so that
+		 * it does not drift when ticks are late or dropped.  Time is not made
+		 * up for if the world has not been ticked for a while (e.g. after
+		 * hibernating).
+		 */
+		phase_start = std::chrono::steady_clock::now ();
+		if ((phase_start - this->wtime_clock) > std::chrono::seconds (1))
+			this->wtime_clock = phase_start - _wtime_period;
+		while ((phase_start - this->wtime_clock) >= _wtime_period)
+			{
+				this->wtime_clock += _wtime_period;
+				if (!this->wtime_frozen)
 					++ this->wtime;
 			}
+		
+		// anything left to do?
+		if (this->get_players ().count () > 0 || this->pending_tasks > 0
+			|| !this->lm.idle ())
+			return false;
+		
+		std::lock_guard<std::mutex> guard {this->update_lock};
+		return this->updates.empty ();
+	}
+	
+	/* 
+	 * Saves and frees all chunks so that the world can stop being ticked
+	 * until a player joins it again.  Returns false if the world turned out
+	 * to still be in use.
+	 */
+	bool
+	world::hibernate ()
+	{
+		// set first, so that a player joining from this point on wakes us up.
+		this->hibernating = true;
+		if (this->get_players ().count () > 0)
+			{
+				this->hibernating = false;
+				return false;
+			}
+		
+		this->save_all ();
+		
+		{
+			std::lock_guard<std::mutex> upd_guard {this->update_lock};
+			std::lock_guard<std::mutex> ch_guard {this->chunk_lock};
+			if (!this->hibernating || !this->updates.empty ())
+				{
+					this->hibernating = false;
+					return false;
+				}
+			
+			// save chunks modified since save_all ().
+			{
+				std::lock_guard<std::mutex> gen_guard {this->gen_lock};
+				bool opened = false;
+				for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+					{
+						chunk *ch = itr->second;
+						if (!ch->modified)
+							continue;
+						
+						if (!opened)
+							{
+								this->prov->open (*this);
+								opened = true;
+							}
+						
+						int x, z;
+						chunk_coords (itr->first, &x, &z);
+						this->prov->save (*this, ch, x, z);
+						ch->modified = false;
+					}
+				if (opened)
+					this->prov->close ();
+			}
+			
+			{
+				std::lock_guard<std::mutex> bad_guard {this->bad_chunk_lock};
+				for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+					{
+						int x, z;
+						chunk_coords (itr->first, &x, &z);
+						this->bad_chunks.push_back ({x, z, itr->second});
+					}
+			}
+			this->chunks.clear ();
+			
+			_total_chunk_mem -= this->chunk_mem;
+			this->chunk_mem = 0;
+		}
+		
+		// nobody's around, so this should free everything.
+		this->dispose_bad_chunks ();
+		
+		this->log (LT_DEBUG) << "World \"" << this->name << "\" is now hibernating." << std::endl;
+		return this->hibernating;
+	}
+	
+	/* 
+	 * Brings the world out of hibernation.
+	 */
+	void
+	world::wake ()
+	{
+		if (this->hibernating.exchange (false) && this->ticking)
+			this->srv.get_tick_executor ().wake (this);
 	}
 	
 	
@@ -825,6 +1059,7 @@ namespace hCraft {
 		inf.use_def_inv = this->use_def_inv;
 		inf.time = this->wtime;
 		inf.time_frozen = this->wtime_frozen;
+		inf.view_dist = this->view_dist;
 	}
 	
 	
@@ -838,6 +1073,7 @@ namespace hCraft {
 		if (this->prov == nullptr)
 			return;
 		
+		auto start = std::chrono::steady_clock::now ();
 		std::lock_guard<std::mutex> ch_guard {this->chunk_lock};
 		std::lock_guard<std::mutex> gen_guard {this->gen_lock};
 		std::lock_guard<std::mutex> ptl_guard {this->portal_lock};
@@ -877,6 +1113,79 @@ namespace hCraft {
 					}
 			}
 		this->prov->close ();
+		this->save_times.observe (start);
+	}
+	
+	/* 
+	 * Returns the number of block updates waiting to be processed.
+	 */
+	size_t
+	world::update_backlog ()
+	{
+		std::lock_guard<std::mutex> guard {this->update_lock};
+		return this->updates.size ();
+	}
+	
+	
+	
+	/* 
+	 * The view distance configured for this world.
+	 */
+	int
+	world::max_view_distance () const
+	{
+		if (this->view_dist > 0)
+			return this->view_dist;
+		return this->srv.get_config ().view_distance;
+	}
+	
+	/* 
+	 * Shrinks the world's view distance by one chunk if recent ticks went
+	 * over budget, or grows it back once there has been headroom for a while.
+	 */
+	void
+	world::adjust_view_distance ()
+	{
+		const server_config& cfg = this->srv.get_config ();
+		int max_vd = this->max_view_distance ();
+		int min_vd = std::min (cfg.min_view_distance, max_vd);
+		int vd = this->view_cap;
+		
+		// average tick time since the last check
+		unsigned long long count = this->tick_times.get_count ();
+		unsigned long long sum = this->tick_times.get_sum ();
+		unsigned long long ticks = count - this->vd_tick_count;
+		double avg_ms = ticks ? ((sum - this->vd_tick_sum) / 1000.0 / ticks) : 0.0;
+		this->vd_tick_count = count;
+		this->vd_tick_sum = sum;
+		
+		// the budget is given as a percentage of the tick period.
+		double budget_ms = tick_period.count () * cfg.tick_budget / 100.0;
+		if (avg_ms > budget_ms)
+			{
+				// shed load right away...
+				-- vd;
+				this->vd_calm_checks = 0;
+			}
+		else if (avg_ms < (budget_ms / 2.0))
+			{
+				// ...but only grow back after five calm seconds in a row.
+				if (++ this->vd_calm_checks >= 5)
+					{
+						++ vd;
+						this->vd_calm_checks = 0;
+					}
+			}
+		else
+			this->vd_calm_checks = 0;
+		
+		vd = std::max (min_vd, std::min (max_vd, vd));
+		if (vd != this->view_cap)
+			{
+				this->log (LT_DEBUG) << "World \"" << this->name << "\": view distance set to "
+					<< vd << " (average tick: " << avg_ms << "ms)" << std::endl;
+				this->view_cap = vd;
+			}
 	}
 	
 	/* 
@@ -900,6 +1209,19 @@ namespace hCraft {
 		this->prov->close ();
 	}
 	
+	/* 
+	 * Calls @{fn} with the world's provider while nothing can be written to
+	 * the world file.
+	 */
+	void
+	world::freeze_provider (const std::function<void (world_provider *)>& fn)
+	{
+		// also keeps the provider from being swapped out by reload_world ().
+		std::lock_guard<std::mutex> gen_guard {this->gen_lock};
+		world_provider *prov = this->prov;
+		prov->freeze ([prov, &fn] () { fn (prov); });
+	}
+	
 	
 	
 	/* 
@@ -1053,7 +1375,11 @@ namespace hCraft {
 		
 		auto itr = this->chunks.find (key);
 		if (itr != this->chunks.end ())
-			return itr->second;
+			{
+				chunk *ch = itr->second;
+				ch->last_access = (unsigned int)this->ticks;
+				return ch;
+			}
 		
 		return nullptr;
 	}
@@ -1096,29 +1422,85 @@ namespace hCraft {
 		if (ch && ch->generated) return ch;
 		else if (!ch)
 			{
+				// the chunk might have been evicted and not yet saved.
+				auto eitr = this->evicting.find (chunk_key (x, z));
+				if (eitr != this->evicting.end ())
+					{
+						ch = eitr->second;
+						this->evicting.erase (eitr);
+						ch->last_access = (unsigned int)this->ticks;
+						this->put_chunk_nolock (x, z, ch);
+						return ch;
+					}
+				
 				ch = new chunk ();
 				
 				// try to load from disk
-				{
-					std::unique_lock<std::mutex> gen_guard {this->gen_lock, std::defer_lock};
-					if (lock)
-						gen_guard.lock ();
-					
-					this->prov->open (*this);
-					if (this->prov->load (*this, ch, x, z))
-						{
-							if (ch->generated)
-								{
-									ch->recalc_heightmap ();
-									this->prov->close ();
-									this->put_chunk_nolock (x, z, ch);
+				if (this->prov->concurrent_loads ())
+					{
+						// the provider does its own locking, so let other threads look
+						// up (and load) chunks while we are waiting on the disk.  the
+						// guard keeps the provider alive should reload_world () swap it
+						// out in the meantime.
+						epoch_guard eg {this->srv.get_epochs ()};
+						world_provider *prov = this->prov;
+						if (lock)
+							ch_guard.unlock ();
+						bool loaded = prov->load (*this, ch, x, z) && ch->generated;
+						if (lock)
+							ch_guard.lock ();
+						
+						if (lock && (prov != this->prov))
+							{
+								// the world was reloaded, what we read is stale.
+								delete ch;
+								ch_guard.unlock ();
+								return this->load_chunk_nolock (x, z, lock);
+							}
+						
+						chunk *other = this->get_chunk_nolock (x, z);
+						if (other)
+							{
+								// someone else got here first.
+								delete ch;
+								ch = other;
+								if (ch->generated)
 									return ch;
-								}
-						}
-					this->prov->close ();
-				}
-				
-				this->put_chunk_nolock (x, z, ch);
+							}
+						else
+							{
+								if (loaded)
+									{
+										ch->recalc_heightmap ();
+										ch->modified = false;
+									}
+								this->put_chunk_nolock (x, z, ch);
+								if (loaded)
+									return ch;
+							}
+					}
+				else
+					{
+						std::unique_lock<std::mutex> gen_guard {this->gen_lock, std::defer_lock};
+						if (lock)
+							gen_guard.lock ();
+					
+						this->prov->open (*this);
+						if (this->prov->load (*this, ch, x, z))
+							{
+								if (ch->generated)
+									{
+										ch->recalc_heightmap ();
+										ch->modified = false;
+										this->prov->close ();
+										this->put_chunk_nolock (x, z, ch);
+										return ch;
+									}
+							}
+						this->prov->close ();
+					
+						this->put_chunk_nolock (x, z, ch);
+					}
 			}
 		
 		if (lock)
@@ -1157,6 +1539,7 @@ namespace hCraft {
 						this->prov->close ();
 					}
 				
+				unlink_chunk (ch);
 				this->chunks.erase (itr);
 				
 				{
@@ -1166,12 +1549,220 @@ namespace hCraft {
 			}
 	}
 	
+	
+	
+	/* 
+	 * Unloads chunks that have not been used in a while and that no player
+	 * can see, if the world's chunks take up more memory than allowed by the
+	 * server's configuration.  Modified chunks are saved asynchronously.
+	 */
+	void
+	world::evict_cold_chunks ()
+	{
+		const static unsigned int min_idle_ticks = 6000; // ~30 seconds
+		
+		if (this->typ == WT_LIGHT || !this->prov)
+			return;
+		
+		const server_config& cfg = this->srv.get_config ();
+		long long world_budget = (long long)cfg.world_chunk_budget << 20;
+		long long total_budget = (long long)cfg.total_chunk_budget << 20;
+		
+		std::unique_lock<std::mutex> ch_guard {this->chunk_lock};
+		
+		long long usage = 0;
+		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+			usage += itr->second->memory_usage ();
+		for (auto itr = this->evicting.begin (); itr != this->evicting.end (); ++itr)
+			usage += itr->second->memory_usage ();
+		long long total = (_total_chunk_mem += usage - this->chunk_mem);
+		this->chunk_mem = usage;
+		
+		// when the server as a whole is over budget, every world gives up its
+		// share of the excess.
+		long long target = (world_budget > 0) ? world_budget : usage;
+		if (total_budget > 0 && total > total_budget)
+			target = std::min (target, (long long)((double)usage * total_budget / total));
+		if (usage <= target)
+			return;
+		
+		// evict a little more than needed so that we don't end up doing this
+		// every pass.
+		target -= target / 10;
+		
+		// keeps the players in pls from being destroyed under us.
+		epoch_guard eg {this->srv.get_epochs ()};
+		std::vector<player *> pls;
+		this->get_players ().populate (pls);
+		
+		std::vector<std::pair<unsigned int, unsigned long long>> cands;
+		unsigned int now = (unsigned int)this->ticks;
+		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+			{
+				chunk *ch = itr->second;
+				unsigned int idle = now - ch->last_access;
+				if (!ch->generated || idle < min_idle_ticks || ch->has_entities ())
+					continue;
+				
+				int cx, cz;
+				chunk_coords (itr->first, &cx, &cz);
+				bool used = false;
+				for (player *pl : pls)
+					if (pl->can_see_chunk (cx, cz))
+						{ used = true; break; }
+				if (!used)
+					cands.emplace_back (idle, itr->first);
+			}
+		
+		// coldest first
+		std::sort (cands.begin (), cands.end (),
+			[] (const std::pair<unsigned int, unsigned long long>& a,
+					const std::pair<unsigned int, unsigned long long>& b)
+				{ return a.first > b.first; });
+		
+		std::vector<tagged_chunk> evicted;
+		for (auto& c : cands)
+			{
+				if (usage <= target)
+					break;
+				
+				auto itr = this->chunks.find (c.second);
+				chunk *ch = itr->second;
+				usage -= ch->memory_usage ();
+				
+				int cx, cz;
+				chunk_coords (c.second, &cx, &cz);
+				unlink_chunk (ch);
+				this->chunks.erase (itr);
+				this->evicting[c.second] = ch;
+				evicted.push_back ({cx, cz, ch});
+			}
+		
+		ch_guard.unlock ();
+		
+		if (evicted.empty ())
+			return;
+		
+		this->run_async (
+			[this, evicted] ()
+				{
+					this->finish_eviction (evicted);
+				});
+	}
+	
+	void
+	world::finish_eviction (const std::vector<tagged_chunk>& evicted)
+	{
+		// save modified chunks.
+		// NOTE: chunks that get looked up again in the meantime are saved anyway,
+		//       but their modified flag is set again on the next change.
+		{
+			std::unique_lock<std::mutex> ch_guard {this->chunk_lock};
+			std::lock_guard<std::mutex> gen_guard {this->gen_lock};
+			
+			// chunks dropped by discard_pending_saves () (or by a reload) must not
+			// be saved.  the ones still here cannot be dropped while we hold the
+			// generator lock.
+			std::vector<tagged_chunk> to_save;
+			for (const tagged_chunk& tch : evicted)
+				{
+					auto itr = this->evicting.find (chunk_key (tch.cx, tch.cz));
+					auto citr = this->chunks.find (chunk_key (tch.cx, tch.cz));
+					if ((itr != this->evicting.end () && itr->second == tch.ch)
+						|| (citr != this->chunks.end () && citr->second == tch.ch))
+						to_save.push_back (tch);
+				}
+			ch_guard.unlock ();
+			
+			bool opened = false;
+			for (const tagged_chunk& tch : to_save)
+				{
+					if (!tch.ch->modified)
+						continue;
+					
+					if (!opened)
+						{
+							this->prov->open (*this);
+							opened = true;
+						}
+					
+					tch.ch->modified = false;
+					this->prov->save (*this, tch.ch, tch.cx, tch.cz);
+				}
+			if (opened)
+				this->prov->close ();
+		}
+		
+		// the memory itself is released by the world's thread once no player
+		// can see the chunk (packets being generated might still refer to it).
+		std::lock_guard<std::mutex> ch_guard {this->chunk_lock};
+		std::lock_guard<std::mutex> bad_guard {this->bad_chunk_lock};
+		for (const tagged_chunk& tch : evicted)
+			{
+				auto itr = this->evicting.find (chunk_key (tch.cx, tch.cz));
+				if (itr == this->evicting.end () || itr->second != tch.ch)
+					continue; // back in use
+				
+				this->evicting.erase (itr);
+				this->bad_chunks.push_back (tch);
+			}
+	}
+	
+	/* 
+	 * Forgets about chunks that were evicted but not saved yet, so that they
+	 * are never written out, and waits for saves that already started.
+	 */
+	void
+	world::discard_pending_saves ()
+	{
+		{
+			std::lock_guard<std::mutex> ch_guard {this->chunk_lock};
+			std::lock_guard<std::mutex> bad_guard {this->bad_chunk_lock};
+			for (auto itr = this->evicting.begin (); itr != this->evicting.end (); ++itr)
+				{
+					int cx, cz;
+					chunk_coords (itr->first, &cx, &cz);
+					this->bad_chunks.push_back ({cx, cz, itr->second});
+				}
+			this->evicting.clear ();
+		}
+		
+		this->wait_for_tasks ();
+	}
+	
+	/* 
+	 * Runs @{fn} on the server's thread pool.  The world is not destroyed,
+	 * and its chunks are not cleared, until the task completes.
+	 */
+	void
+	world::run_async (std::function<void ()> fn)
+	{
+		++ this->pending_tasks;
+		this->srv.get_thread_pool ().enqueue (
+			[this, fn] (void *)
+				{
+					fn ();
+					-- this->pending_tasks;
+				}, nullptr);
+	}
+	
+	/* 
+	 * Blocks until all tasks started with run_async () have completed.
+	 */
+	void
+	world::wait_for_tasks ()
+	{
+		while (this->pending_tasks > 0)
+			std::this_thread::sleep_for (std::chrono::milliseconds (5));
+	}
+	
 	/* 
 	 * Removes all chunks from the world and optionally saves them to disk.
 	 */
 	void
 	world::clear_chunks (bool save, bool del)
 	{
+		this->wait_for_tasks ();
 		std::lock_guard<std::mutex> guard {this->chunk_lock};
 		
 		if (save)
@@ -1256,22 +1847,22 @@ namespace hCraft {
 		// spawn entity to players
 		chunk_pos cpos = e->pos;
 		int cx, cz;
-		for (cx = (cpos.x - player::chunk_radius ());
-				 cx <= (cpos.x + player::chunk_radius ()); ++cx)
+		int radius = this->max_view_distance ();
+		for (cx = (cpos.x - radius); cx <= (cpos.x + radius); ++cx)
 			{
-				for (cz = (cpos.z - player::chunk_radius ());
-						 cz <= (cpos.z + player::chunk_radius ()); ++cz)
+				for (cz = (cpos.z - radius); cz <= (cpos.z + radius); ++cz)
 					{
 						chunk *och = this->get_chunk (cx, cz);
 						if (!och) continue;
 						
 						entity *e_this = e;
-						och->all_entities ([e_this] (entity *e)
+						och->all_entities ([e_this, cpos] (entity *e)
 							{
 								if (e->get_type () == ET_PLAYER)
 									{
 										player *pl = dynamic_cast<player *> (e);
-										e_this->spawn_to (pl);
+										if (pl->can_see_chunk (cpos.x, cpos.z))
+											e_this->spawn_to (pl);
 									}
 							});
 					}
@@ -1293,11 +1884,10 @@ namespace hCraft {
 		// despawn from players
 		chunk_pos cpos = e->pos;
 		int cx, cz;
-		for (cx = (cpos.x - player::chunk_radius ());
-				 cx <= (cpos.x + player::chunk_radius ()); ++cx)
+		int radius = this->max_view_distance ();
+		for (cx = (cpos.x - radius); cx <= (cpos.x + radius); ++cx)
 			{
-				for (cz = (cpos.z - player::chunk_radius ());
-						 cz <= (cpos.z + player::chunk_radius ()); ++cz)
+				for (cz = (cpos.z - radius); cz <= (cpos.z + radius); ++cz)
 					{
 						chunk *och = this->get_chunk (cx, cz);
 						if (!och) continue;
@@ -1549,12 +2139,46 @@ namespace hCraft {
 				return;
 			}
 		
+		if (this->hibernating)
+			this->wake ();
 		this->updates.emplace_back (x, y, z, id, meta, extra, data, ptr, pl, physics);
 		
 		std::lock_guard<std::mutex> estage_guard {this->estage_lock};
 		this->estage.set (x, y, z, id, meta, extra);
 	}
 	
+	/* 
+	 * Enqueues a batch of updates, taking the world's locks only once.
+	 */
+	void
+	world::queue_updates (const std::vector<block_update>& batch)
+	{
+		if (batch.empty ())
+			return;
+		
+		std::lock_guard<std::mutex> guard {this->update_lock};
+		if (this->typ == WT_LIGHT)
+			{
+				for (const block_update& u : batch)
+					this->queue_update_nolock (u.x, u.y, u.z, u.id, u.meta, u.extra,
+						u.data, u.ptr, u.pl, u.physics);
+				return;
+			}
+		
+		if (this->hibernating)
+			this->wake ();
+		
+		std::lock_guard<std::mutex> estage_guard {this->estage_lock};
+		for (const block_update& u : batch)
+			{
+				if (!this->in_bounds (u.x, u.y, u.z))
+					continue;
+				
+				this->updates.push_back (u);
+				this->estage.set (u.x, u.y, u.z, u.id, u.meta, u.extra);
+			}
+	}
+	
 	void
 	world::queue_physics (int x, int y, int z, int extra, void *ptr,
 		int tick_delay, physics_params *params, physics_block_callback cb)
@@ -0,0 +1,1976 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * hcraft-bench - microbenchmarks for the engine's hot paths.
+ * 
+ * Usage:
+ *   hcraft-bench [--filter <substring>] [--format text|csv|json]
+ *                [--min-time <ms>] [--runs <n>] [--label <label>]
+ * 
+ * Every benchmark is run until it has taken at least --min-time milliseconds,
+ * --runs times over, and the median time per operation is reported.  The csv
+ * and json formats print one record per benchmark, tagged with --label (e.g.
+ * a commit hash), so that results can be appended to a file and compared
+ * across commits.
+ */
+
+#include "system/logger.hpp"
+#include "system/server.hpp"
+#include "system/packet.hpp"
+#include "world/world.hpp"
+#include "world/chunk.hpp"
+#include "world/chunk_kernels.hpp"
+#include "world/lighting.hpp"
+#include "world/providers/worldprovider.hpp"
+#include "world/generation/worldgenerator.hpp"
+#include "drawing/editstage.hpp"
+#include "drawing/drawops.hpp"
+#include "drawing/raster.hpp"
+#include "physics/physics.hpp"
+#include "player/permissions.hpp"
+#include "slot/blocks.hpp"
+#include "slot/slot.hpp"
+#include "util/noise.hpp"
+#include "util/nbt.hpp"
+#include "util/codec.hpp"
+#include "util/spatial_map.hpp"
+#include "util/utils.hpp"
+#include "util/slot_map.hpp"
+#include "util/epoch.hpp"
+#include "util/slab.hpp"
+#include <iostream>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <mutex>
+#include <ftw.h>
+#include <unistd.h>
+
+using namespace hCraft;
+
+
+namespace {
+	
+	typedef std::chrono::steady_clock clk;
+	
+	struct bench_args
+	{
+		std::string filter;
+		std::string format;
+		std::string label;
+		double min_time; // milliseconds
+		int runs;
+		bool verify;     // run the correctness checks instead
+	};
+	
+	/* 
+	 * A benchmark body performs @{iters} iterations and returns the number of
+	 * operations that were carried out (usually @{iters}).
+	 */
+	typedef std::function<long long (long long iters)> bench_fn;
+	
+	/* 
+	 * A check compares some part of the server against a reference
+	 * implementation and throws std::runtime_error on a mismatch.  Whatever it
+	 * writes to @{report} is printed along with its result.
+	 * 
+	 * There is no separate test suite, so checks for optimized code paths
+	 * (pools, SIMD kernels, packet batching, ...) live here and are run with
+	 * --verify, which exits with a non-zero status if any of them fails.
+	 */
+	typedef std::function<void (std::ostream& report)> check_fn;
+	
+	struct bench_result
+	{
+		std::string name;
+		long long ops;
+		double ns_per_op;   // median of all runs
+		double min_ns_per_op;
+		double max_ns_per_op;
+	};
+	
+	
+	
+	void
+	print_usage ()
+	{
+		std::cout <<
+			"usage:\n"
+			"  hcraft-bench [--filter <substring>] [--format text|csv|json]\n"
+			"               [--min-time <ms>] [--runs <n>] [--label <label>]\n"
+			"  hcraft-bench --verify\n"
+			"\n"
+			"options:\n"
+			"  --filter <str>   only run benchmarks whose name contains <str>\n"
+			"  --format <fmt>   output format (default: text)\n"
+			"  --min-time <ms>  minimum duration of a single run (default: 200)\n"
+			"  --runs <n>       number of runs per benchmark (default: 5)\n"
+			"  --label <str>    tag added to every csv/json record (e.g. a commit hash)\n"
+			"  --list           print the names of all benchmarks and exit\n"
+			"  --verify         run every correctness check instead of the benchmarks,\n"
+			"                   exits with a non-zero status if any of them fails\n";
+	}
+	
+	bool
+	parse_args (int argc, char *argv[], bench_args& out, bool& list)
+	{
+		out.format = "text";
+		out.min_time = 200.0;
+		out.runs = 5;
+		out.verify = false;
+		list = false;
+		
+		for (int i = 1; i < argc; ++i)
+			{
+				std::string arg = argv[i];
+				bool has_val = (i + 1) < argc;
+				
+				if (arg == "--list")
+					list = true;
+				else if (arg == "--verify")
+					out.verify = true;
+				else if (arg == "--filter" && has_val)
+					out.filter = argv[++i];
+				else if (arg == "--format" && has_val)
+					out.format = argv[++i];
+				else if (arg == "--label" && has_val)
+					out.label = argv[++i];
+				else if (arg == "--min-time" && has_val)
+					out.min_time = std::atof (argv[++i]);
+				else if (arg == "--runs" && has_val)
+					out.runs = std::atoi (argv[++i]);
+				else
+					{
+						std::cerr << "hcraft-bench: unexpected argument: " << arg << std::endl;
+						return false;
+					}
+			}
+		
+		if (out.format != "text" && out.format != "csv" && out.format != "json")
+			{
+				std::cerr << "hcraft-bench: unknown format: " << out.format << std::endl;
+				return false;
+			}
+		
+		return (out.runs > 0 && out.min_time > 0.0);
+	}
+	
+	
+	
+//----
+	
+	// prevents the compiler from optimizing away computed values.
+	volatile unsigned long long g_sink;
+	
+	template<typename T>
+	inline void
+	keep (const T& val)
+	{
+		g_sink += (unsigned long long)val;
+	}
+	
+	
+	
+	/* 
+	 * Runs a single benchmark, growing the iteration count until one run takes
+	 * at least @{min_time} milliseconds.
+	 */
+	bench_result
+	run_bench (const std::string& name, const bench_fn& fn, const bench_args& args)
+	{
+		// warm up and calibrate
+		long long iters = 1;
+		for (;;)
+			{
+				auto start = clk::now ();
+				fn (iters);
+				double ms = std::chrono::duration<double, std::milli> (clk::now () - start).count ();
+				if (ms >= args.min_time)
+					break;
+				
+				long long next = (ms > 0.01)
+					? (long long)(iters * (args.min_time * 1.2 / ms))
+					: iters * 100;
+				iters = std::max (iters * 2, std::min (next, iters * 100));
+			}
+		
+		std::vector<double> samples;
+		long long ops = 0;
+		for (int i = 0; i < args.runs; ++i)
+			{
+				auto start = clk::now ();
+				ops = fn (iters);
+				double ns = std::chrono::duration<double, std::nano> (clk::now () - start).count ();
+				samples.push_back (ns / std::max (ops, 1LL));
+			}
+		std::sort (samples.begin (), samples.end ());
+		
+		bench_result res;
+		res.name = name;
+		res.ops = ops;
+		res.ns_per_op = samples[samples.size () / 2];
+		res.min_ns_per_op = samples.front ();
+		res.max_ns_per_op = samples.back ();
+		return res;
+	}
+	
+	
+	
+	/* 
+	 * Runs every check, and returns the number of checks that failed.
+	 */
+	int
+	run_checks (const std::vector<std::pair<std::string, check_fn>>& checks)
+	{
+		int failed = 0;
+		for (auto& c : checks)
+			{
+				std::ostringstream report;
+				try
+					{
+						c.second (report);
+						std::printf ("ok    %s\n", c.first.c_str ());
+					}
+				catch (const std::exception& ex)
+					{
+						++ failed;
+						std::printf ("FAIL  %s: %s\n", c.first.c_str (), ex.what ());
+					}
+				
+				std::istringstream lines (report.str ());
+				std::string line;
+				while (std::getline (lines, line))
+					std::printf ("        %s\n", line.c_str ());
+				std::fflush (stdout);
+			}
+		
+		std::printf ("%d of %d checks passed\n", (int)checks.size () - failed,
+			(int)checks.size ());
+		return failed;
+	}
+	
+	
+	
+//----
+	
+	/* 
+	 * Shared state for the benchmarks that need a world.
+	 * The world lives in a temporary directory that is removed on exit.
+	 */
+	struct bench_world
+	{
+		std::string dir;
+		world *w;
+		
+		static const int radius = 4; // in chunks
+		
+		
+		
+		bench_world (server& srv, logger& log)
+		{
+			char tmpl[] = "/tmp/hcraft-bench.XXXXXX";
+			if (!mkdtemp (tmpl))
+				throw std::runtime_error ("could not create a temporary directory");
+			this->dir = tmpl;
+			
+			world_generator *gen = world_generator::create ("flatgrass", 1337);
+			world_provider *prov = world_provider::create ("hw", this->dir.c_str (), "bench");
+			if (!gen || !prov)
+				throw std::runtime_error ("could not create the benchmark world");
+			
+			this->w = new world (WT_NORMAL, srv, "bench", log, gen, prov);
+			for (int cx = -radius; cx < radius; ++cx)
+				for (int cz = -radius; cz < radius; ++cz)
+					this->w->load_chunk (cx, cz);
+		}
+		
+		~bench_world ()
+		{
+			delete this->w;
+			nftw (this->dir.c_str (),
+				[] (const char *path, const struct stat *, int, struct FTW *) -> int
+					{ return remove (path); },
+				16, FTW_DEPTH | FTW_PHYS);
+		}
+	};
+	
+	
+	
+	/* 
+	 * Fills @{ch} with something that resembles generated terrain, with some
+	 * variation so that codecs and lighting have work to do.
+	 */
+	void
+	fill_terrain (chunk *ch, int seed)
+	{
+		for (int x = 0; x < 16; ++x)
+			for (int z = 0; z < 16; ++z)
+				{
+					int h = 60 + (int)(h_noise::fractal_noise_2d (seed, x / 16.0, z / 16.0, 4, 0.5) * 8.0);
+					for (int y = 0; y < h; ++y)
+						ch->set_block (x, y, z, (y < h - 4) ? BT_STONE : BT_DIRT, 0);
+				}
+	}
+	
+	
+	
+//----
+	
+	void
+	add_subchunk_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		out.emplace_back ("subchunk.get_id", [] (long long iters) -> long long
+			{
+				static subchunk sub;
+				for (int i = 0; i < 4096; i += 3)
+					sub.set_id (i & 0xF, i >> 8, (i >> 4) & 0xF, (i % 7) + 1);
+				
+				unsigned long long sum = 0;
+				unsigned int idx = 0;
+				for (long long i = 0; i < iters; ++i)
+					{
+						idx = (idx + 2503) & 0xFFF; // odd stride, visits every block
+						sum += sub.get_id (idx & 0xF, idx >> 8, (idx >> 4) & 0xF);
+					}
+				keep (sum);
+				return iters;
+			});
+		
+		out.emplace_back ("subchunk.set_block", [] (long long iters) -> long long
+			{
+				static subchunk sub;
+				unsigned int idx = 0;
+				for (long long i = 0; i < iters; ++i)
+					{
+						idx = (idx + 2503) & 0xFFF;
+						sub.set_block (idx & 0xF, idx >> 8, (idx >> 4) & 0xF, (i & 1) ? BT_STONE : BT_AIR, i & 0xF);
+					}
+				keep (sub.air_count);
+				return iters;
+			});
+	}
+	
+	void
+	add_world_benches (std::vector<std::pair<std::string, bench_fn>>& out,
+		bench_world& bw)
+	{
+		// the same lookups, spread over an increasing number of threads, to
+		// show how much the chunk lock costs under contention.
+		int max_threads = std::max (2u, std::thread::hardware_concurrency ());
+		for (int threads = 1; threads <= max_threads; threads *= 2)
+			{
+				out.emplace_back ("world.get_block/t" + std::to_string (threads),
+					[&bw, threads] (long long iters) -> long long
+						{
+							world *w = bw.w;
+							int span = bench_world::radius * 32;
+							std::atomic<unsigned long long> total {0};
+							
+							auto body = [w, iters, span, &total] (int t)
+								{
+									std::minstd_rand rnd (t + 1);
+									unsigned long long sum = 0;
+									for (long long i = 0; i < iters; ++i)
+										{
+											int x = (int)(rnd () % span) - span / 2;
+											int z = (int)(rnd () % span) - span / 2;
+											sum += w->get_block (x, rnd () & 0x7F, z).id;
+										}
+									total += sum;
+								};
+							
+							std::vector<std::thread> ths;
+							for (int t = 1; t < threads; ++t)
+								ths.emplace_back (body, t);
+							body (0);
+							for (auto& th : ths)
+								th.join ();
+							
+							keep (total.load ());
+							return iters * threads;
+						});
+			}
+		
+		out.emplace_back ("world.dense_edit_stage.set", [&bw] (long long iters) -> long long
+			{
+				dense_edit_stage es (bw.w);
+				for (long long i = 0; i < iters; ++i)
+					{
+						int n = (int)(i & 0x7FFF);
+						es.set (n & 0x1F, 64 + (n >> 10), (n >> 5) & 0x1F, BT_STONE);
+					}
+				return iters;
+			});
+		
+		// a 32x32x32 cuboid.  the lighting updates queued by the commit are
+		// handled too, otherwise the queue would overflow after a few runs.
+		out.emplace_back ("world.dense_edit_stage.commit_32k", [&bw] (long long iters) -> long long
+			{
+				for (long long i = 0; i < iters; ++i)
+					{
+						dense_edit_stage es (bw.w);
+						unsigned short id = (i & 1) ? BT_AIR : BT_STONE;
+						for (int x = 0; x < 32; ++x)
+							for (int y = 0; y < 32; ++y)
+								for (int z = 0; z < 32; ++z)
+									es.set (x, 64 + y, z, id);
+						es.commit (false);
+						while (!bw.w->lm.idle ())
+							bw.w->lm.update (1 << 16);
+					}
+				return iters;
+			});
+		
+		out.emplace_back ("lighting.relight_chunk", [&bw] (long long iters) -> long long
+			{
+				chunk *ch = bw.w->load_chunk (0, 0);
+				for (long long i = 0; i < iters; ++i)
+					bw.w->lm.relight_chunk (ch);
+				return iters;
+			});
+	}
+	
+	/* 
+	 * The position hashes used before spatial_map was introduced, kept here so
+	 * that the spatial.* benchmarks can show the difference.
+	 */
+	struct legacy_block_pos_hash
+	{
+		std::size_t
+		operator() (const block_pos& bpos) const
+			{ return bpos.x ^ (bpos.y << 11) ^ (bpos.z << 5); }
+	};
+	
+	struct legacy_chunk_pos_hash
+	{
+		std::size_t
+		operator() (const chunk_pos& cpos) const
+			{ return cpos.x ^ (cpos.z << 5); }
+	};
+	
+	
+	/* 
+	 * Fills a map with every position in a 32x32x32 cube, as a large
+	 * selection would, then looks every one of them up again.
+	 */
+	template<typename Map>
+	long long
+	block_map_bench (long long iters)
+	{
+		unsigned long long sum = 0;
+		for (long long i = 0; i < iters; ++i)
+			{
+				Map m;
+				for (int x = -16; x < 16; ++x)
+					for (int y = 64; y < 96; ++y)
+						for (int z = -16; z < 16; ++z)
+							m[block_pos (x, y, z)] = (unsigned int)(x + y + z);
+				for (int x = -16; x < 16; ++x)
+					for (int y = 64; y < 96; ++y)
+						for (int z = -16; z < 16; ++z)
+							sum += m.find (block_pos (x, y, z))->second;
+			}
+		keep (sum);
+		return iters * 32768 * 2;
+	}
+	
+	/* 
+	 * Mimics how the physics manager tracks block memberships: random
+	 * positions over a 256x256 area are looked up in a map of per-chunk
+	 * membership arrays, with new chunks added as needed.
+	 */
+	template<typename Map>
+	long long
+	ph_mem_bench (long long iters)
+	{
+		Map m;
+		std::minstd_rand rnd (7);
+		for (long long i = 0; i < iters; ++i)
+			{
+				int x = (int)(rnd () & 0xFF) - 128;
+				int y = rnd () & 0xFF;
+				int z = (int)(rnd () & 0xFF) - 128;
+				
+				ph_mem_chunk& ch = m[chunk_pos (x >> 4, z >> 4)];
+				ph_mem_subchunk *sub = ch.subs[y >> 4];
+				if (!sub)
+					sub = ch.subs[y >> 4] = new ph_mem_subchunk ();
+				++ sub->blocks[((y & 0xF) << 8) | ((z & 0xF) << 4) | (x & 0xF)];
+			}
+		return iters;
+	}
+	
+	void
+	add_spatial_benches (std::vector<std::pair<std::string, bench_fn>>& out,
+		bench_world& bw)
+	{
+		out.emplace_back ("spatial.block_map/unordered_legacy",
+			block_map_bench<std::unordered_map<block_pos, unsigned int, legacy_block_pos_hash>>);
+		out.emplace_back ("spatial.block_map/unordered",
+			block_map_bench<std::unordered_map<block_pos, unsigned int, block_pos_hash>>);
+		out.emplace_back ("spatial.block_map/spatial_map",
+			block_map_bench<spatial_map<block_pos, unsigned int, block_pos_hash>>);
+		
+		out.emplace_back ("spatial.ph_mem/unordered_legacy",
+			ph_mem_bench<std::unordered_map<chunk_pos, ph_mem_chunk, legacy_chunk_pos_hash>>);
+		out.emplace_back ("spatial.ph_mem/spatial_map",
+			ph_mem_bench<spatial_map<chunk_pos, ph_mem_chunk, chunk_pos_hash>>);
+		
+		// a 64x64x8 sparse selection, spread over 16 chunks.
+		out.emplace_back ("spatial.sparse_edit_stage.set_32k", [&bw] (long long iters) -> long long
+			{
+				for (long long i = 0; i < iters; ++i)
+					{
+						sparse_edit_stage es (bw.w);
+						for (int x = -32; x < 32; ++x)
+							for (int y = 64; y < 72; ++y)
+								for (int z = -32; z < 32; ++z)
+									es.set (x, y, z, BT_STONE);
+						keep (es.get (0, 64, 0).id);
+					}
+				return iters * 32768;
+			});
+	}
+	
+	/* 
+	 * The voxel-at-a-time sphere loops draw_ops used before shapes were
+	 * rasterized into spans.
+	 */
+	int
+	legacy_filled_sphere (edit_stage& es, vector3 pt, double radius, blocki material)
+	{
+		int rad = std::round (radius);
+		int srad = rad * rad;
+		int cx = pt.x, cy = pt.y, cz = pt.z;
+		
+		int modified = 0;
+		for (int x = -rad; x <= rad; ++x)
+			for (int y = -rad; y <= rad; ++y)
+				for (int z = -rad; z <= rad; ++z)
+					if (x*x + y*y + z*z <= srad)
+						{
+							es.set (x + cx, y + cy, z + cz, material.id, material.meta);
+							++ modified;
+						}
+		return modified;
+	}
+	
+	int
+	legacy_hollow_sphere (edit_stage& es, vector3 pt, double radius, blocki material)
+	{
+		int srad = std::round (radius * radius);
+		int rad = std::round (radius);
+		int sradm1 = (rad - 1) * (rad - 1);
+		int cx = pt.x, cy = pt.y, cz = pt.z;
+		
+		int modified = 0;
+		for (int y = -rad; y <= rad; ++y)
+			for (int x = -rad; x <= rad; ++x)
+				for (int z = -rad; z <= rad; ++z)
+					{
+						int v = x*x + y*y + z*z;
+						if (v <= srad && v > sradm1)
+							{
+								es.set (x + cx, y + cy, z + cz, material.id, material.meta);
+								++ modified;
+							}
+					}
+		return modified;
+	}
+	
+	/* 
+	 * Checks that two dense edit stages hold the same blocks within the cube of
+	 * radius @{r} around @{c}.
+	 */
+	void
+	compare_stages (const char *what, dense_edit_stage& a, dense_edit_stage& b,
+		vector3 c, int r, int count_a, int count_b)
+	{
+		if (count_a != count_b)
+			throw std::runtime_error (std::string (what) + ": block counts differ ("
+				+ std::to_string (count_a) + " vs " + std::to_string (count_b) + ")");
+		
+		int cx = c.x, cy = c.y, cz = c.z;
+		for (int x = cx - r - 1; x <= cx + r + 1; ++x)
+			for (int y = utils::max (0, cy - r - 1); y <= utils::min (255, cy + r + 1); ++y)
+				for (int z = cz - r - 1; z <= cz + r + 1; ++z)
+					{
+						blocki ba, bb;
+						bool ha = a.get_staged (x, y, z, ba);
+						bool hb = b.get_staged (x, y, z, bb);
+						if (ha != hb || (ha && (ba.id != bb.id || ba.meta != bb.meta)))
+							throw std::runtime_error (std::string (what) + ": blocks differ at "
+								+ std::to_string (x) + "," + std::to_string (y) + "," + std::to_string (z));
+					}
+	}
+	
+	/* 
+	 * Makes sure the span rasterizers and dense_edit_stage::fill_spans ()
+	 * produce the exact same blocks as the old voxel loops.
+	 */
+	void
+	verify_raster (std::ostream& report)
+	{
+		static const double radii[] = { 0.0, 1.0, 2.4, 3.5, 7.0, 16.6, 40.0 };
+		vector3 c {5.0, 100.0, -9.0};
+		blocki mat {BT_STONE, 2};
+		
+		for (double r : radii)
+			{
+				int ir = std::ceil (r) + 1;
+				{
+					dense_edit_stage old_es, new_es;
+					draw_ops draw (new_es);
+					int n_old = legacy_filled_sphere (old_es, c, r, mat);
+					int n_new = draw.filled_sphere (c, r, mat);
+					compare_stages ("filled_sphere", old_es, new_es, c, ir, n_old, n_new);
+				}
+				{
+					dense_edit_stage old_es, new_es;
+					draw_ops draw (new_es);
+					int n_old = legacy_hollow_sphere (old_es, c, r, mat);
+					int n_new = draw.sphere (c, r, mat);
+					compare_stages ("sphere", old_es, new_es, c, ir, n_old, n_new);
+				}
+			}
+		
+		// lines and curves: bulk fill against block-by-block set ().
+		std::vector<vector3> pts { {0, 70, 0}, {13, 90, -20}, {40, 75, 5}, {-10, 110, 31}, {3, 64, 3} };
+		{
+			dense_edit_stage slow_es, fast_es;
+			span_list spans;
+			raster::curve (spans, pts);
+			raster::bezier (spans, pts);
+			for (const block_span& sp : spans)
+				for (int x = sp.x0; x <= sp.x1; ++x)
+					slow_es.set (x, sp.y, sp.z, mat.id, mat.meta);
+			fast_es.fill_spans (spans, mat.id, mat.meta);
+			compare_stages ("curve", slow_es, fast_es, {15, 87, 5}, 45,
+				(int)spans.volume (), (int)spans.volume ());
+		}
+		
+		report << (2 * (sizeof radii / sizeof radii[0])) << " spheres and a "
+			<< pts.size () << "-point curve match the voxel loops" << std::endl;
+	}
+	
+	/* 
+	 * Stages the blocks used by verify_bulk_commit () over the chunk whose
+	 * corner is at (@{bx}, @{bz}).  The microchunks at y=64 are uniform,
+	 * uniform with extra data, uniform air, and fully covered with mixed IDs,
+	 * metadata and extra data.  Those at y=72 are all fully covered and mixed,
+	 * and those at y=80 are only partially covered.
+	 */
+	void
+	stage_commit_pattern (edit_stage& es, int bx, int bz)
+	{
+		static const unsigned short ids[] = { BT_STONE, BT_DIRT, BT_WOOD, BT_GLASS, BT_WOOL };
+		std::mt19937 rng (29);
+		auto mixed = [&rng, &es] (int x, int y, int z)
+			{
+				unsigned short id = ids[rng () % 5];
+				unsigned char meta = rng () & 15;
+				unsigned char ex = rng () & 0xFF;
+				es.set (x, y, z, id, meta, ex);
+			};
+		
+		for (int x = 0; x < 16; ++x)
+			for (int z = 0; z < 16; ++z)
+				for (int y = 0; y < 8; ++y)
+					{
+						int wx = bx + x, wz = bz + z;
+						switch (((z >> 3) << 1) | (x >> 3))
+							{
+								case 0: es.set (wx, 64 + y, wz, BT_STONE); break;
+								case 1: es.set (wx, 64 + y, wz, BT_WOOL, 5, 3); break;
+								case 2: es.set (wx, 64 + y, wz, BT_AIR); break;
+								default: mixed (wx, 64 + y, wz); break;
+							}
+						
+						mixed (wx, 72 + y, wz);
+						if (rng () & 1)
+							mixed (wx, 80 + y, wz);
+					}
+	}
+	
+	/* 
+	 * Commits the same blocks to two identical chunks, once through a dense
+	 * edit stage (which writes fully covered microchunks in bulk) and once
+	 * through a sparse edit stage (which goes block by block), and checks that
+	 * both chunks end up with the same blocks, extra data and heightmap.  Both
+	 * commits must also clear the world's own edit stage over what they wrote.
+	 */
+	void
+	verify_bulk_commit (bench_world& bw, std::ostream& report)
+	{
+		world *w = bw.w;
+		const int bulk_cx = -bench_world::radius, ref_cx = bench_world::radius - 1;
+		const int cz = -bench_world::radius;
+		chunk *bulk_ch = w->load_chunk (bulk_cx, cz);
+		chunk *ref_ch = w->load_chunk (ref_cx, cz);
+		
+		auto compare = [bulk_ch, ref_ch] (const char *when)
+			{
+				for (int x = 0; x < 16; ++x)
+					for (int z = 0; z < 16; ++z)
+						{
+							std::string at = " at " + std::to_string (x) + ",";
+							if (bulk_ch->get_height (x, z) != ref_ch->get_height (x, z))
+								throw std::runtime_error (std::string ("heightmaps differ ")
+									+ when + at + std::to_string (z));
+							for (int y = 0; y < 256; ++y)
+								{
+									block_data a = bulk_ch->get_block (x, y, z);
+									block_data b = ref_ch->get_block (x, y, z);
+									if (a.id != b.id || a.meta != b.meta || a.ex != b.ex)
+										throw std::runtime_error (std::string ("blocks differ ") + when
+											+ at + std::to_string (y) + "," + std::to_string (z));
+								}
+						}
+			};
+		compare ("before committing");
+		
+		{
+			std::lock_guard<std::mutex> guard {w->estage_lock};
+			for (int x = 0; x < 16; ++x)
+				for (int z = 0; z < 16; ++z)
+					for (int y = 64; y < 88; ++y)
+						{
+							w->estage.set ((bulk_cx << 4) | x, y, (cz << 4) | z, BT_GLASS);
+							w->estage.set ((ref_cx << 4) | x, y, (cz << 4) | z, BT_GLASS);
+						}
+		}
+		
+		dense_edit_stage bulk_es (w);
+		stage_commit_pattern (bulk_es, bulk_cx << 4, cz << 4);
+		bulk_es.commit (false);
+		
+		sparse_edit_stage ref_es (w);
+		stage_commit_pattern (ref_es, ref_cx << 4, cz << 4);
+		ref_es.commit (false);
+		
+		while (!w->lm.idle ())
+			w->lm.update (1 << 16);
+		
+		compare ("after committing");
+		
+		// only the blocks that were actually committed are cleared.
+		{
+			std::lock_guard<std::mutex> guard {w->estage_lock};
+			blocki bl;
+			int left = 0;
+			for (int x = 0; x < 16; ++x)
+				for (int z = 0; z < 16; ++z)
+					for (int y = 64; y < 88; ++y)
+						{
+							bool a = w->estage.get_staged ((bulk_cx << 4) | x, y, (cz << 4) | z, bl);
+							bool b = w->estage.get_staged ((ref_cx << 4) | x, y, (cz << 4) | z, bl);
+							if (a != b)
+								throw std::runtime_error ("the world's edit stage differs at "
+									+ std::to_string (x) + "," + std::to_string (y) + "," + std::to_string (z));
+							if (a && y < 80)
+								throw std::runtime_error ("a fully covered block was left in the world's edit stage");
+							left += a;
+						}
+			
+			w->estage.clear ();
+			report << "16x24x16 blocks match the per-block commit, "
+				<< left << " partially covered blocks left staged" << std::endl;
+		}
+	}
+	
+	void
+	add_draw_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		// a radius-64 sphere into a dense edit stage (spans ~81 chunks).
+		static const vector3 center {8.0, 128.0, 8.0};
+		static const double radius = 64.0;
+		
+		out.emplace_back ("draw.filled_sphere_r64/voxel", [] (long long iters) -> long long
+			{
+				long long n = 0;
+				for (long long i = 0; i < iters; ++i)
+					{
+						dense_edit_stage es;
+						n += legacy_filled_sphere (es, center, radius, {BT_STONE});
+					}
+				return n;
+			});
+		out.emplace_back ("draw.filled_sphere_r64/span", [] (long long iters) -> long long
+			{
+				long long n = 0;
+				for (long long i = 0; i < iters; ++i)
+					{
+						dense_edit_stage es;
+						draw_ops draw (es);
+						n += draw.filled_sphere (center, radius, {BT_STONE});
+					}
+				return n;
+			});
+		
+		out.emplace_back ("draw.sphere_r64/voxel", [] (long long iters) -> long long
+			{
+				long long n = 0;
+				for (long long i = 0; i < iters; ++i)
+					{
+						dense_edit_stage es;
+						n += legacy_hollow_sphere (es, center, radius, {BT_STONE});
+					}
+				return n;
+			});
+		out.emplace_back ("draw.sphere_r64/span", [] (long long iters) -> long long
+			{
+				long long n = 0;
+				for (long long i = 0; i < iters; ++i)
+					{
+						dense_edit_stage es;
+						draw_ops draw (es);
+						n += draw.sphere (center, radius, {BT_STONE});
+					}
+				return n;
+			});
+	}
+	
+	// resident set size, in KiB.
+	long long
+	current_rss_kb ()
+	{
+		long long pages = 0, rss = 0;
+		FILE *fp = std::fopen ("/proc/self/statm", "r");
+		if (!fp)
+			return 0;
+		if (std::fscanf (fp, "%lld %lld", &pages, &rss) != 2)
+			rss = 0;
+		std::fclose (fp);
+		return rss * (sysconf (_SC_PAGESIZE) / 1024);
+	}
+	
+	/* 
+	 * Generates, duplicates and destroys batches of chunks over and over, the
+	 * way a world streams terrain in and out.  Fails if any chunk or subchunk
+	 * is not given back to its pool, or if the pools keep carving new slabs
+	 * after the first cycle.
+	 */
+	void
+	chunk_pool_stress (bench_world& bw, std::ostream& report)
+	{
+		static const int cycles = 20;
+		static const int batch = 256;
+		
+		slab_stats ch0 = chunk::chunk_pool ().stats ();
+		slab_stats sub0 = chunk::subchunk_pool ().stats ();
+		long long rss_first = 0, slabs_first = 0;
+		
+		world_generator *gen = bw.w->get_generator ();
+		std::vector<chunk *> chunks;
+		for (int c = 0; c < cycles; ++c)
+			{
+				for (int i = 0; i < batch; ++i)
+					{
+						chunk *ch = new chunk ();
+						gen->generate (*bw.w, ch, 1000 + (i & 15), 1000 + (i >> 4) + c * 16);
+						chunks.push_back (ch);
+						chunks.push_back (ch->duplicate ());
+					}
+				for (chunk *ch : chunks)
+					delete ch;
+				chunks.clear ();
+				
+				if (c == 0)
+					{
+						rss_first = current_rss_kb ();
+						slabs_first = chunk::chunk_pool ().stats ().slabs
+							+ chunk::subchunk_pool ().stats ().slabs;
+					}
+			}
+		
+		slab_stats ch1 = chunk::chunk_pool ().stats ();
+		slab_stats sub1 = chunk::subchunk_pool ().stats ();
+		if (ch1.live != ch0.live || sub1.live != sub0.live)
+			throw std::runtime_error (std::to_string (ch1.live - ch0.live)
+				+ " chunks and " + std::to_string (sub1.live - sub0.live)
+				+ " subchunks were not returned to their pools");
+		if (ch1.slabs + sub1.slabs != slabs_first)
+			throw std::runtime_error ("the pools grew from " + std::to_string (slabs_first)
+				+ " to " + std::to_string (ch1.slabs + sub1.slabs)
+				+ " slabs after the first cycle");
+		
+		report << cycles << " cycles of " << (batch * 2) << " chunks, peak "
+			<< sub1.peak << " subchunks in " << sub1.slabs << " slabs" << std::endl;
+		report << "rss growth after the first cycle: "
+			<< (current_rss_kb () - rss_first) << " KiB" << std::endl;
+	}
+	
+	/* 
+	 * Returns the name of the first field of @{sub} that does not hold what
+	 * a newly constructed subchunk should, or null if there is none.
+	 */
+	const char*
+	_dirty_subchunk_field (const subchunk *sub)
+	{
+		for (int i = 0; i < 4096; ++i)
+			if (sub->ids[i] != 0) return "ids";
+		for (int i = 0; i < 2048; ++i)
+			if (sub->meta[i] != 0) return "meta";
+		for (int i = 0; i < 2048; ++i)
+			if (sub->blight[i] != 0) return "blight";
+		for (int i = 0; i < 2048; ++i)
+			if (sub->slight[i] != 0xFF) return "slight";
+		for (int i = 0; i < 4096; ++i)
+			if (sub->extra[i] != 0) return "extra";
+		for (int i = 0; i < 128; ++i)
+			if (sub->custom[i] != 0) return "custom";
+		if (sub->add) return "add";
+		if (sub->add_count != 0) return "add_count";
+		if (sub->air_count != 4096) return "air_count";
+		return nullptr;
+	}
+	
+	/* 
+	 * Subchunks carved from fresh slabs skip most of their clearing (see
+	 * subchunk::subchunk ()).  Allocates enough of them to span several new
+	 * slabs, dirties every field, frees them, and allocates them again, so
+	 * that both fresh and recycled memory go through the constructor.  Fails
+	 * if any of them does not come out empty.
+	 */
+	void
+	verify_subchunk_reuse (std::ostream& report)
+	{
+		// more than the pool has lying around, so that new slabs get carved.
+		slab_stats st0 = chunk::subchunk_pool ().stats ();
+		const int count = (int)st0.free + 1024;
+		
+		std::vector<subchunk *> subs;
+		for (int round = 0; round < 2; ++round)
+			{
+				for (int i = 0; i < count; ++i)
+					subs.push_back (new subchunk ());
+				
+				for (subchunk *sub : subs)
+					{
+						const char *field = _dirty_subchunk_field (sub);
+						if (field)
+							{
+								for (subchunk *s : subs)
+									delete s;
+								throw std::runtime_error (std::string (round ? "recycled" : "new")
+									+ " subchunk has a dirty " + field + " field");
+							}
+					}
+				
+				// leave garbage behind for the next round.
+				for (subchunk *sub : subs)
+					{
+						std::memset (sub->ids, 0xA5, 4096);
+						std::memset (sub->meta, 0x5A, 2048);
+						std::memset (sub->blight, 0x33, 2048);
+						std::memset (sub->slight, 0x00, 2048);
+						std::memset (sub->extra, 0xC3, 4096);
+						for (int i = 0; i < 128; ++i)
+							sub->custom[i] = 0xFFFFFFFFU;
+						sub->air_count = 0;
+						delete sub;
+					}
+				subs.clear ();
+			}
+		
+		slab_stats st1 = chunk::subchunk_pool ().stats ();
+		if (st1.live != st0.live)
+			throw std::runtime_error (std::to_string (st1.live - st0.live)
+				+ " subchunks were not returned to their pool");
+		if (st1.slabs == st0.slabs)
+			throw std::runtime_error ("no new slab was carved, fresh memory went unchecked");
+		
+		report << (count * 2) << " subchunks checked, "
+			<< (st1.slabs - st0.slabs) << " new slabs" << std::endl;
+	}
+	
+	void
+	add_pool_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		// a full chunk's worth of subchunks, created and destroyed.
+		out.emplace_back ("pool.chunk_churn", [] (long long iters) -> long long
+			{
+				for (long long i = 0; i < iters; ++i)
+					{
+						chunk *ch = new chunk ();
+						for (int sy = 0; sy < 16; ++sy)
+							ch->create_sub (sy);
+						keep (ch->get_sub (15)->air_count);
+						delete ch;
+					}
+				return iters;
+			});
+	}
+	
+	void
+	add_registry_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		// ID lookups of 4096 live entities, as done by physics workers and the
+		// chunk generator.
+		static const int count = 4096;
+		
+		out.emplace_back ("registry.entity_by_id/locked_unordered", [] (long long iters) -> long long
+			{
+				static std::unordered_map<int, int *> m;
+				static std::mutex lock;
+				static int objs[count];
+				if (m.empty ())
+					for (int i = 0; i < count; ++i)
+						m[i] = &objs[i];
+				
+				long long sum = 0;
+				for (long long i = 0; i < iters; ++i)
+					for (int id = 0; id < count; ++id)
+						{
+							std::lock_guard<std::mutex> guard {lock};
+							auto itr = m.find (id);
+							if (itr != m.end ())
+								sum += *itr->second;
+						}
+				keep (sum);
+				return iters * count;
+			});
+		
+		out.emplace_back ("registry.entity_by_id/slot_map", [] (long long iters) -> long long
+			{
+				static slot_map<int> m;
+				static epoch_manager em;
+				static int objs[count];
+				static std::vector<int> ids;
+				if (ids.empty ())
+					for (int i = 0; i < count; ++i)
+						ids.push_back (m.insert (&objs[i]));
+				
+				long long sum = 0;
+				for (long long i = 0; i < iters; ++i)
+					{
+						epoch_guard eg {em};
+						for (int id : ids)
+							{
+								int *o = m.find (id);
+								if (o)
+									sum += *o;
+							}
+					}
+				keep (sum);
+				return iters * count;
+			});
+	}
+	
+	
+	
+//----
+	
+	/* 
+	 * Inputs for the chunk kernels: a terrain chunk with some custom blocks
+	 * mixed in, so that ID translation has work to do.
+	 */
+	struct kernel_input
+	{
+		chunk *ch;
+		const unsigned char *subs[16];
+		unsigned int custom[16][128];
+		std::vector<unsigned char> nibbles;
+		
+		kernel_input ()
+		{
+			this->ch = new chunk ();
+			fill_terrain (this->ch, 7);
+			
+			std::mt19937 rng (7);
+			for (int i = 0; i < 600; ++i)
+				this->ch->set_block (rng () & 15, rng () % 70, rng () & 15,
+					0xA5 + (rng () % 20), rng () & 15);
+			
+			for (int i = 0; i < 16; ++i)
+				{
+					subchunk *sub = this->ch->get_sub (i);
+					this->subs[i] = (sub && !sub->all_air ()) ? sub->ids : nullptr;
+					if (sub)
+						std::memcpy (this->custom[i], sub->custom, sizeof this->custom[i]);
+					else
+						std::memset (this->custom[i], 0, sizeof this->custom[i]);
+				}
+			
+			this->nibbles.resize (4096);
+			for (unsigned char& b : this->nibbles)
+				b = rng () & 15;
+		}
+		
+		static kernel_input&
+		get ()
+		{
+			static kernel_input inst;
+			return inst;
+		}
+	};
+	
+	static void
+	check_kernel (bool ok, const char *kernel, simd_level level)
+	{
+		if (!ok)
+			throw std::runtime_error (std::string ("chunk kernel mismatch: ")
+				+ kernel + "/" + chunk_kernels::level_name (level));
+	}
+	
+	/* 
+	 * Makes sure every set of chunk kernels the CPU can run produces the exact
+	 * same output as the scalar kernels, on terrain and on random bytes, and
+	 * that chunk::recalc_heightmap () still agrees with the per-column version.
+	 * Random inputs are read through misaligned pointers, and the nibble
+	 * kernels are also run on every short length, so that the scalar tails
+	 * after the vector loops get covered.
+	 */
+	void
+	verify_kernels (std::ostream& report)
+	{
+		using namespace chunk_kernels;
+		
+		const kernel_set& ref = *get (SIMD_SCALAR);
+		kernel_input& in = kernel_input::get ();
+		std::mt19937 rng (13);
+		
+		// the extra bytes allow reading the last subchunk misaligned.
+		std::vector<unsigned char> rnd (16 * 4096 + 4), meta (2048);
+		const unsigned char *rnd_subs[16];
+		unsigned char table[256];
+		
+		for (int lvl = SIMD_SSE2; lvl <= SIMD_AVX2; ++lvl)
+			{
+				const kernel_set *ks = get ((simd_level)lvl);
+				if (!ks)
+					{
+						report << level_name ((simd_level)lvl) << ": not supported by this CPU" << std::endl;
+						continue;
+					}
+				
+				for (int round = 0; round < 64; ++round)
+					{
+						for (unsigned char& b : rnd)
+							b = (round & 1) ? rng () : ((rng () & 7) ? 0 : rng ());
+						for (unsigned char& b : meta)
+							b = rng ();
+						for (int i = 0; i < 16; ++i)
+							rnd_subs[i] = (rng () & 3) ? &rnd[i << 12] : nullptr;
+						for (int i = 0; i < 256; ++i)
+							table[i] = i && !(rng () % (1 + (round & 7)));
+						
+						const unsigned char *const *subs = (round < 8) ? in.subs : rnd_subs;
+						const unsigned char *ids = subs[round & 15] ? subs[round & 15] : &rnd[0];
+						if (round >= 8)
+							ids += round & 3;
+						
+						unsigned int c1[128], c2[128];
+						int n1 = ref.classify_ids (ids, c1);
+						int n2 = ks->classify_ids (ids, c2);
+						check_kernel (n1 == n2 && std::memcmp (c1, c2, sizeof c1) == 0,
+							"classify_ids", ks->level);
+						
+						const unsigned char *htable = (round < 8) ? block_props::height_table : table;
+						int h1[256], h2[256];
+						ref.heightmap (subs, htable, h1);
+						ks->heightmap (subs, htable, h2);
+						check_kernel (std::memcmp (h1, h2, sizeof h1) == 0, "heightmap", ks->level);
+						
+						unsigned char oi1[4096], oi2[4096], om1[2048], om2[2048];
+						ref.translate_ids (ids, &meta[0], c1, block_props::client_id_table,
+							block_props::client_meta_table, oi1, om1);
+						ks->translate_ids (ids, &meta[0], c1, block_props::client_id_table,
+							block_props::client_meta_table, oi2, om2);
+						check_kernel (std::memcmp (oi1, oi2, 4096) == 0
+							&& std::memcmp (om1, om2, 2048) == 0, "translate_ids", ks->level);
+						
+						int count = (round & 3) ? (int)(rng () % 2048) * 2 : 4096;
+						ref.unpack_nibbles (&meta[0], oi1, count);
+						ks->unpack_nibbles (&meta[0], oi2, count);
+						check_kernel (std::memcmp (oi1, oi2, count) == 0, "unpack_nibbles", ks->level);
+						
+						ref.pack_nibbles (ids, om1, count);
+						ks->pack_nibbles (ids, om2, count);
+						check_kernel (std::memcmp (om1, om2, count >> 1) == 0, "pack_nibbles", ks->level);
+					}
+				
+				// short and odd-sized runs, on misaligned buffers.  Both versions
+				// must also leave the guard bytes past the output alone.
+				std::vector<unsigned char> src (4096 + 8), o1 (4096 + 8), o2 (4096 + 8);
+				for (unsigned char& b : src)
+					b = rng () & 15;
+				for (int count = 0; count <= 4096; count += (count < 160) ? 2 : 978)
+					for (int off = 0; off < 4; ++off)
+						{
+							std::fill (o1.begin (), o1.end (), 0xEE);
+							std::fill (o2.begin (), o2.end (), 0xEE);
+							ref.pack_nibbles (&src[off], &o1[off], count);
+							ks->pack_nibbles (&src[off], &o2[off], count);
+							check_kernel (o1 == o2 && o2[off + (count >> 1)] == 0xEE,
+								"pack_nibbles (tail)", ks->level);
+							
+							std::fill (o1.begin (), o1.end (), 0xEE);
+							std::fill (o2.begin (), o2.end (), 0xEE);
+							ref.unpack_nibbles (&src[off], &o1[off], count);
+							ks->unpack_nibbles (&src[off], &o2[off], count);
+							check_kernel (o1 == o2 && o2[off + count] == 0xEE,
+								"unpack_nibbles (tail)", ks->level);
+						}
+				
+				report << level_name (ks->level) << ": all kernels match scalar" << std::endl;
+			}
+		
+		chunk *ch = in.ch;
+		ch->recalc_heightmap ();
+		int fast[256];
+		for (int c = 0; c < 256; ++c)
+			fast[c] = ch->get_height (c & 15, c >> 4);
+		for (int c = 0; c < 256; ++c)
+			check_kernel (ch->recalc_heightmap (c & 15, c >> 4) == fast[c],
+				"recalc_heightmap", chunk_kernels::best ().level);
+	}
+	
+	void
+	add_kernel_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		using namespace chunk_kernels;
+		
+		// the old way: get_id () walks down every column.
+		out.emplace_back ("kernels.heightmap/get_id", [] (long long iters) -> long long
+			{
+				chunk *ch = kernel_input::get ().ch;
+				for (long long i = 0; i < iters; ++i)
+					for (int x = 0; x < 16; ++x)
+						for (int z = 0; z < 16; ++z)
+							keep (ch->recalc_heightmap (x, z));
+				return iters;
+			});
+		
+		for (int lvl = SIMD_SCALAR; lvl <= SIMD_AVX2; ++lvl)
+			{
+				const kernel_set *ks = get ((simd_level)lvl);
+				if (!ks)
+					continue;
+				std::string suffix = std::string ("/") + level_name (ks->level);
+				
+				out.emplace_back ("kernels.classify_ids" + suffix, [ks] (long long iters) -> long long
+					{
+						kernel_input& in = kernel_input::get ();
+						unsigned int custom[128];
+						long long n = 0;
+						for (long long i = 0; i < iters; ++i)
+							n += ks->classify_ids (in.subs[3], custom);
+						keep (n);
+						return iters;
+					});
+				
+				out.emplace_back ("kernels.heightmap" + suffix, [ks] (long long iters) -> long long
+					{
+						kernel_input& in = kernel_input::get ();
+						int heights[256];
+						for (long long i = 0; i < iters; ++i)
+							{
+								ks->heightmap (in.subs, block_props::height_table, heights);
+								keep (heights[i & 0xFF]);
+							}
+						return iters;
+					});
+				
+				out.emplace_back ("kernels.translate_ids" + suffix, [ks] (long long iters) -> long long
+					{
+						kernel_input& in = kernel_input::get ();
+						subchunk *sub = in.ch->get_sub (3);
+						unsigned char ids[4096], meta[2048];
+						for (long long i = 0; i < iters; ++i)
+							{
+								ks->translate_ids (sub->ids, sub->meta, in.custom[3],
+									block_props::client_id_table, block_props::client_meta_table,
+									ids, meta);
+								keep (meta[i & 0x7FF]);
+							}
+						return iters;
+					});
+				
+				out.emplace_back ("kernels.pack_nibbles" + suffix, [ks] (long long iters) -> long long
+					{
+						kernel_input& in = kernel_input::get ();
+						unsigned char packed[2048];
+						for (long long i = 0; i < iters; ++i)
+							{
+								ks->pack_nibbles (&in.nibbles[0], packed, 4096);
+								keep (packed[i & 0x7FF]);
+							}
+						return iters;
+					});
+				
+				out.emplace_back ("kernels.unpack_nibbles" + suffix, [ks] (long long iters) -> long long
+					{
+						subchunk *sub = kernel_input::get ().ch->get_sub (3);
+						unsigned char bytes[4096];
+						for (long long i = 0; i < iters; ++i)
+							{
+								ks->unpack_nibbles (sub->slight, bytes, 4096);
+								keep (bytes[i & 0xFFF]);
+							}
+						return iters;
+					});
+			}
+	}
+	
+	
+	
+//----
+	
+	/* 
+	 * The 11x11 columns a player at the default view distance receives when
+	 * joining a world, each with slightly different terrain.
+	 */
+	std::vector<chunk_column>&
+	join_columns ()
+	{
+		static std::vector<chunk_column> cols;
+		if (cols.empty ())
+			for (int cx = -5; cx <= 5; ++cx)
+				for (int cz = -5; cz <= 5; ++cz)
+					{
+						chunk *ch = new chunk ();
+						fill_terrain (ch, (cx * 31) ^ cz);
+						cols.push_back ({cx, cz, ch});
+					}
+		return cols;
+	}
+	
+	// size of a column's uncompressed data in a chunk packet.
+	static size_t
+	column_data_size (chunk *ch)
+	{
+		size_t size = 256; // biome array
+		for (int s = 0; s < 16; ++s)
+			if (ch->get_sub (s) && !ch->get_sub (s)->all_air ())
+				size += 10240;
+		return size;
+	}
+	
+	/* 
+	 * Builds the packets a join sends with the columns above, either as one
+	 * Chunk Data packet per column (@{budget} = 0), or grouped into Map Chunk
+	 * Bulk packets of up to @{budget} bytes of uncompressed data, in the same
+	 * way stream_chunks does.
+	 */
+	std::vector<packet *>
+	make_join_packets (size_t budget)
+	{
+		std::vector<chunk_column>& cols = join_columns ();
+		std::vector<edit_stage *> es_vec;
+		std::vector<packet *> packs;
+		
+		std::vector<chunk_column> batch;
+		for (size_t b = 0; b < cols.size (); )
+			{
+				size_t bytes = 0;
+				batch.clear ();
+				do
+					{
+						batch.push_back (cols[b]);
+						bytes += column_data_size (cols[b].ch);
+						++ b;
+					}
+				while (b < cols.size () && (bytes + column_data_size (cols[b].ch)) <= budget);
+				
+				if (batch.size () == 1)
+					packs.push_back (packets::play::make_chunk (batch[0].x, batch[0].z, batch[0].ch, es_vec));
+				else
+					packs.push_back (packets::play::make_chunk_bulk (batch, es_vec));
+			}
+		return packs;
+	}
+	
+	struct decoded_column
+	{
+		int x, z;
+		unsigned short primary, add;
+		std::vector<unsigned char> data;
+	};
+	
+	static std::vector<unsigned char>
+	inflate_bytes (packet_reader& reader, int len)
+	{
+		std::vector<unsigned char> comp (len), out (16 * 1024 * 1024);
+		reader.read_bytes (comp.data (), len);
+		unsigned long out_len = out.size ();
+		if (!codec::decompress (CODEC_ZLIB, comp.data (), len, out.data (), out_len))
+			throw std::runtime_error ("chunk packet: bad deflate stream");
+		out.resize (out_len);
+		return out;
+	}
+	
+	/* 
+	 * Decodes Chunk Data (0x21) and Map Chunk Bulk (0x26) packets the way the
+	 * client does, and returns the columns they carry.
+	 */
+	std::vector<decoded_column>
+	decode_chunk_packets (const std::vector<packet *>& packs)
+	{
+		std::vector<decoded_column> cols;
+		for (packet *pack : packs)
+			{
+				packet_reader reader (pack->data);
+				reader.read_varint (); // length
+				int id = reader.read_varint ();
+				if (id == 0x21)
+					{
+						decoded_column col;
+						col.x = (int)reader.read_int ();
+						col.z = (int)reader.read_int ();
+						if (!reader.read_byte ())
+							throw std::runtime_error ("chunk packet: not ground-up");
+						col.primary = reader.read_short ();
+						col.add = reader.read_short ();
+						col.data = inflate_bytes (reader, reader.read_int ());
+						cols.push_back (std::move (col));
+					}
+				else if (id == 0x26)
+					{
+						int count = reader.read_short ();
+						int len = reader.read_int ();
+						if (!reader.read_byte ())
+							throw std::runtime_error ("chunk bulk: no sky light");
+						std::vector<unsigned char> data = inflate_bytes (reader, len);
+						
+						size_t off = 0;
+						for (int i = 0; i < count; ++i)
+							{
+								decoded_column col;
+								col.x = (int)reader.read_int ();
+								col.z = (int)reader.read_int ();
+								col.primary = reader.read_short ();
+								col.add = reader.read_short ();
+								
+								size_t size = 10240 * __builtin_popcount (col.primary)
+									+ 2048 * __builtin_popcount (col.add) + 256;
+								if (off + size > data.size ())
+									throw std::runtime_error ("chunk bulk: data too short");
+								col.data.assign (data.begin () + off, data.begin () + off + size);
+								off += size;
+								cols.push_back (std::move (col));
+							}
+						if (off != data.size ())
+							throw std::runtime_error ("chunk bulk: trailing data");
+					}
+				else
+					throw std::runtime_error ("unexpected packet id " + std::to_string (id));
+			}
+		return cols;
+	}
+	
+	/* 
+	 * Decodes the packets a join sends with a bulk budget of @{budget} bytes,
+	 * and makes sure they carry exactly the columns in @{ref}, and that no bulk
+	 * packet goes over the budget.  Returns the number of columns in each
+	 * packet, and adds their size to @{total}.
+	 */
+	std::vector<size_t>
+	check_bulk_budget (const std::vector<decoded_column>& ref, size_t budget,
+		long long& total)
+	{
+		std::vector<packet *> packs = make_join_packets (budget);
+		std::vector<decoded_column> cols;
+		std::vector<size_t> counts;
+		std::string err;
+		try
+			{
+				for (packet *pack : packs)
+					{
+						total += pack->size;
+						std::vector<decoded_column> part = decode_chunk_packets ({pack});
+						
+						size_t bytes = 0;
+						for (decoded_column& col : part)
+							bytes += col.data.size ();
+						if (part.size () > 1 && bytes > budget)
+							err = "a bulk packet carries " + std::to_string (bytes) + " bytes";
+						counts.push_back (part.size ());
+						cols.insert (cols.end (), part.begin (), part.end ());
+					}
+			}
+		catch (...)
+			{
+				for (packet *pack : packs) delete pack;
+				throw;
+			}
+		for (packet *pack : packs) delete pack;
+		
+		if (err.empty () && cols.size () != ref.size ())
+			err = "column count mismatch";
+		for (size_t i = 0; err.empty () && i < ref.size (); ++i)
+			if (ref[i].x != cols[i].x || ref[i].z != cols[i].z || ref[i].primary != cols[i].primary
+				|| ref[i].add != cols[i].add || ref[i].data != cols[i].data)
+				err = "column " + std::to_string (i) + " differs";
+		if (!err.empty ())
+			throw std::runtime_error ("chunk bulk (budget " + std::to_string (budget)
+				+ "): " + err);
+		return counts;
+	}
+	
+	/* 
+	 * Checks that the bulk packets carry exactly the same columns as the
+	 * single-chunk packets, and reports how many bytes a join takes each way.
+	 * Budgets right at and right below the size of the first two columns
+	 * must group exactly two and one columns respectively, and a budget
+	 * smaller than any column must still send every column.
+	 */
+	void
+	verify_chunk_bulk (std::ostream& report)
+	{
+		std::vector<packet *> singles = make_join_packets (0);
+		std::vector<decoded_column> a;
+		long long single_bytes = 0, bulk_bytes = 0, unused = 0;
+		for (packet *pack : singles)
+			single_bytes += pack->size;
+		try
+			{
+				a = decode_chunk_packets (singles);
+			}
+		catch (...)
+			{
+				for (packet *pack : singles) delete pack;
+				throw;
+			}
+		for (packet *pack : singles) delete pack;
+		
+		std::vector<chunk_column>& cols = join_columns ();
+		if (a.size () != cols.size ())
+			throw std::runtime_error ("chunk packets: column count mismatch");
+		size_t first_two = column_data_size (cols[0].ch) + column_data_size (cols[1].ch);
+		
+		size_t bulks = check_bulk_budget (a, 256 * 1024, bulk_bytes).size ();
+		if (check_bulk_budget (a, 1, unused).size () != cols.size ())
+			throw std::runtime_error ("chunk bulk: a budget of one byte grouped columns");
+		if (check_bulk_budget (a, first_two, unused)[0] != 2)
+			throw std::runtime_error ("chunk bulk: a budget of exactly two columns was not filled");
+		if (check_bulk_budget (a, first_two - 1, unused)[0] != 1)
+			throw std::runtime_error ("chunk bulk: a budget one byte short of two columns was overrun");
+		
+		report << "join of " << a.size () << " columns: " << singles.size ()
+			<< " chunk packets, " << single_bytes << " bytes" << std::endl;
+		report << "join of " << a.size () << " columns: " << bulks
+			<< " bulk packets, " << bulk_bytes << " bytes ("
+			<< (100 * bulk_bytes / std::max (single_bytes, 1LL)) << "%)" << std::endl;
+	}
+	
+	void
+	add_packet_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		out.emplace_back ("packet.make_chunk", [] (long long iters) -> long long
+			{
+				static chunk *ch = nullptr;
+				if (!ch)
+					{
+						ch = new chunk ();
+						fill_terrain (ch, 1);
+					}
+				
+				for (long long i = 0; i < iters; ++i)
+					{
+						packet *pack = packets::play::make_chunk (0, 0, ch);
+						keep (pack->size);
+						delete pack;
+					}
+				return iters;
+			});
+		
+		// CPU per join: the columns of a default-sized view.
+		out.emplace_back ("packet.join_121/chunk", [] (long long iters) -> long long
+			{
+				for (long long i = 0; i < iters; ++i)
+					for (packet *pack : make_join_packets (0))
+						{
+							keep (pack->size);
+							delete pack;
+						}
+				return iters;
+			});
+		out.emplace_back ("packet.join_121/bulk", [] (long long iters) -> long long
+			{
+				for (long long i = 0; i < iters; ++i)
+					for (packet *pack : make_join_packets (256 * 1024))
+						{
+							keep (pack->size);
+							delete pack;
+						}
+				return iters;
+			});
+		
+		out.emplace_back ("packet.put_varint", [] (long long iters) -> long long
+			{
+				packet pack (5 * 1024);
+				for (long long i = 0; i < iters; ++i)
+					{
+						if ((i & 0x3FF) == 0)
+							pack.clear ();
+						pack.put_varint ((unsigned int)(i * 2654435761u) >> (i & 31));
+					}
+				keep (pack.pos);
+				return iters;
+			});
+		
+		out.emplace_back ("packet_reader.read_varint", [] (long long iters) -> long long
+			{
+				packet pack (5 * 1024);
+				for (int i = 0; i < 1024; ++i)
+					pack.put_varint ((unsigned int)(i * 2654435761u) >> (i & 31));
+				
+				unsigned long long sum = 0;
+				packet_reader reader (pack.data);
+				for (long long i = 0; i < iters; ++i)
+					{
+						if ((i & 0x3FF) == 0)
+							reader.seek (0);
+						sum += reader.read_varint ();
+					}
+				keep (sum);
+				return iters;
+			});
+	}
+	
+	void
+	add_noise_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		out.emplace_back ("noise.fractal_2d", [] (long long iters) -> long long
+			{
+				double sum = 0.0;
+				for (long long i = 0; i < iters; ++i)
+					sum += h_noise::fractal_noise_2d (1337, (i & 0xFF) / 32.0, (i >> 8) / 32.0, 6, 0.5);
+				keep (sum > 0.0);
+				return iters;
+			});
+		
+		out.emplace_back ("noise.fractal_3d", [] (long long iters) -> long long
+			{
+				double sum = 0.0;
+				for (long long i = 0; i < iters; ++i)
+					sum += h_noise::fractal_noise_3d (1337, (i & 0xF) / 16.0,
+						((i >> 4) & 0xFF) / 16.0, (i >> 12) / 16.0, 6, 0.5);
+				keep (sum > 0.0);
+				return iters;
+			});
+	}
+	
+	
+	
+	/* 
+	 * Builds a compound tag resembling a player's saved inventory.
+	 */
+	nbt_tag_compound*
+	make_inventory_nbt ()
+	{
+		nbt_tag_compound *root = new nbt_tag_compound ("Player");
+		root->add ((new nbt_tag_string ("Name"))->set ("benchmark"));
+		root->add ((new nbt_tag_int ("Health"))->set (20));
+		
+		nbt_tag_list *inv = new nbt_tag_list ("Inventory", TAG_COMPOUND);
+		for (int i = 0; i < 36; ++i)
+			{
+				nbt_tag_compound *slot = new nbt_tag_compound ("");
+				slot->add ((new nbt_tag_int ("Slot"))->set (i));
+				slot->add ((new nbt_tag_int ("id"))->set (i + 1));
+				slot->add ((new nbt_tag_int ("Count"))->set (64));
+				slot->add ((new nbt_tag_int ("Damage"))->set (0));
+				inv->add (slot);
+			}
+		root->add (inv);
+		
+		return root;
+	}
+	
+	void
+	add_nbt_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		out.emplace_back ("nbt.encode", [] (long long iters) -> long long
+			{
+				nbt_tag_compound *root = make_inventory_nbt ();
+				std::vector<unsigned char> buf (root->size () + 16);
+				for (long long i = 0; i < iters; ++i)
+					keep (root->encode (buf.data ()));
+				delete root;
+				return iters;
+			});
+		
+		out.emplace_back ("nbt.decode", [] (long long iters) -> long long
+			{
+				nbt_tag_compound *root = make_inventory_nbt ();
+				std::vector<unsigned char> buf (root->size () + 16);
+				root->encode (buf.data ());
+				delete root;
+				
+				for (long long i = 0; i < iters; ++i)
+					{
+						nbt_tag *tag = nbt_tag::decode (buf.data ());
+						keep (tag != nullptr);
+						delete tag;
+					}
+				return iters;
+			});
+		
+		out.emplace_back ("nbt.decode/arena", [] (long long iters) -> long long
+			{
+				nbt_tag_compound *root = make_inventory_nbt ();
+				std::vector<unsigned char> buf (root->size () + 16);
+				root->encode (buf.data ());
+				delete root;
+				
+				nbt_arena arena;
+				for (long long i = 0; i < iters; ++i)
+					{
+						{
+							nbt_arena_scope scope (arena);
+							nbt_tag *tag = nbt_tag::decode (buf.data ());
+							keep (tag != nullptr);
+							delete tag;
+						}
+						arena.reset ();
+					}
+				return iters;
+			});
+		
+		// a slot with a name, lore and enchantments, as sent in window items.
+		out.emplace_back ("packet.put_slot/metadata", [] (long long iters) -> long long
+			{
+				enchantment_list ench;
+				ench.push_back (enchantment (0, 4));
+				ench.push_back (enchantment (34, 3));
+				slot_item item (IT_DIAMOND_SWORD, 0, 1, &ench);
+				item.set_display_name ("Benchmark Sword");
+				item.set_lore ({ "first line", "second line" });
+				
+				packet pack (64);
+				for (long long i = 0; i < iters; ++i)
+					{
+						pack.clear ();
+						pack.put_slot (item);
+					}
+				keep (pack.size);
+				return iters;
+			});
+	}
+	
+	void
+	add_permission_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		out.emplace_back ("permission_manager.get", [] (long long iters) -> long long
+			{
+				static const char *groups[] = { "command", "world", "chat", "build", "zone" };
+				
+				permission_manager perms;
+				std::vector<std::string> names;
+				for (int g = 0; g < 5; ++g)
+					for (int i = 0; i < 40; ++i)
+						{
+							names.push_back (std::string (groups[g]) + ".node"
+								+ std::to_string (i / 8) + ".perm" + std::to_string (i));
+							perms.add (names.back ().c_str ());
+						}
+				
+				unsigned long long sum = 0;
+				for (long long i = 0; i < iters; ++i)
+					sum += perms.get (names[i % names.size ()].c_str ()).nodes[0];
+				keep (sum);
+				return iters;
+			});
+	}
+	
+	void
+	add_codec_benches (std::vector<std::pair<std::string, bench_fn>>& out)
+	{
+		// a serialized chunk is mostly block ids, metadata and light.
+		static std::vector<unsigned char> input;
+		if (input.empty ())
+			{
+				chunk ch;
+				fill_terrain (&ch, 2);
+				for (int sy = 0; sy < 16; ++sy)
+					{
+						subchunk *sub = ch.get_sub (sy);
+						if (!sub) continue;
+						input.insert (input.end (), sub->ids, sub->ids + 4096);
+						input.insert (input.end (), sub->meta, sub->meta + 2048);
+						input.insert (input.end (), sub->blight, sub->blight + 2048);
+						input.insert (input.end (), sub->slight, sub->slight + 2048);
+					}
+			}
+		
+		for (int id : { CODEC_ZLIB, CODEC_RAW, CODEC_LZ4 })
+			{
+				if (!codec::available (id))
+					continue;
+				std::string name = codec::name (id);
+				
+				out.emplace_back ("codec." + name + ".compress", [id] (long long iters) -> long long
+					{
+						std::vector<unsigned char> buf (codec::bound (id, input.size ()));
+						for (long long i = 0; i < iters; ++i)
+							{
+								unsigned long dlen = buf.size ();
+								codec::compress (id, -1, input.data (), input.size (), buf.data (), dlen);
+								keep (dlen);
+							}
+						return iters;
+					});
+				
+				out.emplace_back ("codec." + name + ".decompress", [id] (long long iters) -> long long
+					{
+						std::vector<unsigned char> comp (codec::bound (id, input.size ()));
+						unsigned long clen = comp.size ();
+						codec::compress (id, -1, input.data (), input.size (), comp.data (), clen);
+						
+						std::vector<unsigned char> buf (input.size ());
+						for (long long i = 0; i < iters; ++i)
+							{
+								unsigned long dlen = buf.size ();
+								codec::decompress (id, comp.data (), clen, buf.data (), dlen);
+								keep (dlen);
+							}
+						return iters;
+					});
+			}
+	}
+	
+	
+	
+//----
+	
+	std::string
+	json_escape (const std::string& str)
+	{
+		std::string out;
+		for (char c : str)
+			{
+				if (c == '"' || c == '\\')
+					out.push_back ('\\');
+				out.push_back (c);
+			}
+		return out;
+	}
+	
+	void
+	print_result (const bench_result& res, const bench_args& args)
+	{
+		double ops_per_sec = (res.ns_per_op > 0.0) ? (1e9 / res.ns_per_op) : 0.0;
+		
+		if (args.format == "csv")
+			std::printf ("%s,%s,%.3f,%.3f,%.3f,%.1f,%lld\n",
+				args.label.c_str (), res.name.c_str (), res.ns_per_op,
+				res.min_ns_per_op, res.max_ns_per_op, ops_per_sec, res.ops);
+		else if (args.format == "json")
+			std::printf ("{\"label\":\"%s\",\"name\":\"%s\",\"ns_per_op\":%.3f,"
+				"\"min_ns_per_op\":%.3f,\"max_ns_per_op\":%.3f,\"ops_per_sec\":%.1f,"
+				"\"ops\":%lld}\n",
+				json_escape (args.label).c_str (), json_escape (res.name).c_str (),
+				res.ns_per_op, res.min_ns_per_op, res.max_ns_per_op, ops_per_sec, res.ops);
+		else
+			std::printf ("%-36s %14.1f ns/op %16.1f ops/s   (min %.1f, max %.1f)\n",
+				res.name.c_str (), res.ns_per_op, ops_per_sec,
+				res.min_ns_per_op, res.max_ns_per_op);
+		std::fflush (stdout);
+	}
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+	bench_args args;
+	bool list;
+	if (!parse_args (argc, argv, args, list))
+		{
+			print_usage ();
+			return 1;
+		}
+	
+	// worlds need a server instance, but nothing in it is started.
+	logger log;
+	server srv (log);
+	
+	try
+		{
+			bench_world bw (srv, log);
+			
+			std::vector<std::pair<std::string, bench_fn>> benches;
+			add_subchunk_benches (benches);
+			add_world_benches (benches, bw);
+			add_spatial_benches (benches, bw);
+			add_registry_benches (benches);
+			add_draw_benches (benches);
+			add_pool_benches (benches);
+			add_kernel_benches (benches);
+			add_packet_benches (benches);
+			add_noise_benches (benches);
+			add_nbt_benches (benches);
+			add_permission_benches (benches);
+			add_codec_benches (benches);
+			
+			if (args.verify)
+				{
+					std::vector<std::pair<std::string, check_fn>> checks;
+					checks.emplace_back ("draw.raster", verify_raster);
+					checks.emplace_back ("editstage.bulk_commit", [&bw] (std::ostream& report)
+						{ verify_bulk_commit (bw, report); });
+					checks.emplace_back ("pool.chunk_stress", [&bw] (std::ostream& report)
+						{ chunk_pool_stress (bw, report); });
+					checks.emplace_back ("pool.subchunk_reuse", verify_subchunk_reuse);
+					checks.emplace_back ("chunk_kernels", verify_kernels);
+					checks.emplace_back ("packet.chunk_bulk", verify_chunk_bulk);
+					return (run_checks (checks) == 0) ? 0 : 1;
+				}
+			
+			if (list)
+				{
+					for (auto& b : benches)
+						std::cout << b.first << std::endl;
+					return 0;
+				}
+			
+			if (args.format == "csv")
+				std::printf ("label,name,ns_per_op,min_ns_per_op,max_ns_per_op,ops_per_sec,ops\n");
+			
+			for (auto& b : benches)
+				{
+					if (!args.filter.empty () && b.first.find (args.filter) == std::string::npos)
+						continue;
+					print_result (run_bench (b.first, b.second, args), args);
+				}
+		}
+	catch (const std::exception& ex)
+		{
+			std::cerr << "hcraft-bench: " << ex.what () << std::endl;
+			return 1;
+		}
+	
+	return 0;
+}
+
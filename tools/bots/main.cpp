@@ -0,0 +1,1236 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * hcraft-bots - headless load generator.
+ * 
+ * Connects a number of simulated 1.7.2 (protocol 4) clients to a running
+ * server in offline mode.  Every bot walks a random path around the spawn
+ * (which keeps chunk streaming busy), chats, places and breaks blocks, and
+ * optionally issues drawing commands.  When the run ends, a report with join
+ * latencies, chunk delivery rates, chat round-trip times and the server's
+ * CPU usage is printed.
+ * 
+ * Usage:
+ *   hcraft-bots [-n <bots>] [-h <host>] [-p <port>] [-d <seconds>] [options]
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <csignal>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+
+namespace {
+	
+	typedef std::chrono::steady_clock clk;
+	
+	struct bots_args
+	{
+		int count;
+		std::string host;
+		int port;
+		int duration;     // seconds
+		double ramp;      // joins per second
+		std::string prefix;
+		double speed;     // blocks per second
+		int radius;       // maximum distance from spawn
+		double chat_interval;
+		double build_interval;
+		double draw_interval;
+		int server_pid;
+		bool json;
+	};
+	
+	
+	enum bot_state
+	{
+		BS_IDLE,
+		BS_CONNECTING,
+		BS_LOGIN,
+		BS_PLAY,
+		BS_DEAD,
+	};
+	
+	struct bot
+	{
+		int index;
+		int fd;
+		std::string name;
+		bot_state state;
+		
+		std::vector<unsigned char> in;
+		std::vector<unsigned char> out;
+		
+		clk::time_point connect_time;
+		bool spawned;
+		int gamemode;
+		bool has_blocks;
+		
+		double x, y, z;
+		double sx, sz; // spawn
+		float yaw;
+		
+		clk::time_point next_move;
+		clk::time_point next_turn;
+		clk::time_point next_chat;
+		clk::time_point next_build;
+		clk::time_point next_draw;
+		
+		int chat_seq;
+		std::string chat_token;
+		clk::time_point chat_time;
+		
+		bool placed;
+		int px, py, pz;
+		bool draw_fill;
+		
+		std::minstd_rand rnd;
+	};
+	
+	struct bots_stats
+	{
+		int connected;
+		int joined;
+		int failed;
+		int kicked;
+		
+		unsigned long long chunks;
+		unsigned long long bytes_in;
+		unsigned long long bytes_out;
+		unsigned long long moves;
+		unsigned long long blocks;
+		unsigned long long draws;
+		
+		std::vector<double> join_ms;
+		std::vector<double> rtt_ms;
+		
+		double cpu_sum;
+		int cpu_samples;
+		double cpu_peak;
+		long rss_peak_kb;
+	};
+	
+	
+	volatile sig_atomic_t g_stop = 0;
+	
+	void
+	on_signal (int)
+	{
+		g_stop = 1;
+	}
+	
+	
+	
+	void
+	print_usage ()
+	{
+		std::cout <<
+			"usage:\n"
+			"  hcraft-bots [-n <bots>] [-h <host>] [-p <port>] [-d <seconds>] [options]\n"
+			"\n"
+			"options:\n"
+			"  -n <bots>             number of bots to connect (default: 10)\n"
+			"  -h <host>             server address (default: 127.0.0.1)\n"
+			"  -p <port>             server port (default: 25565)\n"
+			"  -d <seconds>          length of the run (default: 60)\n"
+			"  -r <joins/sec>        rate at which bots join (default: 10)\n"
+			"  --prefix <name>       bot name prefix (default: bot)\n"
+			"  --speed <blocks/sec>  walking speed (default: 4.3)\n"
+			"  --radius <blocks>     how far bots wander from spawn (default: 256)\n"
+			"  --chat <seconds>      chat interval, 0 to disable (default: 10)\n"
+			"  --build <seconds>     block place/break interval, 0 to disable (default: 2)\n"
+			"  --draw <seconds>      /cuboid interval, 0 to disable (default: 0)\n"
+			"  --server-pid <pid>    server process to sample CPU usage from\n"
+			"                        (default: look for a process named hCraft)\n"
+			"  --json                print the report as JSON\n"
+			"\n"
+			"The server must be running in offline mode.  Drawing commands need the\n"
+			"bots to be in a group that has the command.draw.cuboid permission.\n";
+	}
+	
+	bool
+	parse_args (int argc, char *argv[], bots_args& out)
+	{
+		out.count = 10;
+		out.host = "127.0.0.1";
+		out.port = 25565;
+		out.duration = 60;
+		out.ramp = 10.0;
+		out.prefix = "bot";
+		out.speed = 4.3;
+		out.radius = 256;
+		out.chat_interval = 10.0;
+		out.build_interval = 2.0;
+		out.draw_interval = 0.0;
+		out.server_pid = -1;
+		out.json = false;
+		
+		for (int i = 1; i < argc; ++i)
+			{
+				std::string arg = argv[i];
+				bool has_val = (i + 1) < argc;
+				
+				if (arg == "--json")
+					out.json = true;
+				else if (arg == "-n" && has_val)
+					out.count = std::atoi (argv[++i]);
+				else if (arg == "-h" && has_val)
+					out.host = argv[++i];
+				else if (arg == "-p" && has_val)
+					out.port = std::atoi (argv[++i]);
+				else if (arg == "-d" && has_val)
+					out.duration = std::atoi (argv[++i]);
+				else if (arg == "-r" && has_val)
+					out.ramp = std::atof (argv[++i]);
+				else if (arg == "--prefix" && has_val)
+					out.prefix = argv[++i];
+				else if (arg == "--speed" && has_val)
+					out.speed = std::atof (argv[++i]);
+				else if (arg == "--radius" && has_val)
+					out.radius = std::atoi (argv[++i]);
+				else if (arg == "--chat" && has_val)
+					out.chat_interval = std::atof (argv[++i]);
+				else if (arg == "--build" && has_val)
+					out.build_interval = std::atof (argv[++i]);
+				else if (arg == "--draw" && has_val)
+					out.draw_interval = std::atof (argv[++i]);
+				else if (arg == "--server-pid" && has_val)
+					out.server_pid = std::atoi (argv[++i]);
+				else
+					{
+						std::cerr << "hcraft-bots: unexpected argument: " << arg << std::endl;
+						return false;
+					}
+			}
+		
+		if (out.count <= 0 || out.duration <= 0 || out.ramp <= 0.0)
+			return false;
+		
+		// usernames are limited to 16 characters
+		std::string longest = out.prefix + std::to_string (out.count - 1);
+		if (out.prefix.empty () || longest.size () > 16)
+			{
+				std::cerr << "hcraft-bots: bot names would be longer than 16 characters" << std::endl;
+				return false;
+			}
+		
+		return true;
+	}
+	
+	
+	
+//----
+	
+	/* 
+	 * Minimal packet writer for the handful of serverbound packets used.
+	 */
+	class bot_packet
+	{
+		std::vector<unsigned char> data;
+		
+	public:
+		bot_packet (int id)
+			{ this->put_varint (id); }
+		
+		void
+		put_varint (int num)
+		{
+			unsigned int n = num;
+			do
+				{
+					unsigned char b = n & 0x7F;
+					n >>= 7;
+					if (n) b |= 0x80;
+					this->data.push_back (b);
+				}
+			while (n);
+		}
+		
+		void put_byte (int b) { this->data.push_back (b & 0xFF); }
+		void put_bool (bool b) { this->put_byte (b ? 1 : 0); }
+		
+		void
+		put_short (int s)
+		{
+			this->put_byte (s >> 8);
+			this->put_byte (s);
+		}
+		
+		void
+		put_int (int i)
+		{
+			this->put_short (i >> 16);
+			this->put_short (i);
+		}
+		
+		void
+		put_long (unsigned long long l)
+		{
+			this->put_int (l >> 32);
+			this->put_int (l & 0xFFFFFFFF);
+		}
+		
+		void
+		put_float (float f)
+		{
+			unsigned int i;
+			std::memcpy (&i, &f, 4);
+			this->put_int (i);
+		}
+		
+		void
+		put_double (double d)
+		{
+			unsigned long long l;
+			std::memcpy (&l, &d, 8);
+			this->put_long (l);
+		}
+		
+		void
+		put_string (const std::string& str)
+		{
+			this->put_varint (str.size ());
+			this->data.insert (this->data.end (), str.begin (), str.end ());
+		}
+		
+		
+		
+		/* 
+		 * Appends the length-prefixed packet to @{out}.
+		 */
+		void
+		finish (std::vector<unsigned char>& out) const
+		{
+			unsigned int n = this->data.size ();
+			do
+				{
+					unsigned char b = n & 0x7F;
+					n >>= 7;
+					if (n) b |= 0x80;
+					out.push_back (b);
+				}
+			while (n);
+			out.insert (out.end (), this->data.begin (), this->data.end ());
+		}
+	};
+	
+	
+	/* 
+	 * Reads fields out of a single clientbound packet.
+	 */
+	class bot_reader
+	{
+		const unsigned char *data;
+		size_t len;
+		size_t pos;
+		
+	public:
+		bot_reader (const unsigned char *data, size_t len)
+			: data (data), len (len), pos (0)
+			{ }
+		
+		bool good () const { return this->pos <= this->len; }
+		
+		int
+		read_varint ()
+		{
+			int num = 0;
+			for (int i = 0; i < 5; ++i)
+				{
+					int b = this->read_byte ();
+					num |= (b & 0x7F) << (7 * i);
+					if (!(b & 0x80))
+						break;
+				}
+			return num;
+		}
+		
+		int
+		read_byte ()
+		{
+			if (this->pos >= this->len)
+				{ this->pos = this->len + 1; return 0; }
+			return this->data[this->pos++];
+		}
+		
+		int
+		read_short ()
+		{
+			int hi = this->read_byte ();
+			return (short)((hi << 8) | this->read_byte ());
+		}
+		
+		int
+		read_int ()
+		{
+			unsigned int hi = this->read_short () & 0xFFFF;
+			return (int)((hi << 16) | (this->read_short () & 0xFFFF));
+		}
+		
+		double
+		read_double ()
+		{
+			unsigned long long hi = (unsigned int)this->read_int ();
+			unsigned long long l = (hi << 32) | (unsigned int)this->read_int ();
+			double d;
+			std::memcpy (&d, &l, 8);
+			return d;
+		}
+		
+		float
+		read_float ()
+		{
+			unsigned int i = this->read_int ();
+			float f;
+			std::memcpy (&f, &i, 4);
+			return f;
+		}
+		
+		std::string
+		read_string ()
+		{
+			int n = this->read_varint ();
+			if (n < 0 || this->pos + n > this->len)
+				{ this->pos = this->len + 1; return std::string (); }
+			std::string str ((const char *)this->data + this->pos, n);
+			this->pos += n;
+			return str;
+		}
+	};
+	
+	
+	
+//----
+	
+	double
+	ms_since (clk::time_point t, clk::time_point now)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds> (
+			now - t).count () / 1000.0;
+	}
+	
+	clk::time_point
+	after (clk::time_point t, double secs)
+	{
+		return t + std::chrono::microseconds ((long long)(secs * 1000000.0));
+	}
+	
+	/* 
+	 * Returns @{base} seconds, randomly stretched by up to +-25% so that
+	 * bots don't all act on the same tick.
+	 */
+	double
+	jitter (bot& b, double base)
+	{
+		std::uniform_real_distribution<double> dis (0.75, 1.25);
+		return base * dis (b.rnd);
+	}
+	
+	
+	
+	void
+	send_packet (bot& b, const bot_packet& pack, bots_stats& st)
+	{
+		size_t prev = b.out.size ();
+		pack.finish (b.out);
+		st.bytes_out += b.out.size () - prev;
+	}
+	
+	void
+	send_position (bot& b, bots_stats& st)
+	{
+		bot_packet pack (0x04);
+		pack.put_double (b.x);
+		pack.put_double (b.y);
+		pack.put_double (b.y + 1.62); // stance
+		pack.put_double (b.z);
+		pack.put_bool (false);
+		send_packet (b, pack, st);
+		++ st.moves;
+	}
+	
+	void
+	send_chat (bot& b, const std::string& msg, bots_stats& st)
+	{
+		bot_packet pack (0x01);
+		pack.put_string (msg);
+		send_packet (b, pack, st);
+	}
+	
+	void
+	send_dig (bot& b, int status, int x, int y, int z, bots_stats& st)
+	{
+		bot_packet pack (0x07);
+		pack.put_byte (status);
+		pack.put_int (x);
+		pack.put_byte (y);
+		pack.put_int (z);
+		pack.put_byte (1);
+		send_packet (b, pack, st);
+	}
+	
+	/* 
+	 * Places the held block on top of the block at the given coordinates.
+	 */
+	void
+	send_place (bot& b, int x, int y, int z, bots_stats& st)
+	{
+		bot_packet pack (0x08);
+		pack.put_int (x);
+		pack.put_byte (y);
+		pack.put_int (z);
+		pack.put_byte (1); // +Y
+		pack.put_short (1); // stone
+		pack.put_byte (1);
+		pack.put_short (0);
+		pack.put_short (-1);
+		pack.put_byte (8);
+		pack.put_byte (16);
+		pack.put_byte (8);
+		send_packet (b, pack, st);
+	}
+	
+	/* 
+	 * Puts a stack of stone into the first hotbar slot (creative mode only).
+	 */
+	void
+	send_give_blocks (bot& b, bots_stats& st)
+	{
+		bot_packet pack (0x10);
+		pack.put_short (36);
+		pack.put_short (1);
+		pack.put_byte (64);
+		pack.put_short (0);
+		pack.put_short (-1);
+		send_packet (b, pack, st);
+		
+		bot_packet held (0x09);
+		held.put_short (0);
+		send_packet (b, held, st);
+	}
+	
+	
+	
+//----
+	
+	bool
+	resolve (const std::string& host, int port, sockaddr_storage& addr, socklen_t& addr_len)
+	{
+		addrinfo hints, *res;
+		std::memset (&hints, 0, sizeof hints);
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		
+		if (getaddrinfo (host.c_str (), std::to_string (port).c_str (), &hints, &res) != 0)
+			return false;
+		
+		std::memcpy (&addr, res->ai_addr, res->ai_addrlen);
+		addr_len = res->ai_addrlen;
+		freeaddrinfo (res);
+		return true;
+	}
+	
+	void
+	kill_bot (bot& b, int epfd)
+	{
+		if (b.fd != -1)
+			{
+				epoll_ctl (epfd, EPOLL_CTL_DEL, b.fd, nullptr);
+				close (b.fd);
+				b.fd = -1;
+			}
+		b.state = BS_DEAD;
+		b.in.clear ();
+		b.out.clear ();
+	}
+	
+	bool
+	start_bot (bot& b, const sockaddr_storage& addr, socklen_t addr_len, int epfd)
+	{
+		b.fd = socket (addr.ss_family, SOCK_STREAM, 0);
+		if (b.fd == -1)
+			return false;
+		
+		fcntl (b.fd, F_SETFL, fcntl (b.fd, F_GETFL) | O_NONBLOCK);
+		int one = 1;
+		setsockopt (b.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+		
+		b.connect_time = clk::now ();
+		if (connect (b.fd, (const sockaddr *)&addr, addr_len) == -1 && errno != EINPROGRESS)
+			{
+				close (b.fd);
+				b.fd = -1;
+				return false;
+			}
+		
+		epoll_event ev;
+		ev.events = EPOLLIN | EPOLLOUT;
+		ev.data.u32 = b.index;
+		epoll_ctl (epfd, EPOLL_CTL_ADD, b.fd, &ev);
+		
+		b.state = BS_CONNECTING;
+		return true;
+	}
+	
+	/* 
+	 * Queues the handshake and login start packets.
+	 */
+	void
+	begin_login (bot& b, const bots_args& args, bots_stats& st)
+	{
+		bot_packet hs (0x00);
+		hs.put_varint (4); // 1.7.2
+		hs.put_string (args.host);
+		hs.put_short (args.port);
+		hs.put_varint (2); // login
+		send_packet (b, hs, st);
+		
+		bot_packet ls (0x00);
+		ls.put_string (b.name);
+		send_packet (b, ls, st);
+		
+		b.state = BS_LOGIN;
+	}
+	
+	
+	
+	/* 
+	 * Handles a single clientbound packet.
+	 * Returns false if the bot got disconnected.
+	 */
+	bool
+	handle_packet (bot& b, const unsigned char *data, size_t len, const bots_args& args,
+		bots_stats& st)
+	{
+		bot_reader reader (data, len);
+		int id = reader.read_varint ();
+		auto now = clk::now ();
+		
+		if (b.state == BS_LOGIN)
+			{
+				switch (id)
+					{
+						case 0x00: // disconnect
+							std::cerr << "hcraft-bots: " << b.name << " was refused: "
+								<< reader.read_string () << std::endl;
+							++ st.kicked;
+							return false;
+						
+						case 0x02: // login success
+							b.state = BS_PLAY;
+							break;
+						
+						default:
+							std::cerr << "hcraft-bots: " << b.name << ": unexpected login packet "
+								<< id << " (is the server in online mode?)" << std::endl;
+							++ st.failed;
+							return false;
+					}
+				return true;
+			}
+		
+		switch (id)
+			{
+				case 0x00: // keep alive
+					{
+						bot_packet pack (0x00);
+						pack.put_int (reader.read_int ());
+						send_packet (b, pack, st);
+						break;
+					}
+				
+				case 0x01: // join game
+					reader.read_int (); // entity id
+					b.gamemode = reader.read_byte () & 0x07;
+					break;
+				
+				case 0x02: // chat message
+					if (!b.chat_token.empty ())
+						{
+							std::string js = reader.read_string ();
+							if (js.find (b.chat_token) != std::string::npos)
+								{
+									st.rtt_ms.push_back (ms_since (b.chat_time, now));
+									b.chat_token.clear ();
+								}
+						}
+					break;
+				
+				case 0x08: // player position and look
+					{
+						b.x = reader.read_double ();
+						b.y = reader.read_double () - 1.62;
+						b.z = reader.read_double ();
+						b.yaw = reader.read_float ();
+						float pitch = reader.read_float ();
+						bool on_ground = reader.read_byte ();
+						
+						// confirm the position, like a real client would
+						bot_packet pack (0x06);
+						pack.put_double (b.x);
+						pack.put_double (b.y);
+						pack.put_double (b.y + 1.62);
+						pack.put_double (b.z);
+						pack.put_float (b.yaw);
+						pack.put_float (pitch);
+						pack.put_bool (on_ground);
+						send_packet (b, pack, st);
+						
+						if (!b.spawned)
+							{
+								b.spawned = true;
+								b.sx = b.x;
+								b.sz = b.z;
+								++ st.joined;
+								st.join_ms.push_back (ms_since (b.connect_time, now));
+								
+								b.next_move = now;
+								b.next_turn = now;
+								b.next_chat = after (now, jitter (b, args.chat_interval));
+								b.next_build = after (now, jitter (b, args.build_interval));
+								b.next_draw = after (now, jitter (b, args.draw_interval));
+							}
+						break;
+					}
+				
+				case 0x21: // chunk data
+					++ st.chunks;
+					break;
+				
+				case 0x26: // map chunk bulk
+					st.chunks += reader.read_short ();
+					break;
+				
+				case 0x40: // disconnect
+					std::cerr << "hcraft-bots: " << b.name << " was kicked: "
+						<< reader.read_string () << std::endl;
+					++ st.kicked;
+					return false;
+			}
+		
+		return true;
+	}
+	
+	/* 
+	 * Splits the input buffer into packets.
+	 */
+	bool
+	handle_input (bot& b, const bots_args& args, bots_stats& st)
+	{
+		size_t pos = 0;
+		while (pos < b.in.size ())
+			{
+				unsigned int len = 0;
+				size_t p = pos;
+				int i;
+				for (i = 0; i < 5 && p < b.in.size (); ++i)
+					{
+						unsigned char c = b.in[p++];
+						len |= (c & 0x7F) << (7 * i);
+						if (!(c & 0x80))
+							break;
+					}
+				if (i == 5)
+					{
+						++ st.failed;
+						return false;
+					}
+				if (p > b.in.size () || (b.in[p - 1] & 0x80) || (b.in.size () - p) < len)
+					break;
+				
+				if (len > 0 && !handle_packet (b, &b.in[p], len, args, st))
+					return false;
+				pos = p + len;
+			}
+		
+		b.in.erase (b.in.begin (), b.in.begin () + pos);
+		return true;
+	}
+	
+	bool
+	flush_output (bot& b)
+	{
+		if (b.out.empty ())
+			return true;
+		
+		ssize_t n = send (b.fd, b.out.data (), b.out.size (), MSG_NOSIGNAL);
+		if (n == -1)
+			return (errno == EAGAIN || errno == EWOULDBLOCK);
+		
+		b.out.erase (b.out.begin (), b.out.begin () + n);
+		return true;
+	}
+	
+	
+	
+	/* 
+	 * Performs whatever periodic actions are due for a spawned bot.
+	 */
+	void
+	act (bot& b, const bots_args& args, bots_stats& st, clk::time_point now)
+	{
+		if (now >= b.next_move)
+			{
+				if (now >= b.next_turn)
+					{
+						double dx = b.x - b.sx, dz = b.z - b.sz;
+						if ((dx * dx + dz * dz) > ((double)args.radius * args.radius))
+							{
+								// head back toward the spawn
+								b.yaw = std::atan2 (-dz, -dx);
+							}
+						else
+							{
+								std::uniform_real_distribution<double> dis (-M_PI, M_PI);
+								b.yaw = dis (b.rnd);
+							}
+						b.next_turn = after (now, jitter (b, 4.0));
+					}
+				
+				// 20 updates per second, like the vanilla client
+				double step = args.speed / 20.0;
+				b.x += std::cos (b.yaw) * step;
+				b.z += std::sin (b.yaw) * step;
+				send_position (b, st);
+				b.next_move = after (b.next_move, 0.05);
+				if (b.next_move < now)
+					b.next_move = after (now, 0.05);
+			}
+		
+		if (args.chat_interval > 0.0 && now >= b.next_chat)
+			{
+				if (b.chat_token.empty ())
+					{
+						b.chat_token = "#" + std::to_string (b.index) + "-" + std::to_string (b.chat_seq++);
+						b.chat_time = now;
+						send_chat (b, "load test " + b.chat_token, st);
+					}
+				else if (ms_since (b.chat_time, now) > 30000.0)
+					b.chat_token.clear (); // lost
+				b.next_chat = after (now, jitter (b, args.chat_interval));
+			}
+		
+		if (args.build_interval > 0.0 && now >= b.next_build && b.gamemode == 1)
+			{
+				if (!b.has_blocks)
+					{
+						send_give_blocks (b, st);
+						b.has_blocks = true;
+					}
+				
+				if (!b.placed)
+					{
+						b.px = (int)std::floor (b.x) + 1;
+						b.py = (int)std::floor (b.y);
+						b.pz = (int)std::floor (b.z);
+						if (b.py > 0 && b.py < 255)
+							{
+								send_place (b, b.px, b.py - 1, b.pz, st);
+								b.placed = true;
+								++ st.blocks;
+							}
+					}
+				else
+					{
+						send_dig (b, 0, b.px, b.py, b.pz, st);
+						b.placed = false;
+						++ st.blocks;
+					}
+				b.next_build = after (now, jitter (b, args.build_interval));
+			}
+		
+		if (args.draw_interval > 0.0 && now >= b.next_draw)
+			{
+				int bx = (int)std::floor (b.x), by = (int)std::floor (b.y), bz = (int)std::floor (b.z);
+				if (by > 4 && by < 250)
+					{
+						// alternate between filling and clearing the same area
+						send_chat (b, b.draw_fill ? "/cuboid stone" : "/cuboid air", st);
+						b.draw_fill = !b.draw_fill;
+						
+						int status = (b.gamemode == 1) ? 0 : 2;
+						send_dig (b, status, bx - 4, by - 4, bz - 4, st);
+						send_dig (b, status, bx + 4, by - 1, bz + 4, st);
+						++ st.draws;
+					}
+				b.next_draw = after (now, jitter (b, args.draw_interval));
+			}
+	}
+	
+	
+	
+//----
+	
+	int
+	find_server_pid ()
+	{
+		DIR *dir = opendir ("/proc");
+		if (!dir)
+			return -1;
+		
+		int pid = -1;
+		dirent *ent;
+		while ((ent = readdir (dir)))
+			{
+				if (ent->d_name[0] < '0' || ent->d_name[0] > '9')
+					continue;
+				
+				std::string path = std::string ("/proc/") + ent->d_name + "/comm";
+				FILE *fp = std::fopen (path.c_str (), "r");
+				if (!fp)
+					continue;
+				char comm[64] = { 0 };
+				if (std::fgets (comm, sizeof comm, fp) && std::strcmp (comm, "hCraft\n") == 0)
+					pid = std::atoi (ent->d_name);
+				std::fclose (fp);
+				if (pid != -1)
+					break;
+			}
+		
+		closedir (dir);
+		return pid;
+	}
+	
+	/* 
+	 * Reads the total CPU time (in clock ticks) and resident set size (in KiB)
+	 * of the given process.
+	 */
+	bool
+	read_proc_stat (int pid, unsigned long long& ticks, long& rss_kb)
+	{
+		std::string path = "/proc/" + std::to_string (pid) + "/stat";
+		FILE *fp = std::fopen (path.c_str (), "r");
+		if (!fp)
+			return false;
+		
+		char buf[1024];
+		size_t n = std::fread (buf, 1, sizeof buf - 1, fp);
+		std::fclose (fp);
+		buf[n] = '\0';
+		
+		// skip past the command name, which may contain spaces
+		const char *p = std::strrchr (buf, ')');
+		if (!p)
+			return false;
+		
+		// fields 3 (state) through 24 (rss)
+		unsigned long long utime = 0, stime = 0;
+		long rss = 0;
+		int field = 2;
+		for (const char *tok = p + 1; *tok; )
+			{
+				while (*tok == ' ') ++ tok;
+				if (!*tok) break;
+				++ field;
+				if (field == 14) utime = std::strtoull (tok, nullptr, 10);
+				else if (field == 15) stime = std::strtoull (tok, nullptr, 10);
+				else if (field == 24) { rss = std::atol (tok); break; }
+				while (*tok && *tok != ' ') ++ tok;
+			}
+		
+		ticks = utime + stime;
+		rss_kb = rss * (sysconf (_SC_PAGESIZE) / 1024);
+		return true;
+	}
+	
+	
+	
+//----
+	
+	double
+	percentile (std::vector<double>& vals, double p)
+	{
+		if (vals.empty ())
+			return 0.0;
+		std::sort (vals.begin (), vals.end ());
+		size_t i = (size_t)std::ceil (p / 100.0 * vals.size ());
+		return vals[(i > 0) ? (i - 1) : 0];
+	}
+	
+	void
+	print_report (const bots_args& args, bots_stats& st, double secs, bool have_cpu)
+	{
+		double cpu_avg = st.cpu_samples ? (st.cpu_sum / st.cpu_samples) : 0.0;
+		
+		double jp50 = percentile (st.join_ms, 50), jp95 = percentile (st.join_ms, 95),
+			jp99 = percentile (st.join_ms, 99), jmax = percentile (st.join_ms, 100);
+		double rp50 = percentile (st.rtt_ms, 50), rp95 = percentile (st.rtt_ms, 95),
+			rp99 = percentile (st.rtt_ms, 99), rmax = percentile (st.rtt_ms, 100);
+		
+		if (args.json)
+			{
+				std::printf (
+					"{\"bots\":%d,\"joined\":%d,\"failed\":%d,\"kicked\":%d,\"seconds\":%.2f,"
+					"\"join_ms\":{\"p50\":%.2f,\"p95\":%.2f,\"p99\":%.2f,\"max\":%.2f},"
+					"\"chunks\":%llu,\"chunks_per_sec\":%.2f,"
+					"\"bytes_in\":%llu,\"bytes_out\":%llu,"
+					"\"moves\":%llu,\"block_changes\":%llu,\"draws\":%llu,"
+					"\"rtt_ms\":{\"samples\":%zu,\"p50\":%.2f,\"p95\":%.2f,\"p99\":%.2f,\"max\":%.2f}",
+					args.count, st.joined, st.failed, st.kicked, secs,
+					jp50, jp95, jp99, jmax,
+					st.chunks, st.chunks / secs, st.bytes_in, st.bytes_out,
+					st.moves, st.blocks, st.draws,
+					st.rtt_ms.size (), rp50, rp95, rp99, rmax);
+				if (have_cpu)
+					std::printf (",\"server_cpu\":{\"avg\":%.1f,\"peak\":%.1f},\"server_rss_kb\":%ld",
+						cpu_avg, st.cpu_peak, st.rss_peak_kb);
+				std::printf ("}\n");
+				return;
+			}
+		
+		std::printf ("\n");
+		std::printf ("bots:          %d requested, %d joined, %d failed, %d kicked\n",
+			args.count, st.joined, st.failed, st.kicked);
+		std::printf ("duration:      %.1fs\n", secs);
+		std::printf ("join latency:  p50 %.1fms  p95 %.1fms  p99 %.1fms  max %.1fms\n",
+			jp50, jp95, jp99, jmax);
+		std::printf ("chunks:        %llu (%.1f/s)\n", st.chunks, st.chunks / secs);
+		std::printf ("traffic:       %.2f MiB in (%.2f MiB/s), %.2f MiB out\n",
+			st.bytes_in / 1048576.0, st.bytes_in / 1048576.0 / secs, st.bytes_out / 1048576.0);
+		std::printf ("actions:       %llu moves, %llu block changes, %llu draws\n",
+			st.moves, st.blocks, st.draws);
+		std::printf ("chat rtt:      p50 %.1fms  p95 %.1fms  p99 %.1fms  max %.1fms  (%zu samples)\n",
+			rp50, rp95, rp99, rmax, st.rtt_ms.size ());
+		if (have_cpu)
+			std::printf ("server:        %.1f%% cpu avg, %.1f%% peak, %.1f MiB rss peak\n",
+				cpu_avg, st.cpu_peak, st.rss_peak_kb / 1024.0);
+		else
+			std::printf ("server:        cpu usage unavailable (use --server-pid)\n");
+	}
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+	bots_args args;
+	if (!parse_args (argc, argv, args))
+		{
+			print_usage ();
+			return 1;
+		}
+	
+	sockaddr_storage addr;
+	socklen_t addr_len;
+	if (!resolve (args.host, args.port, addr, addr_len))
+		{
+			std::cerr << "hcraft-bots: could not resolve " << args.host << std::endl;
+			return 1;
+		}
+	
+	int pid = (args.server_pid != -1) ? args.server_pid : find_server_pid ();
+	unsigned long long last_ticks = 0;
+	long rss_kb;
+	bool have_cpu = (pid != -1) && read_proc_stat (pid, last_ticks, rss_kb);
+	long clk_tck = sysconf (_SC_CLK_TCK);
+	
+	std::signal (SIGINT, on_signal);
+	std::signal (SIGTERM, on_signal);
+	
+	int epfd = epoll_create1 (0);
+	if (epfd == -1)
+		{
+			std::cerr << "hcraft-bots: epoll_create1: " << std::strerror (errno) << std::endl;
+			return 1;
+		}
+	
+	std::vector<bot> bots (args.count);
+	for (int i = 0; i < args.count; ++i)
+		{
+			bot& b = bots[i];
+			b.index = i;
+			b.fd = -1;
+			b.name = args.prefix + std::to_string (i);
+			b.state = BS_IDLE;
+			b.spawned = false;
+			b.gamemode = 0;
+			b.has_blocks = false;
+			b.x = b.y = b.z = b.sx = b.sz = 0.0;
+			b.yaw = 0.0f;
+			b.chat_seq = 0;
+			b.placed = false;
+			b.px = b.py = b.pz = 0;
+			b.draw_fill = true;
+			b.rnd.seed (i * 7919 + 1);
+		}
+	
+	bots_stats st {};
+	
+	if (!args.json)
+		std::printf ("hcraft-bots: connecting %d bots to %s:%d (%d seconds)\n",
+			args.count, args.host.c_str (), args.port, args.duration);
+	
+	auto start = clk::now ();
+	auto end = after (start, args.duration);
+	auto next_sample = after (start, 1.0);
+	auto last_sample = start;
+	auto next_status = after (start, 5.0);
+	int started = 0;
+	
+	std::vector<epoll_event> events (256);
+	std::vector<unsigned char> rbuf (65536);
+	
+	while (!g_stop)
+		{
+			auto now = clk::now ();
+			if (now >= end)
+				break;
+			
+			// ramp up
+			while (started < args.count &&
+				std::chrono::duration_cast<std::chrono::duration<double>> (now - start).count ()
+					* args.ramp >= started)
+				{
+					bot& b = bots[started++];
+					if (!start_bot (b, addr, addr_len, epfd))
+						{
+							b.state = BS_DEAD;
+							++ st.failed;
+						}
+				}
+			
+			int n = epoll_wait (epfd, events.data (), events.size (), 5);
+			now = clk::now ();
+			for (int i = 0; i < n; ++i)
+				{
+					bot& b = bots[events[i].data.u32];
+					if (b.state == BS_DEAD)
+						continue;
+					
+					if (b.state == BS_CONNECTING)
+						{
+							int err = 0;
+							socklen_t err_len = sizeof err;
+							getsockopt (b.fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+							if (err != 0)
+								{
+									std::cerr << "hcraft-bots: " << b.name << ": connect: "
+										<< std::strerror (err) << std::endl;
+									kill_bot (b, epfd);
+									++ st.failed;
+									continue;
+								}
+							
+							++ st.connected;
+							begin_login (b, args, st);
+						}
+					
+					if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+						{
+							bool alive = true;
+							for (;;)
+								{
+									ssize_t r = recv (b.fd, rbuf.data (), rbuf.size (), 0);
+									if (r > 0)
+										{
+											st.bytes_in += r;
+											b.in.insert (b.in.end (), rbuf.begin (), rbuf.begin () + r);
+											continue;
+										}
+									if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+										alive = false;
+									break;
+								}
+							
+							if (!handle_input (b, args, st))
+								{
+									kill_bot (b, epfd);
+									continue;
+								}
+							if (!alive)
+								{
+									if (b.spawned)
+										++ st.kicked;
+									else
+										++ st.failed;
+									kill_bot (b, epfd);
+									continue;
+								}
+						}
+				}
+			
+			// periodic actions and output
+			for (bot& b : bots)
+				{
+					if (b.state == BS_DEAD || b.state == BS_IDLE || b.state == BS_CONNECTING)
+						continue;
+					
+					if (b.spawned)
+						act (b, args, st, now);
+					if (!flush_output (b))
+						{
+							std::cerr << "hcraft-bots: " << b.name << ": connection lost" << std::endl;
+							++ st.kicked;
+							kill_bot (b, epfd);
+						}
+				}
+			
+			if (have_cpu && now >= next_sample)
+				{
+					unsigned long long ticks;
+					if (read_proc_stat (pid, ticks, rss_kb))
+						{
+							double secs = ms_since (last_sample, now) / 1000.0;
+							double cpu = (ticks - last_ticks) * 100.0 / clk_tck / secs;
+							st.cpu_sum += cpu;
+							++ st.cpu_samples;
+							st.cpu_peak = std::max (st.cpu_peak, cpu);
+							st.rss_peak_kb = std::max (st.rss_peak_kb, rss_kb);
+							last_ticks = ticks;
+						}
+					last_sample = now;
+					next_sample = after (now, 1.0);
+				}
+			
+			if (!args.json && now >= next_status)
+				{
+					std::fprintf (stderr, "  %5.0fs: %d/%d joined, %llu chunks\n",
+						ms_since (start, now) / 1000.0, st.joined, args.count, st.chunks);
+					next_status = after (now, 5.0);
+				}
+		}
+	
+	double secs = ms_since (start, clk::now ()) / 1000.0;
+	for (bot& b : bots)
+		if (b.fd != -1)
+			kill_bot (b, epfd);
+	close (epfd);
+	
+	print_report (args, st, secs, have_cpu && st.cpu_samples > 0);
+	return 0;
+}
+
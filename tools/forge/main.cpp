@@ -0,0 +1,364 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012-2013	Jacob Zhitomirsky (BizarreCake)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* 
+ * hcraft-forge - offline world pre-generation and conversion.
+ * 
+ * Usage:
+ *   hcraft-forge generate <world> -w <width> -d <depth> [-g <generator>] [-s <seed>]
+ *   hcraft-forge convert <world> <new-world> [--relight]
+ *   hcraft-forge recompress <world> [--relight]
+ * 
+ * Common options:
+ *   -j <threads>  -c <codec>  -l <level>  --dir <world directory>
+ * 
+ * All commands can be interrupted and later resumed by running them again.
+ */
+
+#include "system/logger.hpp"
+#include "system/server.hpp"
+#include "world/world.hpp"
+#include "world/forge.hpp"
+#include "world/providers/worldprovider.hpp"
+#include "world/generation/worldgenerator.hpp"
+#include "util/codec.hpp"
+#include "util/utils.hpp"
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <sys/stat.h>
+
+using namespace hCraft;
+
+
+namespace {
+	
+	struct forge_args
+	{
+		std::string cmd;
+		std::string names[2];
+		int name_count;
+		
+		std::string dir;
+		std::string gen_name;
+		long seed;
+		int width, depth;
+		
+		forge_options opts;
+	};
+	
+	
+	
+	void
+	print_usage ()
+	{
+		std::cout <<
+			"usage:\n"
+			"  hcraft-forge generate <world> -w <width> -d <depth> [-g <generator>] [-s <seed>]\n"
+			"  hcraft-forge convert <world> <new-world> [--relight]\n"
+			"  hcraft-forge recompress <world> [--relight]\n"
+			"\n"
+			"options:\n"
+			"  -j <threads>   number of threads to use (default: one per core)\n"
+			"  -c <codec>     chunk codec (zlib, raw, lz4)\n"
+			"  -l <level>     compression level (0-9)\n"
+			"  --dir <path>   world directory (default: data/worlds)\n";
+	}
+	
+	bool
+	parse_args (int argc, char *argv[], forge_args& out)
+	{
+		if (argc < 3)
+			return false;
+		
+		out.cmd = argv[1];
+		out.name_count = 0;
+		out.dir = "data/worlds";
+		out.gen_name = "flatgrass";
+		out.seed = utils::ns_since_epoch () & 0x7FFFFFFF;
+		out.width = out.depth = 0;
+		
+		for (int i = 2; i < argc; ++i)
+			{
+				std::string arg = argv[i];
+				bool has_val = (i + 1) < argc;
+				
+				if (arg == "--relight")
+					out.opts.relight = true;
+				else if (arg == "-j" && has_val)
+					out.opts.threads = std::atoi (argv[++i]);
+				else if (arg == "-l" && has_val)
+					out.opts.level = std::atoi (argv[++i]);
+				else if (arg == "-c" && has_val)
+					{
+						out.opts.codec = codec::from_name (argv[++i]);
+						if (out.opts.codec == -1 || !codec::available (out.opts.codec))
+							{
+								std::cerr << "hcraft-forge: unsupported codec: " << argv[i] << std::endl;
+								return false;
+							}
+					}
+				else if (arg == "-w" && has_val)
+					out.width = std::atoi (argv[++i]);
+				else if (arg == "-d" && has_val)
+					out.depth = std::atoi (argv[++i]);
+				else if (arg == "-g" && has_val)
+					out.gen_name = argv[++i];
+				else if (arg == "-s" && has_val)
+					out.seed = std::atol (argv[++i]);
+				else if (arg == "--dir" && has_val)
+					out.dir = argv[++i];
+				else if (arg[0] != '-' && out.name_count < 2)
+					out.names[out.name_count++] = arg;
+				else
+					{
+						std::cerr << "hcraft-forge: unexpected argument: " << arg << std::endl;
+						return false;
+					}
+			}
+		
+		if (out.name_count == 0)
+			return false;
+		for (int i = 0; i < out.name_count; ++i)
+			if (!world::is_valid_name (out.names[i].c_str ()))
+				{
+					std::cerr << "hcraft-forge: invalid world name: " << out.names[i] << std::endl;
+					return false;
+				}
+		
+		return true;
+	}
+	
+	
+	
+	void
+	print_progress (int done, int total)
+	{
+		std::printf ("\r  %d/%d chunks (%.1f%%)", done, total,
+			(total > 0) ? (done * 100.0 / total) : 100.0);
+		std::fflush (stdout);
+	}
+	
+	/* 
+	 * Opens an existing world without loading any of its chunks.
+	 */
+	world*
+	open_world (server& srv, logger& log, const std::string& dir, const std::string& name)
+	{
+		std::string prov_name = world_provider::determine (dir.c_str (), name.c_str ());
+		if (prov_name.empty ())
+			return nullptr;
+		
+		world_provider *prov = world_provider::create (prov_name.c_str (),
+			dir.c_str (), name.c_str ());
+		if (!prov)
+			return nullptr;
+		
+		const world_information& inf = prov->info ();
+		world_generator *gen = world_generator::create (inf.generator.c_str (), inf.seed);
+		if (!gen)
+			{
+				delete prov;
+				return nullptr;
+			}
+		
+		world_type wtyp = (inf.world_type == "LIGHT") ? WT_LIGHT : WT_NORMAL;
+		world *w = new world (wtyp, srv, name.c_str (), log, gen, prov);
+		w->set_size (inf.width, inf.depth);
+		w->set_spawn (inf.spawn_pos);
+		w->set_time (inf.time);
+		if (inf.time_frozen)
+			w->stop_time ();
+		w->def_gm = (inf.def_gm == "CREATIVE") ? GT_CREATIVE : GT_SURVIVAL;
+		w->def_inv = inf.def_inv;
+		w->use_def_inv = inf.use_def_inv;
+		w->view_dist = inf.view_dist;
+		return w;
+	}
+	
+	/* 
+	 * Creates an empty world named @{name} that has the same dimensions and
+	 * generator as @{src}.
+	 */
+	world*
+	create_like (server& srv, logger& log, const std::string& dir,
+		const std::string& name, world *src)
+	{
+		world_generator *gen = world_generator::create (src->get_generator ()->name (),
+			src->get_generator ()->seed ());
+		world_provider *prov = world_provider::create ("hw", dir.c_str (), name.c_str ());
+		if (!gen || !prov)
+			{
+				delete gen;
+				delete prov;
+				return nullptr;
+			}
+		
+		world *w = new world (src->get_type (), srv, name.c_str (), log, gen, prov);
+		w->set_size (src->get_width (), src->get_depth ());
+		return w;
+	}
+	
+	
+	
+	int
+	cmd_generate (server& srv, logger& log, forge_args& args)
+	{
+		world *w = open_world (srv, log, args.dir, args.names[0]);
+		if (w)
+			std::cout << "Resuming generation of \"" << args.names[0] << "\"" << std::endl;
+		else
+			{
+				if (args.width <= 0 || args.depth <= 0)
+					{
+						std::cerr << "hcraft-forge: only bounded worlds can be pre-generated (-w, -d)" << std::endl;
+						return 1;
+					}
+				
+				world_generator *gen = world_generator::create (args.gen_name.c_str (), args.seed);
+				if (!gen)
+					{
+						std::cerr << "hcraft-forge: invalid generator: " << args.gen_name << std::endl;
+						return 1;
+					}
+				
+				world_provider *prov = world_provider::create ("hw", args.dir.c_str (),
+					args.names[0].c_str ());
+				w = new world (WT_NORMAL, srv, args.names[0].c_str (), log, gen, prov);
+				w->set_size (args.width, args.depth);
+				std::cout << "Generating \"" << args.names[0] << "\" (" << args.width
+					<< "x" << args.depth << ", " << args.gen_name << ")" << std::endl;
+			}
+		
+		world_forge forge {*w, args.opts};
+		int n = forge.pregenerate ();
+		std::cout << std::endl << "Generated " << n << " chunks." << std::endl;
+		
+		delete w;
+		return 0;
+	}
+	
+	int
+	cmd_convert (server& srv, logger& log, forge_args& args,
+		const std::string& src_name, const std::string& dest_name)
+	{
+		world *src = open_world (srv, log, args.dir, src_name);
+		if (!src)
+			{
+				std::cerr << "hcraft-forge: cannot open world: " << src_name << std::endl;
+				return 1;
+			}
+		
+		world *dest = create_like (srv, log, args.dir, dest_name, src);
+		if (!dest)
+			{
+				delete src;
+				std::cerr << "hcraft-forge: cannot create world: " << dest_name << std::endl;
+				return 1;
+			}
+		
+		std::cout << "Converting \"" << src_name << "\" into \"" << dest_name << "\"" << std::endl;
+		world_forge forge {*dest, args.opts};
+		int n = forge.convert (*src);
+		std::cout << std::endl << "Copied " << n << " chunks." << std::endl;
+		
+		delete dest;
+		delete src;
+		return 0;
+	}
+	
+	int
+	cmd_recompress (server& srv, logger& log, forge_args& args)
+	{
+		const std::string& name = args.names[0];
+		std::string tmp_name = name + "_forge";
+		
+		std::string src_path, tmp_path;
+		{
+			world *src = open_world (srv, log, args.dir, name);
+			if (!src)
+				{
+					std::cerr << "hcraft-forge: cannot open world: " << name << std::endl;
+					return 1;
+				}
+			src_path = src->get_path ();
+			delete src;
+		}
+		
+		int res = cmd_convert (srv, log, args, name, tmp_name);
+		if (res != 0)
+			return res;
+		
+		{
+			world *tmp = open_world (srv, log, args.dir, tmp_name);
+			if (!tmp)
+				return 1;
+			tmp_path = tmp->get_path ();
+			delete tmp;
+		}
+		
+		if (std::rename (tmp_path.c_str (), src_path.c_str ()) != 0)
+			{
+				std::cerr << "hcraft-forge: could not replace " << src_path << std::endl;
+				return 1;
+			}
+		return 0;
+	}
+}
+
+
+
+int
+main (int argc, char *argv[])
+{
+	forge_args args;
+	if (!parse_args (argc, argv, args))
+		{
+			print_usage ();
+			return 1;
+		}
+	args.opts.progress = print_progress;
+	
+	mkdir ("data", 0744);
+	mkdir (args.dir.c_str (), 0744);
+	
+	// worlds need a server instance, but nothing in it is started.
+	logger log;
+	server srv (log);
+	
+	try
+		{
+			if (args.cmd == "generate")
+				return cmd_generate (srv, log, args);
+			else if (args.cmd == "convert" && args.name_count == 2)
+				return cmd_convert (srv, log, args, args.names[0], args.names[1]);
+			else if (args.cmd == "recompress")
+				return cmd_recompress (srv, log, args);
+		}
+	catch (const std::exception& ex)
+		{
+			std::cerr << std::endl << "hcraft-forge: " << ex.what () << std::endl;
+			return 1;
+		}
+	
+	print_usage ();
+	return 1;
+}
+